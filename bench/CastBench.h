@@ -0,0 +1,124 @@
+/**
+ * \file   CastBench.h
+ * \author Jan Milík <milikjan@fit.cvut.cz>
+ * \date   2026-10-19
+ *
+ * \brief  Benchmarks of fast_cast against dynamic_cast.
+ */
+
+#ifndef CASTBENCH_W8NP4DKT
+#define CASTBENCH_W8NP4DKT
+
+
+#include <cppapp/cppapp.h>
+using namespace cppapp;
+
+
+/**
+ * \brief Casts done by the walk, through \ref fast_cast().
+ */
+struct FastCaster {
+	template<class U>
+	static U* cast(DynObject *obj) { return fast_cast<U>(obj); }
+};
+
+
+/**
+ * \brief Casts done by the walk, through \c dynamic_cast.
+ */
+struct DynamicCaster {
+	template<class U>
+	static U* cast(DynObject *obj) { return dynamic_cast<U*>(obj); }
+};
+
+
+/**
+ * \brief Walks a tree of dictionaries and lists by casting every node,
+ *        counts the strings.
+ */
+template<class Caster>
+long benchWalk(DynObject *obj)
+{
+	if (DynDict *dict = Caster::template cast<DynDict>(obj)) {
+		long count = 0;
+		FOR_EACH(*dict, it)
+			count += benchWalk<Caster>(it->second.getPtr());
+		return count;
+	}
+	if (DynList *list = Caster::template cast<DynList>(obj)) {
+		long count = 0;
+		FOR_EACH(*list, it)
+			count += benchWalk<Caster>(it->getPtr());
+		return count;
+	}
+	if (Caster::template cast<DynString>(obj) != NULL)
+		return 1;
+	return 0;
+}
+
+
+/**
+ * \brief Builds a tree \p depth levels deep, every dictionary has a name,
+ *        a number and a list of four children.
+ */
+Ref<DynObject> benchBuildTree(int depth)
+{
+	TextLoc      loc("<bench>");
+	Ref<DynDict> dict = new DynDict(loc);
+	dict->setStrItem("name", new DynString(loc, "node"));
+	dict->setStrItem("size", new DynNumber(loc, depth));
+
+	if (depth > 0) {
+		Ref<DynList> children = new DynList(loc);
+		for (int i = 0; i < 4; i++)
+			children->append(benchBuildTree(depth - 1));
+		dict->setStrItem("children", children.as<DynObject>());
+	}
+
+	return dict.as<DynObject>();
+}
+
+
+/**
+ * \brief Walks a tree of about 1 400 dictionaries, casting each node to
+ *        the dictionary, list and string classes.
+ */
+class CastBench : public BenchmarkCase {
+private:
+	Ref<DynObject> tree_;
+
+public:
+	CastBench()
+	{
+		BENCH_ADD(CastBench, benchFastCast);
+		BENCH_ADD(CastBench, benchDynamicCast);
+	}
+
+	virtual void setUp()
+	{
+		tree_ = benchBuildTree(5);
+	}
+
+	virtual void tearDown()
+	{
+		tree_ = NULL;
+	}
+
+	void benchFastCast(long iterations)
+	{
+		for (long i = 0; i < iterations; i++)
+			benchSink(benchWalk<FastCaster>(tree_.getPtr()));
+	}
+
+	void benchDynamicCast(long iterations)
+	{
+		for (long i = 0; i < iterations; i++)
+			benchSink(benchWalk<DynamicCaster>(tree_.getPtr()));
+	}
+};
+
+
+RUN_SUITE(CastBench);
+
+
+#endif /* end of include guard: CASTBENCH_W8NP4DKT */
@@ -0,0 +1,177 @@
+/**
+ * \file   ConfigBench.h
+ * \author Jan Milík <milikjan@fit.cvut.cz>
+ * \date   2026-10-19
+ *
+ * \brief  Benchmarks of the configuration parser.
+ */
+
+#ifndef CONFIGBENCH_Q3LW8ZRE
+#define CONFIGBENCH_Q3LW8ZRE
+
+
+#include <unistd.h>
+#include <cctype>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+#include <cppapp/cppapp.h>
+using namespace cppapp;
+
+
+/**
+ * \brief Writes a file of \p lines feature flags with some comments and
+ *        blank lines.
+ */
+static void benchWriteConfigFile(const std::string &fileName, int lines)
+{
+	std::ofstream out(fileName.c_str());
+
+	for (int i = 0; i < lines; i++) {
+		if (i % 100 == 0)
+			out << "# feature flags " << i << "\n\n";
+		out << "feature.flag_" << i << " = " << ((i % 3 == 0) ? "true" : "false") << "\n";
+	}
+}
+
+
+/**
+ * \brief The character by character parser that \ref ConfigParser
+ *        replaced, kept as the baseline of \ref ConfigBench.
+ *
+ * Reads the stream with \c peek() and \c get(), builds keys and values
+ * in string streams and sets them one by one.
+ */
+class BenchStreamConfigParser {
+private:
+	Ref<Config>   config_;
+	std::istream *in_;
+	bool          error_;
+
+	int peek() { return in_->peek(); }
+	int get()  { return in_->get(); }
+
+	bool shouldContinue() { return !error_ && in_->good(); }
+
+	void skipWhitespace()
+	{
+		if (!shouldContinue()) return;
+		while ((peek() != '\n') && isspace(peek()))
+			get();
+	}
+
+	void readLine()
+	{
+		if (!shouldContinue()) return;
+
+		skipWhitespace();
+		if (peek() == '#') {
+			while ((peek() != '\n') && (peek() != EOF))
+				get();
+		} else if (isalnum(peek())) {
+			std::ostringstream key;
+			while (!isspace(peek()) && (peek() != '=') && (peek() != EOF))
+				key.put(get());
+			skipWhitespace();
+			if (peek() != '=') {
+				error_ = true;
+				return;
+			}
+			get();
+			skipWhitespace();
+
+			std::ostringstream value;
+			while ((peek() != '\n') && (peek() != EOF))
+				value.put(get());
+			config_->set(new ConfigValue(key.str(), value.str()));
+		}
+		skipWhitespace();
+	}
+
+public:
+	BenchStreamConfigParser(Ref<Config> config) : config_(config), in_(NULL), error_(false) {}
+
+	bool parse(Ref<Input> input)
+	{
+		in_    = input->getStream();
+		error_ = false;
+
+		while (true) {
+			readLine();
+			if (peek() != '\n') break;
+			get();
+		}
+		return !error_ && (peek() == EOF);
+	}
+};
+
+
+/**
+ * \brief Parses a file of 500 000 feature flags with the old character
+ *        by character parser, through a stream and from a mapped file.
+ */
+class ConfigBench : public BenchmarkCase {
+private:
+	std::string fileName_;
+
+public:
+	ConfigBench()
+	{
+		BENCH_ADD(ConfigBench, benchBaseline);
+		BENCH_ADD(ConfigBench, benchStream);
+		BENCH_ADD(ConfigBench, benchMapped);
+	}
+
+	virtual void setUp()
+	{
+		char fileName[] = "/tmp/cppapp-bench-XXXXXX";
+		int  fd         = mkstemp(fileName);
+		CPPAPP_ASSERT(fd >= 0);
+		close(fd);
+
+		fileName_ = fileName;
+		benchWriteConfigFile(fileName_, 500000);
+	}
+
+	virtual void tearDown()
+	{
+		unlink(fileName_.c_str());
+	}
+
+	void benchBaseline(long iterations)
+	{
+		for (long i = 0; i < iterations; i++) {
+			Ref<Config> config = new Config();
+			BenchStreamConfigParser parser(config);
+			parser.parse(new FileInput(fileName_));
+			benchSink(config->get("feature.flag_3")->asBool());
+		}
+	}
+
+	void benchStream(long iterations)
+	{
+		for (long i = 0; i < iterations; i++) {
+			Ref<Config> config = new Config();
+			ConfigParser parser(config);
+			parser.parse(new FileInput(fileName_));
+			benchSink(config->get("feature.flag_3")->asBool());
+		}
+	}
+
+	void benchMapped(long iterations)
+	{
+		for (long i = 0; i < iterations; i++) {
+			Ref<Config> config = new Config();
+			ConfigParser parser(config);
+			parser.parseFile(fileName_);
+			benchSink(config->get("feature.flag_3")->asBool());
+		}
+	}
+};
+
+
+RUN_SUITE(ConfigBench);
+
+
+#endif /* end of include guard: CONFIGBENCH_Q3LW8ZRE */
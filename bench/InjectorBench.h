@@ -0,0 +1,136 @@
+/**
+ * \file   InjectorBench.h
+ * \author Jan Milík <milikjan@fit.cvut.cz>
+ * \date   2026-10-19
+ *
+ * \brief  Startup-time benchmarks of the dependency injection.
+ */
+
+#ifndef INJECTORBENCH_K2VN7QXA
+#define INJECTORBENCH_K2VN7QXA
+
+
+#include <unistd.h>
+#include <sstream>
+
+#include <cppapp/cppapp.h>
+using namespace cppapp;
+
+
+/**
+ * \brief Object made by a synthetic slow factory; it accepts any
+ *        dependency.
+ */
+class BenchSlowObject : public DIObject {
+public:
+	std::vector<Ref<DIObject> > dependencies;
+
+	virtual bool injectDependency(Ref<DIObject> obj, std::string key)
+	{
+		dependencies.push_back(obj);
+		return true;
+	}
+};
+
+
+/**
+ * \brief Sleeps for the number of microseconds given by the \c "delay"
+ *        key, like a factory preloading data.
+ */
+Ref<DIObject> benchCreateSlow(Ref<DynObject> config, Ref<DIObject> parent)
+{
+	if (config->hasStrItem("delay"))
+		usleep(config->getStrItem("delay")->getInt());
+	return new BenchSlowObject();
+}
+
+
+/**
+ * \brief Returns a plan with \p children children, each with
+ *        \p grandchildren children, all taking \p delay microseconds.
+ */
+std::string benchMakeStartupConfig(int children, int grandchildren, int delay)
+{
+	std::ostringstream out;
+
+	out << "[ { \"key\": \"bench.root\", \"factory\": \"bench.slow\", \"children\": [";
+	for (int i = 0; i < children; i++) {
+		out << "{ \"key\": \"child" << i << "\", \"factory\": \"bench.slow\", "
+		    << "\"delay\": " << delay << ", \"children\": [";
+		for (int j = 0; j < grandchildren; j++) {
+			out << "{ \"key\": \"leaf" << j << "\", \"factory\": \"bench.slow\", "
+			    << "\"delay\": " << delay << " },";
+		}
+		out << "] },";
+	}
+	out << "] } ]";
+
+	return out.str();
+}
+
+
+/**
+ * \brief Instantiates a tree of slow objects sequentially and with
+ *        thread pools of several sizes.
+ */
+class InjectorBench : public BenchmarkCase {
+private:
+	Ref<ThreadPool> pool2_;
+	Ref<ThreadPool> pool4_;
+	Ref<ThreadPool> pool8_;
+
+	void startup(long iterations, Ref<ThreadPool> pool)
+	{
+		Injector::getInstance().setThreadPool(pool);
+		for (long i = 0; i < iterations; i++) {
+			Ref<DIObject> root = Injector::getInstance().instantiate("bench.root");
+			CPPAPP_ASSERT(root.isNotNull());
+		}
+		Injector::getInstance().setThreadPool(NULL);
+	}
+
+public:
+	InjectorBench()
+	{
+		BENCH_ADD(InjectorBench, benchSequential);
+		BENCH_ADD(InjectorBench, benchParallel2);
+		BENCH_ADD(InjectorBench, benchParallel4);
+		BENCH_ADD(InjectorBench, benchParallel8);
+	}
+
+	/**
+	 * 16 children with 4 children each, every object takes 1 ms to
+	 * create.
+	 */
+	virtual void setUp()
+	{
+		Injector::getInstance().clear();
+		CPPAPP_DI_FUNCTION("bench.slow", benchCreateSlow);
+
+		JSONParser parser;
+		Injector::getInstance().makePlans(parser.parse(benchMakeStartupConfig(16, 4, 1000)));
+
+		pool2_ = new ThreadPool(2);
+		pool4_ = new ThreadPool(4);
+		pool8_ = new ThreadPool(8);
+	}
+
+	virtual void tearDown()
+	{
+		Injector::getInstance().clear();
+		pool2_ = NULL;
+		pool4_ = NULL;
+		pool8_ = NULL;
+	}
+
+	void benchSequential(long iterations) { startup(iterations, NULL); }
+	void benchParallel2(long iterations) { startup(iterations, pool2_); }
+	void benchParallel4(long iterations) { startup(iterations, pool4_); }
+	void benchParallel8(long iterations) { startup(iterations, pool8_); }
+};
+
+
+RUN_SUITE(InjectorBench);
+
+
+#endif /* end of include guard: INJECTORBENCH_K2VN7QXA */
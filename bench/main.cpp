@@ -0,0 +1,20 @@
+/**
+ * \file   main.cpp
+ * \author Jan Milík <milikjan@fit.cvut.cz>
+ * \date   2026-10-19
+ *
+ * \brief  Runs the cppapp benchmarks.
+ */
+
+#include <iostream>
+using namespace std;
+
+#include <cppapp/cppapp.h>
+using namespace cppapp;
+
+#include "InjectorBench.h"
+#include "ConfigBench.h"
+#include "CastBench.h"
+
+
+BENCHAPP_BOOTSTRAP;
@@ -8,6 +8,7 @@
 
 #include "AppBase.h"
 #include "Logger.h"
+#include "Trace.h"
 
 #include <sstream>
 
@@ -42,19 +43,51 @@ void AppBase::readConfig()
 	
 	string configFileName = config_->get(CPPAPP_CONFIG_FILE_CFG_KEY,
 								  getDefaultConfigFile())->asString();
+	configFileName_ = configFileName;
 	
-	Ref<FileInput> configInput = new FileInput(configFileName);
-	if (configInput->exists()) {
-		ConfigParser parser(config_);
-		parser.parse(configInput);
-		configInput->close();
-	} else {
-		LOG_WARNING("Configuration file " << configFileName << " does not exist.");
-	}
+	ConfigLayers layers;
+	layers.addFile(configFileName);
+	
+	string prefix = getEnvironmentPrefix();
+	if (!prefix.empty())
+		layers.addEnvironment(prefix);
 	
 	// Override the configuration read from the file by the command line
 	// options.
-	options_.setConfigKeys(config_);
+	layers.addCommandLine(options_);
+	
+	// The global configuration must not change once it is published, the
+	// layers are flattened into a copy which then replaces it.
+	Ref<Config> config = new Config();
+	config->copyDefaults(config_);
+	config->merge(config_);
+	layers.flatten(config);
+	
+	if (config_.getPtr() == Config::globalConfig().getPtr())
+		Config::setGlobalConfig(config);
+	config_ = config;
+}
+
+
+Ref<ConfigWatcher> AppBase::watchConfig(int interval)
+{
+	if (configWatcher_.isNotNull())
+		return configWatcher_;
+	
+	string fileName = configFileName_;
+	if (fileName.empty())
+		fileName = config_->get(CPPAPP_CONFIG_FILE_CFG_KEY, getDefaultConfigFile())->asString();
+	
+	ConfigLayers layers;
+	string prefix = getEnvironmentPrefix();
+	if (!prefix.empty())
+		layers.addEnvironment(prefix);
+	layers.addCommandLine(options_);
+	Ref<Config> overrides = layers.flatten();
+	
+	configWatcher_ = new ConfigWatcher(fileName, overrides, interval);
+	configWatcher_->start();
+	return configWatcher_;
 }
 
 
@@ -123,15 +156,44 @@ AppBase::AppBase(bool readConfig) :
 }
 
 
+/**
+ * If the \c CPPAPP_TRACE environment variable is set, tracing is enabled
+ * and the spans are written to the file it names when the application
+ * returns.
+ */
 int AppBase::run(int argc, char* argv[])
 {
+	const char *traceFile = getenv("CPPAPP_TRACE");
+	bool        trace     = (traceFile != NULL) && (*traceFile != '\0');
+	if (trace)
+		Tracer::enable();
+	
+	int result = runTraced(argc, argv);
+	
+	if (trace)
+		Tracer::flush(new FileOutput(traceFile));
+	
+	return result;
+}
+
+
+int AppBase::runTraced(int argc, char* argv[])
+{
+	TRACE_SCOPE("AppBase::run");
+	
 	// Call setUp hook.
-	setUp();
+	{
+		TRACE_SCOPE("AppBase::setUp");
+		setUp();
+	}
 	
 	Logger::defaultConfig();
 	
 	// Parse command line options
-	options_.parse(argc, argv);
+	{
+		TRACE_SCOPE("Options::parse");
+		options_.parse(argc, argv);
+	}
 	if (!options_.isValid()) {
 		printUsage(std::cerr);
 		return EXIT_FAILURE;
@@ -140,9 +202,13 @@ int AppBase::run(int argc, char* argv[])
 		options_.get(CPPAPP_CONFIG_FILE_CFG_KEY).setConfigKey(config_);
 	
 	// Parse configuration file
-	readConfig();
+	{
+		TRACE_SCOPE("AppBase::readConfig");
+		readConfig();
+	}
 	
 	// Run the actual application.
+	TRACE_SCOPE("AppBase::onRun");
 	return onRun();
 }
 
@@ -15,6 +15,8 @@
 
 #include "Object.h"
 #include "Config.h"
+#include "ConfigWatcher.h"
+#include "ConfigLayers.h"
 #include "Options.h"
 #include "Output.h"
 #include "Logger.h"
@@ -42,11 +44,16 @@ class AppBase : public Object {
 private:
 	bool        readConfig_;
 	Ref<Config> config_;
+	string      configFileName_;
+	
+	Ref<ConfigWatcher> configWatcher_;
 	
 	Options     options_;
 	Ref<Output> output_;
 	
 	AppBase(const AppBase& other);
+	
+	int runTraced(int argc, char* argv[]);
 
 protected:
 	/**
@@ -54,6 +61,12 @@ protected:
 	 *        the applications.
 	 */
 	virtual string      getDefaultConfigFile();
+	/**
+	 * \brief Returns the prefix of environment variables that set
+	 *        configuration keys (see \ref ConfigLayers::addEnvironment()),
+	 *        or an empty string (the default) to ignore the environment.
+	 */
+	virtual string      getEnvironmentPrefix() { return ""; }
 	/**
 	 * \brief Returns the configuration object. 
 	 */
@@ -95,10 +108,29 @@ protected:
 	/**
 	 * \brief Reads the configuration file.
 	 *
+	 * The file, the environment (see \ref getEnvironmentPrefix()) and the
+	 * command-line options are flattened by \ref ConfigLayers over a copy
+	 * of \ref config(), in this order of precedence. The copy replaces
+	 * \ref config() and, if that was the global configuration, is
+	 * published by \ref Config::setGlobalConfig().
+	 *
 	 * This method is made virtual protected so that it can be overriden
 	 * in a subclass.
 	 */
 	virtual void        readConfig();
+	/**
+	 * \brief Starts reloading the configuration file when it changes.
+	 *
+	 * Values set by the environment and command-line options keep
+	 * overriding the file. The
+	 * reloaded configuration is published as \ref Config::globalConfig(),
+	 * \ref config() keeps returning the configuration read at startup.
+	 * Register listeners on the returned watcher.
+	 *
+	 * \param interval interval of the modification time checks in
+	 *                 milliseconds
+	 */
+	Ref<ConfigWatcher>  watchConfig(int interval = CPPAPP_CONFIG_WATCH_INTERVAL);
 	/**
 	 * \brief Sets up command line options and does whatever initialization
 	 *        is necessary before executing the application.
@@ -0,0 +1,83 @@
+/**
+ * \file   BenchApp.cpp
+ * \author Jan Milík <milikjan@fit.cvut.cz>
+ * \date   2026-10-19
+ *
+ * \brief  Implementation file for the BenchApp class.
+ */
+
+#include "BenchApp.h"
+#include "Logger.h"
+
+
+namespace cppapp {
+
+
+void BenchApp::setUp()
+{
+	AppBase::setUp();
+	
+	options().add('b',
+			    "",
+			    "BASELINE",
+			    "bench_baseline",
+			    "Compare the results with BASELINE, a file written by -j.");
+	options().add('j',
+			    "",
+			    "JSON_FILE",
+			    "bench_json",
+			    "Write the results to JSON_FILE.");
+	options().add('r',
+			    "10",
+			    "PERCENT",
+			    "bench_threshold",
+			    "Report benchmarks more than PERCENT slower than the baseline as regressions.");
+	options().add('m',
+			    "100",
+			    "MILLISECONDS",
+			    "bench_min_time",
+			    "Run each repetition for at least MILLISECONDS.");
+	options().add('n',
+			    "10",
+			    "REPETITIONS",
+			    "bench_repetitions",
+			    "Repeat each benchmark REPETITIONS times.");
+	options().add('f',
+			    "",
+			    "FILTER",
+			    "bench_filter",
+			    "Run only benchmarks whose name contains FILTER.");
+}
+
+
+int BenchApp::onRun()
+{
+	AppBase::onRun();
+	
+	BenchmarkRunner runner;
+	runner.setThreshold(options().get('r').toLong() / 100.0);
+	runner.setMinTime(options().get('m').toLong());
+	runner.setRepetitions(options().get('n').toLong());
+	runner.setFilter(options().get('f').argument);
+	
+	string baseline = options().get('b').argument;
+	if (!baseline.empty() && !runner.loadBaseline(baseline)) {
+		LOG_ERROR("Cannot read benchmark baseline from " << baseline << ".");
+		return EXIT_FAILURE;
+	}
+	
+	runner.run(TestSuite::getDefaultSuite());
+	
+	string json = options().get('j').argument;
+	if (!json.empty() && !runner.saveJSON(json)) {
+		LOG_ERROR("Cannot write benchmark results to " << json << ".");
+		return EXIT_FAILURE;
+	}
+	
+	if ((runner.getFailureCount() > 0) || (runner.getRegressionCount() > 0))
+		return EXIT_FAILURE;
+	return EXIT_SUCCESS;
+}
+
+
+} // namespace cppapp
@@ -0,0 +1,44 @@
+/**
+ * \file   BenchApp.h
+ * \author Jan Milík <milikjan@fit.cvut.cz>
+ * \date   2026-10-19
+ *
+ * \brief  Header file for the BenchApp class.
+ */
+
+#ifndef BENCHAPP_M4QZ7HEC
+#define BENCHAPP_M4QZ7HEC
+
+
+#include "Benchmark.h"
+#include "AppBase.h"
+
+
+namespace cppapp {
+
+
+/**
+ * \brief Application running the benchmarks of the default test suite.
+ *
+ * Exits with a failure if a benchmark fails or regresses against the
+ * baseline given by <tt>-b</tt>.
+ */
+class BenchApp : public AppBase {
+protected:
+	virtual void setUp();
+	virtual int onRun();
+};
+
+
+#define BENCHAPP_BOOTSTRAP \
+	int main(int argc, char *argv[]) \
+	{ \
+		BenchApp app; \
+		return app.run(argc, argv); \
+	}
+
+
+} /* namespace cppapp */
+
+
+#endif /* end of include guard: BENCHAPP_M4QZ7HEC */
@@ -0,0 +1,328 @@
+/**
+ * \file   Benchmark.cpp
+ * \author Jan Milík <milikjan@fit.cvut.cz>
+ * \date   2026-10-19
+ *
+ * \brief  Implementation file for the benchmark harness.
+ */
+
+#include "Benchmark.h"
+
+#include <cmath>
+#include <cstdio>
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+
+#include "Clock.h"
+#include "Input.h"
+#include "json.h"
+#include "utils.h"
+
+
+namespace cppapp {
+
+
+////////////////////////////////////////////////////////////////////////////////
+// HELPERS
+////////////////////////////////////////////////////////////////////////////////
+
+
+static std::string formatNanos(double ns)
+{
+	char buffer[32];
+	if (ns < 1e3)
+		snprintf(buffer, sizeof(buffer), "%.2f ns", ns);
+	else if (ns < 1e6)
+		snprintf(buffer, sizeof(buffer), "%.2f us", ns / 1e3);
+	else if (ns < 1e9)
+		snprintf(buffer, sizeof(buffer), "%.2f ms", ns / 1e6);
+	else
+		snprintf(buffer, sizeof(buffer), "%.2f s", ns / 1e9);
+	return buffer;
+}
+
+
+static void writeJSONString(std::ostream &output, const std::string &value)
+{
+	output << '"';
+	FOR_EACH(value, c) {
+		switch (*c) {
+		case '"':  output << "\\\""; break;
+		case '\\': output << "\\\\"; break;
+		case '\n': output << "\\n"; break;
+		case '\t': output << "\\t"; break;
+		default:
+			if ((unsigned char)*c < 0x20) {
+				char buffer[8];
+				snprintf(buffer, sizeof(buffer), "\\u%04x", *c);
+				output << buffer;
+			} else {
+				output << *c;
+			}
+		}
+	}
+	output << '"';
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// BENCH RESULT
+////////////////////////////////////////////////////////////////////////////////
+
+
+/**
+ * The 99th percentile is the nearest rank, with few repetitions it is
+ * the slowest one.
+ */
+void BenchResult::computeStats()
+{
+	if (samples.empty())
+		return;
+
+	std::vector<double> sorted(samples);
+	std::sort(sorted.begin(), sorted.end());
+	size_t count = sorted.size();
+
+	median = (count % 2 == 1) ?
+		sorted[count / 2] :
+		(sorted[count / 2 - 1] + sorted[count / 2]) / 2;
+	p99 = sorted[(size_t)ceil(0.99 * count) - 1];
+	min = sorted[0];
+
+	double sum = 0;
+	FOR_EACH(sorted, sample)
+		sum += *sample;
+	mean = sum / count;
+
+	double squares = 0;
+	FOR_EACH(sorted, sample)
+		squares += (*sample - mean) * (*sample - mean);
+	stddev = (count > 1) ? sqrt(squares / (count - 1)) : 0;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// BENCHMARK RUNNER
+////////////////////////////////////////////////////////////////////////////////
+
+
+BenchmarkRunner::BenchmarkRunner(std::ostream *output) :
+	output_(output),
+	minTime_(100),
+	repetitions_(10),
+	threshold_(0.1),
+	failureCount_(0),
+	regressionCount_(0)
+{
+}
+
+
+/**
+ * \brief Returns the time of \p iterations iterations in nanoseconds.
+ */
+double BenchmarkRunner::timeIterations(BenchRef *bench, long iterations)
+{
+	uint64_t start = Clock::nanos();
+	bench->runIterations(iterations);
+	return (double)(Clock::nanos() - start);
+}
+
+
+/**
+ * The number of iterations grows by the ratio of the measured time to
+ * the minimal time (with some margin), at least twice and at most
+ * a hundred times per step.
+ */
+long BenchmarkRunner::calibrate(BenchRef *bench)
+{
+	double minTime    = minTime_ * 1e6;
+	long   iterations = 1;
+
+	while (true) {
+		double time = timeIterations(bench, iterations);
+		if ((time >= minTime) || (iterations >= 1000000000L))
+			return iterations;
+
+		double factor = (time > 0) ? minTime * 1.2 / time : 100;
+		factor = std::max(2.0, std::min(100.0, factor));
+		iterations = (long)(iterations * factor);
+	}
+}
+
+
+BenchResult BenchmarkRunner::measure(BenchRef *bench, const std::string &name)
+{
+	BenchResult result;
+	result.name = name;
+
+	bench->setUp();
+	try {
+		result.iterations = calibrate(bench);
+		// Warm up.
+		timeIterations(bench, result.iterations);
+		for (int i = 0; i < repetitions_; i++) {
+			double time = timeIterations(bench, result.iterations);
+			result.samples.push_back(time / result.iterations);
+		}
+	} catch (TestResult &r) {
+		result.success = false;
+		result.message = (r.message == NULL) ? "" : r.message;
+	} catch (std::exception &e) {
+		result.success = false;
+		result.message = e.what();
+	} catch (...) {
+		result.success = false;
+		result.message = "unknown exception";
+	}
+	bench->tearDown();
+
+	result.computeStats();
+	return result;
+}
+
+
+void BenchmarkRunner::report(const BenchResult &result)
+{
+	if (!result.success) {
+		*output_ << "\033[1;33mFAILED\033[0m" << std::endl;
+		*output_ << "\tMessage: " << result.message << std::endl;
+		return;
+	}
+
+	*output_ << formatNanos(result.median) << " per iteration" << std::endl;
+	*output_ << "\tp99 " << formatNanos(result.p99)
+	         << ", min " << formatNanos(result.min)
+	         << ", stddev " << formatNanos(result.stddev)
+	         << " (" << result.samples.size() << " x " << result.iterations
+	         << " iterations)" << std::endl;
+
+	if (result.baseline > 0) {
+		char change[32];
+		snprintf(change, sizeof(change), "%+.1f %%",
+		         (result.median / result.baseline - 1) * 100);
+		*output_ << "\tbaseline " << formatNanos(result.baseline) << ", " << change;
+		if (result.regressed)
+			*output_ << " \033[1;31mREGRESSION\033[0m";
+		*output_ << std::endl;
+	}
+}
+
+
+bool BenchmarkRunner::loadBaseline(const std::string &fileName)
+{
+	Ref<FileInput> input = new FileInput(fileName);
+	if (!input->exists())
+		return false;
+
+	JSONParser parser;
+	Ref<DynObject> root = parser.parse(input.as<Input>());
+	if (root.isNull() || root->isError())
+		return false;
+
+	Ref<DynObject> benchmarks = root->getStrItem("benchmarks");
+	if (benchmarks.isNull() || !benchmarks->isList())
+		return false;
+
+	baseline_.clear();
+	for (int i = 0; i < benchmarks->getSize(); i++) {
+		Ref<DynObject> bench = benchmarks->getIntItem(i);
+		std::string    name  = bench->getStrString("name", "");
+		double         time  = bench->getStrDouble("median_ns", 0);
+		if (!name.empty() && (time > 0))
+			baseline_[name] = time;
+	}
+	return true;
+}
+
+
+void BenchmarkRunner::run(const TestSuite &tests)
+{
+	results_.clear();
+	failureCount_    = 0;
+	regressionCount_ = 0;
+
+	FOR_EACH(tests, test) {
+		BenchRef *bench = dynamic_cast<BenchRef*>(test->getPtr());
+		if (bench == NULL)
+			continue;
+
+		std::string name = bench->getTestCase()->getName() + "::" + bench->getName();
+		if (!filter_.empty() && (name.find(filter_) == std::string::npos))
+			continue;
+
+		*output_ << name << "... " << std::flush;
+
+		BenchResult result = measure(bench, name);
+		if (!result.success) {
+			failureCount_++;
+		} else {
+			VAR(baseline, baseline_.find(name));
+			if (baseline != baseline_.end()) {
+				result.baseline  = baseline->second;
+				result.regressed = result.median > result.baseline * (1 + threshold_);
+				if (result.regressed)
+					regressionCount_++;
+			}
+		}
+
+		report(result);
+		results_.push_back(result);
+	}
+
+	for (int i = 0; i < 80; i++)
+		*output_ << "=";
+	*output_ << std::endl;
+	*output_ << "\033[1m" << results_.size() << " benchmarks run\033[0m, "
+	         << failureCount_ << " failure(s), "
+	         << regressionCount_ << " regression(s)." << std::endl;
+}
+
+
+/**
+ * Times are written in fixed notation, \ref JSONParser does not read
+ * exponents.
+ */
+void BenchmarkRunner::writeJSON(std::ostream &output) const
+{
+	std::ios_base::fmtflags flags     = output.flags();
+	std::streamsize         precision = output.precision();
+	output << std::fixed << std::setprecision(3);
+
+	output << "{\n\t\"benchmarks\": [";
+	for (size_t i = 0; i < results_.size(); i++) {
+		const BenchResult &result = results_[i];
+		output << (i > 0 ? "," : "") << "\n\t\t{ \"name\": ";
+		writeJSONString(output, result.name);
+		if (result.success) {
+			output << ", \"iterations\": "  << result.iterations
+			       << ", \"repetitions\": " << result.samples.size()
+			       << ", \"median_ns\": "   << result.median
+			       << ", \"p99_ns\": "      << result.p99
+			       << ", \"mean_ns\": "     << result.mean
+			       << ", \"stddev_ns\": "   << result.stddev
+			       << ", \"min_ns\": "      << result.min;
+		} else {
+			output << ", \"error\": ";
+			writeJSONString(output, result.message);
+		}
+		output << " }";
+	}
+	output << "\n\t]\n}\n";
+
+	output.flags(flags);
+	output.precision(precision);
+}
+
+
+bool BenchmarkRunner::saveJSON(const std::string &fileName) const
+{
+	std::ofstream output(fileName.c_str());
+	if (!output)
+		return false;
+	writeJSON(output);
+	return (bool)output;
+}
+
+
+} // namespace cppapp
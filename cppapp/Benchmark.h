@@ -0,0 +1,258 @@
+/**
+ * \file   Benchmark.h
+ * \author Jan Milík <milikjan@fit.cvut.cz>
+ * \date   2026-10-19
+ *
+ * \brief  Header file for the benchmark harness.
+ */
+
+#ifndef BENCHMARK_R8KD3TWN
+#define BENCHMARK_R8KD3TWN
+
+
+#include <map>
+#include <string>
+#include <vector>
+#include <iostream>
+
+#include "Test.h"
+
+
+namespace cppapp {
+
+
+////////////////////////////////////////////////////////////////////////////////
+// SINK
+////////////////////////////////////////////////////////////////////////////////
+
+
+/**
+ * \brief Makes the compiler assume that \p value is used, so the
+ *        computation producing it is not optimized away.
+ */
+template<class T>
+inline void benchSink(const T &value)
+{
+	asm volatile("" : : "g"(&value) : "memory");
+}
+
+
+/**
+ * \brief Makes the compiler assume that all memory is read and written,
+ *        so stores before the call are not optimized away.
+ */
+inline void benchClobber()
+{
+	asm volatile("" : : : "memory");
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// BENCH REF
+////////////////////////////////////////////////////////////////////////////////
+
+
+/**
+ * \brief Benchmark method registered in a \ref BenchmarkCase.
+ *
+ * When the benchmark runs as an ordinary test, the method is called for
+ * a single iteration.
+ */
+class BenchRef : public TestRef {
+public:
+	BenchRef(const std::string &name) : TestRef(name, false) {}
+
+	virtual void runIterations(long iterations) = 0;
+
+	virtual void executeMethod() { runIterations(1); }
+};
+
+
+template<class T>
+class BenchRef_ : public BenchRef {
+private:
+	Ref<T> instance_;
+	void (T::*method_)(long);
+
+public:
+	BenchRef_(const std::string &name, Ref<T> instance, void (T::*method)(long)) :
+		BenchRef(name), instance_(instance), method_(method)
+	{ }
+
+	virtual Ref<TestCase> getTestCase() { return instance_; }
+
+	virtual void setUp()
+	{
+		instance_->reset();
+		instance_->setUp();
+	}
+
+	virtual void tearDown()
+	{
+		instance_->tearDown();
+	}
+
+	virtual void runIterations(long iterations)
+	{
+		((instance_.getPtr())->*method_)(iterations);
+	}
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// BENCHMARK CASE
+////////////////////////////////////////////////////////////////////////////////
+
+
+#define BENCH_ADD(benchCase, method) registerBenchmark(&benchCase::method, #method, #benchCase);
+
+
+/**
+ * \brief Test case holding benchmarks.
+ *
+ * A benchmark method takes the number of iterations and runs the
+ * measured code that many times:
+ *
+ * \code
+ * void benchLookup(long iterations)
+ * {
+ *     for (long i = 0; i < iterations; i++)
+ *         benchSink(map_.find(key_));
+ * }
+ * \endcode
+ *
+ * \ref setUp() and \ref tearDown() are called once per benchmark, outside
+ * of the measured time.
+ */
+class BenchmarkCase : public TestCase {
+protected:
+	BenchmarkCase() : TestCase()
+	{}
+
+	template<class T>
+	void registerBenchmark(void (T::*method)(long), std::string name, std::string caseName)
+	{
+		setName(caseName);
+		add(new BenchRef_<T>(name, (T*)this, method));
+	}
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// BENCH RESULT
+////////////////////////////////////////////////////////////////////////////////
+
+
+/**
+ * \brief Measured times of a benchmark, all in nanoseconds per
+ *        iteration.
+ */
+struct BenchResult {
+	std::string         name;
+	bool                success;
+	std::string         message;
+
+	long                iterations;
+	std::vector<double> samples;
+
+	double              median;
+	double              p99;
+	double              mean;
+	double              stddev;
+	double              min;
+
+	double              baseline;
+	bool                regressed;
+
+	BenchResult() :
+		success(true), iterations(0),
+		median(0), p99(0), mean(0), stddev(0), min(0),
+		baseline(0), regressed(false)
+	{}
+
+	/**
+	 * \brief Computes the statistics from \ref samples.
+	 */
+	void computeStats();
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// BENCHMARK RUNNER
+////////////////////////////////////////////////////////////////////////////////
+
+
+/**
+ * \brief Runs the benchmarks of a suite and reports their times.
+ *
+ * For every benchmark the runner finds the number of iterations that
+ * takes at least \ref getMinTime(), runs them once to warm up and then
+ * \ref getRepetitions() times, recording the time per iteration. Tests
+ * in the suite that are not benchmarks are skipped.
+ *
+ * With a baseline loaded (see \ref loadBaseline()), a benchmark whose
+ * median is slower than the baseline by more than \ref getThreshold() is
+ * reported as a regression.
+ */
+class BenchmarkRunner {
+private:
+	std::ostream                 *output_;
+
+	double                        minTime_;
+	int                           repetitions_;
+	double                        threshold_;
+	std::string                   filter_;
+
+	std::map<std::string, double> baseline_;
+	std::vector<BenchResult>      results_;
+	int                           failureCount_;
+	int                           regressionCount_;
+
+	double     timeIterations(BenchRef *bench, long iterations);
+	long       calibrate(BenchRef *bench);
+	BenchResult measure(BenchRef *bench, const std::string &name);
+	void       report(const BenchResult &result);
+
+public:
+	BenchmarkRunner(std::ostream *output = &std::cout);
+
+	/**
+	 * \brief Minimal time of a repetition in milliseconds.
+	 */
+	double getMinTime() const { return minTime_; }
+	void   setMinTime(double value) { minTime_ = value; }
+	int    getRepetitions() const { return repetitions_; }
+	void   setRepetitions(int value) { repetitions_ = value; }
+	/**
+	 * \brief Allowed slowdown against the baseline as a fraction
+	 *        (0.1 for 10 %).
+	 */
+	double getThreshold() const { return threshold_; }
+	void   setThreshold(double value) { threshold_ = value; }
+	/**
+	 * \brief Only benchmarks whose full name (<tt>Case::method</tt>)
+	 *        contains the filter are run.
+	 */
+	const std::string& getFilter() const { return filter_; }
+	void   setFilter(const std::string &value) { filter_ = value; }
+
+	/**
+	 * \brief Reads median times from a file written by \ref saveJSON().
+	 */
+	bool loadBaseline(const std::string &fileName);
+
+	void run(const TestSuite &tests);
+
+	const std::vector<BenchResult>& getResults() const { return results_; }
+	int getFailureCount() const { return failureCount_; }
+	int getRegressionCount() const { return regressionCount_; }
+
+	void writeJSON(std::ostream &output) const;
+	bool saveJSON(const std::string &fileName) const;
+};
+
+
+} // namespace cppapp
+
+
+#endif /* end of include guard: BENCHMARK_R8KD3TWN */
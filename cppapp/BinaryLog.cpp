@@ -0,0 +1,715 @@
+/**
+ * \file   BinaryLog.cpp
+ * \author Jan Milík <milikjan@fit.cvut.cz>
+ * \date   2026-10-19
+ *
+ * \brief  Implementation file for the BinaryLog class.
+ */
+
+#include "BinaryLog.h"
+
+#include <time.h>
+#include <cstdio>
+#include <cstdarg>
+#include <cstdlib>
+#include <algorithm>
+#include <iterator>
+#include <sstream>
+
+#include "Mutex.h"
+#include "ThreadLocal.h"
+#include "utils.h"
+
+
+namespace cppapp {
+
+
+////////////////////////////////////////////////////////////////////////////////
+// OUTPUT AND SITES
+////////////////////////////////////////////////////////////////////////////////
+
+
+/**
+ * The output state is never deleted, because threads can still flush
+ * their buffers during static destruction.
+ */
+struct BinaryLogOutputState {
+	Mutex                   mutex;
+	Ref<Output>             output;
+	vector<BinaryLogSite*>  sites;
+};
+
+
+static BinaryLogOutputState& getOutputState()
+{
+	static BinaryLogOutputState *state = new BinaryLogOutputState();
+	return *state;
+}
+
+
+static void writeVarint(ostream &out, uint64_t value)
+{
+	char buffer[BinaryLogEncoder::VARINT_SIZE];
+	char *end = BinaryLogEncoder::encodeVarint(buffer, value);
+	out.write(buffer, end - buffer);
+}
+
+
+static void writeString(ostream &out, const char *value)
+{
+	size_t length = strlen(value);
+	writeVarint(out, length);
+	out.write(value, length);
+}
+
+
+/**
+ * Must be called with the output mutex locked.
+ */
+static void writeSite(ostream &out, const BinaryLogSite *site)
+{
+	out.put(BINLOG_ITEM_SITE);
+	writeVarint(out, site->id);
+	writeVarint(out, site->level);
+	writeVarint(out, site->line);
+	writeString(out, site->file);
+	writeString(out, site->format);
+}
+
+
+BinaryLogSite::BinaryLogSite(const char *file, int line, LogLevel level, const char *format) :
+	LogSite(file, line, level), format(format), id(0)
+{
+	id = BinaryLog::registerSite(this);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// THREAD BUFFERS
+////////////////////////////////////////////////////////////////////////////////
+
+
+#define BINLOG_RECORD_HEADER_SIZE \
+	(1 + BinaryLogEncoder::VARINT_SIZE + sizeof(uint64_t) + 1)
+
+
+/**
+ * \brief Records of a single thread waiting to be written.
+ *
+ * The buffer is only ever touched by its own thread, except when
+ * \ref BinaryLog::flush() drains it, so the spin lock is practically
+ * never contended.
+ */
+class BinaryLogThreadBuffer {
+private:
+	BinaryLogThreadBuffer(const BinaryLogThreadBuffer &other);
+
+public:
+	SpinLock lock;
+	char    *data;
+	size_t   size;
+	size_t   capacity;
+	uint32_t thread;
+
+	BinaryLogThreadBuffer();
+	~BinaryLogThreadBuffer();
+
+	void reserve(size_t newCapacity);
+	void drain();
+};
+
+
+static Mutex& getBuffersMutex()
+{
+	static Mutex *mutex = new Mutex();
+	return *mutex;
+}
+
+
+static vector<BinaryLogThreadBuffer*>& getBuffers()
+{
+	static vector<BinaryLogThreadBuffer*> *buffers = new vector<BinaryLogThreadBuffer*>();
+	return *buffers;
+}
+
+
+static BinaryLogThreadBuffer& getThreadBuffer()
+{
+	static ThreadLocal<BinaryLogThreadBuffer> *buffers =
+		new ThreadLocal<BinaryLogThreadBuffer>();
+	return buffers->get();
+}
+
+
+static volatile uint32_t nextThread = 0;
+
+
+BinaryLogThreadBuffer::BinaryLogThreadBuffer() :
+	data(NULL), size(0), capacity(0), thread(__sync_fetch_and_add(&nextThread, 1))
+{
+	reserve(CPPAPP_BINLOG_BUFFER_SIZE);
+
+	MutexLock lock(&getBuffersMutex());
+	getBuffers().push_back(this);
+}
+
+
+/**
+ * Called when the thread exits.
+ */
+BinaryLogThreadBuffer::~BinaryLogThreadBuffer()
+{
+	{
+		MutexLock lock(&getBuffersMutex());
+		vector<BinaryLogThreadBuffer*> &buffers = getBuffers();
+		buffers.erase(std::remove(buffers.begin(), buffers.end(), this), buffers.end());
+	}
+
+	drain();
+	free(data);
+}
+
+
+void BinaryLogThreadBuffer::reserve(size_t newCapacity)
+{
+	if (newCapacity <= capacity)
+		return;
+	char *newData = (char*)realloc(data, newCapacity);
+	if (newData == NULL)
+		throw std::bad_alloc();
+	data     = newData;
+	capacity = newCapacity;
+}
+
+
+/**
+ * Writes the buffered records to the output (or discards them if the
+ * log is closed). Must be called with the spin lock held, unless the
+ * buffer is being destroyed.
+ */
+void BinaryLogThreadBuffer::drain()
+{
+	if (size == 0)
+		return;
+
+	BinaryLogOutputState &state = getOutputState();
+	MutexLock lock(&state.mutex);
+
+	if (!state.output.isNull()) {
+		ostream &out = *state.output->getStream();
+		out.put(BINLOG_ITEM_THREAD);
+		writeVarint(out, thread);
+		out.write(data, size);
+	}
+	size = 0;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// BINARY LOG
+////////////////////////////////////////////////////////////////////////////////
+
+
+volatile int BinaryLog::enabledLevel_ = LOG_LVL_NONE;
+LogLevel     BinaryLog::threshold_    = LOG_LVL_DEBUG;
+
+
+static void flushAtExit()
+{
+	BinaryLog::close();
+}
+
+
+char* BinaryLog::begin(BinaryLogThreadBuffer **buffer,
+                       const BinaryLogSite    &site,
+                       int                     argc,
+                       size_t                  argsSize)
+{
+	BinaryLogThreadBuffer &b = getThreadBuffer();
+	b.lock.lock();
+
+	size_t needed = BINLOG_RECORD_HEADER_SIZE + argsSize;
+	if (b.size + needed > b.capacity) {
+		b.drain();
+		b.reserve(needed);
+	}
+
+	struct timespec now;
+	clock_gettime(CLOCK_REALTIME, &now);
+	uint64_t timestamp = (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+
+	char *p = b.data + b.size;
+	*p++ = BINLOG_ITEM_RECORD;
+	p = BinaryLogEncoder::encodeVarint(p, site.id);
+	memcpy(p, &timestamp, sizeof(timestamp));
+	p += sizeof(timestamp);
+	*p++ = (char)argc;
+
+	*buffer = &b;
+	return p;
+}
+
+
+void BinaryLog::end(BinaryLogThreadBuffer *buffer, char *p)
+{
+	buffer->size = p - buffer->data;
+	buffer->lock.unlock();
+}
+
+
+void BinaryLog::open(Ref<Output> output)
+{
+	static bool atExitRegistered = false;
+
+	BinaryLogOutputState &state = getOutputState();
+	{
+		MutexLock lock(&state.mutex);
+
+		state.output = output;
+		ostream &out = *output->getStream();
+		out.write(CPPAPP_BINLOG_MAGIC, CPPAPP_BINLOG_MAGIC_SIZE);
+		FOR_EACH(state.sites, site) {
+			writeSite(out, *site);
+		}
+
+		if (!atExitRegistered) {
+			atexit(flushAtExit);
+			atExitRegistered = true;
+		}
+	}
+
+	enabledLevel_ = threshold_;
+}
+
+
+void BinaryLog::open(const std::string &fileName)
+{
+	open(new FileOutput(fileName));
+}
+
+
+void BinaryLog::close()
+{
+	enabledLevel_ = LOG_LVL_NONE;
+	flush();
+
+	BinaryLogOutputState &state = getOutputState();
+	MutexLock lock(&state.mutex);
+	if (!state.output.isNull()) {
+		state.output->close();
+		state.output = NULL;
+	}
+}
+
+
+void BinaryLog::flush()
+{
+	{
+		MutexLock lock(&getBuffersMutex());
+		FOR_EACH(getBuffers(), buffer) {
+			SpinLockGuard guard(&(*buffer)->lock);
+			(*buffer)->drain();
+		}
+	}
+
+	BinaryLogOutputState &state = getOutputState();
+	MutexLock lock(&state.mutex);
+	if (!state.output.isNull())
+		state.output->getStream()->flush();
+}
+
+
+void BinaryLog::setThreshold(LogLevel level)
+{
+	BinaryLogOutputState &state = getOutputState();
+	MutexLock lock(&state.mutex);
+
+	threshold_ = level;
+	if (!state.output.isNull())
+		enabledLevel_ = level;
+}
+
+
+uint32_t BinaryLog::registerSite(BinaryLogSite *site)
+{
+	BinaryLogOutputState &state = getOutputState();
+	MutexLock lock(&state.mutex);
+
+	site->id = state.sites.size();
+	state.sites.push_back(site);
+
+	if (!state.output.isNull())
+		writeSite(*state.output->getStream(), site);
+
+	return site->id;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// DECODER
+////////////////////////////////////////////////////////////////////////////////
+
+
+static string formatVa(const char *fmt, va_list args)
+{
+	va_list copy;
+	va_copy(copy, args);
+	char buffer[128];
+	int length = vsnprintf(buffer, sizeof(buffer), fmt, copy);
+	va_end(copy);
+
+	if (length < 0)
+		return "#error#";
+	if (length < (int)sizeof(buffer))
+		return string(buffer, length);
+
+	vector<char> large(length + 1);
+	vsnprintf(&large[0], large.size(), fmt, args);
+	return string(&large[0], length);
+}
+
+
+static string stringf(const char *fmt, ...)
+{
+	va_list args;
+	va_start(args, fmt);
+	string result = formatVa(fmt, args);
+	va_end(args);
+	return result;
+}
+
+
+static string formatValue(const string &spec, char conversion, ...)
+{
+	string fmt = spec + conversion;
+
+	va_list args;
+	va_start(args, conversion);
+	string result = formatVa(fmt.c_str(), args);
+	va_end(args);
+	return result;
+}
+
+
+/**
+ * \brief Cursor over the raw bytes of a binary log.
+ */
+struct BinaryLogReader {
+	const char *p;
+	const char *end;
+
+	BinaryLogReader(const string &data) :
+		p(data.data()), end(data.data() + data.size())
+	{}
+
+	bool atEnd() const { return p >= end; }
+
+	bool readByte(char *value)
+	{
+		if (p >= end) return false;
+		*value = *p++;
+		return true;
+	}
+
+	bool readVarint(uint64_t *value)
+	{
+		*value = 0;
+		for (int shift = 0; shift < 64; shift += 7) {
+			if (p >= end) return false;
+			unsigned char c = (unsigned char)*p++;
+			*value |= (uint64_t)(c & 0x7f) << shift;
+			if ((c & 0x80) == 0)
+				return true;
+		}
+		return false;
+	}
+
+	bool readRaw(void *value, size_t size)
+	{
+		if ((size_t)(end - p) < size) return false;
+		memcpy(value, p, size);
+		p += size;
+		return true;
+	}
+
+	bool readString(string *value)
+	{
+		uint64_t length;
+		if (!readVarint(&length) || ((uint64_t)(end - p) < length))
+			return false;
+		value->assign(p, length);
+		p += length;
+		return true;
+	}
+};
+
+
+bool BinaryLogDecoder::read(std::istream &input)
+{
+	string data((std::istreambuf_iterator<char>(input)),
+	            std::istreambuf_iterator<char>());
+
+	if ((data.size() < CPPAPP_BINLOG_MAGIC_SIZE) ||
+	    (data.compare(0, CPPAPP_BINLOG_MAGIC_SIZE, CPPAPP_BINLOG_MAGIC) != 0))
+		return fail("not a binary log");
+
+	BinaryLogReader reader(data);
+	reader.p += CPPAPP_BINLOG_MAGIC_SIZE;
+
+	uint32_t file   = files_++;
+	uint32_t thread = 0;
+
+	// Ids of this log's sites in sites_, indexed by the ids in the file.
+	vector<uint32_t> siteIds;
+	const uint32_t   unknownSite = (uint32_t)-1;
+
+	while (!reader.atEnd()) {
+		char     item;
+		uint64_t value;
+
+		reader.readByte(&item);
+		switch (item) {
+		case BINLOG_ITEM_SITE: {
+			Site site;
+			uint64_t id, level, line;
+			if (!reader.readVarint(&id) ||
+			    !reader.readVarint(&level) ||
+			    !reader.readVarint(&line) ||
+			    !reader.readString(&site.file) ||
+			    !reader.readString(&site.format))
+				return fail("truncated site definition");
+			site.level = (LogLevel)level;
+			site.line  = (int)line;
+			if (id >= siteIds.size())
+				siteIds.resize(id + 1, unknownSite);
+			siteIds[id] = sites_.size();
+			sites_.push_back(site);
+			break;
+		}
+
+		case BINLOG_ITEM_THREAD:
+			if (!reader.readVarint(&value))
+				return fail("truncated thread marker");
+			thread = (uint32_t)value;
+			break;
+
+		case BINLOG_ITEM_RECORD: {
+			Record record;
+			char   argc;
+			record.file   = file;
+			record.thread = thread;
+			if (!reader.readVarint(&value) ||
+			    !reader.readRaw(&record.timestamp, sizeof(record.timestamp)) ||
+			    !reader.readByte(&argc))
+				return fail("truncated record");
+			if ((value >= siteIds.size()) || (siteIds[value] == unknownSite))
+				return fail("record refers to an unknown site");
+			record.site = siteIds[value];
+
+			for (int i = 0; i < argc; i++) {
+				Arg arg;
+				bool ok = reader.readByte(&arg.type);
+				switch (arg.type) {
+				case BINLOG_ARG_INT:
+					ok = ok && reader.readVarint(&value);
+					arg.intValue = (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+					break;
+				case BINLOG_ARG_UINT:
+					ok = ok && reader.readVarint(&arg.uintValue);
+					break;
+				case BINLOG_ARG_DOUBLE:
+					ok = ok && reader.readRaw(&arg.doubleValue, sizeof(double));
+					break;
+				case BINLOG_ARG_CHAR:
+					ok = ok && reader.readByte(&item);
+					arg.intValue = item;
+					break;
+				case BINLOG_ARG_STRING:
+					ok = ok && reader.readString(&arg.stringValue);
+					break;
+				case BINLOG_ARG_POINTER:
+					ok = ok && reader.readRaw(&arg.uintValue, sizeof(uint64_t));
+					break;
+				default:
+					return fail(stringf("unknown argument type 0x%02x", (int)(unsigned char)arg.type));
+				}
+				if (!ok)
+					return fail("truncated record argument");
+				record.args.push_back(arg);
+			}
+
+			records_.push_back(record);
+			break;
+		}
+
+		default:
+			return fail(stringf("unknown item type 0x%02x", (int)(unsigned char)item));
+		}
+	}
+
+	return true;
+}
+
+
+struct RecordTimeLess {
+	const vector<BinaryLogDecoder::Record> &records;
+
+	RecordTimeLess(const vector<BinaryLogDecoder::Record> &records) : records(records) {}
+
+	bool operator () (size_t a, size_t b) const
+	{
+		return records[a].timestamp < records[b].timestamp;
+	}
+};
+
+
+void BinaryLogDecoder::print(std::ostream &output) const
+{
+	vector<size_t> order;
+	for (size_t i = 0; i < records_.size(); i++)
+		order.push_back(i);
+	std::stable_sort(order.begin(), order.end(), RecordTimeLess(records_));
+
+	FOR_EACH(order, index) {
+		const Record &record = records_[*index];
+		const Site   &site   = sites_[record.site];
+
+		time_t    seconds = record.timestamp / 1000000000ULL;
+		struct tm local;
+		char      timeText[80];
+		localtime_r(&seconds, &local);
+		strftime(timeText, sizeof(timeText), "%Y-%m-%d %a %H:%M:%S", &local);
+
+		output
+			<< "["
+			<< timeText
+			<< stringf(".%06d", (int)(record.timestamp % 1000000000ULL / 1000))
+			<< " "
+			<< Logger::logLevelToString(site.level)
+			<< " "
+			<< site.file << ":" << site.line
+			<< " #";
+		if (files_ > 1)
+			output << record.file << ".";
+		output
+			<< record.thread
+			<< "]  "
+			<< formatMessage(record)
+			<< endl;
+	}
+}
+
+
+std::string BinaryLogDecoder::formatMessage(const Record &record) const
+{
+	return format(sites_[record.site].format, record.args);
+}
+
+
+static string formatArg(const string &spec, char conversion, const BinaryLogDecoder::Arg &arg)
+{
+	bool isInteger = (strchr("diouxXc", conversion) != NULL);
+	bool isFloat   = (strchr("eEfFgGaA", conversion) != NULL);
+
+	switch (arg.type) {
+	case BINLOG_ARG_INT:
+	case BINLOG_ARG_CHAR:
+		if (conversion == 'c')
+			return formatValue(spec, 'c', (int)arg.intValue);
+		if (isInteger)
+			return formatValue(spec + "ll", conversion, (long long)arg.intValue);
+		if (isFloat)
+			return formatValue(spec, conversion, (double)arg.intValue);
+		if (arg.type == BINLOG_ARG_CHAR)
+			return formatValue(spec, 's', string(1, (char)arg.intValue).c_str());
+		return formatValue(spec, 's', stringf("%lld", (long long)arg.intValue).c_str());
+
+	case BINLOG_ARG_UINT:
+		if (conversion == 'c')
+			return formatValue(spec, 'c', (int)arg.uintValue);
+		if (isInteger)
+			return formatValue(spec + "ll", conversion, (unsigned long long)arg.uintValue);
+		if (isFloat)
+			return formatValue(spec, conversion, (double)arg.uintValue);
+		return formatValue(spec, 's', stringf("%llu", (unsigned long long)arg.uintValue).c_str());
+
+	case BINLOG_ARG_DOUBLE:
+		if (isFloat)
+			return formatValue(spec, conversion, arg.doubleValue);
+		if (isInteger)
+			return formatValue(spec + "ll", conversion, (long long)arg.doubleValue);
+		return formatValue(spec, 's', stringf("%g", arg.doubleValue).c_str());
+
+	case BINLOG_ARG_POINTER:
+		if (isInteger)
+			return formatValue(spec + "ll", conversion, (unsigned long long)arg.uintValue);
+		return formatValue(spec, 's', stringf("0x%llx", (unsigned long long)arg.uintValue).c_str());
+
+	case BINLOG_ARG_STRING:
+		return formatValue(spec, 's', arg.stringValue.c_str());
+	}
+
+	return "#error#";
+}
+
+
+std::string BinaryLogDecoder::format(const std::string &fmt, const std::vector<Arg> &args)
+{
+	ostringstream out;
+	size_t        next = 0;
+	size_t        i    = 0;
+
+	while (i < fmt.size()) {
+		if (fmt[i] != '%') {
+			out << fmt[i++];
+			continue;
+		}
+
+		i++;
+		if ((i < fmt.size()) && (fmt[i] == '%')) {
+			out << '%';
+			i++;
+			continue;
+		}
+
+		string spec = "%";
+		while ((i < fmt.size()) && (strchr("-+ #0", fmt[i]) != NULL))
+			spec += fmt[i++];
+		for (int part = 0; part < 2; part++) {
+			if ((i < fmt.size()) && (fmt[i] == '*')) {
+				i++;
+				int value = 0;
+				if (next < args.size()) {
+					const Arg &arg = args[next++];
+					value = (int)((arg.type == BINLOG_ARG_UINT) ? arg.uintValue : arg.intValue);
+				}
+				spec += stringf("%d", value);
+			}
+			while ((i < fmt.size()) && (fmt[i] >= '0') && (fmt[i] <= '9'))
+				spec += fmt[i++];
+			if ((part == 0) && (i < fmt.size()) && (fmt[i] == '.'))
+				spec += fmt[i++];
+			else
+				break;
+		}
+		while ((i < fmt.size()) && (strchr("hlLqjzt", fmt[i]) != NULL))
+			i++;
+		if (i >= fmt.size())
+			break;
+
+		char conversion = fmt[i++];
+		if (conversion == 'p')
+			conversion = 's';
+
+		if (next >= args.size()) {
+			out << "<missing>";
+			continue;
+		}
+		out << formatArg(spec, conversion, args[next++]);
+	}
+
+	return out.str();
+}
+
+
+} // namespace cppapp
@@ -0,0 +1,471 @@
+/**
+ * \file   BinaryLog.h
+ * \author Jan Milík <milikjan@fit.cvut.cz>
+ * \date   2026-10-19
+ *
+ * \brief  Header file for the BinaryLog class.
+ */
+
+#ifndef BINARYLOG_W7HC2KQM
+#define BINARYLOG_W7HC2KQM
+
+
+#ifdef LOG_DISABLE
+#	define BINLOG_AT(level__, format__, ...)
+#else // LOG_DISABLE
+/**
+ * \brief Writes a structured record to the binary log.
+ *
+ * The format string uses printf syntax, but it is never interpreted
+ * by the logging thread. Only the raw arguments are stored; the text
+ * is reconstructed offline by \ref cppapp::BinaryLogDecoder.
+ *
+ * \code
+ * BINLOG_INFO("request %d took %.3f ms (%s)", id, ms, path);
+ * \endcode
+ */
+#	define BINLOG_AT(level__, format__, ...) { \
+		if (cppapp::BinaryLog::isEnabled(level__)) { \
+			static cppapp::BinaryLogSite binlogSite__(__FILE__, __LINE__, level__, format__); \
+			if (binlogSite__.isEnabled() && cppapp::Logger::admit(binlogSite__)) \
+				cppapp::BinaryLog::write(binlogSite__, ##__VA_ARGS__); \
+		} }
+#endif // LOG_DISABLE
+
+#define BINLOG_ERROR(format__, ...)   BINLOG_AT(cppapp::LOG_LVL_ERROR, format__, ##__VA_ARGS__)
+#define BINLOG_WARNING(format__, ...) BINLOG_AT(cppapp::LOG_LVL_WARNING, format__, ##__VA_ARGS__)
+#define BINLOG_INFO(format__, ...)    BINLOG_AT(cppapp::LOG_LVL_INFO, format__, ##__VA_ARGS__)
+#ifndef NDEBUG
+#	define BINLOG_DEBUG(format__, ...) BINLOG_AT(cppapp::LOG_LVL_DEBUG, format__, ##__VA_ARGS__)
+#else
+#	define BINLOG_DEBUG(format__, ...)
+#endif
+
+
+#include <stdint.h>
+#include <cstring>
+
+#include <string>
+#include <vector>
+#include <istream>
+#include <ostream>
+
+#include "Object.h"
+#include "Output.h"
+#include "Logger.h"
+
+
+namespace cppapp {
+
+
+/** \addtogroup logging
+ * @{
+ */
+
+
+#define CPPAPP_BINLOG_MAGIC       "CPPBLOG\x01"
+#define CPPAPP_BINLOG_MAGIC_SIZE  8
+#define CPPAPP_BINLOG_BUFFER_SIZE 65536
+
+
+/**
+ * \brief Kinds of items in a binary log file.
+ *
+ * The file starts with \ref CPPAPP_BINLOG_MAGIC followed by a sequence
+ * of items, each starting with one of these bytes. Integers are stored
+ * as variable-length (LEB128) values, signed integers zig-zag encoded,
+ * everything else in the native byte order.
+ */
+enum BinaryLogItem {
+	/// Call site definition: id, level, line, file, format.
+	BINLOG_ITEM_SITE   = 'S',
+	/// All following records come from the given thread.
+	BINLOG_ITEM_THREAD = 'T',
+	/// Log record: site id, timestamp, argument count, arguments.
+	BINLOG_ITEM_RECORD = 'R'
+};
+
+
+/**
+ * \brief Type tags of arguments stored in binary log records.
+ */
+enum BinaryLogArgType {
+	BINLOG_ARG_INT     = 'i',
+	BINLOG_ARG_UINT    = 'u',
+	BINLOG_ARG_DOUBLE  = 'd',
+	BINLOG_ARG_CHAR    = 'c',
+	BINLOG_ARG_STRING  = 's',
+	BINLOG_ARG_POINTER = 'p'
+};
+
+
+/**
+ * \brief Call site of a BINLOG_* macro.
+ *
+ * The site is registered (and its format string written to the log)
+ * only once, when it logs for the first time. Sites can be switched
+ * on and off like any other \ref LogSite.
+ */
+struct BinaryLogSite : public LogSite {
+	const char *format;
+	uint32_t    id;
+
+	BinaryLogSite(const char *file, int line, LogLevel level, const char *format);
+};
+
+
+/**
+ * \brief Encodes raw log arguments.
+ *
+ * For every supported argument type there is a \c maxSize() overload
+ * returning an upper bound of the encoded size and an \c encode()
+ * overload writing the argument and returning the end of the written
+ * data. Unsupported argument types are a compile-time error.
+ */
+struct BinaryLogEncoder {
+	static const size_t VARINT_SIZE = 10;
+
+	static inline char* encodeVarint(char *p, uint64_t value)
+	{
+		while (value >= 0x80) {
+			*p++ = (char)(value | 0x80);
+			value >>= 7;
+		}
+		*p++ = (char)value;
+		return p;
+	}
+
+	static inline char* encodeSigned(char *p, int64_t value)
+	{
+		*p++ = BINLOG_ARG_INT;
+		return encodeVarint(p, ((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+	}
+
+	static inline char* encodeUnsigned(char *p, uint64_t value)
+	{
+		*p++ = BINLOG_ARG_UINT;
+		return encodeVarint(p, value);
+	}
+
+	static inline char* encodeString(char *p, const char *value, size_t length)
+	{
+		*p++ = BINLOG_ARG_STRING;
+		p = encodeVarint(p, length);
+		memcpy(p, value, length);
+		return p + length;
+	}
+
+	static inline size_t maxSize(bool)               { return 1 + VARINT_SIZE; }
+	static inline size_t maxSize(char)               { return 2; }
+	static inline size_t maxSize(short)              { return 1 + VARINT_SIZE; }
+	static inline size_t maxSize(unsigned short)     { return 1 + VARINT_SIZE; }
+	static inline size_t maxSize(int)                { return 1 + VARINT_SIZE; }
+	static inline size_t maxSize(unsigned int)       { return 1 + VARINT_SIZE; }
+	static inline size_t maxSize(long)               { return 1 + VARINT_SIZE; }
+	static inline size_t maxSize(unsigned long)      { return 1 + VARINT_SIZE; }
+	static inline size_t maxSize(long long)          { return 1 + VARINT_SIZE; }
+	static inline size_t maxSize(unsigned long long) { return 1 + VARINT_SIZE; }
+	static inline size_t maxSize(float)              { return 1 + sizeof(double); }
+	static inline size_t maxSize(double)             { return 1 + sizeof(double); }
+	static inline size_t maxSize(const void *)       { return 1 + sizeof(uint64_t); }
+	static inline size_t maxSize(const char *value)
+	{
+		return 1 + VARINT_SIZE + (value == NULL ? 6 : strlen(value));
+	}
+	static inline size_t maxSize(const std::string &value)
+	{
+		return 1 + VARINT_SIZE + value.size();
+	}
+
+	static inline char* encode(char *p, bool value)           { return encodeUnsigned(p, value ? 1 : 0); }
+	static inline char* encode(char *p, char value)           { *p++ = BINLOG_ARG_CHAR; *p++ = value; return p; }
+	static inline char* encode(char *p, short value)          { return encodeSigned(p, value); }
+	static inline char* encode(char *p, unsigned short value) { return encodeUnsigned(p, value); }
+	static inline char* encode(char *p, int value)            { return encodeSigned(p, value); }
+	static inline char* encode(char *p, unsigned int value)   { return encodeUnsigned(p, value); }
+	static inline char* encode(char *p, long value)           { return encodeSigned(p, value); }
+	static inline char* encode(char *p, unsigned long value)  { return encodeUnsigned(p, value); }
+	static inline char* encode(char *p, long long value)      { return encodeSigned(p, value); }
+	static inline char* encode(char *p, unsigned long long value) { return encodeUnsigned(p, value); }
+	static inline char* encode(char *p, float value)          { return encode(p, (double)value); }
+	static inline char* encode(char *p, double value)
+	{
+		*p++ = BINLOG_ARG_DOUBLE;
+		memcpy(p, &value, sizeof(value));
+		return p + sizeof(value);
+	}
+	static inline char* encode(char *p, const void *value)
+	{
+		uint64_t address = (uint64_t)(uintptr_t)value;
+		*p++ = BINLOG_ARG_POINTER;
+		memcpy(p, &address, sizeof(address));
+		return p + sizeof(address);
+	}
+	static inline char* encode(char *p, const char *value)
+	{
+		if (value == NULL)
+			return encodeString(p, "(null)", 6);
+		return encodeString(p, value, strlen(value));
+	}
+	static inline char* encode(char *p, const std::string &value)
+	{
+		return encodeString(p, value.data(), value.size());
+	}
+};
+
+
+class BinaryLogThreadBuffer;
+
+
+/**
+ * \brief Structured logging into a compact binary file.
+ *
+ * Each thread appends records into its own buffer, which is written
+ * to the output when it fills up, when the thread exits and on
+ * \ref flush(). Format strings are not expanded while logging; use
+ * \ref BinaryLogDecoder (or the \c logdecode tool) to get the text.
+ *
+ * Records in the file are grouped per thread. The decoder orders them
+ * by their timestamps.
+ */
+class BinaryLog {
+private:
+	static volatile int enabledLevel_;
+	static LogLevel     threshold_;
+
+	BinaryLog();
+
+	static char* begin(BinaryLogThreadBuffer **buffer,
+	                   const BinaryLogSite    &site,
+	                   int                     argc,
+	                   size_t                  argsSize);
+	static void  end(BinaryLogThreadBuffer *buffer, char *p);
+
+public:
+	static inline bool isEnabled(LogLevel level) { return level <= enabledLevel_; }
+
+	/**
+	 * \brief Starts writing the binary log into \p output.
+	 *
+	 * All call sites that have already been registered are written to the
+	 * new output, so the output can be decoded on its own.
+	 */
+	static void open(Ref<Output> output);
+	/**
+	 * \brief Starts writing the binary log into a file (truncating it).
+	 */
+	static void open(const std::string &fileName);
+	/**
+	 * \brief Flushes all buffers and stops writing the binary log.
+	 */
+	static void close();
+	/**
+	 * \brief Writes the buffers of all threads to the output.
+	 */
+	static void flush();
+
+	static void     setThreshold(LogLevel level);
+	static LogLevel getThreshold() { return threshold_; }
+
+	/**
+	 * \brief Registers a call site and returns its id.
+	 */
+	static uint32_t registerSite(BinaryLogSite *site);
+
+	/**
+	 * \name Record Writing
+	 *
+	 * These are called by the BINLOG_* macros.
+	 */
+	///@{
+	static void write(const BinaryLogSite &site)
+	{
+		BinaryLogThreadBuffer *buffer;
+		char *p = begin(&buffer, site, 0, 0);
+		end(buffer, p);
+	}
+
+	template<class A1>
+	static void write(const BinaryLogSite &site, const A1 &a1)
+	{
+		BinaryLogThreadBuffer *buffer;
+		char *p = begin(&buffer, site, 1, BinaryLogEncoder::maxSize(a1));
+		p = BinaryLogEncoder::encode(p, a1);
+		end(buffer, p);
+	}
+
+	template<class A1, class A2>
+	static void write(const BinaryLogSite &site, const A1 &a1, const A2 &a2)
+	{
+		BinaryLogThreadBuffer *buffer;
+		char *p = begin(&buffer, site, 2,
+		                BinaryLogEncoder::maxSize(a1) +
+		                BinaryLogEncoder::maxSize(a2));
+		p = BinaryLogEncoder::encode(p, a1);
+		p = BinaryLogEncoder::encode(p, a2);
+		end(buffer, p);
+	}
+
+	template<class A1, class A2, class A3>
+	static void write(const BinaryLogSite &site, const A1 &a1, const A2 &a2, const A3 &a3)
+	{
+		BinaryLogThreadBuffer *buffer;
+		char *p = begin(&buffer, site, 3,
+		                BinaryLogEncoder::maxSize(a1) +
+		                BinaryLogEncoder::maxSize(a2) +
+		                BinaryLogEncoder::maxSize(a3));
+		p = BinaryLogEncoder::encode(p, a1);
+		p = BinaryLogEncoder::encode(p, a2);
+		p = BinaryLogEncoder::encode(p, a3);
+		end(buffer, p);
+	}
+
+	template<class A1, class A2, class A3, class A4>
+	static void write(const BinaryLogSite &site,
+	                  const A1 &a1, const A2 &a2, const A3 &a3, const A4 &a4)
+	{
+		BinaryLogThreadBuffer *buffer;
+		char *p = begin(&buffer, site, 4,
+		                BinaryLogEncoder::maxSize(a1) +
+		                BinaryLogEncoder::maxSize(a2) +
+		                BinaryLogEncoder::maxSize(a3) +
+		                BinaryLogEncoder::maxSize(a4));
+		p = BinaryLogEncoder::encode(p, a1);
+		p = BinaryLogEncoder::encode(p, a2);
+		p = BinaryLogEncoder::encode(p, a3);
+		p = BinaryLogEncoder::encode(p, a4);
+		end(buffer, p);
+	}
+
+	template<class A1, class A2, class A3, class A4, class A5>
+	static void write(const BinaryLogSite &site,
+	                  const A1 &a1, const A2 &a2, const A3 &a3, const A4 &a4,
+	                  const A5 &a5)
+	{
+		BinaryLogThreadBuffer *buffer;
+		char *p = begin(&buffer, site, 5,
+		                BinaryLogEncoder::maxSize(a1) +
+		                BinaryLogEncoder::maxSize(a2) +
+		                BinaryLogEncoder::maxSize(a3) +
+		                BinaryLogEncoder::maxSize(a4) +
+		                BinaryLogEncoder::maxSize(a5));
+		p = BinaryLogEncoder::encode(p, a1);
+		p = BinaryLogEncoder::encode(p, a2);
+		p = BinaryLogEncoder::encode(p, a3);
+		p = BinaryLogEncoder::encode(p, a4);
+		p = BinaryLogEncoder::encode(p, a5);
+		end(buffer, p);
+	}
+
+	template<class A1, class A2, class A3, class A4, class A5, class A6>
+	static void write(const BinaryLogSite &site,
+	                  const A1 &a1, const A2 &a2, const A3 &a3, const A4 &a4,
+	                  const A5 &a5, const A6 &a6)
+	{
+		BinaryLogThreadBuffer *buffer;
+		char *p = begin(&buffer, site, 6,
+		                BinaryLogEncoder::maxSize(a1) +
+		                BinaryLogEncoder::maxSize(a2) +
+		                BinaryLogEncoder::maxSize(a3) +
+		                BinaryLogEncoder::maxSize(a4) +
+		                BinaryLogEncoder::maxSize(a5) +
+		                BinaryLogEncoder::maxSize(a6));
+		p = BinaryLogEncoder::encode(p, a1);
+		p = BinaryLogEncoder::encode(p, a2);
+		p = BinaryLogEncoder::encode(p, a3);
+		p = BinaryLogEncoder::encode(p, a4);
+		p = BinaryLogEncoder::encode(p, a5);
+		p = BinaryLogEncoder::encode(p, a6);
+		end(buffer, p);
+	}
+	///@}
+};
+
+
+/**
+ * \brief Reads binary log files and reconstructs the text of the records.
+ */
+class BinaryLogDecoder {
+public:
+	struct Site {
+		LogLevel    level;
+		int         line;
+		std::string file;
+		std::string format;
+	};
+
+	struct Arg {
+		char        type;
+		int64_t     intValue;
+		uint64_t    uintValue;
+		double      doubleValue;
+		std::string stringValue;
+
+		Arg() : type(0), intValue(0), uintValue(0), doubleValue(0.0) {}
+	};
+
+	/**
+	 * \brief A decoded record. \c site indexes \ref getSites(), \c file
+	 *        is the number of the \ref read() call that read it.
+	 */
+	struct Record {
+		uint64_t         timestamp;
+		uint32_t         file;
+		uint32_t         thread;
+		uint32_t         site;
+		std::vector<Arg> args;
+	};
+
+private:
+	std::vector<Site>   sites_;
+	std::vector<Record> records_;
+	uint32_t            files_;
+	std::string         error_;
+
+	bool fail(const std::string &message) { error_ = message; return false; }
+
+public:
+	BinaryLogDecoder() : files_(0) {}
+
+	/**
+	 * \brief Reads all items from a binary log.
+	 *
+	 * Site and thread ids are local to the process that wrote the log, so
+	 * the sites of every log are added to \ref getSites() under new ids
+	 * and the threads of different logs are told apart by the file number.
+	 *
+	 * \returns \c false if the input is not a binary log or it is
+	 *          malformed (see \ref getError())
+	 */
+	bool read(std::istream &input);
+
+	const std::vector<Site>&   getSites() const   { return sites_; }
+	const std::vector<Record>& getRecords() const { return records_; }
+	std::string                getError() const   { return error_; }
+
+	/**
+	 * \brief Writes the text of all records read so far, ordered by time.
+	 */
+	void print(std::ostream &output) const;
+	/**
+	 * \brief Returns the text of a single record without the header.
+	 */
+	std::string formatMessage(const Record &record) const;
+
+	/**
+	 * \brief Expands a printf-style format string with decoded arguments.
+	 *
+	 * Length modifiers in the format string are ignored, the arguments
+	 * are printed according to their stored types.
+	 */
+	static std::string format(const std::string &format, const std::vector<Arg> &args);
+};
+
+
+/** @} */
+
+
+} // namespace cppapp
+
+
+#endif /* end of include guard: BINARYLOG_W7HC2KQM */
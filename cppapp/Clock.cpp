@@ -0,0 +1,98 @@
+/**
+ * \file   Clock.cpp
+ * \author Jan Milík <milikjan@fit.cvut.cz>
+ * \date   2026-10-19
+ *
+ * \brief  Implementation file for the Clock class.
+ */
+
+#include "Clock.h"
+
+#include <pthread.h>
+#if defined(__x86_64__) || defined(__i386__)
+#	include <cpuid.h>
+#endif
+
+
+namespace cppapp {
+
+
+volatile int Clock::state_        = Clock::STATE_UNINITIALIZED;
+double       Clock::ticksPerNano_ = 1.0;
+
+
+static pthread_once_t clockOnce = PTHREAD_ONCE_INIT;
+
+
+static bool hasInvariantTsc()
+{
+#if defined(__x86_64__) || defined(__i386__)
+	unsigned int eax, ebx, ecx, edx;
+	if (!__get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx) || (eax < 0x80000007))
+		return false;
+	if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx))
+		return false;
+	return (edx & (1 << 8)) != 0;
+#else
+	return false;
+#endif
+}
+
+
+/**
+ * Counts ticks over 10 ms of the monotonic clock.
+ */
+void Clock::calibrate()
+{
+#if defined(__x86_64__) || defined(__i386__)
+	uint32_t low, high;
+	
+	uint64_t startNanos = nanos();
+	asm volatile("rdtsc" : "=a"(low), "=d"(high));
+	uint64_t startTicks = ((uint64_t)high << 32) | low;
+	
+	uint64_t endNanos;
+	do {
+		endNanos = nanos();
+	} while (endNanos - startNanos < 10000000);
+	
+	asm volatile("rdtsc" : "=a"(low), "=d"(high));
+	uint64_t endTicks = ((uint64_t)high << 32) | low;
+	
+	ticksPerNano_ = (double)(endTicks - startTicks) / (double)(endNanos - startNanos);
+	__sync_synchronize();
+	state_ = STATE_TSC;
+#endif
+}
+
+
+/**
+ * The state is published after the rate, so a thread that sees
+ * \c STATE_TSC also sees the calibrated rate.
+ */
+void Clock::init()
+{
+	if (hasInvariantTsc())
+		pthread_once(&clockOnce, calibrate);
+	if (state_ == STATE_UNINITIALIZED)
+		state_ = STATE_MONOTONIC;
+}
+
+
+bool Clock::hasTsc()
+{
+	if (state_ == STATE_UNINITIALIZED)
+		init();
+	return state_ == STATE_TSC;
+}
+
+
+double Clock::getTicksPerNanosecond()
+{
+	if (state_ == STATE_UNINITIALIZED)
+		init();
+	return ticksPerNano_;
+}
+
+
+} // namespace cppapp
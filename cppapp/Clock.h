@@ -0,0 +1,118 @@
+/**
+ * \file   Clock.h
+ * \author Jan Milík <milikjan@fit.cvut.cz>
+ * \date   2026-10-19
+ *
+ * \brief  Header file for the Clock class.
+ */
+
+#ifndef CLOCK_H8XQ2NVD
+#define CLOCK_H8XQ2NVD
+
+
+#include <stdint.h>
+#include <time.h>
+
+
+namespace cppapp {
+
+
+/** \addtogroup threading
+ * @{
+ */
+
+
+enum ClockBackend {
+	/** \brief \c clock_gettime(CLOCK_MONOTONIC), in nanoseconds. */
+	CLOCK_BACKEND_MONOTONIC,
+	/** \brief The time stamp counter, in CPU ticks. */
+	CLOCK_BACKEND_TSC
+};
+
+
+/**
+ * \brief Monotonic time sources.
+ *
+ * \ref nanos() reads \c CLOCK_MONOTONIC. \ref ticks() reads the time stamp
+ * counter, which is cheaper, and converts with \ref ticksToNanos(). The
+ * counter is used only on x86 processors with an invariant TSC (constant
+ * rate, synchronized across cores); elsewhere ticks are nanoseconds of
+ * the monotonic clock. The rate of the counter is calibrated against the
+ * monotonic clock the first time ticks are used.
+ */
+class Clock {
+private:
+	enum State {
+		STATE_UNINITIALIZED = 0,
+		STATE_MONOTONIC,
+		STATE_TSC
+	};
+
+	static volatile int state_;
+	static double       ticksPerNano_;
+
+	Clock();
+
+	static void init();
+	static void calibrate();
+
+public:
+	static uint64_t nanos()
+	{
+		struct timespec now;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+	}
+
+	static uint64_t ticks()
+	{
+		if (__builtin_expect(state_ == STATE_UNINITIALIZED, 0))
+			init();
+#if defined(__x86_64__) || defined(__i386__)
+		if (state_ == STATE_TSC) {
+			uint32_t low, high;
+			asm volatile("rdtsc" : "=a"(low), "=d"(high));
+			return ((uint64_t)high << 32) | low;
+		}
+#endif
+		return nanos();
+	}
+
+	static uint64_t ticksToNanos(uint64_t ticks)
+	{
+		if (__builtin_expect(state_ == STATE_UNINITIALIZED, 0))
+			init();
+		if (state_ == STATE_TSC)
+			return (uint64_t)((double)ticks / ticksPerNano_);
+		return ticks;
+	}
+
+	/**
+	 * \brief Returns the current time of \p backend, in nanoseconds for
+	 *        the monotonic clock and in ticks for the counter.
+	 */
+	static uint64_t now(ClockBackend backend)
+	{
+		return (backend == CLOCK_BACKEND_TSC) ? ticks() : nanos();
+	}
+
+	static uint64_t toNanos(ClockBackend backend, uint64_t value)
+	{
+		return (backend == CLOCK_BACKEND_TSC) ? ticksToNanos(value) : value;
+	}
+
+	/**
+	 * \brief Returns \c true if \ref ticks() reads the time stamp counter.
+	 */
+	static bool   hasTsc();
+	static double getTicksPerNanosecond();
+};
+
+
+/** @} */
+
+
+} // namespace cppapp
+
+
+#endif /* end of include guard: CLOCK_H8XQ2NVD */
@@ -9,8 +9,19 @@
 #include "Config.h"
 #include "Logger.h"
 
+#include <fcntl.h>
+#include <unistd.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cctype>
 #include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <iterator>
 
+#include "Mutex.h"
+#include "Rcu.h"
 #include "utils.h"
 #include "string_utils.h"
 
@@ -23,39 +34,55 @@ namespace cppapp {
 ////////////////////////////////////////////////////////////////////////////////
 
 
-/**
- * Constructor.
- */
-ConfigValue::ConfigValue(string name, string rawValue) :
-	name_(name), rawValue_(Strings::trim(rawValue))
+static inline void trimRange(const char **begin, const char **end)
 {
+	while ((*begin < *end) && isspace((unsigned char)**begin))
+		(*begin)++;
+	while ((*end > *begin) && isspace((unsigned char)*(*end - 1)))
+		(*end)--;
 }
 
 
 /**
- *
+ * Constructor.
  */
-bool ConfigValue::asBool() const
+ConfigValue::ConfigValue(string name, string rawValue) :
+	name_(name)
 {
-	string l = Strings::toLower(rawValue_);
+	const char *begin = rawValue.data();
+	const char *end   = begin + rawValue.size();
+	trimRange(&begin, &end);
+	rawValue_.assign(begin, end);
 	
-	if ((l.compare("f") == 0) ||
-	    (l.compare("false") == 0) ||
-	    (l.compare("0") == 0))
-		return false;
-	return l.size() > 0;
+	parse();
 }
 
 
-int ConfigValue::asInteger() const
+/**
+ * Constructor.
+ */
+ConfigValue::ConfigValue(const char *name, size_t nameSize, const char *rawValue, size_t rawValueSize) :
+	name_(name, nameSize)
 {
-	return atoi(rawValue_.c_str());
+	const char *begin = rawValue;
+	const char *end   = rawValue + rawValueSize;
+	trimRange(&begin, &end);
+	rawValue_.assign(begin, end);
+	
+	parse();
 }
 
 
-float ConfigValue::asFloat() const
+void ConfigValue::parse()
 {
-	return atof(rawValue_.c_str());
+	const char *value = rawValue_.c_str();
+	
+	bool_    = !((strcasecmp(value, "f") == 0) ||
+	             (strcasecmp(value, "false") == 0) ||
+	             (strcmp(value, "0") == 0) ||
+	             (rawValue_.size() == 0));
+	integer_ = atoi(value);
+	float_   = atof(value);
 }
 
 
@@ -73,202 +100,321 @@ Ref<ConfigValue> ConfigValue::make(string name, bool value)
 
 
 ////////////////////////////////////////////////////////////////////////////////
-// Config
+// ConfigHandle
 ////////////////////////////////////////////////////////////////////////////////
 
 
-Ref<Config> Config::globalConfig_;
+static Mutex& slotMutex()
+{
+	static Mutex *mutex = new Mutex();
+	return *mutex;
+}
+
+
+typedef std::tr1::unordered_map<string, int> SlotIndex;
+
+
+static SlotIndex& slotIndex()
+{
+	static SlotIndex *index = new SlotIndex();
+	return *index;
+}
 
 
 /**
- *
+ * Keys of the slots, indexed by slot.
  */
-void Config::setDefault(Ref<ConfigValue> value)
+static vector<string>& slotKeys()
+{
+	static vector<string> *keys = new vector<string>();
+	return *keys;
+}
+
+
+ConfigHandle::ConfigHandle(const string &key) :
+	slot_(resolve(key)), key_(key)
 {
-	defaults_[value->getName()] = value;
 }
 
 
+int ConfigHandle::resolve(const string &key)
+{
+	MutexLock lock(&slotMutex());
+	
+	SlotIndex &index = slotIndex();
+	VAR(found, index.find(key));
+	if (found != index.end())
+		return found->second;
+	
+	int slot = index.size();
+	index[key] = slot;
+	slotKeys().push_back(key);
+	return slot;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Config
+////////////////////////////////////////////////////////////////////////////////
+
+
 /**
- *
+ * The snapshot is leaked, so that it can be used during static
+ * destruction.
  */
-void Config::set(Ref<ConfigValue> value)
+static RcuPtr<Ref<Config> >& globalSnapshot()
+{
+	static RcuPtr<Ref<Config> > *snapshot = new RcuPtr<Ref<Config> >();
+	return *snapshot;
+}
+
+
+static Mutex& globalSnapshotMutex()
 {
-	values_[value->getName()] = value;
+	static Mutex *mutex = new Mutex();
+	return *mutex;
 }
 
 
 /**
- *
+ * The reference is copied inside an RCU read section, so the returned
+ * snapshot stays valid even if it is replaced concurrently.
  */
-Ref<ConfigValue> Config::get(const string &key)
+Ref<Config> Config::globalConfig()
 {
-	VAR(it, values_.find(key));
-	if (it != values_.end()) return it->second;
-	
-	it = defaults_.find(key);
-	if (it != defaults_.end()) return it->second;
+	{
+		RcuReadLock lock;
+		Ref<Config> *config = globalSnapshot().get();
+		if (config != NULL)
+			return *config;
+	}
 	
-	return NULL;
+	MutexLock lock(&globalSnapshotMutex());
+	if (globalSnapshot().get() == NULL)
+		globalSnapshot().publish(new Ref<Config>(new Config()));
+	return *globalSnapshot().get();
 }
 
 
-Ref<ConfigValue> Config::get(const string &key, const string &deflt)
+void Config::setGlobalConfig(Ref<Config> config)
 {
-	VAR(result, get(key));
-	if (result.isNull()) return new ConfigValue(key, deflt);
-	return result;
+	MutexLock lock(&globalSnapshotMutex());
+	globalSnapshot().update(new Ref<Config>(config));
 }
 
 
 /**
- *
+ * The key of an entry points to the name of its value, so a value that
+ * replaces another replaces the key as well.
  */
-void Config::dump(ostream &output)
+void Config::put(ValueMap *map, const Ref<ConfigValue> &value)
 {
-	output << "# Defaults" << endl;
-	
-	FOR_EACH(defaults_, it) {
-		output << it->first << " = " << it->second->asString() << endl;
+	pair<ValueMap::iterator, bool> result = map->insert(make_pair(&value->getName(), value));
+	if (!result.second) {
+		map->erase(result.first);
+		map->insert(make_pair(&value->getName(), value));
 	}
+}
+
+
+ConfigValue* Config::find(const string &key) const
+{
+	VAR(it, values_.find(&key));
+	if (it != values_.end()) return it->second.getPtr();
 	
-	output << "# Values" << endl;
+	it = defaults_.find(&key);
+	if (it != defaults_.end()) return it->second.getPtr();
 	
-	FOR_EACH(values_, it) {
-		output << it->first << " = " << it->second->asString() << endl;
-	}
+	return NULL;
 }
 
 
-////////////////////////////////////////////////////////////////////////////////
-// ConfigParser
-////////////////////////////////////////////////////////////////////////////////
+/**
+ * Only keys that have a handle have a slot. The slots of the handles
+ * created since the configuration last changed are filled in first.
+ */
+void Config::setSlot(const string &key, ConfigValue *value)
+{
+	MutexLock lock(&slotMutex());
+	
+	vector<string> &keys = slotKeys();
+	for (size_t slot = slots_.size(); slot < keys.size(); slot++)
+		slots_.push_back(find(keys[slot]));
+	
+	SlotIndex &index = slotIndex();
+	VAR(found, index.find(key));
+	if (found != index.end())
+		slots_[found->second] = value;
+}
 
 
 /**
- *
+ * Looks up the key of every handle, which costs the same however many
+ * values have changed.
  */
-void ConfigParser::handleError()
+void Config::resolveSlots()
 {
-	LOG_ERROR("Error occured while reading configuration from " <<
-			input_->getName() << " on line " << loc_.line << ".");
-	error_ = true;
+	MutexLock lock(&slotMutex());
+	
+	vector<string> &keys = slotKeys();
+	slots_.resize(keys.size());
+	for (size_t slot = 0; slot < keys.size(); slot++)
+		slots_[slot] = find(keys[slot]);
 }
 
 
 /**
  *
  */
-bool ConfigParser::shouldContinue()
+void Config::setDefault(Ref<ConfigValue> value)
 {
-	return ((!error_) && (input_->getStream()->good()));
+	put(&defaults_, value);
+	if (values_.find(&value->getName()) == values_.end())
+		setSlot(value->getName(), value.getPtr());
 }
 
 
 /**
  *
  */
-void ConfigParser::skipWhitespace()
+void Config::set(Ref<ConfigValue> value)
 {
-	if (!shouldContinue()) return;
+	put(&values_, value);
+	setSlot(value->getName(), value.getPtr());
+}
+
+
+void Config::set(const vector<Ref<ConfigValue> > &values)
+{
+	values_.rehash(values_.size() + values.size());
+	FOR_EACH(values, value)
+		put(&values_, *value);
 	
-	while ((peek() != '\n') && (isspace(peek())))
-		get();
+	resolveSlots();
 }
 
 
-/**
- *
- */
-void ConfigParser::readComment()
+void Config::copyDefaults(Ref<Config> other)
 {
-	if (!shouldContinue()) return;
-	while (peek() != '\n') get();
+	FOR_EACH(other->defaults_, it) {
+		setDefault(it->second);
+	}
+}
+
+
+void Config::merge(Ref<Config> other)
+{
+	FOR_EACH(other->values_, it) {
+		set(it->second);
+	}
 }
 
 
 /**
  *
  */
-void ConfigParser::readKey()
+Ref<ConfigValue> Config::get(const string &key)
 {
-	if (!shouldContinue()) return;
-	
-	ostringstream output;
-	
-	skipWhitespace();
-	
-	while (isKeyChar(peek()))
-		output.put(get());
-	
-	string result = output.str();
+	return find(key);
+}
+
+
+Ref<ConfigValue> Config::get(const string &key, const string &deflt)
+{
+	VAR(result, get(key));
+	if (result.isNull()) return new ConfigValue(key, deflt);
+	return result;
+}
+
+
+vector<string> Config::getKeys()
+{
+	vector<string> keys;
 	
-	if (result.size() == 0) {
-		handleError();
-		return;
+	FOR_EACH(defaults_, it) {
+		keys.push_back(*it->first);
+	}
+	FOR_EACH(values_, it) {
+		if (defaults_.find(it->first) == defaults_.end())
+			keys.push_back(*it->first);
 	}
 	
-	key_ = result;
+	sort(keys.begin(), keys.end());
+	return keys;
 }
 
 
-void ConfigParser::readValue()
+vector<string> Config::diff(Ref<Config> oldConfig, Ref<Config> newConfig)
 {
-	if (!shouldContinue()) return;
+	vector<string> oldKeys = oldConfig->getKeys();
+	vector<string> newKeys = newConfig->getKeys();
 	
-	ostringstream output;
+	vector<string> keys;
+	set_union(oldKeys.begin(), oldKeys.end(),
+	          newKeys.begin(), newKeys.end(),
+	          back_inserter(keys));
 	
-	skipWhitespace();
-	
-	while ((peek() != '\n') && (peek() != EOF))
-		output.put(get());
+	vector<string> changed;
+	FOR_EACH(keys, key) {
+		Ref<ConfigValue> oldValue = oldConfig->get(*key);
+		Ref<ConfigValue> newValue = newConfig->get(*key);
+		
+		if (oldValue.isNull() != newValue.isNull())
+			changed.push_back(*key);
+		else if (oldValue.isNotNull() && (oldValue->asString() != newValue->asString()))
+			changed.push_back(*key);
+	}
 	
-	value_ = output.str();
+	return changed;
 }
 
 
-void ConfigParser::readLine()
+/**
+ *
+ */
+void Config::dump(ostream &output)
 {
-	if (!shouldContinue()) return;
+	map<string, Ref<ConfigValue> > defaults;
+	map<string, Ref<ConfigValue> > values;
+	FOR_EACH(defaults_, it) defaults[*it->first] = it->second;
+	FOR_EACH(values_, it)   values[*it->first]   = it->second;
 	
-	skipWhitespace();
+	output << "# Defaults" << endl;
 	
-	if (peek() == '#') {
-		readComment();
-	} else if (isalnum(peek())) {
-		readKey();
-		skipWhitespace();
-		expect('=');
-		readValue();
-		
-		ConfigValue *cfgval = new ConfigValue(key_, value_);
-		config_->set(cfgval);
+	FOR_EACH(defaults, it) {
+		output << it->first << " = " << it->second->asString() << endl;
 	}
 	
-	skipWhitespace();
+	output << "# Values" << endl;
+	
+	FOR_EACH(values, it) {
+		output << it->first << " = " << it->second->asString() << endl;
+	}
 }
 
 
+////////////////////////////////////////////////////////////////////////////////
+// ConfigParser
+////////////////////////////////////////////////////////////////////////////////
+
+
 /**
  * Constructor.
  */
 ConfigParser::ConfigParser(Ref<Config> config) :
-	config_(config)
+	config_(config),
+	error_(false)
 {
 }
 
 
 /**
- *
+ * The whole input is read into memory and parsed as a buffer.
  */
 void ConfigParser::parse(Ref<Input> input)
 {
-	input_ = input;
-	loc_ = TextLoc2();
 	error_ = false;
-	key_ = "";
-	value_ = "";
-
+	
 	if (!input->getStream()->good()) {
 		LOG_WARNING("Cannot read configuration from " <<
 				  input->getName() <<
@@ -276,16 +422,109 @@ void ConfigParser::parse(Ref<Input> input)
 		return;
 	}
 	
+	ostringstream content;
+	content << input->getStream()->rdbuf();
+	string data = content.str();
+	
+	parse(data.data(), data.size(), input->getName());
+}
+
+
+bool ConfigParser::parseFile(const string &fileName)
+{
+	error_ = false;
+	
+	int fd = ::open(fileName.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		LOG_WARNING("Cannot read configuration from " << fileName << ". The file may not exist.");
+		error_ = true;
+		return false;
+	}
+	
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		::close(fd);
+		error_ = true;
+		return false;
+	}
+	
+	if (st.st_size == 0) {
+		::close(fd);
+		return parse("", 0, fileName);
+	}
+	
+	void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (data == MAP_FAILED) {
+		error_ = true;
+		return false;
+	}
+	madvise(data, st.st_size, MADV_SEQUENTIAL);
+	
+	bool result = parse((const char*)data, st.st_size, fileName);
+	
+	munmap(data, st.st_size);
+	return result;
+}
+
+
+/**
+ * Lines are found by \c memchr() and the values are collected and added
+ * to the configuration at once by \ref Config::set().
+ */
+bool ConfigParser::parse(const char *data, size_t size, const string &name)
+{
+	error_ = false;
 	if (config_.isNull())
 		config_ = new Config();
 	
-	while (true) {
-		readLine();
-		if (peek() != '\n') break;
-		get();
+	vector<Ref<ConfigValue> > values;
+	
+	const char *p    = data;
+	const char *end  = data + size;
+	int         line = 1;
+	
+	for (; p < end; line++) {
+		const char *eol = (const char*)memchr(p, '\n', end - p);
+		if (eol == NULL)
+			eol = end;
+		
+		const char *s = p;
+		p = eol + 1;
+		
+		while ((s < eol) && isspace((unsigned char)*s))
+			s++;
+		if ((s == eol) || (*s == '#'))
+			continue;
+		
+		if (!isalnum((unsigned char)*s)) {
+			error_ = true;
+			break;
+		}
+		
+		const char *key = s;
+		while ((s < eol) && !isspace((unsigned char)*s) && (*s != '='))
+			s++;
+		const char *keyEnd = s;
+		
+		while ((s < eol) && isspace((unsigned char)*s))
+			s++;
+		if ((s == eol) || (*s != '=')) {
+			error_ = true;
+			break;
+		}
+		s++;
+		
+		values.push_back(new ConfigValue(key, keyEnd - key, s, eol - s));
+	}
+	
+	if (error_) {
+		LOG_ERROR("Error occured while reading configuration from " <<
+				name << " on line " << line << ".");
 	}
 	
-	if (peek() != EOF) handleError();
+	config_->set(values);
+	return !error_;
 }
 
 
@@ -14,6 +14,8 @@
 #include <sstream>
 #include <iostream>
 #include <map>
+#include <vector>
+#include <tr1/unordered_map>
 using namespace std;
 
 #include "Object.h"
@@ -23,21 +25,37 @@ using namespace std;
 namespace cppapp {
 
 
+/**
+ * \brief Value of a configuration key.
+ *
+ * Values are immutable; the typed representations are parsed once by
+ * the constructor.
+ */
 class ConfigValue : public Object {
 private:
 	string name_;
 	string rawValue_;
+	
+	bool   bool_;
+	int    integer_;
+	float  float_;
+	
+	void parse();
 
 public:
 	ConfigValue(string name, string rawValue);
+	/**
+	 * \brief Constructor taking the name and value as character ranges.
+	 */
+	ConfigValue(const char *name, size_t nameSize, const char *rawValue, size_t rawValueSize);
 	virtual ~ConfigValue() {}
 	
-	string getName() { return name_; }
+	const string& getName() const { return name_; }
 	
-	string asString() const { return rawValue_; }
-	bool   asBool() const;
-	int    asInteger() const;
-	float  asFloat() const;
+	const string& asString() const  { return rawValue_; }
+	bool          asBool() const    { return bool_; }
+	int           asInteger() const { return integer_; }
+	float         asFloat() const   { return float_; }
 	
 	template<class T>
 	static Ref<ConfigValue> make(string name, T value)
@@ -52,24 +70,78 @@ public:
 };
 
 
+/**
+ * \brief Key resolved to a slot for fast reads from any \ref Config.
+ *
+ * Every handle gets a process-wide slot number for its key, and every
+ * configuration keeps the values of the keys that have handles in an
+ * array indexed by the slot, so reading through a handle is an array
+ * access:
+ *
+ * \code
+ * static const ConfigHandle maxRequests("max_requests");
+ * ...
+ * int limit = config->getInteger(maxRequests, 100);
+ * \endcode
+ *
+ * Handles are cheap to copy and can be created at any time, including
+ * before the key is set.
+ */
+class ConfigHandle {
+private:
+	int    slot_;
+	string key_;
+
+public:
+	explicit ConfigHandle(const string &key);
+	
+	int           getSlot() const { return slot_; }
+	const string& getKey() const  { return key_; }
+	
+	/**
+	 * \brief Returns the slot of \p key, assigning a new one if needed.
+	 */
+	static int resolve(const string &key);
+};
+
+
 /**
  * \todo Write documentation for class Config.
+ *
+ * The global configuration is an immutable snapshot once it has been
+ * published: \ref setGlobalConfig() replaces it atomically (see
+ * \ref ConfigWatcher) and \ref globalConfig() can be called from any
+ * thread. Changes are made on a new instance which is then published.
  */
 class Config : public Object {
 private:
-	map<string, Ref<ConfigValue> > defaults_;
-	map<string, Ref<ConfigValue> > values_;
+	struct KeyHash {
+		size_t operator()(const string *key) const { return std::tr1::hash<string>()(*key); }
+	};
+	
+	struct KeyEqual {
+		bool operator()(const string *a, const string *b) const { return *a == *b; }
+	};
+	
+	/// Keyed by the name of the value, which is not copied.
+	typedef std::tr1::unordered_map<const string*, Ref<ConfigValue>, KeyHash, KeyEqual> ValueMap;
+	
+	static void put(ValueMap *map, const Ref<ConfigValue> &value);
 	
-	static Ref<Config> globalConfig_;
+	ValueMap                       defaults_;
+	ValueMap                       values_;
+	
+	/// Effective values (owned by the maps) indexed by slot, for the
+	/// handles that existed when the configuration last changed.
+	vector<ConfigValue*>           slots_;
+	
+	ConfigValue* find(const string &key) const;
+	void         setSlot(const string &key, ConfigValue *value);
+	void         resolveSlots();
 	
 public:
-	static Ref<Config> globalConfig()
-	{
-		if (globalConfig_.isNull())
-			globalConfig_ = new Config();
-		return globalConfig_;
-	}
-	static void setGlobalConfig(Ref<Config> config) { globalConfig_ = config; }
+	static Ref<Config> globalConfig();
+	static void        setGlobalConfig(Ref<Config> config);
 	
 	Config() {}
 	//Config(const Config& other);
@@ -77,10 +149,71 @@ public:
 	
 	void setDefault(Ref<ConfigValue> value);
 	void set(Ref<ConfigValue> value);
+	/**
+	 * \brief Sets many values at once, in order.
+	 *
+	 * Faster than calling \ref set() for every value, the slots are
+	 * updated once for all handles rather than for every key.
+	 */
+	void set(const vector<Ref<ConfigValue> > &values);
+	
+	/**
+	 * \brief Copies the defaults of \p other into this configuration.
+	 */
+	void copyDefaults(Ref<Config> other);
+	/**
+	 * \brief Sets all values of \p other in this configuration.
+	 */
+	void merge(Ref<Config> other);
 	
 	Ref<ConfigValue> get(const string &key);
 	Ref<ConfigValue> get(const string &key, const string &deflt);
 	
+	/**
+	 * \name Handle Accessors
+	 *
+	 * Return the value of a key resolved by a \ref ConfigHandle without
+	 * allocating: an array access, or a hash lookup for handles created
+	 * after the configuration last changed. The returned pointer is valid
+	 * while the configuration exists and the key is not set again.
+	 */
+	///@{
+	ConfigValue* get(const ConfigHandle &handle) const
+	{
+		size_t slot = handle.getSlot();
+		return (slot < slots_.size()) ? slots_[slot] : find(handle.getKey());
+	}
+	
+	bool getBool(const ConfigHandle &handle, bool deflt) const
+	{
+		ConfigValue *value = get(handle);
+		return (value == NULL) ? deflt : value->asBool();
+	}
+	
+	int getInteger(const ConfigHandle &handle, int deflt) const
+	{
+		ConfigValue *value = get(handle);
+		return (value == NULL) ? deflt : value->asInteger();
+	}
+	
+	float getFloat(const ConfigHandle &handle, float deflt) const
+	{
+		ConfigValue *value = get(handle);
+		return (value == NULL) ? deflt : value->asFloat();
+	}
+	///@}
+	
+	/**
+	 * \brief Returns all keys that have a value or a default, sorted.
+	 */
+	vector<string> getKeys();
+	/**
+	 * \brief Returns the sorted keys whose values differ between
+	 *        \p oldConfig and \p newConfig, including added and
+	 *        removed keys.
+	 */
+	static vector<string> diff(Ref<Config> oldConfig, Ref<Config> newConfig);
+	
 	void dump(ostream &output);
 };
 
@@ -106,58 +239,52 @@ struct TextLoc2 {
 };
 
 
+/**
+ * \brief Parser of <tt>key = value</tt> configuration files.
+ *
+ * Lines starting with \c # are comments, keys must start with an
+ * alphanumeric character and end with white space or \c =, values are
+ * trimmed. Parsing stops at the first invalid line; the values before it
+ * are kept.
+ *
+ * The input is parsed from a single buffer (a memory mapped file with
+ * \ref parseFile()) and the values are added to the configuration at
+ * once. Every entry is still a \ref ConfigValue object and an entry of
+ * a hash map, values are handed out by reference and may outlive the
+ * configuration.
+ */
 class ConfigParser : public Object {
 private:
 	Ref<Config> config_;
-	
-	Ref<Input> input_;
-	
-	TextLoc2 loc_;
-	bool error_;
-	string key_;
-	string value_;
-	
-	inline bool isKeyChar(int c)
-	{
-		return (!isspace(c)) && (c != '=');
-	}
-	
-	inline int peek() { return input_->getStream()->peek(); }
-	
-	inline int get()
-	{
-		int result = input_->getStream()->get();
-		if (result == EOF) return result;
-		loc_++;
-		if (result == '\n') loc_ = loc_.newline();
-		return result;
-	}
-	
-	inline void expect(int ch)
-	{
-		if (peek() != ch) {
-			handleError();
-			return;
-		}
-		get();
-	}
-	
-	void handleError();
-	bool shouldContinue();
-	
-	void skipWhitespace();
-	void readComment();
-	void readKey();
-	void readValue();
-	void readLine();
+	bool        error_;
 
 public:
 	ConfigParser(Ref<Config> config);
 	virtual ~ConfigParser() {}
 
 	Ref<Config> getConfig() { return config_; }
+	/**
+	 * \brief Returns \c true if the last parse found no errors.
+	 */
+	bool        isValid() const { return !error_; }
 	
+	/**
+	 * \brief Parses the whole input.
+	 */
 	void parse(Ref<Input> input);
+	/**
+	 * \brief Parses a file, reading it through a memory mapping.
+	 *
+	 * \returns \c false if the file cannot be read or parsed
+	 */
+	bool parseFile(const string &fileName);
+	/**
+	 * \brief Parses \p size bytes at \p data.
+	 *
+	 * \param name name of the input used in error messages
+	 * \returns \c false if the input is not valid
+	 */
+	bool parse(const char *data, size_t size, const string &name);
 };
 
 
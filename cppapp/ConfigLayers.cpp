@@ -0,0 +1,201 @@
+/**
+ * \file   ConfigLayers.cpp
+ * \author Jan Milík <milikjan@fit.cvut.cz>
+ * \date   2026-10-19
+ *
+ * \brief  Implementation file for the ConfigLayers class.
+ */
+
+#include "ConfigLayers.h"
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#include "Input.h"
+#include "json.h"
+#include "Logger.h"
+#include "utils.h"
+#include "string_utils.h"
+
+
+extern char **environ;
+
+
+namespace cppapp {
+
+
+/**
+ * Integral numbers are written without an exponent, so that they can be
+ * read by \ref ConfigValue::asInteger().
+ */
+static string numberToString(double value)
+{
+	ostringstream s;
+	if ((value == floor(value)) && (fabs(value) < 1e15))
+		s << (long long)value;
+	else {
+		s.precision(17);
+		s << value;
+	}
+	return s.str();
+}
+
+
+void ConfigLayers::flattenDyn(Ref<DynObject> obj, const string &prefix, Ref<Config> config)
+{
+	if (obj.isNull() || obj->isNull() || obj->isError())
+		return;
+	
+	string dot = prefix.empty() ? "" : ".";
+	
+	if (obj->isDict()) {
+		DYN_FOR_EACH(key, obj->getKeys()) {
+			flattenDyn(obj->getStrItem(key->getString()), prefix + dot + key->getString(), config);
+		}
+	} else if (obj->isList()) {
+		for (int i = 0; i < obj->getSize(); i++) {
+			ostringstream index;
+			index << i;
+			flattenDyn(obj->getIntItem(i), prefix + dot + index.str(), config);
+		}
+	} else if (obj->isNum()) {
+		config->set(new ConfigValue(prefix, numberToString(obj->getDouble())));
+	} else {
+		config->set(new ConfigValue(prefix, obj->getString()));
+	}
+}
+
+
+void ConfigLayers::add(ConfigLayerKind kind, const string &name, Ref<Config> config)
+{
+	Layer layer;
+	layer.kind   = kind;
+	layer.name   = name;
+	layer.config = config;
+	layers_.push_back(layer);
+}
+
+
+void ConfigLayers::addDefaults(Ref<Config> defaults)
+{
+	add(CONFIG_LAYER_DEFAULTS, "defaults", defaults);
+}
+
+
+bool ConfigLayers::addFile(const string &fileName)
+{
+	Ref<FileInput> input = new FileInput(fileName);
+	if (!input->exists()) {
+		LOG_WARNING("Configuration file " << fileName << " does not exist.");
+		return false;
+	}
+	
+	Ref<Config> config = new Config();
+	
+	if (input->hasExtension("json")) {
+		JSONParser     parser;
+		Ref<DynObject> tree = parser.parse(input.as<Input>());
+		input->close();
+		if (tree.isNull() || tree->isError() || !tree->isDict()) {
+			LOG_ERROR("Configuration file " << fileName << " is not a JSON object.");
+			return false;
+		}
+		flattenDyn(tree, "", config);
+	} else {
+		input->close();
+		ConfigParser parser(config);
+		if (!parser.parseFile(fileName))
+			return false;
+	}
+	
+	add(CONFIG_LAYER_FILE, fileName, config);
+	return true;
+}
+
+
+void ConfigLayers::addEnvironment(const string &prefix, char **env)
+{
+	if (env == NULL)
+		env = environ;
+	
+	Ref<Config> config = new Config();
+	
+	for (; *env != NULL; env++) {
+		const char *var   = *env;
+		const char *equal = strchr(var, '=');
+		if ((equal == NULL) || (strncmp(var, prefix.c_str(), prefix.size()) != 0))
+			continue;
+		
+		string name(var + prefix.size(), equal);
+		if (name.empty())
+			continue;
+		
+		string key;
+		for (size_t i = 0; i < name.size(); i++) {
+			if ((name[i] == '_') && (i + 1 < name.size()) && (name[i + 1] == '_')) {
+				key += '.';
+				i++;
+			} else {
+				key += tolower(name[i]);
+			}
+		}
+		
+		config->set(new ConfigValue(key, equal + 1));
+	}
+	
+	add(CONFIG_LAYER_ENVIRONMENT, "environment", config);
+}
+
+
+void ConfigLayers::addCommandLine(const Options &options)
+{
+	Ref<Config> config = new Config();
+	options.setConfigKeys(config);
+	add(CONFIG_LAYER_COMMAND_LINE, "command line", config);
+}
+
+
+Ref<Config> ConfigLayers::flatten(Ref<Config> target)
+{
+	if (target.isNull())
+		target = new Config();
+	
+	// Layers of the same kind keep the order in which they were added
+	vector<ConfigLayerKind> kinds;
+	FOR_EACH(layers_, layer) {
+		kinds.push_back(layer->kind);
+	}
+	std::sort(kinds.begin(), kinds.end());
+	kinds.erase(std::unique(kinds.begin(), kinds.end()), kinds.end());
+	
+	origins_.clear();
+	FOR_EACH(kinds, kind) {
+		FOR_EACH(layers_, layer) {
+			if (layer->kind != *kind)
+				continue;
+			
+			vector<string> keys = layer->config->getKeys();
+			FOR_EACH(keys, key) {
+				Ref<ConfigValue> value = layer->config->get(*key);
+				if (*kind == CONFIG_LAYER_DEFAULTS)
+					target->setDefault(value);
+				else
+					target->set(value);
+				origins_[*key] = layer->name;
+			}
+		}
+	}
+	
+	return target;
+}
+
+
+string ConfigLayers::getOrigin(const string &key)
+{
+	VAR(found, origins_.find(key));
+	return (found == origins_.end()) ? "" : found->second;
+}
+
+
+} // namespace cppapp
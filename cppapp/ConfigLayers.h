@@ -0,0 +1,140 @@
+/**
+ * \file   ConfigLayers.h
+ * \author Jan Milík <milikjan@fit.cvut.cz>
+ * \date   2026-10-19
+ *
+ * \brief  Header file for the ConfigLayers class.
+ */
+
+#ifndef CONFIGLAYERS_H7XW2PLN
+#define CONFIGLAYERS_H7XW2PLN
+
+
+#include <string>
+#include <vector>
+#include <map>
+
+#include "Object.h"
+#include "Config.h"
+#include "DynObject.h"
+#include "Options.h"
+
+
+namespace cppapp {
+
+
+/**
+ * \brief Kinds of configuration layers, from the lowest precedence to the
+ *        highest.
+ */
+enum ConfigLayerKind {
+	CONFIG_LAYER_DEFAULTS,
+	CONFIG_LAYER_FILE,
+	CONFIG_LAYER_ENVIRONMENT,
+	CONFIG_LAYER_COMMAND_LINE
+};
+
+
+/**
+ * \brief Stack of configuration sources flattened into a single
+ *        \ref Config.
+ *
+ * A key is taken from the layer with the highest precedence that sets
+ * it: the command line overrides the environment, which overrides the
+ * files, which override the built-in defaults. Of two layers of the same
+ * kind (typically files), the one added later wins, regardless of the
+ * order in which layers of different kinds were added.
+ *
+ * \ref flatten() resolves the precedence once, so the lookups in the
+ * resulting configuration do not depend on the number of layers.
+ *
+ * \code
+ * ConfigLayers layers;
+ * layers.addDefaults(defaults);
+ * layers.addFile("/etc/app.conf");
+ * layers.addFile("/etc/app.d/local.json");
+ * layers.addEnvironment("APP_");
+ * layers.addCommandLine(options);
+ * Config::setGlobalConfig(layers.flatten());
+ * \endcode
+ */
+class ConfigLayers : public Object {
+private:
+	struct Layer {
+		ConfigLayerKind kind;
+		string          name;
+		Ref<Config>     config;
+	};
+	
+	vector<Layer>       layers_;
+	map<string, string> origins_;
+
+public:
+	ConfigLayers() {}
+	virtual ~ConfigLayers() {}
+	
+	/**
+	 * \brief Adds a layer.
+	 *
+	 * \param kind   kind of the layer, determines its precedence
+	 * \param name   name of the layer used by \ref getOrigin()
+	 * \param config values of the layer, including its defaults
+	 */
+	void add(ConfigLayerKind kind, const string &name, Ref<Config> config);
+	
+	void addDefaults(Ref<Config> defaults);
+	/**
+	 * \brief Adds a file layer.
+	 *
+	 * Files with the \c .json extension are read by \ref JSONParser and
+	 * nested keys are joined by dots (<tt>{"cache": {"size": 10}}</tt>
+	 * sets \c cache.size); other files are read by \ref ConfigParser.
+	 *
+	 * \returns \c false if the file does not exist or cannot be parsed,
+	 *          the layer is not added then
+	 */
+	bool addFile(const string &fileName);
+	/**
+	 * \brief Adds the environment variables starting with \p prefix.
+	 *
+	 * The prefix is removed, the rest of the name is lowercased and
+	 * double underscores are replaced by dots, so \c APP_CACHE__MAX_SIZE
+	 * with the prefix \c APP_ sets \c cache.max_size.
+	 *
+	 * \param prefix prefix of the variables
+	 * \param env    environment to read, \c NULL for the process environment
+	 */
+	void addEnvironment(const string &prefix, char **env = NULL);
+	/**
+	 * \brief Adds the values of the options that were set.
+	 */
+	void addCommandLine(const Options &options);
+	
+	/**
+	 * \brief Resolves the precedence of the layers into one configuration.
+	 *
+	 * Values of the defaults layers become defaults of the result, the
+	 * other values become its values.
+	 *
+	 * \param target configuration to fill, a new one if \c NULL
+	 */
+	Ref<Config> flatten(Ref<Config> target = NULL);
+	
+	/**
+	 * \brief Returns the name of the layer the value of \p key came from
+	 *        in the last \ref flatten(), or an empty string.
+	 */
+	string getOrigin(const string &key);
+	
+	/**
+	 * \brief Sets the scalars of a JSON tree as values of \p config,
+	 *        with keys joined by dots (list items by their index).
+	 */
+	static void flattenDyn(Ref<DynObject> obj, const string &prefix, Ref<Config> config);
+};
+
+
+} // namespace cppapp
+
+
+#endif /* end of include guard: CONFIGLAYERS_H7XW2PLN */
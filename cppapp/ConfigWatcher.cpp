@@ -0,0 +1,281 @@
+/**
+ * \file   ConfigWatcher.cpp
+ * \author Jan Milík <milikjan@fit.cvut.cz>
+ * \date   2026-10-19
+ *
+ * \brief  Implementation file for the ConfigWatcher class.
+ */
+
+#include "ConfigWatcher.h"
+#include "ConfigLayers.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <cerrno>
+#include <cstring>
+
+#include "Input.h"
+#include "Logger.h"
+#include "Thread.h"
+#include "utils.h"
+
+
+namespace cppapp {
+
+
+////////////////////////////////////////////////////////////////////////////////
+// WATCHER THREAD
+////////////////////////////////////////////////////////////////////////////////
+
+
+class ConfigWatcherThread : public Thread {
+private:
+	ConfigWatcher *watcher_;
+
+public:
+	ConfigWatcherThread(ConfigWatcher *watcher) : Thread(false), watcher_(watcher)
+	{
+		start();
+	}
+
+	virtual void* run()
+	{
+		watcher_->watch();
+		return NULL;
+	}
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// CONFIG WATCHER
+////////////////////////////////////////////////////////////////////////////////
+
+
+ConfigWatcher::ConfigWatcher(const string &fileName, Ref<Config> overrides, int interval) :
+	fileName_(fileName),
+	overrides_(overrides),
+	interval_(interval > 0 ? interval : CPPAPP_CONFIG_WATCH_INTERVAL),
+	thread_(NULL),
+	inotify_(-1)
+{
+	wakeup_[0] = -1;
+	wakeup_[1] = -1;
+	signature_ = getSignature();
+}
+
+
+ConfigWatcher::~ConfigWatcher()
+{
+	stop();
+}
+
+
+/**
+ * The signature changes whenever the file is modified or replaced.
+ */
+string ConfigWatcher::getSignature()
+{
+	struct stat st;
+	if (stat(fileName_.c_str(), &st) != 0)
+		return "";
+
+	ostringstream s;
+	s << st.st_dev << ":" << st.st_ino << ":" << st.st_size << ":"
+	  << st.st_mtim.tv_sec << "." << st.st_mtim.tv_nsec;
+	return s.str();
+}
+
+
+void ConfigWatcher::addListener(const string &key, Ref<ConfigListener> listener)
+{
+	MutexLock lock(&listenersMutex_);
+	listeners_.insert(std::make_pair(key, listener));
+}
+
+
+void ConfigWatcher::removeListener(Ref<ConfigListener> listener)
+{
+	MutexLock lock(&listenersMutex_);
+	for (VAR(it, listeners_.begin()); it != listeners_.end();) {
+		if (it->second == listener)
+			listeners_.erase(it++);
+		else
+			++it;
+	}
+}
+
+
+/**
+ * Listeners are called without the lock, so they can add or remove
+ * listeners.
+ */
+void ConfigWatcher::notify(const string &key, Ref<ConfigValue> oldValue, Ref<ConfigValue> newValue)
+{
+	std::vector<Ref<ConfigListener> > listeners;
+	{
+		MutexLock lock(&listenersMutex_);
+		
+		VAR(range, listeners_.equal_range(key));
+		for (VAR(it, range.first); it != range.second; ++it)
+			listeners.push_back(it->second);
+		
+		range = listeners_.equal_range("");
+		for (VAR(it, range.first); it != range.second; ++it)
+			listeners.push_back(it->second);
+	}
+	
+	FOR_EACH(listeners, listener) {
+		(*listener)->configChanged(key, oldValue, newValue);
+	}
+}
+
+
+/**
+ * Reloads are serialized, so listeners see the changes in the order in
+ * which they were published. The file is read by
+ * \ref ConfigLayers::addFile(), so JSON files are reloaded as well.
+ */
+bool ConfigWatcher::reload()
+{
+	MutexLock lock(&reloadMutex_);
+	
+	signature_ = getSignature();
+	
+	Ref<Config> current = Config::globalConfig();
+	Ref<Config> next    = new Config();
+	next->copyDefaults(current);
+	
+	ConfigLayers layers;
+	if (!layers.addFile(fileName_)) {
+		LOG_ERROR("Cannot reload configuration from " << fileName_ << ", keeping the current one.");
+		return false;
+	}
+	if (overrides_.isNotNull())
+		layers.add(CONFIG_LAYER_COMMAND_LINE, "overrides", overrides_);
+	layers.flatten(next);
+	
+	vector<string> changed = Config::diff(current, next);
+	if (changed.empty())
+		return true;
+	
+	Config::setGlobalConfig(next);
+	LOG_INFO("Configuration reloaded from " << fileName_ << ", " << changed.size() << " key(s) changed.");
+	
+	FOR_EACH(changed, key) {
+		notify(*key, current->get(*key), next->get(*key));
+	}
+	
+	return true;
+}
+
+
+void ConfigWatcher::start()
+{
+	if (thread_ != NULL)
+		return;
+	
+	if (pipe(wakeup_) != 0) {
+		LOG_ERROR("Cannot watch configuration file " << fileName_ << ": " << strerror(errno));
+		return;
+	}
+	fcntl(wakeup_[0], F_SETFD, FD_CLOEXEC);
+	fcntl(wakeup_[1], F_SETFD, FD_CLOEXEC);
+	
+	// Watch the directory, editors often replace the file by renaming
+	inotify_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (inotify_ >= 0) {
+		size_t slash = fileName_.rfind('/');
+		string dir   = (slash == string::npos) ? "." : fileName_.substr(0, slash + 1);
+		int mask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE | IN_ATTRIB;
+		if (inotify_add_watch(inotify_, dir.c_str(), mask) < 0) {
+			close(inotify_);
+			inotify_ = -1;
+		}
+	}
+	if (inotify_ < 0)
+		LOG_DEBUG("Watching configuration file " << fileName_ << " by polling.");
+	
+	thread_ = new ConfigWatcherThread(this);
+}
+
+
+void ConfigWatcher::stop()
+{
+	if (thread_ == NULL)
+		return;
+	
+	char c = 0;
+	while ((write(wakeup_[1], &c, 1) < 0) && (errno == EINTR))
+		;
+	thread_->join();
+	delete thread_;
+	thread_ = NULL;
+	
+	close(wakeup_[0]);
+	close(wakeup_[1]);
+	wakeup_[0] = wakeup_[1] = -1;
+	if (inotify_ >= 0) {
+		close(inotify_);
+		inotify_ = -1;
+	}
+}
+
+
+/**
+ * Events are collected for a short while before reloading, so that a file
+ * written in several steps is reloaded only once.
+ */
+void ConfigWatcher::watch()
+{
+	string baseName = pathBasename(fileName_);
+	char   buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	
+	while (true) {
+		struct pollfd fds[2];
+		int nfds = 0;
+		fds[nfds].fd     = wakeup_[0];
+		fds[nfds].events = POLLIN;
+		nfds++;
+		if (inotify_ >= 0) {
+			fds[nfds].fd     = inotify_;
+			fds[nfds].events = POLLIN;
+			nfds++;
+		}
+		
+		int ready = poll(fds, nfds, interval_);
+		if ((ready < 0) && (errno != EINTR))
+			break;
+		if ((ready > 0) && (fds[0].revents != 0))
+			break;
+		
+		bool changed = false;
+		if ((ready > 0) && (nfds > 1) && (fds[1].revents != 0)) {
+			usleep(20000);
+			
+			ssize_t length;
+			while ((length = read(inotify_, buffer, sizeof(buffer))) > 0) {
+				for (char *p = buffer; p < buffer + length;) {
+					struct inotify_event *event = (struct inotify_event*)p;
+					if ((event->len > 0) && (baseName == event->name))
+						changed = true;
+					p += sizeof(struct inotify_event) + event->len;
+				}
+			}
+		}
+		
+		{
+			MutexLock lock(&reloadMutex_);
+			if (getSignature() != signature_)
+				changed = true;
+		}
+		
+		if (changed && (getSignature() != ""))
+			reload();
+	}
+}
+
+
+} // namespace cppapp
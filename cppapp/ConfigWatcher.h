@@ -0,0 +1,145 @@
+/**
+ * \file   ConfigWatcher.h
+ * \author Jan Milík <milikjan@fit.cvut.cz>
+ * \date   2026-10-19
+ *
+ * \brief  Header file for the ConfigWatcher class.
+ */
+
+#ifndef CONFIGWATCHER_B8RQ4MZE
+#define CONFIGWATCHER_B8RQ4MZE
+
+
+#include <string>
+#include <vector>
+#include <map>
+
+#include "Object.h"
+#include "Config.h"
+#include "Mutex.h"
+
+
+#define CPPAPP_CONFIG_WATCH_INTERVAL 1000
+
+
+namespace cppapp {
+
+
+/**
+ * \brief Receives changes of configuration values from a
+ *        \ref ConfigWatcher.
+ */
+class ConfigListener : public Object {
+public:
+	virtual ~ConfigListener() {}
+	
+	/**
+	 * \brief Called after a new configuration has been published.
+	 *
+	 * \param key      changed key
+	 * \param oldValue previous value, \c NULL if the key was added
+	 * \param newValue new value, \c NULL if the key was removed
+	 */
+	virtual void configChanged(const string     &key,
+	                           Ref<ConfigValue>  oldValue,
+	                           Ref<ConfigValue>  newValue) = 0;
+};
+
+
+class ConfigWatcherThread;
+
+
+/**
+ * \brief Reloads the global configuration when its file changes.
+ *
+ * The file is watched with inotify (its directory, so that editors that
+ * replace the file are noticed), and its modification time is also
+ * checked periodically, which is the only mechanism if inotify is not
+ * available. \ref reload() can also be called explicitly, for example
+ * from a \c SIGHUP handler thread.
+ *
+ * A reload reads the file like \ref ConfigLayers::addFile() (by its
+ * extension) into a new \ref Config with the defaults of
+ * the current global configuration and the overrides given to the
+ * constructor (usually the command-line options), publishes it by
+ * \ref Config::setGlobalConfig() if anything changed, and then calls the
+ * listeners of the changed keys. A file that cannot be read or parsed
+ * leaves the current configuration in place.
+ *
+ * \code
+ * Ref<ConfigWatcher> watcher = new ConfigWatcher("app.conf");
+ * watcher->addListener("cache_size", new CacheSizeListener(cache));
+ * watcher->start();
+ * \endcode
+ */
+class ConfigWatcher : public Object {
+friend class ConfigWatcherThread;
+private:
+	ConfigWatcher(const ConfigWatcher &other);
+	
+	typedef std::multimap<string, Ref<ConfigListener> > Listeners;
+	
+	string               fileName_;
+	Ref<Config>          overrides_;
+	int                  interval_;
+	
+	Mutex                reloadMutex_;
+	Mutex                listenersMutex_;
+	Listeners            listeners_;
+	
+	ConfigWatcherThread *thread_;
+	int                  inotify_;
+	int                  wakeup_[2];
+	
+	/// Identity of the file at the last reload, used by the polling.
+	string               signature_;
+	
+	string getSignature();
+	void   notify(const string &key, Ref<ConfigValue> oldValue, Ref<ConfigValue> newValue);
+	void   watch();
+
+public:
+	/**
+	 * \brief Constructor.
+	 *
+	 * \param fileName  configuration file to watch
+	 * \param overrides values set over the values from the file
+	 * \param interval  interval of the modification time checks in
+	 *                  milliseconds
+	 */
+	ConfigWatcher(const string &fileName,
+	              Ref<Config>   overrides = NULL,
+	              int           interval  = CPPAPP_CONFIG_WATCH_INTERVAL);
+	virtual ~ConfigWatcher();
+	
+	const string& getFileName() const { return fileName_; }
+	
+	/**
+	 * \brief Registers a listener of changes of \p key, or of all keys
+	 *        if \p key is empty.
+	 */
+	void addListener(const string &key, Ref<ConfigListener> listener);
+	void removeListener(Ref<ConfigListener> listener);
+	
+	/**
+	 * \brief Re-reads the file now.
+	 *
+	 * \returns \c false if the file could not be read or parsed
+	 */
+	bool reload();
+	
+	/**
+	 * \brief Starts watching the file in a background thread.
+	 */
+	void start();
+	/**
+	 * \brief Stops the background thread.
+	 */
+	void stop();
+};
+
+
+} // namespace cppapp
+
+
+#endif /* end of include guard: CONFIGWATCHER_B8RQ4MZE */
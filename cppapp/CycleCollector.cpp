@@ -0,0 +1,602 @@
+/**
+ * \file   CycleCollector.cpp
+ * \author Jan Milík <milikjan@fit.cvut.cz>
+ * \date   2026-10-19
+ *
+ * \brief  Implementation file for the CycleCollector class.
+ */
+
+#include "CycleCollector.h"
+
+#include <vector>
+#include <tr1/unordered_map>
+
+#include "Thread.h"
+#include "utils.h"
+
+
+namespace cppapp {
+
+
+////////////////////////////////////////////////////////////////////////////////
+// CYCLE GRAPH
+////////////////////////////////////////////////////////////////////////////////
+
+
+enum CycleColor {
+	CYCLE_BLACK,
+	CYCLE_GRAY,
+	CYCLE_WHITE
+};
+
+
+/**
+ * \brief Added to the trial count of objects whose children did not fit
+ *        the budget, which makes them (and what they reach) alive.
+ */
+static const int CYCLE_UNVISITED = 1 << 24;
+
+
+struct CycleNode {
+	int        trial;
+	/// Reference count when the object was first seen.
+	int        refs;
+	/// Change count of its children when it was first seen.
+	int        changes;
+	CycleColor color;
+};
+
+
+class CycleChildren : public ObjectVisitor {
+public:
+	std::vector<Object*> children;
+
+	virtual void visit(Object *child)
+	{
+		if (child != NULL)
+			children.push_back(child);
+	}
+};
+
+
+/**
+ * \brief Side table of the trial deletion.
+ *
+ * The phases are iterative, documents can be nested deeper than the
+ * stack allows.
+ */
+class CycleGraph {
+private:
+	typedef std::tr1::unordered_map<Object*, CycleNode> Nodes;
+
+	Nodes                nodes_;
+	std::vector<Object*> stack_;
+	CycleChildren        visitor_;
+
+	CycleNode& node(Object *obj, int held)
+	{
+		Nodes::iterator found = nodes_.find(obj);
+		if (found != nodes_.end())
+			return found->second;
+
+		CycleNode &node = nodes_[obj];
+		node.refs    = obj->getRefCount();
+		node.changes = obj->getChangeCount();
+		node.trial   = node.refs - held;
+		node.color   = CYCLE_BLACK;
+		return node;
+	}
+
+	const std::vector<Object*>& children(Object *obj)
+	{
+		visitor_.children.clear();
+		obj->traceChildren(&visitor_);
+		return visitor_.children;
+	}
+
+public:
+	size_t getSize() const { return nodes_.size(); }
+
+	/**
+	 * \brief Adds a root the collector holds one reference to.
+	 *
+	 * A root already seen as a child was counted before the collector
+	 * claimed it.
+	 */
+	void addRoot(Object *root)
+	{
+		Nodes::iterator found = nodes_.find(root);
+		if (found != nodes_.end())
+			found->second.refs++;
+		else
+			node(root, 1);
+	}
+
+	/**
+	 * \brief Subtracts the references from the objects reachable from
+	 *        \p root.
+	 *
+	 * \returns \c false if the graph grew to \p budget objects before
+	 *          everything reachable was visited; the objects left are
+	 *          then treated as referenced from outside
+	 */
+	bool markGray(Object *root, size_t budget)
+	{
+		CycleNode &rootNode = node(root, 0);
+		if (rootNode.color == CYCLE_GRAY)
+			return true;
+		rootNode.color = CYCLE_GRAY;
+
+		stack_.push_back(root);
+		while (!stack_.empty()) {
+			Object *obj = stack_.back();
+			stack_.pop_back();
+
+			std::vector<Object*> edges(children(obj));
+			FOR_EACH(edges, child) {
+				CycleNode &childNode = node(*child, 0);
+				childNode.trial--;
+				if (childNode.color != CYCLE_GRAY) {
+					childNode.color = CYCLE_GRAY;
+					stack_.push_back(*child);
+				}
+			}
+
+			if (!stack_.empty() && (nodes_.size() >= budget)) {
+				FOR_EACH(stack_, unvisited)
+					nodes_[*unvisited].trial += CYCLE_UNVISITED;
+				stack_.clear();
+				return false;
+			}
+		}
+		return true;
+	}
+
+	/**
+	 * \brief Restores the references from \p root and everything it
+	 *        reaches.
+	 */
+	void scanBlack(Object *root)
+	{
+		nodes_[root].color = CYCLE_BLACK;
+
+		std::vector<Object*> stack(1, root);
+		while (!stack.empty()) {
+			Object *obj = stack.back();
+			stack.pop_back();
+
+			std::vector<Object*> edges(children(obj));
+			FOR_EACH(edges, child) {
+				CycleNode &childNode = nodes_[*child];
+				childNode.trial++;
+				if (childNode.color != CYCLE_BLACK) {
+					childNode.color = CYCLE_BLACK;
+					stack.push_back(*child);
+				}
+			}
+		}
+	}
+
+	/**
+	 * \brief Colors the gray objects reachable from \p root white if
+	 *        only garbage references them, black otherwise.
+	 */
+	void scan(Object *root)
+	{
+		stack_.push_back(root);
+		while (!stack_.empty()) {
+			Object *obj = stack_.back();
+			stack_.pop_back();
+
+			CycleNode &objNode = nodes_[obj];
+			if (objNode.color != CYCLE_GRAY)
+				continue;
+			if (objNode.trial > 0) {
+				scanBlack(obj);
+				continue;
+			}
+
+			objNode.color = CYCLE_WHITE;
+			std::vector<Object*> edges(children(obj));
+			FOR_EACH(edges, child)
+				stack_.push_back(*child);
+		}
+	}
+
+	void getWhite(std::vector<Object*> *white)
+	{
+		FOR_EACH(nodes_, it) {
+			if (it->second.color == CYCLE_WHITE)
+				white->push_back(it->first);
+		}
+	}
+
+	/**
+	 * \brief Returns \c true if neither the reference counts nor the
+	 *        children of \p objects changed since they were first seen.
+	 *
+	 * A reference moved from one container to another keeps the count,
+	 * but changes both containers. A thread can also take a new
+	 * reference to an object it reaches by other means, such as a
+	 * \ref WeakRef.
+	 */
+	bool isUnchanged(const std::vector<Object*> &objects)
+	{
+		FOR_EACH(objects, obj) {
+			const CycleNode &objNode = nodes_[*obj];
+			if (((*obj)->getRefCount() != objNode.refs) ||
+			    ((*obj)->getChangeCount() != objNode.changes))
+				return false;
+		}
+		return true;
+	}
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// COLLECTOR STATE
+////////////////////////////////////////////////////////////////////////////////
+
+
+class CycleCollectorThread;
+
+
+struct CycleCollectorState {
+	Mutex                         mutex;
+	std::vector<WeakRef<Object> > candidates;
+	/// Size of the candidates at which the dead ones are removed.
+	size_t                        compactAt;
+	long                          collected;
+	/// Serializes the steps, including the clearing of the garbage.
+	Mutex                         stepMutex;
+	ReadWriteLock                 lock;
+	CycleCollectorThread         *thread;
+
+	CycleCollectorState() :
+		compactAt(CPPAPP_GC_COMPACT_SIZE), collected(0), thread(NULL)
+	{}
+};
+
+
+/**
+ * Never deleted, objects may be released during static destruction.
+ */
+static CycleCollectorState& getState()
+{
+	static CycleCollectorState *state = new CycleCollectorState();
+	return *state;
+}
+
+
+class CycleCollectorThread : public Thread {
+private:
+	int       interval_;
+	int       budget_;
+	Mutex     mutex_;
+	Condition changed_;
+	bool      stopping_;
+
+public:
+	CycleCollectorThread(int interval, int budget) :
+		Thread(false),
+		interval_(interval),
+		budget_(budget),
+		stopping_(false)
+	{
+		start();
+	}
+
+	void stop()
+	{
+		{
+			MutexLock lock(&mutex_);
+			stopping_ = true;
+			changed_.broadcast();
+		}
+		join();
+	}
+
+	virtual void* run()
+	{
+		while (true) {
+			{
+				MutexLock lock(&mutex_);
+				if (!stopping_)
+					changed_.timedWait(mutex_, interval_);
+				if (stopping_)
+					break;
+			}
+			CycleCollector::step(budget_);
+		}
+		return NULL;
+	}
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// CYCLE COLLECTOR
+////////////////////////////////////////////////////////////////////////////////
+
+
+volatile bool CycleCollector::enabled_ = false;
+
+
+void CycleCollector::enable()
+{
+	enabled_ = true;
+}
+
+
+void CycleCollector::disable()
+{
+	enabled_ = false;
+}
+
+
+/**
+ * Removes the candidates that have been destroyed, which also frees
+ * their memory held by the weak references. Must be called with the
+ * state mutex locked.
+ */
+static void compactCandidates(CycleCollectorState &state)
+{
+	std::vector<WeakRef<Object> > alive;
+	alive.reserve(state.candidates.size());
+	FOR_EACH(state.candidates, candidate) {
+		if (!candidate->isExpired())
+			alive.push_back(*candidate);
+	}
+	state.candidates.swap(alive);
+
+	state.compactAt = 2 * state.candidates.size();
+	if (state.compactAt < CPPAPP_GC_COMPACT_SIZE)
+		state.compactAt = CPPAPP_GC_COMPACT_SIZE;
+}
+
+
+/**
+ * The candidate is held weakly, so that it is destroyed as usual if the
+ * last reference goes away before the next step. The reference taken
+ * to create the weak reference is released again, which is ignored
+ * because the object is already marked as buffered.
+ *
+ * If no steps run, the dead candidates are removed as the buffer grows
+ * and a candidate that does not fit \ref CPPAPP_GC_MAX_CANDIDATES is not
+ * recorded (it is recorded again when it loses another reference).
+ */
+void CycleCollector::addCandidate(Object *obj)
+{
+	int flags = obj->gcFlags_;
+	while (true) {
+		if (flags & Object::GC_BUFFERED)
+			return;
+		int previous = __sync_val_compare_and_swap(&obj->gcFlags_, flags, flags | Object::GC_BUFFERED);
+		if (previous == flags)
+			break;
+		flags = previous;
+	}
+
+	if (!obj->tryClaim())
+		return;
+
+	CycleCollectorState &state = getState();
+	bool queued = false;
+	{
+		Ref<Object>     ref(obj);
+		WeakRef<Object> weak(ref);
+		MutexLock       lock(&state.mutex);
+		if (state.candidates.size() >= state.compactAt)
+			compactCandidates(state);
+		if (state.candidates.size() < CPPAPP_GC_MAX_CANDIDATES) {
+			state.candidates.push_back(weak);
+			queued = true;
+		}
+	}
+
+	if (queued) {
+		Object::release(obj);
+	} else {
+		__sync_fetch_and_and(&obj->gcFlags_, ~Object::GC_BUFFERED);
+		releaseHeld(obj);
+	}
+}
+
+
+/**
+ * Marks an object the step holds a reference to as buffered again.
+ *
+ * \returns \c false if it has been recorded as a candidate since
+ */
+bool CycleCollector::rebuffer(Object *obj)
+{
+	return (__sync_fetch_and_or(&obj->gcFlags_, Object::GC_BUFFERED) & Object::GC_BUFFERED) == 0;
+}
+
+
+/**
+ * Releases a reference held by a step without making the object a
+ * candidate again.
+ */
+void CycleCollector::releaseHeld(Object *obj)
+{
+	if (__sync_sub_and_fetch(&obj->refCount_, 1) <= 0)
+		Object::destroy(obj);
+}
+
+
+/**
+ * A root stays marked as buffered until the step holds its own reference,
+ * so that dropping the temporary references does not record it again.
+ *
+ * The graph is built with \ref getLock() locked for writing. The weak
+ * references to the white objects are expired before their reference
+ * counts are checked again, so that no thread can take a new reference
+ * to the garbage once the check has passed. If a count or the children
+ * of a white container changed, nothing is collected and the roots are
+ * recorded again. The garbage is cleared
+ * (and the references to the roots and to the garbage are released)
+ * after the lock, because that runs destructors; other steps wait for it.
+ */
+int CycleCollector::step(int budget)
+{
+	CycleCollectorState &state = getState();
+	MutexLock stepLock(&state.stepMutex);
+
+	std::vector<WeakRef<Object> > batch;
+	{
+		MutexLock lock(&state.mutex);
+		batch.swap(state.candidates);
+	}
+	if (batch.empty())
+		return 0;
+
+	std::vector<Object*>      roots;
+	std::vector<Object*>      retry;
+	std::vector<Ref<Object> > garbage;
+	size_t                    next = 0;
+	{
+		WriteLock  lock(&state.lock);
+		CycleGraph graph;
+
+		while ((next < batch.size()) && (graph.getSize() < (size_t)budget)) {
+			Object *root;
+			{
+				Ref<Object> ref = batch[next++].lock();
+				if (ref.isNull())
+					continue;
+				root = ref.getPtr();
+				root->claim();
+			}
+			__sync_fetch_and_and(&root->gcFlags_, ~Object::GC_BUFFERED);
+
+			roots.push_back(root);
+			graph.addRoot(root);
+			if (!graph.markGray(root, budget)) {
+				// Tried again after the candidates that are left.
+				retry.push_back(root);
+				break;
+			}
+		}
+
+		FOR_EACH(roots, root)
+			graph.scan(*root);
+
+		std::vector<Object*> white;
+		graph.getWhite(&white);
+
+		std::vector<Object*> expired;
+		FOR_EACH(white, obj) {
+			WeakControl *control = (*obj)->weak_;
+			if ((control != NULL) &&
+			    __sync_bool_compare_and_swap(&control->object, *obj, (Object*)NULL))
+				expired.push_back(*obj);
+		}
+		__sync_synchronize();
+
+		if (graph.isUnchanged(white)) {
+			FOR_EACH(white, obj)
+				garbage.push_back(*obj);
+		} else {
+			FOR_EACH(expired, obj)
+				__sync_bool_compare_and_swap(&(*obj)->weak_->object, (Object*)NULL, *obj);
+			retry = roots;
+		}
+	}
+
+	FOR_EACH(garbage, obj)
+		(*obj)->clearChildren();
+
+	std::vector<WeakRef<Object> > again;
+	FOR_EACH(retry, root) {
+		if (rebuffer(*root))
+			again.push_back(WeakRef<Object>(Ref<Object>(*root)));
+	}
+
+	FOR_EACH(roots, root)
+		releaseHeld(*root);
+
+	int collected = garbage.size();
+	garbage.clear();
+
+	{
+		MutexLock lock(&state.mutex);
+		state.candidates.insert(state.candidates.end(), batch.begin() + next, batch.end());
+		state.candidates.insert(state.candidates.end(), again.begin(), again.end());
+		state.collected += collected;
+	}
+
+	return collected;
+}
+
+
+/**
+ * Stops when a step neither collects anything nor reduces the number of
+ * candidates, which happens when the only candidates left reach more
+ * than \p budget objects or keep changing.
+ */
+int CycleCollector::collect(int budget)
+{
+	int  collected  = 0;
+	long candidates = getCandidateCount();
+	while (candidates > 0) {
+		int  found = step(budget);
+		long left  = getCandidateCount();
+		collected += found;
+		if ((found == 0) && (left >= candidates))
+			break;
+		candidates = left;
+	}
+	return collected;
+}
+
+
+void CycleCollector::start(int interval, int budget)
+{
+	CycleCollectorState &state = getState();
+	MutexLock lock(&state.mutex);
+
+	if (state.thread == NULL)
+		state.thread = new CycleCollectorThread(interval, budget);
+}
+
+
+void CycleCollector::stop()
+{
+	CycleCollectorState  &state = getState();
+	CycleCollectorThread *thread;
+	{
+		MutexLock lock(&state.mutex);
+		thread       = state.thread;
+		state.thread = NULL;
+	}
+	if (thread == NULL)
+		return;
+
+	thread->stop();
+	delete thread;
+}
+
+
+ReadWriteLock& CycleCollector::getLock()
+{
+	return getState().lock;
+}
+
+
+long CycleCollector::getCandidateCount()
+{
+	CycleCollectorState &state = getState();
+	MutexLock lock(&state.mutex);
+	return state.candidates.size();
+}
+
+
+long CycleCollector::getCollectedCount()
+{
+	CycleCollectorState &state = getState();
+	MutexLock lock(&state.mutex);
+	return state.collected;
+}
+
+
+} // namespace cppapp
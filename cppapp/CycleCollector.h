@@ -0,0 +1,132 @@
+/**
+ * \file   CycleCollector.h
+ * \author Jan Milík <milikjan@fit.cvut.cz>
+ * \date   2026-10-19
+ *
+ * \brief  Header file for the CycleCollector class.
+ */
+
+#ifndef CYCLECOLLECTOR_N6HV2TQB
+#define CYCLECOLLECTOR_N6HV2TQB
+
+
+#include "Object.h"
+#include "Mutex.h"
+
+
+/**
+ * \brief Default number of objects traced by one collection step.
+ */
+#define CPPAPP_GC_STEP_BUDGET 10000
+
+/**
+ * \brief Maximum number of candidates waiting for a step.
+ */
+#define CPPAPP_GC_MAX_CANDIDATES 100000
+
+/**
+ * \brief Number of candidates at which the destroyed ones are removed
+ *        for the first time.
+ */
+#define CPPAPP_GC_COMPACT_SIZE 1024
+
+
+namespace cppapp {
+
+
+/**
+ * \brief Frees cycles of reference-counted container objects.
+ *
+ * Reference counting never frees objects that reference each other,
+ * such as a \ref DynDict storing its own root. The collector finds such
+ * cycles by trial deletion (Bacon and Rajan): a container that loses a
+ * reference but stays alive becomes a candidate root; a collection step
+ * subtracts the references among the objects reachable from the
+ * candidates, and the objects whose remaining count is zero (and that
+ * are not reachable from objects with a positive count) are garbage.
+ * The trial counts are kept in a side table, the reference counts of
+ * the objects are never changed. Before the garbage is freed, its weak
+ * references expire and its reference counts and change counts are
+ * checked again; if any changed during the step, the step collects nothing and its roots are
+ * tried again later. Garbage containers are cleared with
+ * \ref Object::clearChildren(), which frees the cycle through ordinary
+ * reference counting, after the step has released \ref getLock().
+ *
+ * Only objects that call \ref Object::registerContainer() and implement
+ * \ref Object::traceChildren() and \ref Object::clearChildren() are
+ * traced; \ref DynDict and \ref DynList do. The collector is disabled by
+ * default, candidates are recorded only while it is enabled. At most
+ * \ref CPPAPP_GC_MAX_CANDIDATES candidates wait for a step, destroyed
+ * candidates are dropped as the buffer grows.
+ *
+ * A step traces at most \p budget objects, which bounds the pause: the
+ * candidates that do not fit are left for the next step, and a root
+ * that reaches more objects than the budget is treated as alive and
+ * tried again after the other candidates. Steps run on demand
+ * (\ref step(), \ref collect()) or periodically on a background thread
+ * (\ref start()), one at a time. A step holds \ref getLock() for
+ * writing while it traces. Containers change their children with it
+ * locked for reading and call \ref Object::markChanged(), which the
+ * check before freeing compares; the setters of \ref DynDict and
+ * \ref DynList do. The children must not be changed through their
+ * iterators while steps may run.
+ *
+ * \ingroup obj
+ */
+class CycleCollector {
+private:
+	CycleCollector();
+
+	static volatile bool enabled_;
+
+	static void releaseHeld(Object *obj);
+	static bool rebuffer(Object *obj);
+
+public:
+	static bool isEnabled() { return enabled_; }
+	static void enable();
+	/**
+	 * \brief Stops recording candidates. Candidates recorded so far are
+	 *        still collected by the next steps.
+	 */
+	static void disable();
+
+	/**
+	 * \brief Records a possible root of a garbage cycle. Called by
+	 *        \ref Object::release().
+	 */
+	static void addCandidate(Object *obj);
+
+	/**
+	 * \brief Runs one collection step.
+	 *
+	 * \returns the number of objects found to be garbage
+	 */
+	static int step(int budget = CPPAPP_GC_STEP_BUDGET);
+	/**
+	 * \brief Runs steps until there are no candidates left, or until
+	 *        the steps stop making progress.
+	 */
+	static int collect(int budget = CPPAPP_GC_STEP_BUDGET);
+
+	/**
+	 * \brief Runs a step every \p interval milliseconds on a background
+	 *        thread until \ref stop() is called.
+	 */
+	static void start(int interval, int budget = CPPAPP_GC_STEP_BUDGET);
+	static void stop();
+
+	static ReadWriteLock& getLock();
+
+	static long getCandidateCount();
+	/**
+	 * \brief Returns the number of objects freed since the start.
+	 */
+	static long getCollectedCount();
+};
+
+
+} // namespace cppapp
+
+
+#endif /* end of include guard: CYCLECOLLECTOR_N6HV2TQB */
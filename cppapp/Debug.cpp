@@ -7,16 +7,282 @@
  */
 
 #include "Debug.h"
+#include "Mutex.h"
+
+#include <dlfcn.h>
+#include <elf.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstring>
+#include <map>
 
 
 namespace cppapp {
 
 
+////////////////////////////////////////////////////////////////////////////////
+// SYMBOLIZER
+////////////////////////////////////////////////////////////////////////////////
+
+
+struct SymbolizerCache {
+	Mutex                         mutex;
+	std::map<void*, std::string>  lines;
+	/** \brief Whether the module is position independent. */
+	std::map<std::string, bool>   relocatable;
+};
+
+
+static SymbolizerCache& symbolizerCache()
+{
+	static SymbolizerCache *cache = new SymbolizerCache();
+	return *cache;
+}
+
+
+/**
+ * Addresses in shared objects and position independent executables are
+ * passed to \c addr2line relative to the module base, addresses in other
+ * executables as they are.
+ */
+static bool isRelocatable(SymbolizerCache &cache, const std::string &module)
+{
+	VAR(found, cache.relocatable.find(module));
+	if (found != cache.relocatable.end())
+		return found->second;
+	
+	bool result = true;
+	int  fd     = open(module.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd >= 0) {
+		unsigned char header[EI_NIDENT + 2];
+		if ((read(fd, header, sizeof(header)) == (ssize_t)sizeof(header)) &&
+		    (memcmp(header, ELFMAG, SELFMAG) == 0)) {
+			uint16_t type;
+			memcpy(&type, header + EI_NIDENT, sizeof(type));
+			result = (type == ET_DYN);
+		}
+		close(fd);
+	}
+	
+	cache.relocatable[module] = result;
+	return result;
+}
+
+
+static std::string shellQuote(const std::string &value)
+{
+	std::string result = "'";
+	FOR_EACH(value, c) {
+		if (*c == '\'')
+			result += "'\\''";
+		else
+			result += *c;
+	}
+	return result + "'";
+}
+
+
+/**
+ * \brief Runs one \c addr2line for all \p offsets of \p module.
+ */
+static bool runAddr2line(const std::string &module,
+                         const std::vector<uintptr_t> &offsets,
+                         std::vector<std::string> *lines)
+{
+	std::stringstream command;
+	command << "addr2line -fCpe " << shellQuote(module);
+	FOR_EACH(offsets, offset)
+		command << " 0x" << std::hex << *offset;
+	command << " 2> /dev/null";
+	
+	FILE *pipe = popen(command.str().c_str(), "r");
+	if (pipe == NULL)
+		return false;
+	
+	std::vector<std::string> result;
+	std::string line;
+	char buffer[256];
+	while (fgets(buffer, sizeof(buffer), pipe) != NULL) {
+		size_t length = strlen(buffer);
+		if ((length > 0) && (buffer[length - 1] == '\n')) {
+			line.append(buffer, length - 1);
+			result.push_back(line);
+			line.clear();
+		} else {
+			line.append(buffer, length);
+		}
+	}
+	
+	if ((pclose(pipe) != 0) || (result.size() != offsets.size()))
+		return false;
+	
+	lines->swap(result);
+	return true;
+}
+
+
+/**
+ * \brief Addresses of one module to be decoded.
+ */
+struct SymbolizerModule {
+	std::vector<void*>     addresses;
+	std::vector<uintptr_t> offsets;
+	std::vector<Dl_info>   infos;
+};
+
+
+/**
+ * \brief Describes \p address using the dynamic symbol table only.
+ */
+static std::string describeAddress(void *address, const Dl_info *info)
+{
+	std::stringstream out;
+	
+	if ((info != NULL) && (info->dli_sname != NULL)) {
+		int   status    = 0;
+		char *demangled = abi::__cxa_demangle(info->dli_sname, NULL, NULL, &status);
+		out << ((status == 0) ? demangled : info->dli_sname);
+		free(demangled);
+		out << "+0x" << std::hex << ((char*)address - (char*)info->dli_saddr);
+	} else {
+		out << "[" << address << "]";
+	}
+	
+	if ((info != NULL) && (info->dli_fname != NULL))
+		out << " in " << info->dli_fname;
+	
+	return out.str();
+}
+
+
+std::string Symbolizer::symbolize(void *address)
+{
+	std::vector<void*> addresses(1, address);
+	std::vector<std::string> lines;
+	symbolize(addresses, &lines);
+	return lines[0];
+}
+
+
+/**
+ * Return addresses point after the call instruction, so the address one
+ * byte before is decoded, which lies in the call itself.
+ *
+ * The cache is locked only while it is read and filled, \c addr2line
+ * runs unlocked, so a slow decode does not block other threads. Two
+ * threads may decode the same address at once, the first result is
+ * kept.
+ */
+void Symbolizer::symbolize(const std::vector<void*> &addresses,
+                           std::vector<std::string> *lines)
+{
+	SymbolizerCache &cache = symbolizerCache();
+	
+	std::map<void*, std::string>            found;
+	std::map<std::string, SymbolizerModule> modules;
+	
+	{
+		MutexLock lock(&cache.mutex);
+		
+		FOR_EACH(addresses, address) {
+			if (found.count(*address) > 0)
+				continue;
+			
+			VAR(cached, cache.lines.find(*address));
+			if (cached != cache.lines.end()) {
+				found[*address] = cached->second;
+				continue;
+			}
+			
+			Dl_info info;
+			if ((dladdr(*address, &info) == 0) || (info.dli_fname == NULL)) {
+				found[*address] = describeAddress(*address, NULL);
+				continue;
+			}
+			
+			// The main executable may be named relative to a different
+			// working directory.
+			std::string name = info.dli_fname;
+			if (access(name.c_str(), R_OK) != 0)
+				name = "/proc/self/exe";
+			
+			uintptr_t offset = (uintptr_t)*address - 1;
+			if (isRelocatable(cache, name))
+				offset -= (uintptr_t)info.dli_fbase;
+			
+			// Marks the address as being decoded.
+			found[*address] = std::string();
+			
+			SymbolizerModule &module = modules[name];
+			module.addresses.push_back(*address);
+			module.offsets.push_back(offset);
+			module.infos.push_back(info);
+		}
+	}
+	
+	std::map<void*, std::string> decodedLines;
+	FOR_EACH(modules, module) {
+		std::vector<std::string> decoded;
+		bool ok = runAddr2line(module->first, module->second.offsets, &decoded);
+		
+		for (size_t i = 0; i < module->second.addresses.size(); i++) {
+			void *address = module->second.addresses[i];
+			// addr2line prints "?? ??:0" for addresses it knows nothing about.
+			if (ok && (decoded[i].compare(0, 2, "??") != 0))
+				decodedLines[address] = decoded[i];
+			else
+				decodedLines[address] = describeAddress(address, &module->second.infos[i]);
+		}
+	}
+	
+	{
+		MutexLock lock(&cache.mutex);
+		
+		FOR_EACH(found, line) {
+			VAR(decoded, decodedLines.find(line->first));
+			if (decoded == decodedLines.end())
+				cache.lines.insert(*line);
+			else
+				line->second = cache.lines.insert(*decoded).first->second;
+		}
+	}
+	
+	std::vector<std::string> result;
+	result.reserve(addresses.size());
+	FOR_EACH(addresses, address)
+		result.push_back(found[*address]);
+	lines->swap(result);
+}
+
+
+void Symbolizer::clearCache()
+{
+	SymbolizerCache &cache = symbolizerCache();
+	MutexLock lock(&cache.mutex);
+	
+	cache.lines.clear();
+	cache.relocatable.clear();
+}
+
+
 ////////////////////////////////////////////////////////////////////////////////
 // BACKTRACE
 ////////////////////////////////////////////////////////////////////////////////
 
 
+void Backtrace::getLines() const
+{
+	if (symbolized_)
+		return;
+	
+	Symbolizer::symbolize(addresses_, &lines_);
+	symbolized_ = true;
+}
+
+
+/**
+ * Only the addresses are recorded, see \ref getLines().
+ */
 void Backtrace::get(int maxSize)
 {
 	AddressType *buffer = new AddressType[maxSize];
@@ -31,29 +297,39 @@ void Backtrace::get(int maxSize)
 	
 	addresses_.swap(result);
 	delete [] buffer;
-
-	getSymbols();
+	
+	symbols_.clear();
+	lines_.clear();
+	symbolized_ = false;
 }
 
 
+/**
+ * The mangled name in <tt>module(name+offset) [address]</tt> is replaced
+ * by the demangled one.
+ */
 void Backtrace::getSymbols()
 {
 	char **strings = backtrace_symbols(&addresses_[0], addresses_.size());
 	
 	std::vector<std::string> symbols;
 	symbols.reserve(addresses_.size());
-
-	std::vector<char> buffer;
 	
 	for (unsigned int i = 0; i < addresses_.size(); i++) {
-		size_t length = 0;
-		int status = 0;
-		char *output = abi::__cxa_demangle(strings[i], NULL, &length, &status);
-		if (status == 0)
-			symbols.push_back(std::string(output));
-		else	
-			symbols.push_back(std::string(strings[i]));
-		free(output);
+		std::string symbol = strings[i];
+		
+		size_t begin = symbol.find('(');
+		size_t end   = (begin == std::string::npos) ? begin : symbol.find_first_of("+)", begin);
+		if ((end != std::string::npos) && (end > begin + 1)) {
+			std::string name = symbol.substr(begin + 1, end - begin - 1);
+			int   status = 0;
+			char *output = abi::__cxa_demangle(name.c_str(), NULL, NULL, &status);
+			if (status == 0)
+				symbol.replace(begin + 1, end - begin - 1, output);
+			free(output);
+		}
+		
+		symbols.push_back(symbol);
 	}
 	
 	symbols_.swap(symbols);
@@ -63,8 +339,9 @@ void Backtrace::getSymbols()
 
 void Backtrace::print(ostream &out) const
 {
-	for (unsigned int i = 0; i < symbols_.size(); i++) {
-		out << symbols_[i] << std::endl;
+	getLines();
+	for (unsigned int i = 0; i < lines_.size(); i++) {
+		out << "#" << i << "  " << lines_[i] << std::endl;
 	}
 }
 
@@ -34,60 +34,70 @@ namespace cppapp {
 #define CPPAPP_BACKTRACE_LIMIT 256
 
 
+/**
+ * \brief Translates code addresses to function names and source
+ *        locations.
+ *
+ * Addresses are grouped by the module (executable or shared library)
+ * they belong to and each module is decoded by a single \c addr2line
+ * process. Decoded addresses are cached for the lifetime of the process.
+ * If \c addr2line is not available, the dynamic symbol table is used,
+ * which gives only function names (link with \c -rdynamic to include
+ * the executable's functions).
+ */
+class Symbolizer {
+private:
+	Symbolizer();
+
+public:
+	static std::string symbolize(void *address);
+	/**
+	 * \brief Decodes all \p addresses at once, the result has the same
+	 *        order.
+	 */
+	static void        symbolize(const std::vector<void*> &addresses,
+	                             std::vector<std::string> *lines);
+	static void        clearCache();
+};
+
+
+/**
+ * \brief Stack trace of the calling thread.
+ *
+ * \ref get() only records the return addresses, which is cheap enough to
+ * be done in production code. They are decoded by \ref Symbolizer the
+ * first time the lines are accessed or printed.
+ */
 class Backtrace {
 public:
 	typedef void* AddressType;
 
 private:
-	std::vector<AddressType> addresses_;
-	std::vector<std::string> symbols_;
-	std::vector<std::string> lines_;
+	std::vector<AddressType>         addresses_;
+	std::vector<std::string>         symbols_;
+	mutable std::vector<std::string> lines_;
+	mutable bool                     symbolized_;
 	
-	bool getLines()
-	{
-		std::stringstream tmpStream;
-		std::vector<std::string> lines;
-		
-		FOR_EACH(addresses_, addr) {
-			tmpStream.str("");
-			tmpStream << "addr2line -fCp " << *addr << " 2> /dev/null";
-			
-			FILE *pipe = popen(tmpStream.str().c_str(), "r");
-			if (!pipe) {
-				tmpStream.str("");
-				tmpStream << "[" << *addr << "]";
-				lines.push_back(tmpStream.str());
-				continue;
-			}
-			
-			char buffer[128];
-			tmpStream.str("");
-			while (!feof(pipe)) {
-				if (fgets(buffer, 128, pipe) != NULL) {
-					for (char *p = buffer; (p < buffer + 128) && *p != '\n'; p++)
-						tmpStream << *p;
-				}
-			}
-			pclose(pipe);
-			
-			lines.push_back(tmpStream.str());
-		}
-		
-		lines_.swap(lines);
-		return true;
-	}
+	void getLines() const;
 	
 public:
 	typedef std::vector<std::string>::const_iterator Iterator;
 	
+	Backtrace() : symbolized_(false) {}
+	
 	int size() const { return (int)addresses_.size(); }
 	
-	Iterator begin() const { return lines_.begin(); }
-	Iterator end() const { return lines_.end(); }
+	Iterator begin() const { getLines(); return lines_.begin(); }
+	Iterator end() const { getLines(); return lines_.end(); }
+	
+	std::string operator[](int index) const { getLines(); return lines_[index]; }
 	
-	std::string operator[](int index) { return lines_[index]; }
+	const std::vector<AddressType>& getAddresses() const { return addresses_; }
 	
 	void get(int maxSize = CPPAPP_BACKTRACE_LIMIT);
+	/**
+	 * \brief Fills the symbols returned by \c backtrace_symbols().
+	 */
 	void getSymbols();
 	
 	void print(ostream &out) const;
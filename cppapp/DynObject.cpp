@@ -7,6 +7,7 @@
  */
 
 #include "DynObject.h"
+#include "CycleCollector.h"
 
 
 namespace cppapp {
@@ -225,9 +226,21 @@ Ref<DynObject> DynDict::getStrItem(std::string key, Ref<DynObject> deflt)
 }
 
 
+/**
+ * The children change with \ref CycleCollector::getLock() locked for
+ * reading, a collection step may be tracing them. The previous value is
+ * released after the lock, its destructor may run.
+ */
 void DynDict::setStrItem(std::string key, Ref<DynObject> value)
 {
-	_values[key] = value;
+	Ref<DynObject> previous;
+	{
+		ReadLock lock(&CycleCollector::getLock());
+		Ref<DynObject> &item = _values[key];
+		previous = item;
+		item     = value;
+		markChanged();
+	}
 }
 
 
@@ -243,6 +256,14 @@ Ref<DynObject> DynDict::getKeys()
 }
 
 
+void DynDict::traceChildren(ObjectVisitor *visitor)
+{
+	FOR_EACH(_values, it) {
+		visitor->visit(it->second.getPtr());
+	}
+}
+
+
 ////////////////////////////////////////////////////////////////////////////////
 // DynList class
 ////////////////////////////////////////////////////////////////////////////////
@@ -280,12 +301,29 @@ Ref<DynObject> DynList::getIntItem(int key)
 }
 
 
+/**
+ * Changes the children like \ref DynDict::setStrItem().
+ */
 void DynList::setIntItem(int key, Ref<DynObject> value)
 {
 	if ((key < 0) || (key >= (int)_values.size()))
 		return;
 	
-	_values[key] = value;
+	Ref<DynObject> previous;
+	{
+		ReadLock lock(&CycleCollector::getLock());
+		previous     = _values[key];
+		_values[key] = value;
+		markChanged();
+	}
+}
+
+
+void DynList::append(Ref<DynObject> obj)
+{
+	ReadLock lock(&CycleCollector::getLock());
+	_values.push_back(obj);
+	markChanged();
 }
 
 
@@ -295,6 +333,14 @@ Ref<DynObject> DynList::getIterator()
 }
 
 
+void DynList::traceChildren(ObjectVisitor *visitor)
+{
+	FOR_EACH(_values, it) {
+		visitor->visit(it->getPtr());
+	}
+}
+
+
 Ref<DynObject> DynListIter::getNext()
 {
 	if (started_) {
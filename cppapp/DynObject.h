@@ -44,6 +44,7 @@ class DynString;
 
 
 class DynObject : public Object {
+	CPPAPP_CLASS_ID(DynObject, Object)
 private:
 	TextLoc location;
 
@@ -146,6 +147,7 @@ class DynString;
 
 
 class DynDict : public DynObject {
+	CPPAPP_CLASS_ID(DynDict, DynObject)
 public:
 	typedef std::map<std::string, Ref<DynObject> > Map;
 
@@ -155,10 +157,15 @@ private:
 public:
 	DynDict(TextLoc loc) :
 		DynObject(loc)
-	{}
+	{
+		registerContainer();
+	}
 	
 	virtual ~DynDict() { _values.clear(); }
 	
+	virtual void traceChildren(ObjectVisitor *visitor);
+	virtual void clearChildren() { _values.clear(); }
+	
 	virtual bool isDict() const { return true; }
 	
 	virtual int getSize() const { return _values.size(); }
@@ -188,6 +195,7 @@ public:
 //// DynList ////////////////////////////////////////////////////////
 
 class DynList : public DynObject {
+	CPPAPP_CLASS_ID(DynList, DynObject)
 public:
 	typedef std::vector<Ref<DynObject> > Vector;
 
@@ -197,10 +205,15 @@ private:
 public:
 	DynList(TextLoc loc) :
 		DynObject(loc)
-	{}
+	{
+		registerContainer();
+	}
 	
 	virtual ~DynList() { _values.clear(); }
 	
+	virtual void traceChildren(ObjectVisitor *visitor);
+	virtual void clearChildren() { _values.clear(); }
+	
 	virtual bool isList() const { return true; }
 	
 	virtual int getSize() const { return _values.size(); }
@@ -213,7 +226,7 @@ public:
 
 	virtual Ref<DynObject> getIterator();
 	
-	void append(Ref<DynObject> obj) { _values.push_back(obj); }
+	void append(Ref<DynObject> obj);
 	
 	Vector::iterator begin() { return _values.begin(); }
 	Vector::iterator end()   { return _values.end(); }
@@ -221,6 +234,7 @@ public:
 
 
 class DynListIter : public DynObject {
+	CPPAPP_CLASS_ID(DynListIter, DynObject)
 private:
 	bool                      started_;
 	DynList::Vector::iterator iterator_;
@@ -259,6 +273,7 @@ public:
 //// DynBoolean /////////////////////////////////////////////////////
 
 class DynBoolean : public DynScalar<bool> {
+	CPPAPP_CLASS_ID(DynBoolean, DynScalar<bool>)
 public:
 	DynBoolean(TextLoc loc, bool value) :
 		DynScalar<bool>(loc, value)
@@ -282,6 +297,7 @@ public:
 //// DynNumber //////////////////////////////////////////////////////
 
 class DynNumber : public DynScalar<double> {
+	CPPAPP_CLASS_ID(DynNumber, DynScalar<double>)
 public:
 	DynNumber(TextLoc loc, double value) :
 		DynScalar<double>(loc, value)
@@ -309,6 +325,7 @@ public:
 //// DynString //////////////////////////////////////////////////////
 
 class DynString : public DynScalar<std::string> {
+	CPPAPP_CLASS_ID(DynString, DynScalar<std::string>)
 public:
 	DynString(TextLoc loc, std::string value) :
 		DynScalar<std::string>(loc, value)
@@ -332,6 +349,7 @@ public:
 //// DynNull ////////////////////////////////////////////////////////
 
 class DynNull : public DynObject {
+	CPPAPP_CLASS_ID(DynNull, DynObject)
 public:
 	virtual bool isNull() const { return true; }
 	
@@ -346,6 +364,7 @@ public:
 //// DynError ///////////////////////////////////////////////////////
 
 class DynError : public DynObject {
+	CPPAPP_CLASS_ID(DynError, DynObject)
 private:
 	std::string message_;
 	TextLoc     errorLoc_;
@@ -0,0 +1,217 @@
+/**
+ * \file   Histogram.cpp
+ * \author Jan Milík <milikjan@fit.cvut.cz>
+ * \date   2026-10-19
+ *
+ * \brief  Implementation file for the latency histograms.
+ */
+
+#include "Histogram.h"
+
+#include <cmath>
+
+#include "ThreadLocal.h"
+#include "utils.h"
+
+
+namespace cppapp {
+
+
+////////////////////////////////////////////////////////////////////////////////
+// LATENCY HISTOGRAM
+////////////////////////////////////////////////////////////////////////////////
+
+
+LatencyHistogram::LatencyHistogram() :
+	counts_(HISTOGRAM_BUCKETS, 0),
+	count_(0),
+	sum_(0),
+	min_(0),
+	max_(0)
+{
+}
+
+
+uint64_t LatencyHistogram::bucketLow(int index)
+{
+	if (index < HISTOGRAM_SUB_BUCKETS)
+		return index;
+	int shift = index / HISTOGRAM_SUB_BUCKETS - 1;
+	int sub   = index % HISTOGRAM_SUB_BUCKETS;
+	return (uint64_t)(HISTOGRAM_SUB_BUCKETS + sub) << shift;
+}
+
+
+uint64_t LatencyHistogram::bucketHigh(int index)
+{
+	if (index < HISTOGRAM_SUB_BUCKETS)
+		return index;
+	int shift = index / HISTOGRAM_SUB_BUCKETS - 1;
+	return bucketLow(index) + ((uint64_t)1 << shift) - 1;
+}
+
+
+void LatencyHistogram::merge(const LatencyHistogram &other)
+{
+	if (other.count_ == 0)
+		return;
+	
+	for (int i = 0; i < HISTOGRAM_BUCKETS; i++)
+		counts_[i] += other.counts_[i];
+	
+	if ((count_ == 0) || (other.min_ < min_))
+		min_ = other.min_;
+	if (other.max_ > max_)
+		max_ = other.max_;
+	count_ += other.count_;
+	sum_   += other.sum_;
+}
+
+
+void LatencyHistogram::reset()
+{
+	counts_.assign(HISTOGRAM_BUCKETS, 0);
+	count_ = 0;
+	sum_   = 0;
+	min_   = 0;
+	max_   = 0;
+}
+
+
+/**
+ * The result is the largest value of the bucket, limited by the largest
+ * recorded value.
+ */
+uint64_t LatencyHistogram::getPercentile(double percentile) const
+{
+	if (count_ == 0)
+		return 0;
+	
+	uint64_t rank = (uint64_t)ceil(percentile / 100.0 * count_);
+	if (rank < 1)
+		rank = 1;
+	
+	uint64_t seen = 0;
+	for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+		seen += counts_[i];
+		if (seen >= rank) {
+			uint64_t high = bucketHigh(i);
+			return (high < max_) ? high : max_;
+		}
+	}
+	return max_;
+}
+
+
+void LatencyHistogram::dump(std::ostream &out) const
+{
+	out << "[count: " << count_ <<
+		",  mean: " << (uint64_t)getMean() <<
+		",  min: " << min_ <<
+		",  p50: " << getPercentile(50) <<
+		",  p90: " << getPercentile(90) <<
+		",  p99: " << getPercentile(99) <<
+		",  p99.9: " << getPercentile(99.9) <<
+		",  max: " << max_ <<
+		"]";
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// CONCURRENT HISTOGRAM
+////////////////////////////////////////////////////////////////////////////////
+
+
+typedef std::vector<LatencyHistogram*> HistogramShards;
+
+
+/**
+ * \brief Histograms of the calling thread indexed by the id of their
+ *        ConcurrentHistogram.
+ *
+ * Ids are never reused, so entries of destroyed histograms are never
+ * accessed again.
+ */
+static ThreadLocal<HistogramShards>& threadShards()
+{
+	static ThreadLocal<HistogramShards> *shards = new ThreadLocal<HistogramShards>();
+	return *shards;
+}
+
+
+static size_t nextHistogramId = 0;
+
+
+ConcurrentHistogram::ConcurrentHistogram() :
+	id_(__sync_fetch_and_add(&nextHistogramId, 1))
+{
+}
+
+
+ConcurrentHistogram::~ConcurrentHistogram()
+{
+	FOR_EACH(shards_, shard) {
+		delete *shard;
+	}
+}
+
+
+LatencyHistogram* ConcurrentHistogram::createShard()
+{
+	MutexLock lock(&mutex_);
+	
+	LatencyHistogram *shard = new LatencyHistogram();
+	shards_.push_back(shard);
+	return shard;
+}
+
+
+LatencyHistogram* ConcurrentHistogram::getShard()
+{
+	HistogramShards &shards = threadShards().get();
+	if ((id_ < shards.size()) && (shards[id_] != NULL))
+		return shards[id_];
+	
+	if (shards.size() <= id_)
+		shards.resize(id_ + 1, NULL);
+	shards[id_] = createShard();
+	return shards[id_];
+}
+
+
+LatencyHistogram ConcurrentHistogram::snapshot() const
+{
+	MutexLock lock(&mutex_);
+	
+	LatencyHistogram result;
+	FOR_EACH(shards_, it) {
+		LatencyHistogram *shard = *it;
+		
+		uint64_t count = __atomic_load_n(&shard->count_, __ATOMIC_RELAXED);
+		if (count == 0)
+			continue;
+		
+		for (int i = 0; i < LatencyHistogram::HISTOGRAM_BUCKETS; i++)
+			result.counts_[i] += __atomic_load_n(&shard->counts_[i], __ATOMIC_RELAXED);
+		
+		uint64_t min = __atomic_load_n(&shard->min_, __ATOMIC_RELAXED);
+		uint64_t max = __atomic_load_n(&shard->max_, __ATOMIC_RELAXED);
+		if ((result.count_ == 0) || (min < result.min_))
+			result.min_ = min;
+		if (max > result.max_)
+			result.max_ = max;
+		result.count_ += count;
+		result.sum_   += __atomic_load_n(&shard->sum_, __ATOMIC_RELAXED);
+	}
+	
+	// Buckets may have been read after the count was.
+	uint64_t total = 0;
+	for (int i = 0; i < LatencyHistogram::HISTOGRAM_BUCKETS; i++)
+		total += result.counts_[i];
+	result.count_ = total;
+	
+	return result;
+}
+
+
+} // namespace cppapp
@@ -0,0 +1,206 @@
+/**
+ * \file   Histogram.h
+ * \author Jan Milík <milikjan@fit.cvut.cz>
+ * \date   2026-10-19
+ *
+ * \brief  Header file for the latency histograms.
+ */
+
+#ifndef HISTOGRAM_V6NE4RXK
+#define HISTOGRAM_V6NE4RXK
+
+
+#include <stdint.h>
+#include <vector>
+#include <iostream>
+
+#include "Clock.h"
+#include "Mutex.h"
+
+
+namespace cppapp {
+
+
+/** \addtogroup threading
+ * @{
+ */
+
+
+/**
+ * \brief Histogram of non-negative integer values (usually nanoseconds)
+ *        with a bounded relative error.
+ *
+ * Values below 64 are counted exactly. Larger values are counted in
+ * buckets that split every power of two into
+ * \ref HISTOGRAM_SUB_BUCKETS parts, so a reported value differs from the
+ * recorded one by less than 1/32 (about 3 %).
+ *
+ * The histogram is not synchronized, use \ref ConcurrentHistogram for
+ * values recorded by several threads.
+ */
+class LatencyHistogram {
+public:
+	enum {
+		HISTOGRAM_SUB_BUCKET_BITS = 5,
+		HISTOGRAM_SUB_BUCKETS     = 1 << HISTOGRAM_SUB_BUCKET_BITS,
+		HISTOGRAM_BUCKETS         = (64 - HISTOGRAM_SUB_BUCKET_BITS + 1) * HISTOGRAM_SUB_BUCKETS
+	};
+
+private:
+	std::vector<uint64_t> counts_;
+	uint64_t              count_;
+	uint64_t              sum_;
+	uint64_t              min_;
+	uint64_t              max_;
+
+	friend class ConcurrentHistogram;
+
+public:
+	LatencyHistogram();
+
+	static int bucketIndex(uint64_t value)
+	{
+		if (value < HISTOGRAM_SUB_BUCKETS)
+			return (int)value;
+		int exponent = 63 - __builtin_clzll(value);
+		int shift    = exponent - HISTOGRAM_SUB_BUCKET_BITS;
+		return (shift + 1) * HISTOGRAM_SUB_BUCKETS +
+		       (int)((value >> shift) & (HISTOGRAM_SUB_BUCKETS - 1));
+	}
+
+	/**
+	 * \brief Returns the smallest value counted in bucket \p index.
+	 */
+	static uint64_t bucketLow(int index);
+	/**
+	 * \brief Returns the largest value counted in bucket \p index.
+	 */
+	static uint64_t bucketHigh(int index);
+
+	void record(uint64_t value)
+	{
+		counts_[bucketIndex(value)]++;
+		if ((count_ == 0) || (value < min_))
+			min_ = value;
+		if (value > max_)
+			max_ = value;
+		count_++;
+		sum_ += value;
+	}
+
+	void merge(const LatencyHistogram &other);
+	void reset();
+
+	uint64_t getCount() const { return count_; }
+	uint64_t getMin() const { return min_; }
+	uint64_t getMax() const { return max_; }
+	double   getMean() const { return (count_ > 0) ? (double)sum_ / count_ : 0; }
+	uint64_t getBucketCount(int index) const { return counts_[index]; }
+
+	/**
+	 * \brief Returns the value below or at which \p percentile percent of
+	 *        the recorded values are.
+	 */
+	uint64_t getPercentile(double percentile) const;
+
+	/**
+	 * \brief Writes the count, mean and common percentiles on one line.
+	 */
+	void dump(std::ostream &out) const;
+};
+
+
+/**
+ * \brief Histogram that many threads record into without locking.
+ *
+ * Every thread records into its own \ref LatencyHistogram; \ref snapshot()
+ * merges them. Counters of a thread are written only by that thread,
+ * with relaxed atomic stores, so a snapshot taken while threads record
+ * may miss the latest values but never sees torn ones.
+ *
+ * The histograms of a thread are kept after the thread exits, until the
+ * ConcurrentHistogram is destroyed.
+ */
+class ConcurrentHistogram {
+private:
+	ConcurrentHistogram(const ConcurrentHistogram &other);
+	ConcurrentHistogram& operator=(const ConcurrentHistogram &other);
+
+	size_t                          id_;
+	mutable Mutex                   mutex_;
+	std::vector<LatencyHistogram*>  shards_;
+
+	LatencyHistogram* createShard();
+
+	LatencyHistogram* getShard();
+
+public:
+	ConcurrentHistogram();
+	~ConcurrentHistogram();
+
+	void record(uint64_t value)
+	{
+		LatencyHistogram *shard = getShard();
+
+		uint64_t *bucket = &shard->counts_[LatencyHistogram::bucketIndex(value)];
+		__atomic_store_n(bucket, *bucket + 1, __ATOMIC_RELAXED);
+		if ((shard->count_ == 0) || (value < shard->min_))
+			__atomic_store_n(&shard->min_, value, __ATOMIC_RELAXED);
+		if (value > shard->max_)
+			__atomic_store_n(&shard->max_, value, __ATOMIC_RELAXED);
+		__atomic_store_n(&shard->sum_, shard->sum_ + value, __ATOMIC_RELAXED);
+		__atomic_store_n(&shard->count_, shard->count_ + 1, __ATOMIC_RELAXED);
+	}
+
+	LatencyHistogram snapshot() const;
+};
+
+
+/**
+ * \brief Records the time from its construction to its destruction into
+ *        a histogram, in nanoseconds.
+ *
+ * \code
+ * static ConcurrentHistogram latency;
+ * {
+ *     ScopedTimer timer(&latency);
+ *     handleRequest();
+ * }
+ * \endcode
+ */
+class ScopedTimer {
+private:
+	ScopedTimer(const ScopedTimer &other);
+	ScopedTimer& operator=(const ScopedTimer &other);
+
+	LatencyHistogram    *histogram_;
+	ConcurrentHistogram *concurrent_;
+	uint64_t             start_;
+
+public:
+	ScopedTimer(LatencyHistogram *histogram) :
+		histogram_(histogram), concurrent_(NULL), start_(Clock::ticks())
+	{}
+
+	ScopedTimer(ConcurrentHistogram *histogram) :
+		histogram_(NULL), concurrent_(histogram), start_(Clock::ticks())
+	{}
+
+	~ScopedTimer()
+	{
+		uint64_t elapsed = Clock::ticksToNanos(Clock::ticks() - start_);
+		if (histogram_ != NULL)
+			histogram_->record(elapsed);
+		else
+			concurrent_->record(elapsed);
+	}
+};
+
+
+/** @} */
+
+
+} // namespace cppapp
+
+
+#endif /* end of include guard: HISTOGRAM_V6NE4RXK */
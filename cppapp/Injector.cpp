@@ -7,30 +7,79 @@
  */
 
 #include "Injector.h"
+#include "Metrics.h"
+#include "Trace.h"
 
 
 namespace cppapp {
 
 
+////////////////////////////////////////////////////////////////////////////////
+// METRICS
+////////////////////////////////////////////////////////////////////////////////
+
+
+static MetricCounter* objectsCreatedMetric()
+{
+	static MetricCounter *counter = MetricsRegistry::global().counter(
+		"cppapp_di_objects_created_total", "Objects created by injector factories.");
+	return counter;
+}
+
+
 ////////////////////////////////////////////////////////////////////////////////
 // DIAdvancedObject
 ////////////////////////////////////////////////////////////////////////////////
 
 
+/**
+ * A property with the same name replaces the old one in its slot.
+ */
 void DIAdvancedObject::addDIProperty(Ref<DIAbstractProperty> property)
 {
 	CPPAPP_ASSERT(property.isNotNull());
-	properties_[property->getName()] = property;
+	
+	VAR(found, propertyIndex_.find(property->name()));
+	if (found != propertyIndex_.end()) {
+		properties_[found->second] = property;
+		return;
+	}
+	
+	propertyIndex_[property->name()] = properties_.size();
+	properties_.push_back(property);
 }
 
 
 bool DIAdvancedObject::injectDependency(Ref<DIObject> obj, std::string key)
 {
-	Ref<DIAbstractProperty> prop = properties_[key];
-	if (prop.isNull())
-		return false;
+	return injectDependencySlot(resolveDependencySlot(key), obj, key);
+}
+
+
+int DIAdvancedObject::resolveDependencySlot(const std::string &key)
+{
+	VAR(found, propertyIndex_.find(key));
+	if (found == propertyIndex_.end())
+		return -1;
+	return found->second;
+}
+
+
+/**
+ * The slot is verified by comparing the property name with \p key, so
+ * a stale slot falls back to the lookup by name.
+ */
+bool DIAdvancedObject::injectDependencySlot(int slot, Ref<DIObject> obj, const std::string &key)
+{
+	if ((slot < 0) ||
+	    (slot >= (int)properties_.size()) ||
+	    (properties_[slot]->name() != key)) {
+		slot = resolveDependencySlot(key);
+		if (slot < 0)
+			return false;
+	}
 	
-	return prop->set(obj);
+	return properties_[slot]->set(obj);
 }
 
 
@@ -55,21 +104,562 @@ DIFunctionRegistration::DIFunctionRegistration(std::string name,
 }
 
 
+////////////////////////////////////////////////////////////////////////////////
+// CONSTRUCTION CHAIN
+////////////////////////////////////////////////////////////////////////////////
+
+
+/**
+ * \brief Link of the chain of scoped objects whose construction led to
+ *        the current one, innermost first.
+ */
+struct DIConstruction {
+	const DIPlan         *plan;
+	const DIConstruction *outer;
+};
+
+
+/**
+ * Chain of the current thread. Tasks creating subtrees run with the
+ * chain of the thread that submitted them, so a plan that depends on
+ * itself is detected on any thread, including from factories that call
+ * the injector.
+ */
+static __thread const DIConstruction *currentConstruction = NULL;
+
+
+static bool isConstructing(const DIPlan *plan)
+{
+	for (const DIConstruction *link = currentConstruction; link != NULL; link = link->outer) {
+		if (link->plan == plan)
+			return true;
+	}
+	return false;
+}
+
+
+/**
+ * \brief Makes \p chain the chain of the current thread for the lifetime
+ *        of the guard.
+ */
+struct DIConstructionChain {
+	const DIConstruction *saved;
+	
+	DIConstructionChain(const DIConstruction *chain) : saved(currentConstruction)
+	{
+		currentConstruction = chain;
+	}
+	~DIConstructionChain() { currentConstruction = saved; }
+};
+
+
+/**
+ * \brief Adds \p plan to the chain of the current thread for the
+ *        lifetime of the guard.
+ */
+struct DIConstructionScope {
+	DIConstruction link;
+	
+	DIConstructionScope(const DIPlan *plan)
+	{
+		link.plan  = plan;
+		link.outer = currentConstruction;
+		currentConstruction = &link;
+	}
+	~DIConstructionScope() { currentConstruction = link.outer; }
+};
+
+
 ////////////////////////////////////////////////////////////////////////////////
 // DIPlan
 ////////////////////////////////////////////////////////////////////////////////
 
 
-Ref<DIObject> DIPlan::instantiate(Ref<DIObject> parent)
+/**
+ * Emits the instructions of this plan and its children and returns the
+ * register of the object created by this plan.
+ */
+int DIPlan::compileNode(int parent, std::vector<DIInstruction> *program, int *registers)
 {
-	Ref<DIObject> obj = factory_->create(config_, parent);
+	// Lazy objects and objects that are not transient are made by the
+	// plan as a whole
+	if ((parent >= 0) && (lazy_ || (lifetime_ != DI_TRANSIENT))) {
+		DIInstruction scoped;
+		scoped.opcode  = lazy_ ? DIInstruction::DI_LAZY : DIInstruction::DI_SCOPED;
+		scoped.target  = (*registers)++;
+		scoped.parent  = parent;
+		scoped.value   = -1;
+		scoped.factory = NULL;
+		scoped.config  = config_.getPtr();
+		scoped.plan    = this;
+		scoped.key     = &key_;
+		scoped.slot    = -2;
+		program->push_back(scoped);
+		return scoped.target;
+	}
+	
+	DIInstruction create;
+	create.opcode  = DIInstruction::DI_CREATE;
+	create.target  = (*registers)++;
+	create.parent  = parent;
+	create.value   = -1;
+	create.factory = factory_.getPtr();
+	create.config  = config_.getPtr();
+	create.plan    = this;
+	create.key     = &key_;
+	create.slot    = -2;
+	program->push_back(create);
 	
 	FOR_EACH(children_, it) {
-		Ref<DIObject> child = (*it)->instantiate(obj);
-		obj->injectDependency(child, (*it)->getKey());
+		int child = (*it)->compileNode(create.target, program, registers);
+		
+		DIInstruction inject;
+		inject.opcode  = DIInstruction::DI_INJECT;
+		inject.target  = create.target;
+		inject.parent  = -1;
+		inject.value   = child;
+		inject.factory = NULL;
+		inject.config  = NULL;
+		inject.plan    = it->getPtr();
+		inject.key     = &(*it)->key_;
+		inject.slot    = -2;
+		program->push_back(inject);
+	}
+	
+	return create.target;
+}
+
+
+void DIPlan::compile()
+{
+	if (compiled_)
+		return;
+	
+	MutexLock lock(&compileMutex_);
+	if (compiled_)
+		return;
+	
+	std::vector<DIInstruction> program;
+	int registers = 0;
+	compileNode(-1, &program, &registers);
+	
+	program_.swap(program);
+	registers_ = registers;
+	
+	__sync_synchronize();
+	compiled_ = true;
+}
+
+
+const std::vector<DIInstruction>& DIPlan::getProgram()
+{
+	compile();
+	return program_;
+}
+
+
+Ref<DIObject> DIPlan::instantiate(Ref<DIObject> parent, const DIContext *context)
+{
+	TRACE_SCOPE("DIPlan::instantiate");
+	
+	if (lifetime_ == DI_TRANSIENT)
+		return construct(parent, context);
+	
+	DIScope *scope = (context == NULL) ? NULL : context->getScope(lifetime_);
+	if (scope == NULL) {
+		LOG_ERROR(
+			"Could not instantiate object configured at " <<
+			getOrigin() <<
+			" - there is no scope for its lifetime."
+		);
+		return NULL;
+	}
+	
+	return scope->getOrCreate(this, parent, context);
+}
+
+
+/**
+ * Executes a single instruction, returns \c false if it failed.
+ */
+bool DIPlan::execute(DIInstruction   &instr,
+                     Ref<DIObject>   *registers,
+                     Ref<DIObject>    parent,
+                     const DIContext *context)
+{
+	switch (instr.opcode) {
+	case DIInstruction::DI_CREATE:
+		registers[instr.target] = instr.factory->create(
+			instr.config,
+			(instr.parent < 0) ? parent : registers[instr.parent]
+		);
+		if (registers[instr.target].isNull()) {
+			LOG_ERROR(
+				"Could not instantiate object configured at " <<
+				instr.plan->getOrigin() <<
+				" - the factory returned null."
+			);
+			return false;
+		}
+		objectsCreatedMetric()->add();
+		break;
+	
+	case DIInstruction::DI_INJECT: {
+		DIObject *target = registers[instr.target].getPtr();
+		int slot = __atomic_load_n(&instr.slot, __ATOMIC_RELAXED);
+		if (slot == -2) {
+			slot = target->resolveDependencySlot(*instr.key);
+			__sync_bool_compare_and_swap(&instr.slot, -2, slot);
+		}
+		target->injectDependencySlot(slot, registers[instr.value], *instr.key);
+		break;
+	}
+	
+	case DIInstruction::DI_SCOPED:
+		registers[instr.target] = instr.plan->instantiate(registers[instr.parent], context);
+		if (registers[instr.target].isNull())
+			return false;
+		break;
+	
+	case DIInstruction::DI_LAZY:
+		registers[instr.target] = new DILazyProxy(instr.plan, registers[instr.parent], context);
+		break;
+	}
+	
+	return true;
+}
+
+
+/**
+ * Executes the compiled plan. The only allocations besides the created
+ * objects are the register file and whatever the factories allocate.
+ */
+Ref<DIObject> DIPlan::construct(Ref<DIObject> parent, const DIContext *context)
+{
+	if ((context != NULL) && (context->pool != NULL))
+		return constructParallel(parent, context);
+	
+	compile();
+	
+	std::vector<Ref<DIObject> > registers(registers_);
+	
+	FOR_EACH(program_, it) {
+		if (!execute(*it, &registers[0], parent, context))
+			return NULL;
 	}
 	
-	return obj;
+	return registers[0];
+}
+
+
+/**
+ * \brief Task executing a block of a compiled plan for
+ *        \ref DIPlan::constructParallel().
+ */
+class DISubtreeTask : public Task {
+private:
+	DIPlan               *plan_;
+	size_t                begin_;
+	size_t                end_;
+	Ref<DIObject>        *registers_;
+	const DIContext      *context_;
+	int                  *ok_;
+	const DIConstruction *construction_;
+
+public:
+	DISubtreeTask(DIPlan          *plan,
+	              size_t           begin,
+	              size_t           end,
+	              Ref<DIObject>   *registers,
+	              const DIContext *context,
+	              int             *ok) :
+		plan_(plan), begin_(begin), end_(end), registers_(registers),
+		context_(context), ok_(ok), construction_(currentConstruction)
+	{}
+	
+	virtual void run()
+	{
+		DIConstructionChain chain(construction_);
+		*ok_ = plan_->executeParallel(begin_, end_, registers_, NULL, context_);
+	}
+};
+
+
+/**
+ * Executes the block of instructions [\p begin, \p end) that creates one
+ * object and its children. Every child's block ends with the injection
+ * into the object, the blocks are executed concurrently and the
+ * injections in their order afterwards. Blocks write only to their own
+ * registers.
+ */
+bool DIPlan::executeParallel(size_t           begin,
+                             size_t           end,
+                             Ref<DIObject>   *registers,
+                             Ref<DIObject>    parent,
+                             const DIContext *context)
+{
+	DIInstruction &head = program_[begin];
+	if (!execute(head, registers, parent, context))
+		return false;
+	if (head.opcode != DIInstruction::DI_CREATE)
+		return true;
+	
+	// Block i is [begins[i], injects[i])
+	std::vector<size_t> begins;
+	std::vector<size_t> injects;
+	size_t              blockBegin = begin + 1;
+	for (size_t i = begin + 1; i < end; i++) {
+		if ((program_[i].opcode == DIInstruction::DI_INJECT) &&
+		    (program_[i].target == head.target)) {
+			begins.push_back(blockBegin);
+			injects.push_back(i);
+			blockBegin = i + 1;
+		}
+	}
+	if (injects.empty())
+		return true;
+	
+	std::vector<int> ok(injects.size(), true);
+	{
+		TaskGroup group(context->pool);
+		int       first = -1;
+		
+		for (size_t i = 0; i < injects.size(); i++) {
+			if (program_[begins[i]].opcode == DIInstruction::DI_LAZY)
+				ok[i] = execute(program_[begins[i]], registers, parent, context);
+			else if (first < 0)
+				first = i;
+			else
+				group.add(new DISubtreeTask(this, begins[i], injects[i], registers, context, &ok[i]));
+		}
+		
+		if (first >= 0)
+			ok[first] = executeParallel(begins[first], injects[first], registers, parent, context);
+		group.wait();
+	}
+	
+	FOR_EACH(ok, it) {
+		if (!*it)
+			return false;
+	}
+	
+	FOR_EACH(injects, it) {
+		if (!execute(program_[*it], registers, parent, context))
+			return false;
+	}
+	
+	return true;
+}
+
+
+Ref<DIObject> DIPlan::constructParallel(Ref<DIObject> parent, const DIContext *context)
+{
+	compile();
+	
+	std::vector<Ref<DIObject> > registers(registers_);
+	
+	if (!executeParallel(0, program_.size(), &registers[0], parent, context))
+		return NULL;
+	
+	return registers[0];
+}
+
+
+bool DIPlan::parseLifetime(const std::string &name, DILifetime *lifetime)
+{
+	if (name == "transient")
+		*lifetime = DI_TRANSIENT;
+	else if (name == "singleton")
+		*lifetime = DI_SINGLETON;
+	else if (name == "thread")
+		*lifetime = DI_THREAD;
+	else if (name == "request")
+		*lifetime = DI_REQUEST;
+	else
+		return false;
+	return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// DIScope
+////////////////////////////////////////////////////////////////////////////////
+
+
+/**
+ * The object is created outside of the lock, so plans in the same scope
+ * can be instantiated concurrently and a plan can use other objects from
+ * the scope as its dependencies. A plan found under construction is
+ * waited for, unless the caller is part of its construction (possibly
+ * on another thread of the pool).
+ */
+Ref<DIObject> DIScope::getOrCreate(DIPlan *plan, Ref<DIObject> parent, const DIContext *context)
+{
+	{
+		MutexLock lock(&mutex_);
+		
+		while (true) {
+			VAR(found, entries_.find(plan));
+			if (found == entries_.end())
+				break;
+			
+			Entry &entry = found->second;
+			if (entry.state == READY)
+				return entry.object;
+			
+			if (isConstructing(plan)) {
+				LOG_ERROR(
+					"Could not instantiate object configured at " <<
+					plan->getOrigin() <<
+					" - it depends on itself."
+				);
+				return NULL;
+			}
+			
+			ready_.wait(mutex_);
+		}
+		
+		Entry &entry = entries_[plan];
+		entry.state  = CONSTRUCTING;
+		entry.plan   = plan;
+	}
+	
+	Ref<DIObject> object;
+	{
+		DIConstructionScope construction(plan);
+		object = plan->construct(parent, context);
+	}
+	
+	MutexLock lock(&mutex_);
+	
+	if (object.isNull()) {
+		// Let the next caller try again
+		entries_.erase(plan);
+	} else {
+		Entry &entry = entries_[plan];
+		entry.state  = READY;
+		entry.object = object;
+		completed_.push_back(object);
+	}
+	
+	ready_.broadcast();
+	return object;
+}
+
+
+Ref<DIObject> DIScope::get(DIPlan *plan)
+{
+	MutexLock lock(&mutex_);
+	
+	VAR(found, entries_.find(plan));
+	if ((found == entries_.end()) || (found->second.state != READY))
+		return NULL;
+	return found->second.object;
+}
+
+
+int DIScope::size()
+{
+	MutexLock lock(&mutex_);
+	return completed_.size();
+}
+
+
+/**
+ * Dependencies are completed before the objects they are injected into,
+ * so releasing in the reverse order of completion releases dependent
+ * objects first. Objects still being constructed are kept.
+ */
+void DIScope::release()
+{
+	std::vector<Ref<DIObject> > completed;
+	
+	{
+		MutexLock lock(&mutex_);
+		
+		completed.swap(completed_);
+		for (VAR(it, entries_.begin()); it != entries_.end();) {
+			if (it->second.state == READY)
+				entries_.erase(it++);
+			else
+				++it;
+		}
+	}
+	
+	while (!completed.empty())
+		completed.pop_back();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// DILazyProxy
+////////////////////////////////////////////////////////////////////////////////
+
+
+DILazyProxy::DILazyProxy(Ref<DIPlan> plan, Ref<DIObject> parent, const DIContext *context) :
+	plan_(plan),
+	parent_(parent),
+	resolved_(false)
+{
+	if (context != NULL) {
+		singleton_ = Ref<DIScope>(context->singleton);
+		thread_    = Ref<DIScope>(context->thread);
+		request_   = Ref<DIScope>(context->request);
+		pool_      = context->pool;
+	}
+}
+
+
+/**
+ * A failed plan is not retried, later calls return \c NULL as well.
+ */
+Ref<DIObject> DILazyProxy::resolve()
+{
+	if (resolved_)
+		return object_;
+	
+	MutexLock lock(&mutex_);
+	if (resolved_)
+		return object_;
+	
+	Ref<DIScope> singleton = singleton_.lock();
+	Ref<DIScope> thread    = thread_.lock();
+	Ref<DIScope> request   = request_.lock();
+	
+	DIContext context;
+	context.singleton = singleton.getPtr();
+	context.thread    = thread.getPtr();
+	context.request   = request.getPtr();
+	context.pool      = pool_.getPtr();
+	
+	Ref<DIObject> parent = parent_.lock();
+	if (parent.isNull() && !parent_.isNull()) {
+		LOG_ERROR(
+			"Could not instantiate lazy object configured at " <<
+			plan_->getOrigin() <<
+			" - the object it was injected into is gone."
+		);
+	} else if ((singleton.isNull() && !singleton_.isNull()) ||
+	           (thread.isNull() && !thread_.isNull()) ||
+	           (request.isNull() && !request_.isNull())) {
+		LOG_ERROR(
+			"Could not instantiate lazy object configured at " <<
+			plan_->getOrigin() <<
+			" - the scope it was created in is gone."
+		);
+	} else {
+		object_ = plan_->instantiate(parent, &context);
+	}
+	
+	parent_.reset();
+	singleton_.reset();
+	thread_.reset();
+	request_.reset();
+	pool_ = NULL;
+	
+	__sync_synchronize();
+	resolved_ = true;
+	return object_;
 }
 
 
@@ -78,19 +668,75 @@ Ref<DIObject> DIPlan::instantiate(Ref<DIObject> parent)
 ////////////////////////////////////////////////////////////////////////////////
 
 
+/**
+ * Sets the lifetime and laziness of a new plan from its configuration.
+ */
+bool Injector::configurePlan(Ref<DIPlan> plan, Ref<DynObject> config)
+{
+	if (config->hasStrItem(DI_LAZY_CFG_KEY))
+		plan->setLazy(config->getStrItem(DI_LAZY_CFG_KEY)->getBool());
+	
+	if (!config->hasStrItem(DI_LIFETIME_CFG_KEY))
+		return true;
+	
+	std::string name     = config->getStrItem(DI_LIFETIME_CFG_KEY)->getString();
+	DILifetime  lifetime = DI_TRANSIENT;
+	if (!DIPlan::parseLifetime(name, &lifetime)) {
+		LOG_ERROR(
+			"Could not instantiate object configured at " <<
+			config->getLocation() <<
+			" - unknown lifetime \"" << name << "\"."
+		);
+		return false;
+	}
+	
+	plan->setLifetime(lifetime);
+	return true;
+}
+
+
 void Injector::registerFactory(std::string name, Ref<DIFactory> factory)
 {
-	VAR(found, factories_.find(name));
-	if (found != factories_.end()) {
+	MutexLock lock(&registryMutex_);
+	
+	Registry *registry = new Registry(*registry_.get());
+	
+	VAR(found, registry->factories.find(name));
+	if (found != registry->factories.end()) {
 		LOG_WARNING("DI factory already registered: " << name);
 	}
-	factories_[name] = factory;
+	registry->factories[name] = factory;
+	
+	registry_.update(registry);
 }
 
 
 Ref<DIFactory> Injector::getFactory(std::string name)
 {
-	return factories_[name];
+	RcuReadLock lock;
+	
+	const Registry *registry = registry_.get();
+	VAR(found, registry->factories.find(name));
+	if (found == registry->factories.end())
+		return NULL;
+	return found->second;
+}
+
+
+void Injector::setThreadPool(Ref<ThreadPool> pool)
+{
+	MutexLock lock(&registryMutex_);
+	
+	Registry *registry = new Registry(*registry_.get());
+	registry->pool = pool;
+	registry_.update(registry);
+}
+
+
+Ref<ThreadPool> Injector::getThreadPool()
+{
+	RcuReadLock lock;
+	return registry_.get()->pool;
 }
 
 
@@ -116,7 +762,10 @@ Ref<DIPlan> Injector::makePlan(std::string name, Ref<DIFactory> factory, Ref<Dyn
 		}
 	}
 	
-	return new DIPlan(name.size() > 0, name, factory, children, config);
+	Ref<DIPlan> plan = new DIPlan(name.size() > 0, name, factory, children, config);
+	if (!configurePlan(plan, config))
+		return NULL;
+	return plan;
 }
 
 
@@ -150,7 +799,7 @@ Ref<DIPlan> Injector::makePlan(Ref<DynObject> config)
 		config->getStrItem(DI_FACTORY_CFG_KEY)->getString();
 	
 	// Get the appropriate factory
-	Ref<DIFactory> factory = factories_[factoryName];
+	Ref<DIFactory> factory = getFactory(factoryName);
 	if (factory.isNull()) {
 		LOG_ERROR(
 			"Could not instantiate object configured at " <<
@@ -179,37 +828,112 @@ Ref<DIPlan> Injector::makePlan(Ref<DynObject> config)
 	}
 	
 	// Return the plan
-	return new DIPlan(
+	Ref<DIPlan> plan = new DIPlan(
 		hasKey,
 		key,
 		factory,
 		children,
 		config
 	);
+	if (!configurePlan(plan, config))
+		return NULL;
+	return plan;
 }
 
 
 Ref<DIPlan> Injector::getPlan(std::string name)
 {
-	return plans_[name];
+	RcuReadLock lock;
+	
+	const Registry *registry = registry_.get();
+	VAR(found, registry->plans.find(name));
+	if (found == registry->plans.end())
+		return NULL;
+	return found->second;
 }
 
 
+/**
+ * The plans are made and compiled before the registry is copied, so
+ * the copy is made only once.
+ */
 void Injector::makePlans(Ref<DynObject> config)
 {
+	std::vector<Ref<DIPlan> > plans;
+	
 	DYN_FOR_EACH(planConfig, config) {
 		Ref<DIPlan> plan = makePlan(planConfig);
 		
 		if (plan.isNotNull() && plan->hasKey()) {
-			plans_[plan->getKey()] = plan;
+			plan->compile();
+			plans.push_back(plan);
 		}
 	}
+	
+	MutexLock lock(&registryMutex_);
+	
+	Registry *registry = new Registry(*registry_.get());
+	FOR_EACH(plans, plan) {
+		registry->plans[(*plan)->getKey()] = *plan;
+	}
+	registry_.update(registry);
+}
+
+
+void Injector::clear()
+{
+	{
+		MutexLock lock(&registryMutex_);
+		
+		Registry *registry = new Registry();
+		registry->pool = registry_.get()->pool;
+		registry_.update(registry);
+	}
+	
+	singletons_->release();
+	releaseThreadScope();
 }
 
 
-Ref<DIObject> Injector::instantiate(std::string planName)
+Ref<DIScope> Injector::getThreadScope()
 {
-	Ref<DIPlan> plan = getPlan(planName);
+	ThreadScope &local = threadScopes_.get();
+	if (local.scope.isNull())
+		local.scope = new DIScope();
+	return local.scope;
+}
+
+
+void Injector::releaseThreadScope()
+{
+	ThreadScope *local = threadScopes_.peek();
+	if (local != NULL)
+		local->scope = NULL;
+}
+
+
+Ref<DIObject> Injector::instantiate(std::string planName, Ref<DIScope> request)
+{
+	static MetricCounter *instantiations = MetricsRegistry::global().counter(
+		"cppapp_di_instantiations_total", "Plans instantiated through the injector.");
+	static MetricHistogram *latency = MetricsRegistry::global().histogram(
+		"cppapp_di_instantiate_seconds", "Time to instantiate a plan.");
+	
+	instantiations->add();
+	ScopedTimer timer(latency->getHistogram());
+	
+	Ref<DIPlan>     plan;
+	Ref<ThreadPool> pool;
+	{
+		RcuReadLock lock;
+		
+		const Registry *registry = registry_.get();
+		VAR(found, registry->plans.find(planName));
+		if (found != registry->plans.end())
+			plan = found->second;
+		pool = registry->pool;
+	}
+	
 	if (plan.isNull()) {
 		LOG_ERROR(
 			"Cannot instantiate configured object - plan \"" << planName << "\" does not exist."
@@ -217,7 +941,13 @@ Ref<DIObject> Injector::instantiate(std::string planName)
 		return NULL;
 	}
 	
-	return plan->instantiate(NULL);
+	DIContext context;
+	context.singleton = singletons_.getPtr();
+	context.thread    = getThreadScope().getPtr();
+	context.request   = request.getPtr();
+	context.pool      = pool.getPtr();
+	
+	return plan->instantiate(NULL, &context);
 }
 
 
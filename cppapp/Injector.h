@@ -14,6 +14,10 @@
 #include "DynObject.h"
 #include "Logger.h"
 #include "Debug.h"
+#include "Mutex.h"
+#include "ThreadLocal.h"
+#include "ThreadPool.h"
+#include "Rcu.h"
 
 
 namespace cppapp {
@@ -39,6 +43,7 @@ class Injector;
  *        or can be injected as a dependency.
  */
 class DIObject : public Object {
+	CPPAPP_CLASS_ID(DIObject, Object)
 public:
 	virtual ~DIObject() {} 
 	
@@ -46,11 +51,80 @@ public:
 	{
 		return false;
 	}
+	
+	/**
+	 * \brief Returns a slot number of the dependency named \p key or -1.
+	 *
+	 * Compiled plans (see \ref DIPlan::compile()) resolve the slot once
+	 * and then inject through \ref injectDependencySlot(), so objects
+	 * that can look up their dependencies faster than by name should
+	 * override both methods. Slots of objects of the same class must be
+	 * the same.
+	 */
+	virtual int resolveDependencySlot(const std::string &key)
+	{
+		return -1;
+	}
+	
+	/**
+	 * \brief Injects a dependency into a slot returned by
+	 *        \ref resolveDependencySlot().
+	 *
+	 * \p key is the name of the dependency, it can be used to verify
+	 * the slot. The default implementation calls \ref injectDependency().
+	 */
+	virtual bool injectDependencySlot(int slot, Ref<DIObject> obj, const std::string &key)
+	{
+		return injectDependency(obj, key);
+	}
+	
+	/**
+	 * \brief Returns the object this object stands for.
+	 *
+	 * Lazily injected dependencies (see \ref DILazyProxy) create the
+	 * object the first time this is called; other objects return
+	 * themselves.
+	 */
+	virtual Ref<DIObject> resolve() { return this; }
+};
+
+
+/**
+ * \brief Reference to a dependency that may be injected lazily.
+ *
+ * Holds either the dependency or its \ref DILazyProxy; the dependency is
+ * created the first time it is accessed. Use it as the type of
+ * \ref DIProperty to keep lazy dependencies lazy.
+ */
+template<class T>
+class DILazy {
+private:
+	Ref<DIObject> value_;
+
+public:
+	DILazy() {}
+	DILazy(Ref<DIObject> value) : value_(value) {}
+	
+	/**
+	 * \brief Returns the dependency, creating it if necessary.
+	 */
+	Ref<T> get() const
+	{
+		if (value_.isNull())
+			return NULL;
+		return value_->resolve().template as<T>();
+	}
+	
+	T* operator->() const { return get().operator->(); }
+	
+	bool isNull() const    { return value_.isNull(); }
+	bool isNotNull() const { return value_.isNotNull(); }
 };
 
 
 template<class T>
 class DIBox : public DIObject {
+	CPPAPP_CLASS_ID(DIBox, DIObject)
 private:
 	Ref<T> value_;
 
@@ -64,6 +138,16 @@ public:
 	{
 		return value_->injectDependency(obj, key);
 	}
+	
+	virtual int resolveDependencySlot(const std::string &key)
+	{
+		return value_->resolveDependencySlot(key);
+	}
+	
+	virtual bool injectDependencySlot(int slot, Ref<DIObject> obj, const std::string &key)
+	{
+		return value_->injectDependencySlot(slot, obj, key);
+	}
 };
 
 
@@ -86,6 +170,7 @@ public:
 	
 	virtual ~DIAbstractProperty() {}
 	
+	const std::string&  name() const { return name_; }
 	virtual std::string getName() { return name_; }
 	virtual bool        isRequired() { return required_; }
 	
@@ -118,27 +203,32 @@ public:
 };
 
 
+/**
+ * \brief DI property set by a method taking a reference to an object.
+ */
 template<class T, class U>
 class DIProperty<Ref<T>, U> : public DIAbstractProperty {
 public:
-	typedef void (U::*Method)(T value);
+	typedef void (U::*Method)(Ref<T> value);
 
 private:
-	std::string  name_;
 	U           *obj_;
 	Method       method_;
 
 public:
-	DIProperty(std::string name, U obj, Method method) :
-		name_(name), obj_(obj), method_(method)
+	DIProperty(std::string name, U *obj, Method method) :
+		DIAbstractProperty(name), obj_(obj), method_(method)
 	{}
 	
 	virtual ~DIProperty() {}
 	
 	virtual bool set(Ref<DIObject> value)
 	{
-		Ref<DynObject> obj = value.as<DynObject>();
-		if (obj.isNull()) {
+		if (value.isNotNull())
+			value = value->resolve();
+		
+		Ref<T> obj = value.as<T>();
+		if (obj.isNull() && value.isNotNull()) {
 			LOG_ERROR(
 				"Failed to set DI property \"" << name_ <<
 				"\" - data type conversion failed. (" << value->getClassName() << ")."
@@ -146,7 +236,36 @@ public:
 			return false;
 		}
 		
-		(obj_->*method_)(*value);
+		(obj_->*method_)(obj);
+		return true;
+	}
+};
+
+
+/**
+ * \brief DI property set by a method taking a lazy reference.
+ *
+ * The type of the dependency is checked when it is accessed.
+ */
+template<class T, class U>
+class DIProperty<DILazy<T>, U> : public DIAbstractProperty {
+public:
+	typedef void (U::*Method)(DILazy<T> value);
+
+private:
+	U           *obj_;
+	Method       method_;
+
+public:
+	DIProperty(std::string name, U *obj, Method method) :
+		DIAbstractProperty(name), obj_(obj), method_(method)
+	{}
+	
+	virtual ~DIProperty() {}
+	
+	virtual bool set(Ref<DIObject> value)
+	{
+		(obj_->*method_)(DILazy<T>(value));
 		return true;
 	}
 };
@@ -155,9 +274,17 @@ public:
 class Injector;
 
 
+/**
+ * \brief DI object with named properties.
+ *
+ * The slot of a property (see \ref resolveDependencySlot()) is the order
+ * in which it was added.
+ */
 class DIAdvancedObject : public DIObject {
+	CPPAPP_CLASS_ID(DIAdvancedObject, DIObject)
 private:
-	std::map<std::string, Ref<DIAbstractProperty> > properties_;
+	std::vector<Ref<DIAbstractProperty> > properties_;
+	std::map<std::string, int>            propertyIndex_;
 	
 protected:
 	void addDIProperty(Ref<DIAbstractProperty> property);
@@ -166,6 +293,8 @@ public:
 	virtual ~DIAdvancedObject() {}
 	
 	virtual bool injectDependency(Ref<DIObject> obj, std::string key);
+	virtual int  resolveDependencySlot(const std::string &key);
+	virtual bool injectDependencySlot(int slot, Ref<DIObject> obj, const std::string &key);
 	
 	virtual void diConfig(Injector &injector, Ref<DynObject> config);
 };
@@ -238,9 +367,113 @@ public:
 //// DIPlan /////////////////////////////////////////////////////////
 
 
+class DIPlan;
+class DIScope;
+
+
+/**
+ * \brief Lifetime of objects created by a \ref DIPlan.
+ *
+ * Set by the \c "lifetime" key of the plan configuration (\c "transient",
+ * \c "singleton", \c "thread" or \c "request").
+ */
+enum DILifetime {
+	/// A new object is created every time the plan is instantiated.
+	DI_TRANSIENT,
+	/// One object per \ref Injector.
+	DI_SINGLETON,
+	/// One object per thread.
+	DI_THREAD,
+	/// One object per request scope passed to \ref Injector::instantiate().
+	DI_REQUEST
+};
+
+
+/**
+ * \brief State shared by the whole instantiation of a plan.
+ *
+ * Holds the scopes used to cache objects with a lifetime other than
+ * \ref DI_TRANSIENT and the thread pool used to create independent
+ * subtrees in parallel (\c NULL to create them sequentially).
+ */
+struct DIContext {
+	DIScope    *singleton;
+	DIScope    *thread;
+	DIScope    *request;
+	ThreadPool *pool;
+	
+	DIContext() : singleton(NULL), thread(NULL), request(NULL), pool(NULL) {}
+	
+	/**
+	 * \brief Returns the scope of objects with \p lifetime or \c NULL.
+	 */
+	DIScope* getScope(DILifetime lifetime) const
+	{
+		switch (lifetime) {
+		case DI_SINGLETON: return singleton;
+		case DI_THREAD:    return thread;
+		case DI_REQUEST:   return request;
+		default:           return NULL;
+		}
+	}
+};
+
+
+/**
+ * \brief Single step of a compiled \ref DIPlan.
+ *
+ * Objects are kept in numbered registers while the plan is executed.
+ * Register 0 holds the object created by the root plan.
+ */
+struct DIInstruction {
+	enum Opcode {
+		/// Creates an object in register \c target.
+		DI_CREATE,
+		/// Injects the object in register \c value into \c target.
+		DI_INJECT,
+		/// Gets an object of a plan that is not \ref DI_TRANSIENT from
+		/// its scope (creating it by the plan if necessary) into
+		/// register \c target.
+		DI_SCOPED,
+		/// Creates a \ref DILazyProxy of the plan in register \c target.
+		DI_LAZY
+	};
+	
+	Opcode             opcode;
+	int                target;
+	/// Register of the parent object (DI_CREATE), -1 for the root.
+	int                parent;
+	int                value;
+	
+	DIFactory         *factory;
+	DynObject         *config;
+	/// Plan the instruction was compiled from.
+	DIPlan            *plan;
+	const std::string *key;
+	
+	/// Slot of \c key in the target object (DI_INJECT), cached by
+	/// the first execution; -2 if not resolved yet. The target's class
+	/// is not known before its factory runs, so the slot cannot be
+	/// resolved by \ref DIPlan::compile(). Accessed with atomic builtins,
+	/// the compiled program is shared by all threads.
+	int                slot;
+};
+
+
 /**
  * \brief Contains information necessary to instantiate a dependecy
  *        (including its dependencies) by name.
+ *
+ * The tree of plans is compiled into a linear sequence of instructions
+ * (see \ref DIInstruction) the first time it is instantiated. Objects
+ * are created in pre-order and dependencies injected in post-order, the
+ * same order in which the tree would be instantiated recursively.
+ *
+ * Children with a lifetime other than \ref DI_TRANSIENT are not inlined,
+ * their objects are taken from the scope (see \ref DIScope) as a whole.
+ * Such an object is created with the parent of its first instantiation.
+ * Lazy children (the \c "lazy" configuration key) are injected as a
+ * \ref DILazyProxy.
  */
 class DIPlan : public Object {
 private:
@@ -250,6 +483,27 @@ private:
 	std::vector<Ref<DIPlan> > children_;
 	
 	Ref<DynObject>            config_;
+	DILifetime                lifetime_;
+	bool                      lazy_;
+	
+	Mutex                      compileMutex_;
+	volatile bool              compiled_;
+	std::vector<DIInstruction> program_;
+	int                        registers_;
+	
+	int compileNode(int parent, std::vector<DIInstruction> *program, int *registers);
+	
+	bool execute(DIInstruction   &instr,
+	             Ref<DIObject>   *registers,
+	             Ref<DIObject>    parent,
+	             const DIContext *context);
+	
+	friend class DISubtreeTask;
+	bool executeParallel(size_t           begin,
+	                     size_t           end,
+	                     Ref<DIObject>   *registers,
+	                     Ref<DIObject>    parent,
+	                     const DIContext *context);
 
 public:
 	DIPlan(bool                             hasKey,
@@ -261,7 +515,11 @@ public:
 		key_(key),
 		factory_(factory),
 		children_(children),
-		config_(config)
+		config_(config),
+		lifetime_(DI_TRANSIENT),
+		lazy_(false),
+		compiled_(false),
+		registers_(0)
 	{}
 
 	DIPlan(Ref<DIFactory>                   factory,
@@ -271,7 +529,11 @@ public:
 		key_(""),
 		factory_(factory),
 		children_(children),
-		config_(config)
+		config_(config),
+		lifetime_(DI_TRANSIENT),
+		lazy_(false),
+		compiled_(false),
+		registers_(0)
 	{}
 	
 	DIPlan(std::string                      key,
@@ -282,7 +544,11 @@ public:
 		key_(key),
 		factory_(factory),
 		children_(children),
-		config_(config)
+		config_(config),
+		lifetime_(DI_TRANSIENT),
+		lazy_(false),
+		compiled_(false),
+		registers_(0)
 	{}
 	
 	virtual ~DIPlan() {}
@@ -294,7 +560,180 @@ public:
 	
 	virtual TextLoc getOrigin() { return config_->getLocation(); }
 	
-	virtual Ref<DIObject> instantiate(Ref<DIObject> parent);
+	const std::vector<Ref<DIPlan> >& getChildren() const { return children_; }
+	
+	DILifetime getLifetime() const { return lifetime_; }
+	/**
+	 * \brief Sets the lifetime of the created objects; must be called
+	 *        before the plan (or a plan containing it) is compiled.
+	 */
+	void       setLifetime(DILifetime lifetime) { lifetime_ = lifetime; }
+	
+	bool isLazy() const { return lazy_; }
+	/**
+	 * \brief Makes the plan inject a \ref DILazyProxy instead of the
+	 *        object when it is a child of another plan; must be called
+	 *        before the parent plan is compiled.
+	 */
+	void setLazy(bool lazy) { lazy_ = lazy; }
+	
+	/**
+	 * \brief Compiles the plan unless it has already been compiled.
+	 *
+	 * Plans are compiled automatically by \ref instantiate(), so calling
+	 * this is only needed to move the cost out of the first
+	 * instantiation. The plan must not be changed afterwards.
+	 */
+	void compile();
+	/**
+	 * \brief Returns the compiled plan (compiling it if necessary).
+	 */
+	const std::vector<DIInstruction>& getProgram();
+	
+	/**
+	 * \brief Returns an object of this plan, taking it from the scope in
+	 *        \p context that corresponds to its lifetime.
+	 *
+	 * Returns \c NULL if the plan is not \ref DI_TRANSIENT and
+	 * \p context does not contain the corresponding scope.
+	 */
+	virtual Ref<DIObject> instantiate(Ref<DIObject> parent, const DIContext *context = NULL);
+	/**
+	 * \brief Creates a new object regardless of the lifetime of the plan.
+	 *
+	 * Used by \ref DIScope, the scopes are still used for the children.
+	 * If \p context has a thread pool, the object is created by
+	 * \ref constructParallel().
+	 */
+	Ref<DIObject>         construct(Ref<DIObject> parent, const DIContext *context);
+	/**
+	 * \brief Creates a new object, creating the subtrees of its children
+	 *        concurrently on the thread pool of \p context.
+	 *
+	 * Executes the compiled plan: the instructions of every child form a
+	 * contiguous block followed by the injection into the parent. Children
+	 * are created once their parent exists, so the blocks of siblings are
+	 * the independent parts of the tree. The calling thread executes the
+	 * first block itself and helps with the others while it waits.
+	 * Dependencies are injected in the order of the children, the same
+	 * order as in a sequential instantiation; factories must be
+	 * thread-safe.
+	 */
+	Ref<DIObject>         constructParallel(Ref<DIObject> parent, const DIContext *context);
+	
+	/**
+	 * \brief Parses the name of a lifetime, returns \c false if it is not valid.
+	 */
+	static bool parseLifetime(const std::string &name, DILifetime *lifetime);
+};
+
+
+//// DIScope ////////////////////////////////////////////////////////
+
+
+/**
+ * \brief Cache of objects created by plans with the same lifetime.
+ *
+ * Every plan creates at most one object in a scope, even if it is
+ * instantiated from several threads at once; the other threads wait for
+ * the first one to finish. A plan instantiated from its own construction
+ * (a cycle) gets \c NULL.
+ *
+ * \ref release() (and the destructor) releases the objects in the reverse
+ * order of their completion, so objects are released before the objects
+ * they depend on.
+ */
+class DIScope : public Object {
+private:
+	enum State {
+		CONSTRUCTING,
+		READY
+	};
+	
+	struct Entry {
+		State         state;
+		Ref<DIObject> object;
+		Ref<DIPlan>   plan;
+	};
+	
+	DIScope(const DIScope &other);
+	
+	Mutex                        mutex_;
+	Condition                    ready_;
+	std::map<DIPlan*, Entry>     entries_;
+	std::vector<Ref<DIObject> >  completed_;
+	
+public:
+	DIScope() {}
+	virtual ~DIScope() { release(); }
+	
+	/**
+	 * \brief Returns the object created by \p plan in this scope,
+	 *        creating it if necessary.
+	 */
+	Ref<DIObject> getOrCreate(DIPlan *plan, Ref<DIObject> parent, const DIContext *context);
+	/**
+	 * \brief Returns the object created by \p plan or \c NULL.
+	 */
+	Ref<DIObject> get(DIPlan *plan);
+	/**
+	 * \brief Returns the number of the created objects.
+	 */
+	int           size();
+	/**
+	 * \brief Releases all objects in the reverse order of their creation.
+	 */
+	void          release();
+};
+
+
+//// DILazyProxy ////////////////////////////////////////////////////
+
+
+/**
+ * \brief Dependency that is created the first time it is used.
+ *
+ * Injected instead of the objects of lazy plans. \ref resolve() runs the
+ * plan once, even when called from several threads at once, with the
+ * scopes and thread pool of the instantiation that created the proxy.
+ * Use \ref DILazy as the type of the property (or call \ref resolve()
+ * in \ref DIObject::injectDependency() when the object is needed);
+ * a \c Ref property resolves the proxy immediately.
+ *
+ * The proxy holds the parent of the object and the scopes through
+ * \ref WeakRef "WeakRefs", so it does not keep the object it was injected
+ * into (nor a scope that owns that object) alive, and it drops them
+ * once it is resolved. Resolving the proxy after the parent or one of
+ * the scopes is gone fails.
+ */
+class DILazyProxy : public DIObject {
+	CPPAPP_CLASS_ID(DILazyProxy, DIObject)
+private:
+	DILazyProxy(const DILazyProxy &other);
+	
+	Ref<DIPlan>       plan_;
+	WeakRef<DIObject> parent_;
+	WeakRef<DIScope>  singleton_;
+	WeakRef<DIScope>  thread_;
+	WeakRef<DIScope>  request_;
+	Ref<ThreadPool>   pool_;
+	
+	Mutex             mutex_;
+	volatile bool     resolved_;
+	Ref<DIObject>     object_;
+	
+public:
+	DILazyProxy(Ref<DIPlan> plan, Ref<DIObject> parent, const DIContext *context);
+	virtual ~DILazyProxy() {}
+	
+	/**
+	 * \brief Returns the object, creating it if necessary; \c NULL if
+	 *        the plan failed.
+	 */
+	virtual Ref<DIObject> resolve();
+	
+	bool        isResolved() const { return resolved_; }
+	Ref<DIPlan> getPlan() const    { return plan_; }
 };
 
 
@@ -304,6 +743,8 @@ public:
 #define DI_KEY_CFG_KEY      "key"
 #define DI_FACTORY_CFG_KEY  "factory"
 #define DI_CHILDREN_CFG_KEY "children"
+#define DI_LIFETIME_CFG_KEY "lifetime"
+#define DI_LAZY_CFG_KEY     "lazy"
 
 
 /**
@@ -311,19 +752,40 @@ public:
  *
  * Use this class to register dependency injection factories and
  * instantiate dependencies.
+ *
+ * Factories, plans and the thread pool are kept in an immutable
+ * snapshot protected by RCU (see \ref RcuPtr). Lookups never block and
+ * have no side effects;
+ * registration copies the snapshot, so it is meant for a read-mostly
+ * registry. Registration must not be done inside an RCU read section.
  */
 class Injector {
 private:
-	std::map<std::string, Ref<DIFactory> > factories_;
-	std::map<std::string, Ref<DIPlan> >    plans_;
+	struct ThreadScope {
+		Ref<DIScope> scope;
+	};
+	
+	struct Registry {
+		std::map<std::string, Ref<DIFactory> > factories;
+		std::map<std::string, Ref<DIPlan> >    plans;
+		Ref<ThreadPool>                        pool;
+	};
+	
+	RcuPtr<Registry>                       registry_;
+	Mutex                                  registryMutex_;
+	
+	Ref<DIScope>                           singletons_;
+	ThreadLocal<ThreadScope>               threadScopes_;
 	
 	Injector(const Injector& other);
 	
+	bool configurePlan(Ref<DIPlan> plan, Ref<DynObject> config);
+	
 public:
 	/**
 	 * \brief Constructor.
 	 */
-	Injector() {}
+	Injector() : registry_(new Registry()), singletons_(new DIScope()) {}
 	
 	/**
 	 * \brief Destructor.
@@ -347,6 +809,7 @@ public:
 	 * \param name name of the factory to return
 	 *
 	 * A named factory must be registered using \ref registerFactory first.
+	 * Returns \c NULL if there is no such factory.
 	 */
 	Ref<DIFactory> getFactory(std::string name);
 	///@}
@@ -358,25 +821,64 @@ public:
 	Ref<DIPlan> makePlan(std::string name, Ref<DIFactory> factory, Ref<DynObject> config);
 	Ref<DIPlan> makePlan(Ref<DynObject> config);
 	Ref<DIPlan> getPlan(std::string name);
+	/**
+	 * \brief Makes plans from a list of configurations and registers the
+	 *        ones that have a key, all at once.
+	 */
 	void        makePlans(Ref<DynObject> config);
 	///@}
 	
+	/**
+	 * \name Scope Methods
+	 */
+	///@{
+	/**
+	 * \brief Returns the scope of \ref DI_SINGLETON objects.
+	 */
+	Ref<DIScope> getSingletonScope() { return singletons_; }
+	/**
+	 * \brief Returns the scope of \ref DI_THREAD objects of the calling
+	 *        thread; it is released when the thread exits.
+	 */
+	Ref<DIScope> getThreadScope();
+	/**
+	 * \brief Releases the \ref DI_THREAD objects of the calling thread.
+	 */
+	void         releaseThreadScope();
+	/**
+	 * \brief Creates a new scope for \ref DI_REQUEST objects.
+	 *
+	 * Pass it to \ref instantiate(); the objects are released when the
+	 * scope is released or destroyed.
+	 */
+	Ref<DIScope> beginRequest() { return new DIScope(); }
+	///@}
+	
+	/**
+	 * \brief Sets the thread pool used to create independent dependencies
+	 *        in parallel; \c NULL (the default) creates them sequentially.
+	 */
+	void            setThreadPool(Ref<ThreadPool> pool);
+	Ref<ThreadPool> getThreadPool();
+	
 	/**
 	 * \brief Instantiate a dependency using a named plan.
 	 *
 	 * \param planName name of the plan to instantiate
+	 * \param request  scope of \ref DI_REQUEST objects, if any
 	 */
-	Ref<DIObject> instantiate(std::string planName);
+	Ref<DIObject> instantiate(std::string planName, Ref<DIScope> request = NULL);
 	
 	/**
 	 * \brief Instantiate a dependency using a named plan and cast it to a type.
 	 *
 	 * \param planName name of the plan to instantiate
+	 * \param request  scope of \ref DI_REQUEST objects, if any
 	 */
 	template<class T>
-	Ref<T> instantiateAs(std::string planName)
+	Ref<T> instantiateAs(std::string planName, Ref<DIScope> request = NULL)
 	{
-		Ref<DIObject> obj = instantiate(planName);
+		Ref<DIObject> obj = instantiate(planName, request);
 		if (obj.isNull()) return NULL;
 		Ref<T> result = obj.as<T>();
 		if (result.isNull()) {
@@ -390,13 +892,12 @@ public:
 	}
 	
 	/**
-	 * \brief Removes all factories and plans.
+	 * \brief Removes all factories and plans and releases the singletons.
+	 *
+	 * The thread pool is kept.
+	 * Thread scopes of other threads are released when they exit.
 	 */
-	void clear()
-	{
-		factories_.clear();
-		plans_.clear();
-	}
+	void clear();
 	
 	/**
 	 * \brief Returns the singleton instance.
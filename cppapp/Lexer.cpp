@@ -13,7 +13,8 @@ namespace cppapp {
 
 
 Lexer::Lexer() :
-	input_(NULL)
+	input_(NULL),
+	consumed_(0)
 {
 }
 
@@ -24,6 +25,7 @@ void Lexer::input(Ref<Input> in)
 	input_    = in->getStream();
 	loc_      = TextLoc(in->getName());
 	buffer_.clear();
+	consumed_ = 0;
 }
 
 
@@ -69,6 +71,7 @@ int Lexer::read()
 		loc_ = loc_.newLine();
 	else
 		loc_ = loc_ + 1;
+	consumed_++;
 	
 	std::vector<char> newBuffer;
 	newBuffer.insert(newBuffer.begin(), buffer_.begin() + 1, buffer_.end());
@@ -33,6 +33,7 @@ private:
 	
 	TextLoc           loc_;
 	std::vector<char> buffer_;
+	long              consumed_;
 	
 	bool bufferChars(int length);
 	
@@ -51,6 +52,10 @@ public:
 	void input(std::string str);
 	
 	TextLoc getLocation() const { return loc_; }
+	/**
+	 * \brief Returns the number of characters read since the input was set.
+	 */
+	long    getConsumed() const { return consumed_; }
 	
 	int peek();
 	int read();
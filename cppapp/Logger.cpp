@@ -8,31 +8,492 @@
 
 
 #include <execinfo.h>
+#include <pthread.h>
 #include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <set>
 
 #include "Logger.h"
+#include "Metrics.h"
+#include "Mutex.h"
+#include "Rcu.h"
+#include "Thread.h"
+#include "ThreadLocal.h"
+#include "Stopwatch.h"
+#include "Clock.h"
 
 
 namespace cppapp {
 
 
-vector<Logger> Logger::levels_;
+////////////////////////////////////////////////////////////////////////////////
+// METRICS
+////////////////////////////////////////////////////////////////////////////////
 
 
+static MetricCounter* recordsMetric()
+{
+	static MetricCounter *counter = MetricsRegistry::global().counter(
+		"cppapp_log_records_total", "Log records committed.");
+	return counter;
+}
+
+
+static MetricCounter* droppedMetric()
+{
+	static MetricCounter *counter = MetricsRegistry::global().counter(
+		"cppapp_log_dropped_total", "Log records dropped by a full asynchronous queue.");
+	return counter;
+}
+
+
+static MetricCounter* suppressedMetric()
+{
+	static MetricCounter *counter = MetricsRegistry::global().counter(
+		"cppapp_log_suppressed_total", "Log records suppressed by sampling, rate limits or repeats.");
+	return counter;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// RECORD BUFFERS
+////////////////////////////////////////////////////////////////////////////////
+
+
+/**
+ * \brief Per-thread state of the record being formatted.
+ */
+struct LogRecordState {
+	LogBuffer buffer;
+	ostream   stream;
+	/// Stream without a buffer, which ignores everything written into it.
+	ostream   nullStream;
+	LogLevel  level;
+	size_t    headerSize;
+	bool      open;
+	bool      isWriter;
+	
+	LogRecordState() :
+		stream(&buffer), nullStream(NULL), level(LOG_LVL_NONE), headerSize(0),
+		open(false), isWriter(false)
+	{}
+};
+
+
+/**
+ * The thread local storage is never deleted, because records may be
+ * logged during static destruction.
+ */
+static LogRecordState& getRecordState()
+{
+	static ThreadLocal<LogRecordState> *states = new ThreadLocal<LogRecordState>();
+	return states->get();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// ASYNC WRITER
+////////////////////////////////////////////////////////////////////////////////
+
+
+struct LogQueueItem {
+	LogLevel level;
+	string   text;
+	size_t   headerSize;
+};
+
+
+/**
+ * \brief Background thread that writes records queued by \ref Logger.
+ */
+class LogWriter : public Thread {
+private:
+	Mutex                    mutex_;
+	Condition                notEmpty_;
+	Condition                notFull_;
+	std::deque<LogQueueItem> queue_;
+	
+	size_t                   capacity_;
+	LogOverflowPolicy        policy_;
+	int                      flushInterval_;
+	size_t                   flushSize_;
+	
+	bool                     stopping_;
+	long                     dropped_;
+	int                      users_;
+	
+public:
+	LogWriter(int capacity, LogOverflowPolicy policy, int flushInterval, int flushSize) :
+		Thread(false),
+		capacity_(capacity > 0 ? capacity : 1),
+		policy_(policy),
+		flushInterval_(flushInterval > 0 ? flushInterval : 1),
+		flushSize_(flushSize > 0 ? flushSize : 0),
+		stopping_(false),
+		dropped_(0),
+		users_(0)
+	{
+		start();
+	}
+	
+	virtual ~LogWriter() {}
+	
+	/**
+	 * \returns \c false if the writer is stopping and the record has to be
+	 *          written by the caller
+	 */
+	bool enqueue(LogLevel level, const string &text, size_t headerSize)
+	{
+		MutexLock lock(&mutex_);
+		
+		while (queue_.size() >= capacity_) {
+			if (stopping_)
+				return false;
+			if (policy_ == LOG_OVERFLOW_DROP) {
+				dropped_++;
+				droppedMetric()->add();
+				return true;
+			}
+			notFull_.wait(mutex_);
+		}
+		if (stopping_)
+			return false;
+		
+		queue_.push_back(LogQueueItem());
+		queue_.back().level = level;
+		queue_.back().text  = text;
+		queue_.back().headerSize = headerSize;
+		
+		if (queue_.size() == 1)
+			notEmpty_.signal();
+		return true;
+	}
+	
+	void stop()
+	{
+		{
+			MutexLock lock(&mutex_);
+			stopping_ = true;
+			notEmpty_.signal();
+			notFull_.broadcast();
+		}
+		join();
+	}
+	
+	/**
+	 * \brief Marks a thread that may call \ref enqueue() outside of an
+	 *        RCU read section.
+	 */
+	void acquire() { __sync_fetch_and_add(&users_, 1); }
+	void release() { __sync_fetch_and_sub(&users_, 1); }
+	
+	/**
+	 * \brief Waits until no thread is using the writer. Must be called
+	 *        after \ref stop(), which wakes blocked threads up.
+	 */
+	void waitForUsers()
+	{
+		while (__atomic_load_n(&users_, __ATOMIC_ACQUIRE) > 0)
+			sched_yield();
+	}
+	
+	long getDropped()
+	{
+		MutexLock lock(&mutex_);
+		return dropped_;
+	}
+	
+	virtual void* run()
+	{
+		getRecordState().isWriter = true;
+		
+		std::deque<LogQueueItem> batch;
+		size_t    unflushed = 0;
+		Stopwatch sinceFlush;
+		sinceFlush.start();
+		
+		while (true) {
+			bool stop = false;
+			{
+				MutexLock lock(&mutex_);
+				if (queue_.empty() && !stopping_)
+					notEmpty_.timedWait(mutex_, flushInterval_);
+				stop = stopping_ && queue_.empty();
+				batch.swap(queue_);
+				if (!batch.empty())
+					notFull_.broadcast();
+			}
+			
+			FOR_EACH(batch, item) {
+				Logger::getLogger(item->level).writeRecord(item->text, item->headerSize);
+				unflushed += item->text.size();
+			}
+			batch.clear();
+			
+			sinceFlush.end();
+			if (unflushed > 0 &&
+			    (stop ||
+			     unflushed >= flushSize_ ||
+			     sinceFlush.getMilliseconds() >= flushInterval_)) {
+				Logger::flushAll();
+				unflushed = 0;
+				sinceFlush.start();
+			}
+			
+			if (stop) break;
+		}
+		
+		return NULL;
+	}
+};
+
+
+static Mutex      asyncMutex;
+static LogWriter *asyncWriter  = NULL;
+static long       asyncDropped = 0;
+
+
+static void stopAsyncAtExit()
+{
+	Logger::stopAsync();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// LOG SITES
+////////////////////////////////////////////////////////////////////////////////
+
+
+struct LogSiteRule {
+	string file;
+	int    line;
+	bool   enabled;
+	
+	bool matches(const LogSite *site) const
+	{
+		if ((line != 0) && (line != site->line))
+			return false;
+		
+		size_t length = strlen(site->file);
+		if (file.size() > length)
+			return false;
+		return file.compare(0, file.size(), site->file + length - file.size()) == 0;
+	}
+};
+
+
+static Mutex& getSitesMutex()
+{
+	static Mutex *mutex = new Mutex();
+	return *mutex;
+}
+
+
+static vector<LogSiteRule>& getSiteRules()
+{
+	static vector<LogSiteRule> *rules = new vector<LogSiteRule>();
+	return *rules;
+}
+
+
+struct LogRateRule : public LogSiteRule {
+	long rate;
+	long burst;
+};
+
+
+static vector<LogRateRule>& getRateRules()
+{
+	static vector<LogRateRule> *rules = new vector<LogRateRule>();
+	return *rules;
+}
+
+
+static LogSite *sites = NULL;
+
+
+/**
+ * The site is unlimited while the bucket is set up, the release store of
+ * the rate publishes the bucket.
+ */
+static void setSiteRate(LogSite *site, long rate, long burst)
+{
+	__atomic_store_n(&site->rate, 0L, __ATOMIC_RELEASE);
+	__atomic_store_n(&site->burst, burst, __ATOMIC_RELAXED);
+	__atomic_store_n(&site->tokens, burst * CPPAPP_LOG_TOKEN, __ATOMIC_RELAXED);
+	__atomic_store_n(&site->refilled, 0LL, __ATOMIC_RELAXED);
+	__atomic_store_n(&site->rate, rate, __ATOMIC_RELEASE);
+}
+
+
+static void applySiteRules(LogSite *site)
+{
+	bool enabled = true;
+	FOR_EACH(getSiteRules(), rule) {
+		if (rule->matches(site))
+			enabled = rule->enabled;
+	}
+	__atomic_store_n(&site->enabled, enabled, __ATOMIC_RELAXED);
+	
+	FOR_EACH(getRateRules(), rule) {
+		if (rule->matches(site))
+			setSiteRate(site, rule->rate, rule->burst);
+	}
+}
+
+
+LogSite::LogSite(const char *file, int line, LogLevel level) :
+	file(file), line(line), level(level), enabled(true), next(NULL),
+	rate(0), burst(0), tokens(0), refilled(0)
+{
+	MutexLock lock(&getSitesMutex());
+	applySiteRules(this);
+	next  = sites;
+	sites = this;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// LOGGER
+////////////////////////////////////////////////////////////////////////////////
+
+
+vector<Logger*> Logger::levels_;
+int             Logger::enabledLevel_    = LOG_LVL_NONE;
+LogLevel        Logger::threshold_       = LOG_LVL_DEBUG;
+unsigned int    Logger::sampling_[]      = {
+	CPPAPP_LOG_SAMPLE_ALL, CPPAPP_LOG_SAMPLE_ALL, CPPAPP_LOG_SAMPLE_ALL,
+	CPPAPP_LOG_SAMPLE_ALL, CPPAPP_LOG_SAMPLE_ALL
+};
+bool            Logger::collapseRepeats_ = false;
+long            Logger::suppressed_      = 0;
+
+
+/**
+ * Serializes configuration changes.
+ */
+static Mutex& getConfigMutex()
+{
+	static Mutex *mutex = new Mutex();
+	return *mutex;
+}
+
+
+/**
+ * Serializes the records compared while collapsing repeats. Writes into
+ * the outputs are serialized by the locks of the outputs.
+ */
+static Mutex& getRepeatMutex()
+{
+	static Mutex *mutex = new Mutex();
+	return *mutex;
+}
+
+
+/**
+ * The loggers are never deleted, because records may be logged during
+ * static destruction.
+ */
 STATIC_CTOR_IMPL(Logger)
 {
-	levels_.push_back(Logger(LOG_LVL_NONE));
-	levels_.push_back(Logger(LOG_LVL_ERROR));
-	levels_.push_back(Logger(LOG_LVL_WARNING));
-	levels_.push_back(Logger(LOG_LVL_INFO));
-	levels_.push_back(Logger(LOG_LVL_DEBUG));
+	levels_.push_back(new Logger(LOG_LVL_NONE));
+	levels_.push_back(new Logger(LOG_LVL_ERROR));
+	levels_.push_back(new Logger(LOG_LVL_WARNING));
+	levels_.push_back(new Logger(LOG_LVL_INFO));
+	levels_.push_back(new Logger(LOG_LVL_DEBUG));
 	
 	defaultConfig();
+	
+	// Handlers registered later are prepared first, so the locks of the
+	// logger are taken before the lock of the RCU domain.
+	RcuDomain::global();
+	pthread_atfork(prepareFork, parentAfterFork, childAfterFork);
+}
+
+
+Logger::~Logger()
+{
+	delete outputs_;
+}
+
+
+/**
+ * Must be called with the config mutex locked, which is why the old
+ * snapshot can be read without an atomic load.
+ */
+void Logger::setOutputs(Outputs *outputs)
+{
+	Outputs *old = outputs_;
+	__atomic_store_n(&outputs_, outputs, __ATOMIC_RELEASE);
+	
+	RcuDomain::global().synchronize();
+	delete old;
+}
+
+
+/**
+ * Streams into levels that are not enabled go to the thread's null
+ * stream. It is per thread because writing into it changes its state.
+ */
+ostream& Logger::getRecordStream()
+{
+	LogRecordState &state = getRecordState();
+	if (!state.open) {
+		if (!isEnabled(level_))
+			return state.nullStream;
+		state.buffer.clear();
+		state.level = level_;
+		state.open  = true;
+	}
+	return state.stream;
+}
+
+
+/**
+ * The async writer is read under RCU and marked as used before the read
+ * section ends, so that \ref stopAsync() can delete it once no thread
+ * can be enqueueing into it. The enqueue itself may block, so it runs
+ * outside of the read section.
+ */
+void Logger::commit(bool flush)
+{
+	LogRecordState &state = getRecordState();
+	if (!state.open)
+		return;
+	state.open = false;
+	recordsMetric()->add();
+	
+	Logger &logger = getLogger(state.level);
+	
+	if (!state.isWriter) {
+		LogWriter *writer;
+		{
+			RcuReadLock guard;
+			writer = __atomic_load_n(&asyncWriter, __ATOMIC_ACQUIRE);
+			if (writer != NULL)
+				writer->acquire();
+		}
+		if (writer != NULL) {
+			bool queued = writer->enqueue(state.level, state.buffer.data(), state.headerSize);
+			writer->release();
+			if (queued)
+				return;
+		}
+	}
+	
+	logger.writeRecord(state.buffer.data(), state.headerSize);
+	if (flush)
+		logger.flush();
 }
 
 
 Logger& Logger::operator << (Logger::Entry entry)
 {
+	LogRecordState &state = getRecordState();
+	if (state.open)
+		commit(true);
+	
 	(*this)
 		<< "["
 		<< LogTime()
@@ -46,10 +507,315 @@ Logger& Logger::operator << (Logger::Entry entry)
 	(*this)
 		<< "]  ";
 	
+	state.headerSize = state.buffer.size();
+	return *this;
+}
+
+
+Logger& Logger::operator << (OStreamManipulator manip)
+{
+	if (manip == static_cast<OStreamManipulator>(std::endl)) {
+		getRecordStream() << '\n';
+		commit(true);
+	} else if (manip == static_cast<OStreamManipulator>(std::flush)) {
+		commit(true);
+	} else {
+		getRecordStream() << manip;
+	}
+	
 	return *this;
 }
 
 
+Logger& Logger::addOutput(Ref<Output> output)
+{
+	MutexLock lock(&getConfigMutex());
+	
+	Outputs *outputs = new Outputs(*outputs_);
+	outputs->push_back(output);
+	setOutputs(outputs);
+	
+	updateEnabledLevel();
+	return *this;
+}
+
+
+Logger& Logger::clearOutputs()
+{
+	MutexLock lock(&getConfigMutex());
+	
+	setOutputs(new Outputs());
+	
+	updateEnabledLevel();
+	return *this;
+}
+
+
+/**
+ * Must be called inside an RCU read section. The whole text is written
+ * to each output under the output's lock, so records written by
+ * different threads do not interleave, while threads writing to
+ * different outputs do not wait for each other. The snapshot is read
+ * once, the loop must not mix iterators of two versions of the outputs.
+ */
+void Logger::writeOutputs(const string &text)
+{
+	const Outputs *outputs = __atomic_load_n(&outputs_, __ATOMIC_ACQUIRE);
+	FOR_EACH(*outputs, output) {
+		MutexLock lock(&(*output)->getWriteMutex());
+		(*output)->getStream()->write(text.data(), text.size());
+	}
+}
+
+
+void Logger::write(const string &record)
+{
+	RcuReadLock guard;
+	writeOutputs(record);
+}
+
+
+/**
+ * \brief The last record written while collapsing repeats.
+ *
+ * Protected by the repeat mutex.
+ */
+struct LogRepeatState {
+	LogLevel level;
+	string   message;
+	long     count;
+	/// When the first repeat not reported yet was suppressed.
+	uint64_t since;
+	
+	LogRepeatState() : level(LOG_LVL_NONE), count(0), since(0) {}
+};
+
+
+static LogRepeatState& getRepeatState()
+{
+	static LogRepeatState *state = new LogRepeatState();
+	return *state;
+}
+
+
+static int repeatInterval = CPPAPP_LOG_REPEAT_INTERVAL;
+
+
+/**
+ * Returns the line reporting the repeats of the last record, or an empty
+ * string if it was not repeated.
+ */
+static string formatRepeatSummary(const LogRepeatState &repeat)
+{
+	if (repeat.count == 0)
+		return string();
+	
+	ostringstream s;
+	s << "[" << LogTime() << " " << Logger::logLevelToString(repeat.level) << "]  "
+	  << "last message repeated " << repeat.count << " times\n";
+	return s.str();
+}
+
+
+/**
+ * Returns the summary of the repeats of the last record and forgets the
+ * record.
+ */
+static string takeRepeatSummary(LogRepeatState &repeat, LogLevel *level)
+{
+	string result = formatRepeatSummary(repeat);
+	*level = repeat.level;
+	repeat.level = LOG_LVL_NONE;
+	repeat.message.clear();
+	repeat.count = 0;
+	return result;
+}
+
+
+/**
+ * Returns \c true if there are repeats that have not been reported for
+ * longer than the repeat interval.
+ */
+static bool isRepeatDue(const LogRepeatState &repeat)
+{
+	return (repeat.count > 0) &&
+	       (Clock::nanos() - repeat.since >=
+	        (uint64_t)__atomic_load_n(&repeatInterval, __ATOMIC_RELAXED) * 1000000);
+}
+
+
+/**
+ * \brief Background thread that reports repeats of the last record when
+ *        no other record follows them.
+ */
+class LogRepeatFlusher : public Thread {
+private:
+	Mutex     mutex_;
+	Condition changed_;
+	bool      stopping_;
+	
+public:
+	LogRepeatFlusher() :
+		Thread(false),
+		stopping_(false)
+	{
+		start();
+	}
+	
+	void stop()
+	{
+		{
+			MutexLock lock(&mutex_);
+			stopping_ = true;
+			changed_.broadcast();
+		}
+		join();
+	}
+	
+	virtual void* run()
+	{
+		while (true) {
+			{
+				MutexLock lock(&mutex_);
+				if (!stopping_)
+					changed_.timedWait(mutex_, __atomic_load_n(&repeatInterval, __ATOMIC_RELAXED));
+				if (stopping_)
+					break;
+			}
+			Logger::flushRepeats();
+		}
+		return NULL;
+	}
+};
+
+
+static Mutex             repeatFlusherMutex;
+static LogRepeatFlusher *repeatFlusher = NULL;
+
+
+static void stopRepeatsAtExit()
+{
+	Logger::setCollapseRepeats(false);
+}
+
+
+/**
+ * Writes a committed record. The message (the part after the header)
+ * is compared with the previous record if repeats are collapsed. The
+ * flag is checked again under the repeat mutex, under which it is
+ * cleared, so no repeat is counted after the last summary.
+ */
+void Logger::writeRecord(const string &text, size_t headerSize)
+{
+	if (!__atomic_load_n(&collapseRepeats_, __ATOMIC_ACQUIRE)) {
+		write(text);
+		return;
+	}
+	
+	RcuReadLock guard;
+	MutexLock   lock(&getRepeatMutex());
+	
+	if (!collapseRepeats_) {
+		writeOutputs(text);
+		return;
+	}
+	
+	LogRepeatState &repeat = getRepeatState();
+	if ((repeat.level == level_) &&
+	    (text.compare(headerSize, string::npos, repeat.message) == 0)) {
+		if (repeat.count == 0)
+			repeat.since = Clock::nanos();
+		repeat.count++;
+		__sync_fetch_and_add(&suppressed_, 1);
+		suppressedMetric()->add();
+		
+		// A long burst is reported periodically, not only when it ends.
+		if (isRepeatDue(repeat)) {
+			writeOutputs(formatRepeatSummary(repeat));
+			repeat.count = 0;
+		}
+		return;
+	}
+	
+	LogLevel summaryLevel;
+	string   summary = takeRepeatSummary(repeat, &summaryLevel);
+	if (!summary.empty())
+		getLogger(summaryLevel).writeOutputs(summary);
+	
+	repeat.level = level_;
+	repeat.message.assign(text, headerSize, string::npos);
+	
+	writeOutputs(text);
+}
+
+
+/**
+ * Reports the repeats of the last record that have been pending for
+ * longer than the repeat interval, so that a burst followed by silence
+ * is not held back.
+ */
+void Logger::flushRepeats()
+{
+	RcuReadLock guard;
+	Logger     *logger;
+	{
+		MutexLock lock(&getRepeatMutex());
+		
+		LogRepeatState &repeat = getRepeatState();
+		if (!isRepeatDue(repeat))
+			return;
+		
+		logger = &getLogger(repeat.level);
+		logger->writeOutputs(formatRepeatSummary(repeat));
+		repeat.count = 0;
+	}
+	logger->flush();
+}
+
+
+void Logger::flush()
+{
+	RcuReadLock guard;
+	
+	const Outputs *outputs = __atomic_load_n(&outputs_, __ATOMIC_ACQUIRE);
+	FOR_EACH(*outputs, output) {
+		MutexLock lock(&(*output)->getWriteMutex());
+		(*output)->getStream()->flush();
+	}
+}
+
+
+/**
+ * Outputs shared by several levels are flushed only once. Pending
+ * repeats of the last record are reported first.
+ */
+void Logger::flushAll()
+{
+	std::set<Output*> flushed;
+	
+	RcuReadLock guard;
+	
+	{
+		MutexLock lock(&getRepeatMutex());
+		
+		LogLevel summaryLevel;
+		string   summary = takeRepeatSummary(getRepeatState(), &summaryLevel);
+		if (!summary.empty())
+			getLogger(summaryLevel).writeOutputs(summary);
+	}
+	
+	FOR_EACH(levels_, lvl) {
+		const Outputs *outputs = __atomic_load_n(&(*lvl)->outputs_, __ATOMIC_ACQUIRE);
+		FOR_EACH(*outputs, output) {
+			if (flushed.insert(output->getPtr()).second) {
+				MutexLock lock(&(*output)->getWriteMutex());
+				(*output)->getStream()->flush();
+			}
+		}
+	}
+}
+
+
 const char* Logger::logLevelToString(LogLevel level)
 {
 	switch (level) {
@@ -66,9 +832,9 @@ const char* Logger::logLevelToString(LogLevel level)
 Logger& Logger::getLogger(LogLevel level)
 {
 	if (level > LOG_LVL_DEBUG)
-		return levels_[LOG_LVL_NONE];
+		return *levels_[LOG_LVL_NONE];
 	
-	return levels_[level];
+	return *levels_[level];
 }
 
 
@@ -78,7 +844,7 @@ void Logger::addOutput(LogLevel level, Ref<Output> output)
 		level = (LogLevel)(levels_.size() - 1);
 	
 	for (int l = LOG_LVL_ERROR; l <= level; l++) {
-		levels_[l].addOutput(output);
+		levels_[l]->addOutput(output);
 	}
 }
 
@@ -103,7 +869,7 @@ void Logger::addOutput(LogLevel level, string fileName)
 void Logger::clearConfig()
 {
 	FOR_EACH(levels_, lvl) {
-		lvl->clearOutputs();
+		(*lvl)->clearOutputs();
 	}
 }
 
@@ -140,6 +906,350 @@ void Logger::defaultConfig()
 }
 
 
+void Logger::updateEnabledLevel()
+{
+	int level = LOG_LVL_NONE;
+	
+	for (int l = LOG_LVL_ERROR; (l <= threshold_) && (l < (int)levels_.size()); l++) {
+		if (levels_[l]->outputs_->size() > 0)
+			level = l;
+	}
+	
+	__atomic_store_n(&enabledLevel_, level, __ATOMIC_RELAXED);
+}
+
+
+void Logger::setThreshold(LogLevel level)
+{
+	MutexLock lock(&getConfigMutex());
+	
+	threshold_ = level;
+	updateEnabledLevel();
+}
+
+
+void Logger::setSiteEnabled(const string &file, int line, bool enabled)
+{
+	MutexLock lock(&getSitesMutex());
+	
+	LogSiteRule rule;
+	rule.file    = file;
+	rule.line    = line;
+	rule.enabled = enabled;
+	getSiteRules().push_back(rule);
+	
+	for (LogSite *site = sites; site != NULL; site = site->next) {
+		if (rule.matches(site))
+			__atomic_store_n(&site->enabled, enabled, __ATOMIC_RELAXED);
+	}
+}
+
+
+void Logger::resetSites()
+{
+	MutexLock lock(&getSitesMutex());
+	
+	getSiteRules().clear();
+	getRateRules().clear();
+	for (LogSite *site = sites; site != NULL; site = site->next) {
+		__atomic_store_n(&site->enabled, true, __ATOMIC_RELAXED);
+		__atomic_store_n(&site->rate, 0L, __ATOMIC_RELEASE);
+	}
+}
+
+
+void Logger::setRateLimit(const string &file, int line, double perSecond, int burst)
+{
+	MutexLock lock(&getSitesMutex());
+	
+	LogRateRule rule;
+	rule.file    = file;
+	rule.line    = line;
+	rule.enabled = true;
+	rule.rate    = (perSecond > 0) ? (long)(perSecond * 1000.0 + 0.5) : 0;
+	rule.burst   = (burst > 0) ? burst : 1;
+	if ((perSecond > 0) && (rule.rate == 0))
+		rule.rate = 1;
+	getRateRules().push_back(rule);
+	
+	for (LogSite *site = sites; site != NULL; site = site->next) {
+		if (rule.matches(site))
+			setSiteRate(site, rule.rate, rule.burst);
+	}
+}
+
+
+void Logger::setSampling(LogLevel level, double probability)
+{
+	if ((level < LOG_LVL_NONE) || (level > LOG_LVL_DEBUG))
+		return;
+	
+	unsigned int threshold;
+	if (probability >= 1.0)
+		threshold = CPPAPP_LOG_SAMPLE_ALL;
+	else if (probability <= 0.0)
+		threshold = 0;
+	else
+		threshold = (unsigned int)(probability * (double)CPPAPP_LOG_SAMPLE_ALL);
+	__atomic_store_n(&sampling_[level], threshold, __ATOMIC_RELAXED);
+}
+
+
+/**
+ * The flag is changed under the repeat mutex before the pending repeats
+ * are reported, so that a record collapsed concurrently is either in the
+ * report or written as usual. The flusher thread is stopped (and the
+ * pending repeats reported) at exit.
+ */
+void Logger::setCollapseRepeats(bool collapse, int interval)
+{
+	LogRepeatFlusher *stopped = NULL;
+	{
+		MutexLock lock(&repeatFlusherMutex);
+		
+		{
+			MutexLock repeatLock(&getRepeatMutex());
+			__atomic_store_n(&collapseRepeats_, collapse, __ATOMIC_RELEASE);
+		}
+		
+		if (collapse) {
+			__atomic_store_n(&repeatInterval, (interval > 0) ? interval : 1, __ATOMIC_RELAXED);
+			if (repeatFlusher == NULL) {
+				static bool atExitRegistered = false;
+				if (!atExitRegistered) {
+					atexit(stopRepeatsAtExit);
+					atExitRegistered = true;
+				}
+				repeatFlusher = new LogRepeatFlusher();
+			}
+		} else {
+			stopped       = repeatFlusher;
+			repeatFlusher = NULL;
+		}
+	}
+	
+	if (stopped != NULL) {
+		stopped->stop();
+		delete stopped;
+	}
+	
+	if (!collapse)
+		flushAll();
+}
+
+
+/**
+ * Per-thread xorshift generator used for sampling.
+ */
+static inline unsigned int nextSample()
+{
+	static __thread unsigned int state = 0;
+	
+	unsigned int x = state;
+	if (x == 0)
+		x = (unsigned int)(size_t)&state ^ (unsigned int)time(NULL) ^ 0x9e3779b9U;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	state = x;
+	return x;
+}
+
+
+/**
+ * The bucket is refilled by the thread that wins the CAS on the refill
+ * time. Refills and takes are CAS loops on the tokens, so neither loses
+ * the other's update and the bucket never holds more than the burst.
+ */
+static bool takeToken(LogSite &site)
+{
+	long rate = site.getRate();
+	if (rate == 0)
+		return true;
+	
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	long long now      = (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+	long long last     = __atomic_load_n(&site.refilled, __ATOMIC_RELAXED);
+	long long capacity = __atomic_load_n(&site.burst, __ATOMIC_RELAXED) * CPPAPP_LOG_TOKEN;
+	
+	if ((now > last) && __sync_bool_compare_and_swap(&site.refilled, last, now)) {
+		// Elapsed time is capped so that the product cannot overflow.
+		long long elapsed = now - last;
+		long long full    = capacity / rate + 1;
+		if ((last == 0) || (elapsed > full))
+			elapsed = full;
+		
+		long long tokens = __atomic_load_n(&site.tokens, __ATOMIC_RELAXED);
+		while (true) {
+			long long refilled = tokens + elapsed * rate;
+			if (refilled > capacity)
+				refilled = capacity;
+			long long previous = __sync_val_compare_and_swap(&site.tokens, tokens, refilled);
+			if (previous == tokens)
+				break;
+			tokens = previous;
+		}
+	}
+	
+	long long tokens = __atomic_load_n(&site.tokens, __ATOMIC_RELAXED);
+	while (true) {
+		if (tokens < CPPAPP_LOG_TOKEN)
+			return false;
+		long long previous = __sync_val_compare_and_swap(&site.tokens, tokens, tokens - CPPAPP_LOG_TOKEN);
+		if (previous == tokens)
+			return true;
+		tokens = previous;
+	}
+}
+
+
+bool Logger::admitSlow(LogSite &site)
+{
+	unsigned int threshold = __atomic_load_n(&sampling_[site.level], __ATOMIC_RELAXED);
+	if ((threshold != CPPAPP_LOG_SAMPLE_ALL) && (nextSample() >= threshold)) {
+		__sync_fetch_and_add(&suppressed_, 1);
+		suppressedMetric()->add();
+		return false;
+	}
+	
+	if (!takeToken(site)) {
+		__sync_fetch_and_add(&suppressed_, 1);
+		suppressedMetric()->add();
+		return false;
+	}
+	return true;
+}
+
+
+void Logger::startAsync(int               queueSize,
+                        LogOverflowPolicy policy,
+                        int               flushInterval,
+                        int               flushSize)
+{
+	MutexLock lock(&asyncMutex);
+	
+	if (asyncWriter != NULL)
+		return;
+	
+	static bool atExitRegistered = false;
+	if (!atExitRegistered) {
+		atexit(stopAsyncAtExit);
+		atExitRegistered = true;
+	}
+	
+	__atomic_store_n(&asyncWriter, new LogWriter(queueSize, policy, flushInterval, flushSize),
+	                 __ATOMIC_RELEASE);
+}
+
+
+/**
+ * The writer is deleted only after no committing thread can still be
+ * using it: after the grace period no thread can start using it, and
+ * the threads that have already started are woken up by stop().
+ */
+void Logger::stopAsync()
+{
+	MutexLock lock(&asyncMutex);
+	
+	if (asyncWriter == NULL)
+		return;
+	
+	LogWriter *writer = asyncWriter;
+	__atomic_store_n(&asyncWriter, (LogWriter*)NULL, __ATOMIC_RELEASE);
+	
+	writer->stop();
+	asyncDropped += writer->getDropped();
+	
+	RcuDomain::global().synchronize();
+	writer->waitForUsers();
+	delete writer;
+}
+
+
+bool Logger::isAsync()
+{
+	return __atomic_load_n(&asyncWriter, __ATOMIC_ACQUIRE) != NULL;
+}
+
+
+long Logger::getDroppedCount()
+{
+	MutexLock lock(&asyncMutex);
+	
+	long result = asyncDropped;
+	if (asyncWriter != NULL)
+		result += asyncWriter->getDropped();
+	return result;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// FORK
+////////////////////////////////////////////////////////////////////////////////
+
+
+/**
+ * Outputs locked across fork(), ordered by address.
+ */
+static vector<Output*> forkOutputs;
+
+
+/**
+ * All locks of the logger are taken before fork(), so that the child
+ * does not inherit a lock held by a thread that does not exist there.
+ * The outputs cannot change while the config mutex is locked.
+ */
+void Logger::prepareFork()
+{
+	asyncMutex.lock();
+	getConfigMutex().lock();
+	repeatFlusherMutex.lock();
+	getSitesMutex().lock();
+	getRepeatMutex().lock();
+	
+	std::set<Output*> outputs;
+	FOR_EACH(levels_, lvl) {
+		const Outputs *levelOutputs = (*lvl)->outputs_;
+		FOR_EACH(*levelOutputs, output) {
+			outputs.insert(output->getPtr());
+		}
+	}
+	forkOutputs.assign(outputs.begin(), outputs.end());
+	FOR_EACH(forkOutputs, output) {
+		(*output)->getWriteMutex().lock();
+	}
+}
+
+
+void Logger::parentAfterFork()
+{
+	for (VAR(output, forkOutputs.rbegin()); output != forkOutputs.rend(); ++output)
+		(*output)->getWriteMutex().unlock();
+	forkOutputs.clear();
+	
+	getRepeatMutex().unlock();
+	getSitesMutex().unlock();
+	repeatFlusherMutex.unlock();
+	getConfigMutex().unlock();
+	asyncMutex.unlock();
+}
+
+
+/**
+ * The writer and flusher threads do not exist in the child. Records
+ * committed in the child are written synchronously; the records queued
+ * in the parent are written by the parent.
+ */
+void Logger::childAfterFork()
+{
+	asyncWriter   = NULL;
+	repeatFlusher = NULL;
+	
+	parentAfterFork();
+}
+
+
 vector<string> Logger::getBacktrace()
 {
 	void* buffer[30];
@@ -162,13 +1272,26 @@ vector<string> Logger::getBacktrace()
 }
 
 
+/**
+ * The formatted time is cached per thread and reformatted only when
+ * the second changes.
+ */
 ostream& operator << (ostream& output, const LogTime& tm)
 {
+	static __thread time_t cachedTime   = 0;
+	static __thread int    cachedLength = 0;
+	static __thread char   cachedText[80];
+	
 	time_t t = time(NULL);
-	char buffer[80];
-	int length = strftime(buffer, 80, "%Y-%m-%d %a %H:%M:%S", localtime(&t));
-	if (length > 0)
-		output << buffer;
+	if ((t != cachedTime) || (cachedLength <= 0)) {
+		struct tm local;
+		localtime_r(&t, &local);
+		cachedLength = strftime(cachedText, 80, "%Y-%m-%d %a %H:%M:%S", &local);
+		cachedTime   = t;
+	}
+	
+	if (cachedLength > 0)
+		output.write(cachedText, cachedLength);
 	else
 		output << "#error#";
 	return output;
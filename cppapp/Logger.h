@@ -18,19 +18,27 @@
 #	define LOG_ASSERTION(expr)
 #	define LOG_EXPR(expr)
 #else // LOG_DISABLE
-#	define LOG_ERROR(message__) { \
-		cppapp::Logger::error() << cppapp::Logger::Entry(__FILE__, __LINE__) << \
-		message__ << flush << endl; }
-#	define LOG_WARNING(message__) { \
-		cppapp::Logger::warning() << cppapp::Logger::Entry(__FILE__, __LINE__) << \
-		message__ << flush << endl; }
-#	define LOG_INFO(message__) { \
-		cppapp::Logger::info() << cppapp::Logger::Entry(__FILE__, __LINE__) << \
-		message__ << flush << endl; }
+/**
+ * \brief Logs a message at the given level.
+ *
+ * The message expression is not evaluated at all unless the level is
+ * enabled (see cppapp::Logger::isEnabled()), the call site has not
+ * been disabled (see cppapp::Logger::setSiteEnabled()) and the record
+ * passes rate limiting and sampling (see cppapp::Logger::admit()).
+ */
+#	define LOG_AT(level__, message__) { \
+		if (cppapp::Logger::isEnabled(level__)) { \
+			static cppapp::LogSite logSite__(__FILE__, __LINE__, level__); \
+			if (logSite__.isEnabled() && cppapp::Logger::admit(logSite__)) { \
+				cppapp::Logger::getLogger(level__) << \
+					cppapp::Logger::Entry(logSite__) << message__ << endl; \
+			} \
+		} }
+#	define LOG_ERROR(message__)   LOG_AT(cppapp::LOG_LVL_ERROR, message__)
+#	define LOG_WARNING(message__) LOG_AT(cppapp::LOG_LVL_WARNING, message__)
+#	define LOG_INFO(message__)    LOG_AT(cppapp::LOG_LVL_INFO, message__)
 #	ifndef NDEBUG
-#		define LOG_DEBUG(message__) { \
-			cppapp::Logger::debug() << cppapp::Logger::Entry(__FILE__, __LINE__) << \
-			message__ << flush << endl; }
+#		define LOG_DEBUG(message__) LOG_AT(cppapp::LOG_LVL_DEBUG, message__)
 #		define LOG_ASSERTION(expr) { \
 			if (!(expr)) LOG_ERROR("Assertion \"" #expr "\" failed!"); \
 			assert(expr); }
@@ -69,43 +77,170 @@ enum LogLevel {
 };
 
 
+/**
+ * \brief Policy applied by the asynchronous logger when its queue is full.
+ */
+enum LogOverflowPolicy {
+	/// The logging thread waits until the writer thread makes room.
+	LOG_OVERFLOW_BLOCK,
+	/// The record is discarded and counted (see Logger::getDroppedCount()).
+	LOG_OVERFLOW_DROP
+};
+
+
+/**
+ * \brief Static information about a single LOG_* call site.
+ *
+ * Instances are created by the LOG_* macros as function-local statics,
+ * so each call site is registered only once, the first time it logs.
+ * The settings and the token bucket are shared by all threads logging
+ * from the site and are only accessed atomically.
+ */
+struct LogSite {
+	const char *file;
+	int         line;
+	LogLevel    level;
+	/// Records from this site are discarded if \c false.
+	bool        enabled;
+	LogSite    *next;
+	
+	/// Records per second allowed (in 1/1000), 0 if the site is not limited.
+	long        rate;
+	/// Maximum number of records allowed in a burst.
+	long        burst;
+	/// Tokens of the token bucket (in 1/CPPAPP_LOG_TOKEN).
+	long long   tokens;
+	/// Time of the last refill of the token bucket (in ns).
+	long long   refilled;
+	
+	LogSite(const char *file, int line, LogLevel level);
+	
+	bool isEnabled() const { return __atomic_load_n(&enabled, __ATOMIC_RELAXED); }
+	/**
+	 * \brief Returns the rate; the bucket set up with it is visible once
+	 *        it is not 0.
+	 */
+	long getRate() const   { return __atomic_load_n(&rate, __ATOMIC_ACQUIRE); }
+};
+
+
+#define CPPAPP_LOG_TOKEN      1000000000000LL
+#define CPPAPP_LOG_SAMPLE_ALL 0xffffffffU
+
+
+#define CPPAPP_LOG_QUEUE_SIZE     8192
+#define CPPAPP_LOG_FLUSH_INTERVAL 200
+#define CPPAPP_LOG_FLUSH_SIZE     65536
+
+/// Default time in milliseconds after which repeats of a record are
+/// reported even if no other record follows.
+#define CPPAPP_LOG_REPEAT_INTERVAL 1000
+
+
+/**
+ * \brief Growable character buffer used to format a single log record.
+ *
+ * The buffer is reused for all records of a thread, so formatting
+ * a record doesn't allocate once the buffer has grown large enough.
+ */
+class LogBuffer : public std::streambuf {
+private:
+	std::string data_;
+
+protected:
+	virtual int_type overflow(int_type c)
+	{
+		if (c != traits_type::eof())
+			data_.push_back((char)c);
+		return c;
+	}
+	
+	virtual std::streamsize xsputn(const char *s, std::streamsize n)
+	{
+		data_.append(s, n);
+		return n;
+	}
+
+public:
+	const std::string& data() const { return data_; }
+	size_t size() const { return data_.size(); }
+	void clear() { data_.clear(); }
+};
+
+
 /**
  * \brief Simple logging class.
+ *
+ * Each thread formats a record into its own \ref LogBuffer. The record
+ * is started by streaming a \ref Logger::Entry and it is committed by
+ * streaming \c endl (or \c flush). Committed records are either written
+ * to the outputs directly or, after \ref startAsync() has been called,
+ * handed over to a background writer thread.
+ *
+ * Loggers can be used from any number of threads. A committed record is
+ * written to each output as a whole, so records of different threads
+ * never interleave. The list of outputs is an immutable snapshot
+ * replaced by \ref addOutput() and \ref clearOutputs() and read under
+ * RCU (see \ref RcuDomain), so writers never wait for configuration
+ * changes.
  */
 class Logger : public Object {
+public:
+	typedef vector<Ref<Output> > Outputs;
+
 private:
-	static vector<Logger> levels_;
+	static vector<Logger*>  levels_;
+	static int              enabledLevel_;
+	static LogLevel         threshold_;
+	static unsigned int     sampling_[LOG_LVL_DEBUG + 1];
+	static bool             collapseRepeats_;
+	static long             suppressed_;
 	
-	LogLevel             level_;
-	vector<Ref<Output> > outputs_;
+	static void updateEnabledLevel();
+	static bool admitSlow(LogSite &site);
+	
+	LogLevel  level_;
+	/// Published with a release store, read with an acquire load.
+	Outputs  *outputs_;
+	
+	Logger(const Logger &other);
+	Logger& operator=(const Logger &other);
+	
+	void     setOutputs(Outputs *outputs);
+	void     writeOutputs(const string &text);
+	
+	ostream& getRecordStream();
+	void     commit(bool flush);
+	
+	friend class LogWriter;
+	void     writeRecord(const string &text, size_t headerSize);
+	
+	friend class LogRepeatFlusher;
+	static void flushRepeats();
+	
+	static void prepareFork();
+	static void parentAfterFork();
+	static void childAfterFork();
 	
 public:
 	STATIC_CTOR_HEADER(Logger)
 	
-	Logger() : level_(LOG_LVL_NONE) { }
-	Logger(LogLevel level) : level_(level) { }
+	Logger() : level_(LOG_LVL_NONE), outputs_(new Outputs()) { }
+	Logger(LogLevel level) : level_(level), outputs_(new Outputs()) { }
+	virtual ~Logger();
 	
 	struct Entry;
 	Logger& operator << (Logger::Entry entry);
 	
 	template<class T>
-	Logger& operator << (T value)
+	Logger& operator << (const T& value)
 	{
-		FOR_EACH(outputs_, output) {
-			*((*output)->getStream()) << value;
-		}
-		
+		getRecordStream() << value;
 		return *this;
 	}
 	
 	typedef ostream& (*OStreamManipulator)(ostream& os);
-	Logger& operator << (OStreamManipulator manip)
-	{
-		FOR_EACH(outputs_, output)
-			*((*output)->getStream()) << manip;
-
-		return *this;
-	}
+	Logger& operator << (OStreamManipulator manip);
 	
 	Logger& operator << (const vector<string>& strings)
 	{
@@ -115,8 +250,32 @@ public:
 		return *this;
 	}
 	
-	Logger& addOutput(Ref<Output> output) { outputs_.push_back(output); return *this; }
-	Logger& clearOutputs() { outputs_.clear(); return *this; }
+	LogLevel getLevel() const { return level_; }
+	
+	/**
+	 * \name Configuration
+	 *
+	 * Configuration changes are serialized and they wait until no thread
+	 * writes to the replaced outputs, so they must not be called while
+	 * writing a record.
+	 */
+	///@{
+	Logger& addOutput(Ref<Output> output);
+	Logger& clearOutputs();
+	///@}
+	
+	/**
+	 * \brief Writes a finished record to all outputs of this logger.
+	 */
+	void write(const string &record);
+	/**
+	 * \brief Flushes all outputs of this logger.
+	 */
+	void flush();
+	/**
+	 * \brief Flushes the outputs of all levels.
+	 */
+	static void flushAll();
 	
 	static const char* logLevelToString(LogLevel level);
 	
@@ -134,22 +293,151 @@ public:
 	static void defaultConfig(string fileName);
 	static void defaultConfig();
 	
+	/**
+	 * \name Filtering
+	 */
+	///@{
+	/**
+	 * \brief Returns \c true if records of \p level would be written
+	 *        anywhere.
+	 *
+	 * A level is enabled if it is not above the threshold (see
+	 * \ref setThreshold()) and it has at least one output. This is
+	 * a single comparison, so it is checked by the LOG_* macros before
+	 * the message is evaluated.
+	 */
+	static inline bool isEnabled(LogLevel level)
+	{
+		return level <= __atomic_load_n(&enabledLevel_, __ATOMIC_RELAXED);
+	}
+	/**
+	 * \brief Sets the most verbose level that is logged.
+	 */
+	static void     setThreshold(LogLevel level);
+	static LogLevel getThreshold() { return threshold_; }
+	/**
+	 * \brief Enables or disables LOG_* call sites.
+	 *
+	 * The setting applies to the sites that have already logged as well as
+	 * to those that will log in the future. Later settings override
+	 * earlier ones.
+	 *
+	 * \param file    suffix of the source file name (for example
+	 *                \c "DynObject.cpp"); empty string matches all files
+	 * \param line    line of the call site, 0 matches all lines
+	 * \param enabled whether the matching sites should log
+	 */
+	static void setSiteEnabled(const string &file, int line, bool enabled);
+	/**
+	 * \brief Re-enables all call sites and forgets all site settings.
+	 */
+	static void resetSites();
+	
+	/**
+	 * \brief Returns \c true if a record from \p site should be logged.
+	 *
+	 * Called by the LOG_* macros after the site has been checked to be
+	 * enabled. Sites without a rate limit at levels that are not sampled
+	 * are admitted after two comparisons.
+	 */
+	static inline bool admit(LogSite &site)
+	{
+		if ((site.getRate() == 0) &&
+		    (__atomic_load_n(&sampling_[site.level], __ATOMIC_RELAXED) == CPPAPP_LOG_SAMPLE_ALL))
+			return true;
+		return admitSlow(site);
+	}
+	/**
+	 * \brief Limits the number of records logged by call sites.
+	 *
+	 * Each matching site gets its own token bucket, which allows bursts
+	 * of up to \p burst records and then \p perSecond records per second.
+	 * Sites are matched the same way as by \ref setSiteEnabled().
+	 *
+	 * \param perSecond records per second, 0 removes the limit
+	 * \param burst     size of the bucket (at least 1)
+	 */
+	static void setRateLimit(const string &file, int line, double perSecond, int burst = 1);
+	/**
+	 * \brief Logs only a random fraction of records of a level.
+	 *
+	 * \param probability probability that a record is logged, 1 logs all
+	 */
+	static void setSampling(LogLevel level, double probability);
+	/**
+	 * \brief Collapses identical consecutive records.
+	 *
+	 * A record whose message equals the message of the previous record at
+	 * the same level is not written. Instead, a line saying how many times
+	 * the message was repeated is written before the next different
+	 * record, by \ref flushAll(), or once the first unreported repeat is
+	 * \p interval milliseconds old. A background thread checks the age
+	 * while collapsing is enabled, so the line is written even if no
+	 * other record follows.
+	 */
+	static void setCollapseRepeats(bool collapse, int interval = CPPAPP_LOG_REPEAT_INTERVAL);
+	/**
+	 * \brief Returns the number of records discarded by rate limiting,
+	 *        sampling and collapsing.
+	 */
+	static long getSuppressedCount() { return __atomic_load_n(&suppressed_, __ATOMIC_RELAXED); }
+	///@}
+	
+	/**
+	 * \name Asynchronous Logging
+	 */
+	///@{
+	/**
+	 * \brief Starts the background writer thread.
+	 *
+	 * From now on, committed records are put into a bounded queue and
+	 * written (and flushed) by the writer thread in batches.
+	 *
+	 * \param queueSize       maximum number of records waiting in the queue
+	 * \param policy          what to do when the queue is full
+	 * \param flushInterval   maximum time in milliseconds a written record
+	 *                        may stay unflushed
+	 * \param flushSize       number of written bytes after which the
+	 *                        outputs are flushed regardless of time
+	 */
+	static void startAsync(int               queueSize     = CPPAPP_LOG_QUEUE_SIZE,
+	                       LogOverflowPolicy policy        = LOG_OVERFLOW_BLOCK,
+	                       int               flushInterval = CPPAPP_LOG_FLUSH_INTERVAL,
+	                       int               flushSize     = CPPAPP_LOG_FLUSH_SIZE);
+	/**
+	 * \brief Writes all queued records and stops the writer thread.
+	 *
+	 * Called automatically at exit if asynchronous logging is running.
+	 */
+	static void stopAsync();
+	static bool isAsync();
+	/**
+	 * \brief Returns the number of records dropped because of a full queue.
+	 */
+	static long getDroppedCount();
+	///@}
+	
 	static vector<string> getBacktrace();
 	
 	
 	struct Entry {
-		string fileName;
-		int    lineNumber;
+		const char *fileName;
+		int         lineNumber;
 		
 		Entry() :
 			fileName("<unknown>"),
 			lineNumber(0)
 		{}
 		
-		Entry(string fileName, int lineNumber) :
+		Entry(const char *fileName, int lineNumber) :
 			fileName(fileName),
 			lineNumber(lineNumber)
 		{}
+		
+		Entry(const LogSite &site) :
+			fileName(site.file),
+			lineNumber(site.line)
+		{}
 	};
 };
 
@@ -0,0 +1,283 @@
+/**
+ * \file   Metrics.cpp
+ * \author Jan Milík <milikjan@fit.cvut.cz>
+ * \date   2026-10-19
+ *
+ * \brief  Implementation file for the metrics registry.
+ */
+
+#include "Metrics.h"
+
+#include <cstdlib>
+#include <new>
+#include <stdexcept>
+
+#include "Thread.h"
+#include "utils.h"
+
+
+namespace cppapp {
+
+
+////////////////////////////////////////////////////////////////////////////////
+// SHARDS
+////////////////////////////////////////////////////////////////////////////////
+
+
+__thread int metricShardIndex = -1;
+
+static int nextMetricShard = 0;
+
+
+int assignMetricShard()
+{
+	metricShardIndex = __sync_fetch_and_add(&nextMetricShard, 1) % CPPAPP_METRIC_SHARDS;
+	return metricShardIndex;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// METRICS
+////////////////////////////////////////////////////////////////////////////////
+
+
+void* MetricCounter::operator new(size_t size)
+{
+	void *ptr = NULL;
+	if (posix_memalign(&ptr, CPPAPP_CACHE_LINE, size) != 0)
+		throw std::bad_alloc();
+	return ptr;
+}
+
+
+void MetricCounter::operator delete(void *ptr)
+{
+	free(ptr);
+}
+
+
+MetricCounter::MetricCounter(const std::string &name, const std::string &help) :
+	Metric(name, help)
+{
+	for (int i = 0; i < CPPAPP_METRIC_SHARDS; i++)
+		shards_[i].value = 0;
+}
+
+
+long long MetricCounter::get() const
+{
+	long long result = 0;
+	for (int i = 0; i < CPPAPP_METRIC_SHARDS; i++)
+		result += shards_[i].value;
+	return result;
+}
+
+
+void MetricCounter::writeSamples(std::ostream &out) const
+{
+	out << getName() << " " << get() << "\n";
+}
+
+
+void MetricGauge::writeSamples(std::ostream &out) const
+{
+	out << getName() << " " << get() << "\n";
+}
+
+
+void MetricHistogram::writeSamples(std::ostream &out) const
+{
+	static const double quantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+	
+	LatencyHistogram histogram = snapshot();
+	for (int i = 0; i < 4; i++) {
+		out << getName() << "{quantile=\"" << quantiles[i] << "\"} " <<
+			histogram.getPercentile(quantiles[i] * 100) / 1e9 << "\n";
+	}
+	out << getName() << "_sum " << histogram.getMean() * histogram.getCount() / 1e9 << "\n";
+	out << getName() << "_count " << histogram.getCount() << "\n";
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// METRICS REGISTRY
+////////////////////////////////////////////////////////////////////////////////
+
+
+MetricsRegistry::~MetricsRegistry()
+{
+	FOR_EACH(metrics_, metric) {
+		delete metric->second;
+	}
+}
+
+
+template<class T>
+T* MetricsRegistry::getOrCreate(const std::string &name, const std::string &help)
+{
+	MutexLock lock(&mutex_);
+	
+	VAR(found, metrics_.find(name));
+	if (found == metrics_.end()) {
+		T *metric = new T(name, help);
+		metrics_[name] = metric;
+		return metric;
+	}
+	
+	T *metric = dynamic_cast<T*>(found->second);
+	if (metric == NULL)
+		throw std::invalid_argument("Metric " + name + " is registered with another type.");
+	return metric;
+}
+
+
+MetricCounter* MetricsRegistry::counter(const std::string &name, const std::string &help)
+{
+	return getOrCreate<MetricCounter>(name, help);
+}
+
+
+MetricGauge* MetricsRegistry::gauge(const std::string &name, const std::string &help)
+{
+	return getOrCreate<MetricGauge>(name, help);
+}
+
+
+MetricHistogram* MetricsRegistry::histogram(const std::string &name, const std::string &help)
+{
+	return getOrCreate<MetricHistogram>(name, help);
+}
+
+
+Metric* MetricsRegistry::get(const std::string &name) const
+{
+	MutexLock lock(&mutex_);
+	
+	VAR(found, metrics_.find(name));
+	return (found == metrics_.end()) ? NULL : found->second;
+}
+
+
+/**
+ * Metrics are written outside of the lock, they are never removed.
+ */
+void MetricsRegistry::writePrometheus(std::ostream &out) const
+{
+	std::vector<Metric*> metrics;
+	{
+		MutexLock lock(&mutex_);
+		FOR_EACH(metrics_, metric) {
+			metrics.push_back(metric->second);
+		}
+	}
+	
+	FOR_EACH(metrics, it) {
+		Metric *metric = *it;
+		if (!metric->getHelp().empty())
+			out << "# HELP " << metric->getName() << " " << metric->getHelp() << "\n";
+		out << "# TYPE " << metric->getName() << " " << metric->getType() << "\n";
+		metric->writeSamples(out);
+	}
+}
+
+
+MetricsRegistry& MetricsRegistry::global()
+{
+	static MetricsRegistry *registry = new MetricsRegistry();
+	return *registry;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// PROMETHEUS EXPORTER
+////////////////////////////////////////////////////////////////////////////////
+
+
+class PrometheusExportThread : public Thread {
+private:
+	PrometheusExporter *exporter_;
+	int                 interval_;
+	Mutex               mutex_;
+	Condition           changed_;
+	bool                stopping_;
+
+public:
+	PrometheusExportThread(PrometheusExporter *exporter, int interval) :
+		Thread(false),
+		exporter_(exporter),
+		interval_(interval),
+		stopping_(false)
+	{
+		start();
+	}
+	
+	void stop()
+	{
+		{
+			MutexLock lock(&mutex_);
+			stopping_ = true;
+			changed_.broadcast();
+		}
+		join();
+	}
+	
+	virtual void* run()
+	{
+		while (true) {
+			{
+				MutexLock lock(&mutex_);
+				if (!stopping_)
+					changed_.timedWait(mutex_, interval_);
+				if (stopping_)
+					break;
+			}
+			exporter_->write();
+		}
+		return NULL;
+	}
+};
+
+
+PrometheusExporter::PrometheusExporter(Ref<Output> output, MetricsRegistry *registry) :
+	output_(output),
+	registry_(registry),
+	thread_(NULL)
+{
+}
+
+
+PrometheusExporter::~PrometheusExporter()
+{
+	stop();
+}
+
+
+void PrometheusExporter::write()
+{
+	MutexLock lock(&mutex_);
+	
+	ostream *out = output_->getStream();
+	registry_->writePrometheus(*out);
+	out->flush();
+}
+
+
+void PrometheusExporter::start(int interval)
+{
+	stop();
+	thread_ = new PrometheusExportThread(this, interval);
+}
+
+
+void PrometheusExporter::stop()
+{
+	if (thread_ == NULL)
+		return;
+	
+	thread_->stop();
+	delete thread_;
+	thread_ = NULL;
+}
+
+
+} // namespace cppapp
@@ -0,0 +1,262 @@
+/**
+ * \file   Metrics.h
+ * \author Jan Milík <milikjan@fit.cvut.cz>
+ * \date   2026-10-19
+ *
+ * \brief  Header file for the metrics registry.
+ */
+
+#ifndef METRICS_T4WB8JZC
+#define METRICS_T4WB8JZC
+
+
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <iostream>
+
+#include "Histogram.h"
+#include "Mutex.h"
+#include "Output.h"
+
+
+namespace cppapp {
+
+
+/** \addtogroup threading
+ * @{
+ */
+
+
+#define CPPAPP_METRIC_SHARDS 16
+#define CPPAPP_CACHE_LINE    64
+
+
+extern __thread int metricShardIndex;
+
+int assignMetricShard();
+
+/**
+ * \brief Returns the counter shard of the calling thread. Threads are
+ *        assigned shards round robin.
+ */
+inline int metricShard()
+{
+	int index = metricShardIndex;
+	if (__builtin_expect(index < 0, 0))
+		index = assignMetricShard();
+	return index;
+}
+
+
+/**
+ * \brief Named value in a \ref MetricsRegistry.
+ */
+class Metric {
+private:
+	Metric(const Metric &other);
+	Metric& operator=(const Metric &other);
+
+	std::string name_;
+	std::string help_;
+
+public:
+	Metric(const std::string &name, const std::string &help) :
+		name_(name), help_(help)
+	{}
+	virtual ~Metric() {}
+
+	const std::string& getName() const { return name_; }
+	const std::string& getHelp() const { return help_; }
+
+	/**
+	 * \brief Returns the Prometheus type of the metric.
+	 */
+	virtual const char* getType() const = 0;
+	/**
+	 * \brief Writes the samples of the metric in the Prometheus text
+	 *        format, without the HELP and TYPE lines.
+	 */
+	virtual void writeSamples(std::ostream &out) const = 0;
+};
+
+
+/**
+ * \brief Monotonically increasing count.
+ *
+ * The count is split into \ref CPPAPP_METRIC_SHARDS cache-line sized
+ * shards, every thread adds to its own shard, so threads do not contend
+ * unless there are more of them than shards. The shards are aligned to
+ * cache lines, including in counters allocated by \c new.
+ */
+class MetricCounter : public Metric {
+private:
+	struct __attribute__((aligned(CPPAPP_CACHE_LINE))) Shard {
+		volatile long long value;
+		char               padding[CPPAPP_CACHE_LINE - sizeof(long long)];
+	};
+
+	Shard shards_[CPPAPP_METRIC_SHARDS];
+
+public:
+	/**
+	 * \brief Allocates the counter aligned to a cache line, which the
+	 *        default \c new does not guarantee before C++17.
+	 */
+	static void* operator new(size_t size);
+	static void  operator delete(void *ptr);
+	
+	MetricCounter(const std::string &name, const std::string &help);
+
+	void add(long long value = 1)
+	{
+		__sync_fetch_and_add(&shards_[metricShard()].value, value);
+	}
+
+	long long get() const;
+
+	virtual const char* getType() const { return "counter"; }
+	virtual void writeSamples(std::ostream &out) const;
+};
+
+
+/**
+ * \brief Value that can go up and down.
+ */
+class MetricGauge : public Metric {
+private:
+	volatile long long value_;
+
+public:
+	MetricGauge(const std::string &name, const std::string &help) :
+		Metric(name, help), value_(0)
+	{}
+
+	void      set(long long value) { value_ = value; }
+	void      add(long long value) { __sync_fetch_and_add(&value_, value); }
+	long long get() const { return value_; }
+
+	virtual const char* getType() const { return "gauge"; }
+	virtual void writeSamples(std::ostream &out) const;
+};
+
+
+/**
+ * \brief Distribution of durations recorded in nanoseconds.
+ *
+ * Exported as a Prometheus summary in seconds, with the 0.5, 0.9, 0.99
+ * and 0.999 quantiles.
+ */
+class MetricHistogram : public Metric {
+private:
+	ConcurrentHistogram histogram_;
+
+public:
+	MetricHistogram(const std::string &name, const std::string &help) :
+		Metric(name, help)
+	{}
+
+	void record(uint64_t nanos) { histogram_.record(nanos); }
+
+	ConcurrentHistogram* getHistogram() { return &histogram_; }
+	LatencyHistogram     snapshot() const { return histogram_.snapshot(); }
+
+	virtual const char* getType() const { return "summary"; }
+	virtual void writeSamples(std::ostream &out) const;
+};
+
+
+/**
+ * \brief Set of named metrics.
+ *
+ * Metrics are created by the first request for their name and live as
+ * long as the registry; the global registry is never destroyed. Looking
+ * a metric up takes a lock, so hot code should keep the pointer:
+ *
+ * \code
+ * static MetricCounter *parsed =
+ *     MetricsRegistry::global().counter("app_parsed_total", "Parsed documents.");
+ * parsed->add();
+ * \endcode
+ *
+ * Requesting an existing name with a different type throws
+ * \c std::invalid_argument.
+ */
+class MetricsRegistry {
+private:
+	MetricsRegistry(const MetricsRegistry &other);
+	MetricsRegistry& operator=(const MetricsRegistry &other);
+
+	mutable Mutex                  mutex_;
+	std::map<std::string, Metric*> metrics_;
+
+	template<class T>
+	T* getOrCreate(const std::string &name, const std::string &help);
+
+public:
+	MetricsRegistry() {}
+	~MetricsRegistry();
+
+	MetricCounter*   counter(const std::string &name, const std::string &help = "");
+	MetricGauge*     gauge(const std::string &name, const std::string &help = "");
+	MetricHistogram* histogram(const std::string &name, const std::string &help = "");
+
+	/**
+	 * \brief Returns the metric named \p name or \c NULL.
+	 */
+	Metric* get(const std::string &name) const;
+
+	/**
+	 * \brief Writes all metrics in the Prometheus text format, ordered by
+	 *        name.
+	 */
+	void writePrometheus(std::ostream &out) const;
+
+	static MetricsRegistry& global();
+};
+
+
+class PrometheusExportThread;
+
+
+/**
+ * \brief Writes snapshots of a \ref MetricsRegistry to an \ref Output, on
+ *        demand or periodically from a background thread.
+ */
+class PrometheusExporter : public Object {
+private:
+	PrometheusExporter(const PrometheusExporter &other);
+
+	Ref<Output>             output_;
+	MetricsRegistry        *registry_;
+	Mutex                   mutex_;
+	PrometheusExportThread *thread_;
+
+public:
+	PrometheusExporter(Ref<Output> output, MetricsRegistry *registry = &MetricsRegistry::global());
+	/**
+	 * \brief Destructor. Stops the periodic export.
+	 */
+	virtual ~PrometheusExporter();
+
+	/**
+	 * \brief Writes one snapshot and flushes the output.
+	 */
+	void write();
+
+	/**
+	 * \brief Writes a snapshot every \p interval milliseconds until
+	 *        \ref stop() is called.
+	 */
+	void start(int interval);
+	void stop();
+};
+
+
+/** @} */
+
+
+} // namespace cppapp
+
+
+#endif /* end of include guard: METRICS_T4WB8JZC */
@@ -31,5 +31,23 @@ MutexLock::~MutexLock()
 }
 
 
+bool Condition::timedWait(Mutex &mutex, int milliseconds)
+{
+	struct timeval now;
+	gettimeofday(&now, NULL);
+	
+	long nanoseconds = (now.tv_usec + (long)(milliseconds % 1000) * 1000) * 1000;
+	
+	struct timespec deadline;
+	deadline.tv_sec  = now.tv_sec + milliseconds / 1000 + nanoseconds / 1000000000;
+	deadline.tv_nsec = nanoseconds % 1000000000;
+	
+	Error err = pthread_cond_timedwait(&cond_, &mutex.mutex_, &deadline);
+	if (err == ETIMEDOUT) return false;
+	err.exit();
+	return true;
+}
+
+
 } /* namespace cppapp */
 
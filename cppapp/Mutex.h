@@ -14,6 +14,8 @@
 #include "Logger.h"
 
 #include <pthread.h>
+#include <sched.h>
+#include <sys/time.h>
 
 
 namespace cppapp {
@@ -99,9 +101,6 @@ public:
 	
 	void lock()
 	{
-#ifdef CPPAPP_DEBUG
-		LOG_DEBUG("Locking mutex...");
-#endif
 		HANDLE_SYSERR(pthread_mutex_lock(&mutex_));
 	}
 	
@@ -151,6 +150,13 @@ public:
 		HANDLE_SYSERR(pthread_cond_wait(&cond_, &mutex.mutex_));
 	}
 	
+	/**
+	 * \brief Waits for the condition for at most \p milliseconds.
+	 *
+	 * \returns \c false if the wait timed out, \c true otherwise
+	 */
+	bool timedWait(Mutex &mutex, int milliseconds);
+	
 	void signal()
 	{
 		HANDLE_SYSERR(pthread_cond_signal(&cond_));
@@ -163,6 +169,109 @@ public:
 };
 
 
+/**
+ * \brief Lock held by many readers or a single writer.
+ */
+class ReadWriteLock {
+private:
+	ReadWriteLock(const ReadWriteLock &other);
+	
+	pthread_rwlock_t lock_;
+
+public:
+	ReadWriteLock()
+	{
+		HANDLE_SYSERR(pthread_rwlock_init(&lock_, NULL));
+	}
+	
+	~ReadWriteLock()
+	{
+		HANDLE_SYSERR(pthread_rwlock_destroy(&lock_));
+	}
+	
+	void readLock()
+	{
+		HANDLE_SYSERR(pthread_rwlock_rdlock(&lock_));
+	}
+	
+	void writeLock()
+	{
+		HANDLE_SYSERR(pthread_rwlock_wrlock(&lock_));
+	}
+	
+	void unlock()
+	{
+		HANDLE_SYSERR(pthread_rwlock_unlock(&lock_));
+	}
+};
+
+
+struct ReadLock {
+private:
+	ReadLock(const ReadLock& other);
+	
+	ReadWriteLock *lock_;
+
+public:
+	ReadLock(ReadWriteLock *lock) : lock_(lock) { lock_->readLock(); }
+	~ReadLock() { lock_->unlock(); }
+};
+
+
+struct WriteLock {
+private:
+	WriteLock(const WriteLock& other);
+	
+	ReadWriteLock *lock_;
+
+public:
+	WriteLock(ReadWriteLock *lock) : lock_(lock) { lock_->writeLock(); }
+	~WriteLock() { lock_->unlock(); }
+};
+
+
+/**
+ * \brief Busy-waiting lock for very short critical sections.
+ *
+ * Use instead of Mutex only when the lock is almost never contended and
+ * held for a few instructions (for example a per-thread buffer that is
+ * occasionally drained by another thread).
+ */
+class SpinLock {
+private:
+	SpinLock(const SpinLock &other);
+	
+	volatile int locked_;
+
+public:
+	SpinLock() : locked_(0) {}
+	
+	void lock()
+	{
+		while (__sync_lock_test_and_set(&locked_, 1)) {
+			while (locked_)
+				sched_yield();
+		}
+	}
+	
+	bool tryLock() { return __sync_lock_test_and_set(&locked_, 1) == 0; }
+	
+	void unlock() { __sync_lock_release(&locked_); }
+};
+
+
+struct SpinLockGuard {
+private:
+	SpinLockGuard(const SpinLockGuard& other);
+	
+	SpinLock *lock_;
+
+public:
+	SpinLockGuard(SpinLock *lock) : lock_(lock) { lock_->lock(); }
+	~SpinLockGuard() { lock_->unlock(); }
+};
+
+
 /** @} */
 
 
@@ -13,15 +13,88 @@
 
 #include "Object.h"
 #include "Debug.h"
+#include "Metrics.h"
+#include "ObjectRegistry.h"
+#include "CycleCollector.h"
 
 
 namespace cppapp {
 
 
+ClassInfo::ClassInfo(const char *name, const ClassInfo *parent) :
+	name(name), parent(parent), depth((parent == NULL) ? 0 : parent->depth + 1)
+{
+	for (int i = 0; i < CPPAPP_CLASS_TABLE_SIZE; i++)
+		ancestors[i] = NULL;
+	for (const ClassInfo *info = this; info != NULL; info = info->parent) {
+		if (info->depth < CPPAPP_CLASS_TABLE_SIZE)
+			ancestors[info->depth] = info;
+	}
+}
+
+
+static MetricCounter* objectsCreated()
+{
+	static MetricCounter *counter = MetricsRegistry::global().counter(
+		"cppapp_objects_created_total", "Objects constructed.");
+	return counter;
+}
+
+
+static MetricCounter* objectsDestroyed()
+{
+	static MetricCounter *counter = MetricsRegistry::global().counter(
+		"cppapp_objects_destroyed_total", "Objects destroyed.");
+	return counter;
+}
+
+
+/**
+ * Not inlined, so that the return address is the \c new expression.
+ */
+__attribute__((noinline))
+void* Object::operator new(size_t size)
+{
+	void *ptr = ::operator new(size);
+	if (__builtin_expect(ObjectRegistry::isEnabled(), 0))
+		ObjectRegistry::noteAllocation(ptr, size, __builtin_return_address(0));
+	return ptr;
+}
+
+
+void Object::operator delete(void *ptr)
+{
+	::operator delete(ptr);
+}
+
+
 Object::Object()
 {
 	refCount_ = 0;
 	sentinel_ = SENTINEL;
+	record_   = NULL;
+	weak_     = NULL;
+	gcFlags_  = 0;
+	
+	if (__builtin_expect(ObjectRegistry::isEnabled(), 0))
+		record_ = ObjectRegistry::track(this);
+	
+	objectsCreated()->add();
+}
+
+
+Object::Object(const Object& other)
+{
+	refCount_ = 0;
+	sentinel_ = SENTINEL;
+	record_   = NULL;
+	weak_     = NULL;
+	gcFlags_  = 0;
+	
+	if (__builtin_expect(ObjectRegistry::isEnabled(), 0))
+		record_ = ObjectRegistry::track(this);
+	
+	objectsCreated()->add();
 }
 
 
@@ -31,13 +104,43 @@ Object::~Object()
 	
 	refCount_ = 0;
 	sentinel_ = DEAD_SENTINEL;
+	
+	if (record_ != NULL) {
+		ObjectRegistry::untrack(record_);
+		record_ = NULL;
+	}
+	
+	// Objects released with weak references are freed by the control,
+	// see release().
+	WeakControl *control = weak_;
+	if (control != NULL) {
+		__atomic_store_n(&control->object, (Object*)NULL, __ATOMIC_RELEASE);
+		if (control->memory == NULL)
+			WeakControl::release(control);
+	}
+	
+	objectsDestroyed()->add();
+}
+
+
+/**
+ * The memory of the object is freed by the last reference to the
+ * control, which may be the object itself.
+ */
+void WeakControl::release(WeakControl *control)
+{
+	if (__sync_sub_and_fetch(&control->count, 1) > 0)
+		return;
+	if (control->memory != NULL)
+		::operator delete(control->memory);
+	delete control;
 }
 
 
 void Object::claim()
 {
 	checkHealth();
-	refCount_++;
+	__sync_fetch_and_add(&refCount_, 1);
 }
 
 
@@ -60,11 +163,68 @@ Object* Object::release(Object* obj)
 	
 	CPPAPP_ASSERT(obj->refCount_ > 0);
 	
-	if (--(obj->refCount_) <= 0) {
+	int count = __sync_sub_and_fetch(&obj->refCount_, 1);
+	if (count > 0) {
+		// A container that loses a reference may be part of a garbage
+		// cycle.
+		if (__builtin_expect(obj->gcFlags_ != 0, 0) && CycleCollector::isEnabled())
+			CycleCollector::addCandidate(obj);
+		return obj;
+	}
+	
+	destroy(obj);
+	return NULL;
+}
+
+
+void Object::destroy(Object *obj)
+{
+	WeakControl *control = obj->weak_;
+	if (control == NULL) {
 		delete obj;
-		return NULL;
+		return;
+	}
+	
+	// Weak references may still read the reference count, destroy the
+	// object but keep its memory until they are gone.
+	control->memory = dynamic_cast<void*>(obj);
+	obj->~Object();
+	WeakControl::release(control);
+}
+
+
+const ClassInfo* Object::staticClassInfo()
+{
+	static const ClassInfo info("Object", NULL);
+	return &info;
+}
+
+
+bool Object::tryClaim()
+{
+	int count = refCount_;
+	while (count > 0) {
+		int previous = __sync_val_compare_and_swap(&refCount_, count, count + 1);
+		if (previous == count)
+			return true;
+		count = previous;
+	}
+	return false;
+}
+
+
+WeakControl* Object::getWeakControl()
+{
+	WeakControl *control = weak_;
+	if (control != NULL)
+		return control;
+	
+	control = new WeakControl(this);
+	if (!__sync_bool_compare_and_swap(&weak_, (WeakControl*)NULL, control)) {
+		delete control;
+		control = weak_;
 	}
-	return obj;
+	return control;
 }
 
 
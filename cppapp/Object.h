@@ -32,10 +32,11 @@ namespace cppapp {
 /**
  * \brief Represents an item in a ring (circular double-linked list).
  *
- * Originally, this was supposed to be used to implement a ring
- * that would keep references to all allocated \ref Objects
- * so that memory leaks could be detected. Currently, it is not
- * used however.
+ * An item that is not linked to others is a ring of its own (both links
+ * point to the item itself), so an item can serve as the head of a ring.
+ * Derive \c T from \c RingItem<T> and cast the items back to \c T.
+ * The ring is not synchronized. \ref ObjectRegistry uses rings to keep
+ * track of live \ref Object instances.
  *
  * \ingroup obj
  */
@@ -49,7 +50,7 @@ private:
 	RingItem<T>& operator=(const RingItem<T>& other);
 
 public:
-	RingItem() : previous_(NULL), next_(NULL) {}
+	RingItem() : previous_(this), next_(this) {}
 	~RingItem() { remove(); }
 	
 	inline RingItem<T>* previous() { return previous_; }
@@ -58,6 +59,15 @@ public:
 	inline const RingItem<T>* previous() const { return previous_; }
 	inline const RingItem<T>* next() const     { return next_; }
 	
+	/**
+	 * \brief Returns \c true if the item is not linked to other items.
+	 */
+	bool isAlone() const { return next_ == this; }
+	
+	/**
+	 * \brief Inserts \p item after this item, removing it from its
+	 *        previous ring first.
+	 */
 	void append(RingItem<T>& item)
 	{
 		item.remove();
@@ -71,17 +81,132 @@ public:
 	
 	void remove()
 	{
-		if (previous_ != NULL)
-			previous_->next_ = next_;
-		if (next_ != NULL)
-			next_->previous_ = previous_;
+		previous_->next_ = next_;
+		next_->previous_ = previous_;
 		
-		previous_ = NULL;
-		next_     = NULL;
+		previous_ = this;
+		next_     = this;
 	}
 };
 
 
+struct ObjectRecord;
+class Object;
+class CycleCollector;
+
+
+/**
+ * \brief Receives the children of a container object, see
+ *        \ref Object::traceChildren().
+ *
+ * \ingroup obj
+ */
+class ObjectVisitor {
+public:
+	virtual ~ObjectVisitor() {}
+	
+	virtual void visit(Object *child) = 0;
+};
+
+
+/**
+ * \brief Control block shared by the weak references to an object.
+ *
+ * The count holds one reference for every \ref WeakRef and one for the
+ * object while it is alive. An object released by its last \ref Ref
+ * while it has weak references is destroyed, but its memory is freed
+ * only when the count drops to zero, so a weak reference can always
+ * read the reference count of the object it points to.
+ *
+ * \ingroup obj
+ */
+struct WeakControl {
+	volatile int     count;
+	/** \brief The object, \c NULL once it is destroyed. */
+	Object *volatile object;
+	/** \brief Memory of the destroyed object to free with the control. */
+	void            *memory;
+	
+	WeakControl(Object *object) : count(1), object(object), memory(NULL) {}
+	
+	void claim() { __sync_fetch_and_add(&count, 1); }
+	static void release(WeakControl *control);
+};
+
+
+/**
+ * \brief Number of ancestors a \ref ClassInfo keeps in its table, deeper
+ *        ancestors are found by walking the parents.
+ */
+#define CPPAPP_CLASS_TABLE_SIZE 8
+
+
+/**
+ * \brief Run-time class identity of an \ref Object subclass declared
+ *        with \ref CPPAPP_CLASS_ID.
+ *
+ * Every class info keeps a table of its ancestors indexed by their depth
+ * in the hierarchy, so checking whether a class derives from another is
+ * a single comparison.
+ *
+ * \ingroup obj
+ */
+struct ClassInfo {
+	const char      *name;
+	const ClassInfo *parent;
+	int              depth;
+	const ClassInfo *ancestors[CPPAPP_CLASS_TABLE_SIZE];
+	
+	ClassInfo(const char *name, const ClassInfo *parent);
+	
+	/**
+	 * \brief Returns \c true if this class is \p other or derives from it.
+	 */
+	bool isA(const ClassInfo *other) const
+	{
+		if (other->depth < CPPAPP_CLASS_TABLE_SIZE)
+			return (other->depth <= depth) && (ancestors[other->depth] == other);
+		for (const ClassInfo *info = this; info != NULL; info = info->parent) {
+			if (info == other)
+				return true;
+		}
+		return false;
+	}
+};
+
+
+/**
+ * \brief Declares the class identity of an \ref Object subclass, for
+ *        \ref fast_cast().
+ *
+ * Place the macro at the top of the class body; it leaves the access at
+ * \c private. \p base is the direct base class derived from \ref Object.
+ * Classes that do not declare their identity share the one of their
+ * nearest declared ancestor, and casts to them fall back to
+ * \c dynamic_cast.
+ *
+ * \code
+ * class DynDict : public DynObject {
+ *     CPPAPP_CLASS_ID(DynDict, DynObject)
+ * public:
+ *     ...
+ * };
+ * \endcode
+ *
+ * \ingroup obj
+ */
+#define CPPAPP_CLASS_ID(cls, base) \
+public: \
+	typedef cls ClassIdSelf; \
+	static const ::cppapp::ClassInfo* staticClassInfo() \
+	{ \
+		static const ::cppapp::ClassInfo info(#cls, base::staticClassInfo()); \
+		return &info; \
+	} \
+	virtual const ::cppapp::ClassInfo* getClassInfo() const { return staticClassInfo(); } \
+private:
+
+
 /**
  * \brief Represents a reference-counted object.
  *
@@ -102,21 +227,72 @@ public:
  */
 class Object {
 private:
-	int refCount_;
+	volatile int refCount_;
 	int sentinel_;
+	ObjectRecord *record_;
+	WeakControl * volatile weak_;
+	volatile int gcFlags_;
+	
+	enum {
+		GC_CONTAINER = 1,
+		GC_BUFFERED  = 2,
+		/// The bits above count the changes of the children.
+		GC_CHANGE    = 1 << 8
+	};
+	
+	friend class CycleCollector;
+	
+	static void destroy(Object *obj);
+
+protected:
+	/**
+	 * \brief Marks the object as a container of references, whose
+	 *        children \ref CycleCollector traces. Call from the
+	 *        constructor of classes that override \ref traceChildren().
+	 */
+	void registerContainer() { gcFlags_ |= GC_CONTAINER; }
+	/**
+	 * \brief Notes that the container changed its children, so that a
+	 *        running \ref CycleCollector step does not collect it. Call
+	 *        with \ref CycleCollector::getLock() locked for reading.
+	 */
+	void markChanged() { __sync_fetch_and_add(&gcFlags_, GC_CHANGE); }
 
 public:
+	/**
+	 * \brief Allocates an object, noting its size and allocation site for
+	 *        \ref ObjectRegistry.
+	 */
+	static void* operator new(size_t size);
+	static void* operator new(size_t size, void *ptr) { return ptr; }
+	static void  operator delete(void *ptr);
+	static void  operator delete(void *ptr, void *place) {}
+	
 	/**
 	 * \brief Constructor
 	 */
 	Object();
+	/**
+	 * \brief Copy constructor. The copy is a new object, with no
+	 *        references.
+	 */
+	Object(const Object& other);
 	/**
 	 * \brief Destructor
 	 */
 	virtual ~Object();
 	
+	/**
+	 * \brief Assignment keeps the reference count of the object.
+	 */
+	Object& operator=(const Object& other) { return *this; }
+	
 	/**
 	 * \brief Increments object's reference count.
+	 *
+	 * The reference count is updated atomically, so references to an
+	 * object can be copied and released from several threads. The
+	 * referenced object itself is not synchronized.
 	 */
 	void claim();
 	/**
@@ -130,9 +306,48 @@ public:
 	 * \param obj Object to be released.
 	 */
 	static Object* release(Object* obj);
+	/**
+	 * \brief Increments the reference count unless it is zero.
+	 *
+	 * \returns \c false if the object is being destroyed
+	 */
+	bool tryClaim();
+	int  getRefCount() const { return refCount_; }
+	/**
+	 * \brief Returns the weak reference control block, creating it if
+	 *        necessary. The caller must hold a reference.
+	 */
+	WeakControl* getWeakControl();
+	
+	bool isContainer() const { return (gcFlags_ & GC_CONTAINER) != 0; }
+	/**
+	 * \brief Returns a number that changes whenever the container calls
+	 *        \ref markChanged().
+	 */
+	int  getChangeCount() const { return gcFlags_ / GC_CHANGE; }
+	/**
+	 * \brief Passes every object the container references to \p visitor.
+	 *
+	 * Each reference is passed once, an object referenced twice is passed
+	 * twice.
+	 */
+	virtual void traceChildren(ObjectVisitor *visitor) {}
+	/**
+	 * \brief Releases all references the container holds. Called by
+	 *        \ref CycleCollector on garbage cycles.
+	 */
+	virtual void clearChildren() {}
 	
 	std::string getClassName();
 	
+	typedef Object ClassIdSelf;
+	static const ClassInfo* staticClassInfo();
+	/**
+	 * \brief Returns the identity of the nearest class declared with
+	 *        \ref CPPAPP_CLASS_ID.
+	 */
+	virtual const ClassInfo* getClassInfo() const { return staticClassInfo(); }
+	
 	/**
 	 * \brief Frees all allocated objects. <b>Not implemented</b>.
 	 *
@@ -142,11 +357,80 @@ public:
 };
 
 
+template<class From, class To>
+struct IsPointerConvertible {
+	static char test(To*);
+	static long test(...);
+	enum { value = (sizeof(test((From*)NULL)) == sizeof(char)) };
+};
+
+
+template<class A, class B>
+struct IsSameClass { enum { value = 0 }; };
+
+template<class A>
+struct IsSameClass<A, A> { enum { value = 1 }; };
+
+
+enum FastCastKind {
+	FAST_CAST_UP,
+	FAST_CAST_DOWN,
+	FAST_CAST_DYNAMIC
+};
+
+
+template<class U, class T, int kind>
+struct FastCast;
+
+template<class U, class T>
+struct FastCast<U, T, FAST_CAST_UP> {
+	static U* cast(T *ptr) { return ptr; }
+};
+
+template<class U, class T>
+struct FastCast<U, T, FAST_CAST_DOWN> {
+	static U* cast(T *ptr)
+	{
+		if ((ptr == NULL) || !ptr->getClassInfo()->isA(U::staticClassInfo()))
+			return NULL;
+		return static_cast<U*>(ptr);
+	}
+};
+
+template<class U, class T>
+struct FastCast<U, T, FAST_CAST_DYNAMIC> {
+	static U* cast(T *ptr) { return dynamic_cast<U*>(ptr); }
+};
+
+
+/**
+ * \brief Casts \p ptr to \c U*, or returns \c NULL if the object is not
+ *        a \c U.
+ *
+ * An upcast is a plain conversion. A downcast to a class declared with
+ * \ref CPPAPP_CLASS_ID compares class identities. Anything else (casts
+ * to undeclared classes, cross casts) is a \c dynamic_cast.
+ *
+ * \ingroup obj
+ */
+template<class U, class T>
+inline U* fast_cast(T *ptr)
+{
+	return FastCast<U, T,
+		IsPointerConvertible<T, U>::value ? FAST_CAST_UP :
+		(IsPointerConvertible<U, T>::value &&
+		 IsSameClass<typename U::ClassIdSelf, U>::value) ? FAST_CAST_DOWN :
+		FAST_CAST_DYNAMIC
+	>::cast(ptr);
+}
+
+
 /**
  * \ingroup obj 
  */
 template<class T>
 class Box : public Object {
+	CPPAPP_CLASS_ID(Box, Object)
 private:
 	T value_;
 
@@ -168,6 +452,7 @@ public:
  */
 template<class T>
 class HeapBox : public Object {
+	CPPAPP_CLASS_ID(HeapBox, Object)
 private:
 	T * value_;
 
@@ -379,10 +664,14 @@ public:
 		return ptr_;
 	}
 	
+	/**
+	 * \brief Returns the reference cast to \c U (see \ref fast_cast()),
+	 *        \c NULL if the object is not a \c U.
+	 */
 	template<class U>
 	Ref<U> as() const
 	{
-		return Ref<U>(dynamic_cast<U*>(getPtr()));
+		return Ref<U>(fast_cast<U>(getPtr()));
 	}
 };
 
@@ -390,6 +679,116 @@ public:
 typedef Ref<Object> ObjRef;
 
 
+/**
+ * \brief Reference that does not keep the object alive.
+ *
+ * \ref lock() returns a \ref Ref to the object, or \c NULL once the
+ * object has been released by its last \ref Ref. Locking takes no lock,
+ * it increments the reference count of the object unless it is already
+ * zero. Weak references can be copied and released from several
+ * threads, like \ref Ref. The weak references to objects that
+ * \ref CycleCollector found to be garbage expire before the objects are
+ * freed.
+ *
+ * \note Objects with weak references must be allocated by \c new of
+ *       \ref Object, because their memory is freed separately from
+ *       their destruction.
+ *
+ * \ingroup obj
+ */
+template<class T>
+class WeakRef {
+private:
+	WeakControl *control_;
+	T           *ptr_;
+	
+	void set(T *ptr)
+	{
+		WeakControl *control = (ptr == NULL) ? NULL : ptr->getWeakControl();
+		if (control != NULL)
+			control->claim();
+		if (control_ != NULL)
+			WeakControl::release(control_);
+		control_ = control;
+		ptr_     = ptr;
+	}
+	
+	void copy(const WeakRef<T> &other)
+	{
+		if (other.control_ != NULL)
+			other.control_->claim();
+		if (control_ != NULL)
+			WeakControl::release(control_);
+		control_ = other.control_;
+		ptr_     = other.ptr_;
+	}
+
+public:
+	WeakRef() : control_(NULL), ptr_(NULL) {}
+	WeakRef(const Ref<T> &ref) : control_(NULL), ptr_(NULL) { set(ref.getPtr()); }
+	WeakRef(const WeakRef<T> &other) : control_(NULL), ptr_(NULL) { copy(other); }
+	~WeakRef() { reset(); }
+	
+	WeakRef<T>& operator=(const Ref<T> &ref)
+	{
+		set(ref.getPtr());
+		return *this;
+	}
+	
+	WeakRef<T>& operator=(const WeakRef<T> &other)
+	{
+		if (this != &other)
+			copy(other);
+		return *this;
+	}
+	
+	/**
+	 * \brief Returns a reference to the object, \c NULL if it is gone.
+	 */
+	Ref<T> lock() const
+	{
+		if (control_ == NULL)
+			return NULL;
+		Object *obj = __atomic_load_n(&control_->object, __ATOMIC_ACQUIRE);
+		if ((obj == NULL) || !obj->tryClaim())
+			return NULL;
+		// Expired by the cycle collector, which found the object to be
+		// garbage, before the reference was taken.
+		if (__atomic_load_n(&control_->object, __ATOMIC_SEQ_CST) == NULL) {
+			Object::release(obj);
+			return NULL;
+		}
+		
+		Ref<T> result(ptr_);
+		Object::release(obj);
+		return result;
+	}
+	
+	void reset()
+	{
+		if (control_ != NULL)
+			WeakControl::release(control_);
+		control_ = NULL;
+		ptr_     = NULL;
+	}
+	
+	/**
+	 * \brief Returns \c true if the reference was never set (or was
+	 *        reset), as opposed to pointing to a destroyed object.
+	 */
+	bool isNull() const { return control_ == NULL; }
+	/**
+	 * \brief Returns \c true if the object is gone. The result may be
+	 *        out of date as soon as it is returned, use \ref lock().
+	 */
+	bool isExpired() const
+	{
+		return (control_ == NULL) ||
+		       (__atomic_load_n(&control_->object, __ATOMIC_ACQUIRE) == NULL);
+	}
+};
+
+
 /**
  * \brief Like \ref Ref, except it references \ref Box instances.
  *
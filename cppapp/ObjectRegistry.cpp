@@ -0,0 +1,398 @@
+/**
+ * \file   ObjectRegistry.cpp
+ * \author Jan Milík <milikjan@fit.cvut.cz>
+ * \date   2026-10-19
+ *
+ * \brief  Implementation file for the ObjectRegistry class.
+ */
+
+#include "ObjectRegistry.h"
+
+#include <cstdlib>
+#include <cxxabi.h>
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <typeinfo>
+
+#include "Mutex.h"
+#include "ThreadLocal.h"
+#include "utils.h"
+
+
+namespace cppapp {
+
+
+////////////////////////////////////////////////////////////////////////////////
+// RINGS
+////////////////////////////////////////////////////////////////////////////////
+
+
+/**
+ * \brief Objects registered by one thread.
+ */
+class ObjectRing {
+public:
+	Mutex                  mutex;
+	RingItem<ObjectRecord> head;
+	long                   count;
+
+	ObjectRing() : count(0) {}
+};
+
+
+/**
+ * \brief Allocation made by \c Object::operator \c new that has not been
+ *        claimed by a constructor yet.
+ */
+struct ObjectPendingAllocation {
+	void   *ptr;
+	size_t  size;
+	void   *site;
+};
+
+
+static __thread ObjectPendingAllocation pendingAllocation = { NULL, 0, NULL };
+static __thread ObjectRing             *threadRing        = NULL;
+
+
+struct ObjectRings {
+	Mutex                    mutex;
+	std::vector<ObjectRing*> all;
+	std::vector<ObjectRing*> free;
+	bool                     reportAtExit;
+	bool                     atExitRegistered;
+
+	ObjectRings() : reportAtExit(false), atExitRegistered(false) {}
+};
+
+
+/**
+ * Never deleted, objects may be destroyed during static destruction.
+ */
+static ObjectRings& getRings()
+{
+	static ObjectRings *rings = new ObjectRings();
+	return *rings;
+}
+
+
+/**
+ * \brief Returns the ring of an exiting thread to the free list.
+ *
+ * The objects in the ring stay there, the next thread that takes the
+ * ring simply adds to them.
+ */
+struct ObjectRingState {
+	ObjectRing *ring;
+
+	ObjectRingState() : ring(NULL) {}
+	~ObjectRingState()
+	{
+		if (ring == NULL)
+			return;
+		ObjectRings &rings = getRings();
+		MutexLock lock(&rings.mutex);
+		rings.free.push_back(ring);
+	}
+};
+
+
+static ObjectRing* acquireRing()
+{
+	static ThreadLocal<ObjectRingState> *states = new ThreadLocal<ObjectRingState>();
+
+	ObjectRings &rings = getRings();
+	ObjectRing  *ring;
+	{
+		MutexLock lock(&rings.mutex);
+		if (!rings.free.empty()) {
+			ring = rings.free.back();
+			rings.free.pop_back();
+		} else {
+			ring = new ObjectRing();
+			rings.all.push_back(ring);
+		}
+	}
+
+	states->get().ring = ring;
+	threadRing = ring;
+	return ring;
+}
+
+
+/**
+ * \brief Type, size and site of a live object, copied out of the rings.
+ */
+struct ObjectSample {
+	const std::type_info *type;
+	size_t                size;
+	void                 *site;
+};
+
+
+/**
+ * An object being destroyed by another thread is still in its ring until
+ * its \ref Object destructor runs, which waits for the ring lock, so the
+ * memory stays valid; its type may already be reported as a base class.
+ */
+static void collectSamples(std::vector<ObjectSample> *samples)
+{
+	ObjectRings &rings = getRings();
+	std::vector<ObjectRing*> all;
+	{
+		MutexLock lock(&rings.mutex);
+		all = rings.all;
+	}
+
+	FOR_EACH(all, it) {
+		ObjectRing *ring = *it;
+		MutexLock lock(&ring->mutex);
+		for (RingItem<ObjectRecord> *item = ring->head.next(); item != &ring->head; item = item->next()) {
+			ObjectRecord *record = static_cast<ObjectRecord*>(item);
+			ObjectSample  sample;
+			sample.type = &typeid(*record->object);
+			sample.size = record->size;
+			sample.site = record->site;
+			samples->push_back(sample);
+		}
+	}
+}
+
+
+static std::string demangle(const char *name)
+{
+	int   status    = 0;
+	char *demangled = abi::__cxa_demangle(name, NULL, NULL, &status);
+	std::string result((status == 0) ? demangled : name);
+	free(demangled);
+	return result;
+}
+
+
+static bool compareClassStats(const ObjectClassStats &a, const ObjectClassStats &b)
+{
+	if (a.bytes != b.bytes)
+		return a.bytes > b.bytes;
+	return a.count > b.count;
+}
+
+
+static bool compareSiteStats(const ObjectSiteStats &a, const ObjectSiteStats &b)
+{
+	if (a.bytes != b.bytes)
+		return a.bytes > b.bytes;
+	return a.count > b.count;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// OBJECT REGISTRY
+////////////////////////////////////////////////////////////////////////////////
+
+
+volatile bool ObjectRegistry::enabled_ = false;
+
+
+void ObjectRegistry::reportAtExit()
+{
+	ObjectRings &rings = getRings();
+	{
+		MutexLock lock(&rings.mutex);
+		if (!rings.reportAtExit)
+			return;
+	}
+
+	if (getLiveCount() > 0)
+		writeReport(std::cerr);
+}
+
+
+void ObjectRegistry::enable()
+{
+	enabled_ = true;
+}
+
+
+void ObjectRegistry::disable()
+{
+	enabled_ = false;
+}
+
+
+void ObjectRegistry::noteAllocation(void *ptr, size_t size, void *site)
+{
+	ObjectPendingAllocation &pending = pendingAllocation;
+	pending.ptr  = ptr;
+	pending.size = size;
+	pending.site = site;
+}
+
+
+/**
+ * The object's own base subobject is constructed before any of its
+ * members, so the pending allocation it lies in is its own.
+ */
+ObjectRecord* ObjectRegistry::track(Object *object)
+{
+	ObjectRecord *record = new ObjectRecord();
+	record->object = object;
+	record->size   = 0;
+	record->site   = NULL;
+
+	ObjectPendingAllocation &pending = pendingAllocation;
+	char *address = (char*)object;
+	char *start   = (char*)pending.ptr;
+	if ((start != NULL) && (address >= start) && (address < start + pending.size)) {
+		record->size = pending.size;
+		record->site = pending.site;
+		pending.ptr  = NULL;
+	}
+
+	ObjectRing *ring = threadRing;
+	if (ring == NULL)
+		ring = acquireRing();
+	record->ring = ring;
+
+	MutexLock lock(&ring->mutex);
+	ring->head.append(*record);
+	ring->count++;
+	return record;
+}
+
+
+void ObjectRegistry::untrack(ObjectRecord *record)
+{
+	ObjectRing *ring = record->ring;
+	{
+		MutexLock lock(&ring->mutex);
+		record->remove();
+		ring->count--;
+	}
+	delete record;
+}
+
+
+long ObjectRegistry::getLiveCount()
+{
+	ObjectRings &rings = getRings();
+	MutexLock lock(&rings.mutex);
+
+	long count = 0;
+	FOR_EACH(rings.all, it) {
+		MutexLock ringLock(&(*it)->mutex);
+		count += (*it)->count;
+	}
+	return count;
+}
+
+
+std::vector<ObjectClassStats> ObjectRegistry::getClassStats()
+{
+	std::vector<ObjectSample> samples;
+	collectSamples(&samples);
+
+	std::map<const std::type_info*, ObjectClassStats> byType;
+	FOR_EACH(samples, sample) {
+		ObjectClassStats &stats = byType[sample->type];
+		stats.count++;
+		stats.bytes += sample->size;
+	}
+
+	// Distinct type_info objects may describe the same class.
+	std::map<std::string, ObjectClassStats> byName;
+	FOR_EACH(byType, it) {
+		std::string       name  = demangle(it->first->name());
+		ObjectClassStats &stats = byName[name];
+		stats.className = name;
+		stats.count    += it->second.count;
+		stats.bytes    += it->second.bytes;
+	}
+
+	std::vector<ObjectClassStats> result;
+	FOR_EACH(byName, it)
+		result.push_back(it->second);
+	std::sort(result.begin(), result.end(), compareClassStats);
+	return result;
+}
+
+
+std::vector<ObjectSiteStats> ObjectRegistry::getSiteStats()
+{
+	std::vector<ObjectSample> samples;
+	collectSamples(&samples);
+
+	std::map<void*, ObjectSiteStats> bySite;
+	FOR_EACH(samples, sample) {
+		ObjectSiteStats &stats = bySite[sample->site];
+		stats.site   = sample->site;
+		stats.count++;
+		stats.bytes += sample->size;
+	}
+
+	std::vector<ObjectSiteStats> result;
+	std::vector<void*>           addresses;
+	FOR_EACH(bySite, it) {
+		result.push_back(it->second);
+		if (it->first != NULL)
+			addresses.push_back(it->first);
+	}
+
+	std::vector<std::string> locations;
+	Symbolizer::symbolize(addresses, &locations);
+	size_t next = 0;
+	FOR_EACH(result, stats) {
+		if (stats->site == NULL)
+			stats->location = "<not allocated by new>";
+		else
+			stats->location = locations[next++];
+	}
+
+	std::sort(result.begin(), result.end(), compareSiteStats);
+	return result;
+}
+
+
+void ObjectRegistry::writeReport(std::ostream &output, int limit)
+{
+	std::vector<ObjectClassStats> classes = getClassStats();
+	std::vector<ObjectSiteStats>  sites   = getSiteStats();
+
+	long   count = 0;
+	size_t bytes = 0;
+	FOR_EACH(classes, stats) {
+		count += stats->count;
+		bytes += stats->bytes;
+	}
+
+	output << "Live objects: " << count << ", " << bytes << " bytes" << std::endl;
+	FOR_EACH(classes, stats) {
+		output << std::setw(12) << stats->bytes << " B "
+		       << std::setw(8) << stats->count << "  "
+		       << stats->className << std::endl;
+	}
+
+	output << "Allocation sites:" << std::endl;
+	for (int i = 0; (i < limit) && (i < (int)sites.size()); i++) {
+		output << std::setw(12) << sites[i].bytes << " B "
+		       << std::setw(8) << sites[i].count << "  "
+		       << sites[i].location << std::endl;
+	}
+}
+
+
+void ObjectRegistry::setReportAtExit(bool value)
+{
+	ObjectRings &rings = getRings();
+	MutexLock lock(&rings.mutex);
+
+	rings.reportAtExit = value;
+	if (value && !rings.atExitRegistered) {
+		atexit(reportAtExit);
+		rings.atExitRegistered = true;
+	}
+}
+
+
+} // namespace cppapp
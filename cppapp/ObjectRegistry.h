@@ -0,0 +1,141 @@
+/**
+ * \file   ObjectRegistry.h
+ * \author Jan Milík <milikjan@fit.cvut.cz>
+ * \date   2026-10-19
+ *
+ * \brief  Header file for the ObjectRegistry class.
+ */
+
+#ifndef OBJECTREGISTRY_K2WN7QFX
+#define OBJECTREGISTRY_K2WN7QFX
+
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "Object.h"
+
+
+namespace cppapp {
+
+
+class ObjectRing;
+
+
+/**
+ * \brief Registry entry of a live \ref Object.
+ *
+ * \ingroup obj
+ */
+struct ObjectRecord : public RingItem<ObjectRecord> {
+	Object     *object;
+	/** \brief Size of the allocation, 0 if not allocated by \c new. */
+	size_t      size;
+	/** \brief Return address of the \c new expression, or \c NULL. */
+	void       *site;
+	ObjectRing *ring;
+};
+
+
+/**
+ * \brief Live objects and bytes of a class.
+ *
+ * \ingroup obj
+ */
+struct ObjectClassStats {
+	std::string className;
+	long        count;
+	size_t      bytes;
+
+	ObjectClassStats() : count(0), bytes(0) {}
+};
+
+
+/**
+ * \brief Live objects and bytes allocated at a \c new expression.
+ *
+ * \ingroup obj
+ */
+struct ObjectSiteStats {
+	void        *site;
+	std::string  location;
+	long         count;
+	size_t       bytes;
+
+	ObjectSiteStats() : site(NULL), count(0), bytes(0) {}
+};
+
+
+/**
+ * \brief Opt-in registry of all live \ref Object instances, for finding
+ *        leaks and memory growth.
+ *
+ * While the registry is enabled, every constructed object is linked into
+ * a ring owned by the constructing thread, together with the size of its
+ * allocation and the address of the \c new expression that allocated
+ * it. Every ring has its own lock, so threads register objects without
+ * contending; an object destroyed by another thread briefly locks the
+ * ring of its creator. Rings of exited threads are reused by new
+ * threads. The statistics merge all rings on demand.
+ *
+ * Objects created while the registry is disabled are never tracked,
+ * objects tracked before \ref disable() stay tracked until destroyed.
+ * When disabled, the registry costs a branch in the constructor,
+ * destructor and \c operator \c new of \ref Object.
+ *
+ * \ingroup obj
+ */
+class ObjectRegistry {
+private:
+	ObjectRegistry();
+
+	static volatile bool enabled_;
+
+	static void reportAtExit();
+
+public:
+	static bool isEnabled() { return enabled_; }
+	static void enable();
+	static void disable();
+
+	/** \brief Called by \c Object::operator \c new. */
+	static void noteAllocation(void *ptr, size_t size, void *site);
+	/** \brief Called by the \ref Object constructor. */
+	static ObjectRecord* track(Object *object);
+	/** \brief Called by the \ref Object destructor. */
+	static void untrack(ObjectRecord *record);
+
+	/**
+	 * \brief Returns the number of tracked live objects.
+	 */
+	static long getLiveCount();
+	/**
+	 * \brief Returns tracked live objects grouped by class, with the most
+	 *        bytes first.
+	 */
+	static std::vector<ObjectClassStats> getClassStats();
+	/**
+	 * \brief Returns tracked live objects grouped by allocation site, with
+	 *        the most bytes first. Sites are symbolized.
+	 */
+	static std::vector<ObjectSiteStats> getSiteStats();
+
+	/**
+	 * \brief Writes the live objects by class and the \p limit largest
+	 *        allocation sites.
+	 */
+	static void writeReport(std::ostream &output, int limit = 20);
+	/**
+	 * \brief Writes a report to \c stderr at exit if there are tracked
+	 *        objects left.
+	 */
+	static void setReportAtExit(bool value);
+};
+
+
+} // namespace cppapp
+
+
+#endif /* end of include guard: OBJECTREGISTRY_K2WN7QFX */
@@ -8,6 +8,8 @@
 
 #include "Output.h"
 
+#include "Mutex.h"
+
 
 namespace cppapp {
 
@@ -17,7 +19,17 @@ namespace cppapp {
 ///////////////////////////////////////////////////////////////////////////////
 
 
-Output::~Output() { close(); }
+Output::Output() :
+	writeMutex_(new Mutex())
+{
+}
+
+
+Output::~Output()
+{
+	close();
+	delete writeMutex_;
+}
 
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -23,13 +23,29 @@ using namespace std;
 namespace cppapp {
 
 
+class Mutex;
+
+
 /**
  * \brief Represents an abstract output.
  */
 class Output : public Object {
+private:
+	Output(const Output &other);
+	Output& operator=(const Output &other);
+	
+	Mutex *writeMutex_;
+	
 public:
+	Output();
 	virtual ~Output();
 	
+	/**
+	 * \brief Returns the lock \ref Logger holds while it writes a record
+	 *        into the output.
+	 */
+	Mutex& getWriteMutex() { return *writeMutex_; }
+	
 	virtual string getName() = 0;
 	virtual ostream* getStream() = 0;
 	virtual void close() {}
@@ -0,0 +1,137 @@
+/**
+ * \file   Rcu.cpp
+ * \author Jan Milík <milikjan@fit.cvut.cz>
+ * \date   2026-10-19
+ *
+ * \brief  Implementation file for the RcuDomain class.
+ */
+
+#include "Rcu.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <algorithm>
+
+#include "utils.h"
+
+
+namespace cppapp {
+
+
+/**
+ * Called when the thread exits.
+ */
+RcuReader::~RcuReader()
+{
+	if (domain != NULL)
+		domain->unregisterReader(this);
+}
+
+
+RcuDomain::RcuDomain() :
+	period_(1)
+{
+}
+
+
+void RcuDomain::registerReader(RcuReader *reader)
+{
+	MutexLock lock(&mutex_);
+	reader->domain = this;
+	readers_.push_back(reader);
+}
+
+
+void RcuDomain::unregisterReader(RcuReader *reader)
+{
+	MutexLock lock(&mutex_);
+	readers_.erase(std::remove(readers_.begin(), readers_.end(), reader), readers_.end());
+}
+
+
+/**
+ * A reader that entered its section before the new period was started
+ * has either stored an older period, or it has not stored its period
+ * yet. In the latter case the fence in \ref readLock() guarantees that
+ * it will see the pointers published before this call.
+ *
+ * The list of readers is locked only while it is checked, not while
+ * waiting, so threads can register as readers (and exit) in the
+ * meantime; their new read sections do not need to be waited for.
+ */
+void RcuDomain::synchronize()
+{
+	__sync_synchronize();
+	unsigned long period = __sync_add_and_fetch(&period_, 1);
+	__sync_synchronize();
+
+	while (true) {
+		bool waiting = false;
+		{
+			MutexLock lock(&mutex_);
+			FOR_EACH(readers_, it) {
+				unsigned long readerPeriod = (*it)->period;
+				if ((readerPeriod != 0) && (readerPeriod < period)) {
+					waiting = true;
+					break;
+				}
+			}
+		}
+		if (!waiting)
+			break;
+		sched_yield();
+	}
+
+	__sync_synchronize();
+}
+
+
+RcuDomain& RcuDomain::global()
+{
+	static RcuDomain *domain = createGlobal();
+	return *domain;
+}
+
+
+RcuDomain* RcuDomain::createGlobal()
+{
+	RcuDomain *domain = new RcuDomain();
+	pthread_atfork(prepareFork, parentAfterFork, childAfterFork);
+	return domain;
+}
+
+
+/**
+ * The list of readers is locked across fork(), so that the child gets
+ * a consistent copy.
+ */
+void RcuDomain::prepareFork()
+{
+	global().mutex_.lock();
+}
+
+
+void RcuDomain::parentAfterFork()
+{
+	global().mutex_.unlock();
+}
+
+
+/**
+ * Only the forking thread exists in the child, the readers of the other
+ * threads would never leave their read sections.
+ */
+void RcuDomain::childAfterFork()
+{
+	RcuDomain &domain = global();
+	RcuReader *self   = &domain.local_.get();
+	
+	domain.readers_.clear();
+	if (self->domain == &domain)
+		domain.readers_.push_back(self);
+	
+	domain.mutex_.unlock();
+}
+
+
+} // namespace cppapp
@@ -0,0 +1,206 @@
+/**
+ * \file   Rcu.h
+ * \author Jan Milík <milikjan@fit.cvut.cz>
+ * \date   2026-10-19
+ *
+ * \brief  Header file for the RcuDomain class and related classes.
+ */
+
+#ifndef RCU_T6MB3XWE
+#define RCU_T6MB3XWE
+
+
+#include <cstddef>
+#include <vector>
+
+#include "Mutex.h"
+#include "ThreadLocal.h"
+
+
+namespace cppapp {
+
+
+/** \addtogroup threading
+ * @{
+ */
+
+
+class RcuDomain;
+
+
+/**
+ * \brief Read-side state of a single thread in an \ref RcuDomain.
+ */
+struct RcuReader {
+	RcuDomain              *domain;
+	/// Grace period in which the outermost read section started, 0 if none.
+	volatile unsigned long  period;
+	int                     nesting;
+
+	RcuReader() : domain(NULL), period(0), nesting(0) {}
+	~RcuReader();
+};
+
+
+/**
+ * \brief Read-copy-update synchronization.
+ *
+ * Readers mark their critical sections with \ref readLock() and
+ * \ref readUnlock() (or an \ref RcuReadLock guard), which never block
+ * and touch only the calling thread's state. A writer publishes a new
+ * version of the shared data and calls \ref synchronize(), which waits
+ * until every read section that might still see the old version has
+ * ended; after that the old version can be deleted.
+ *
+ * Read sections can be nested, but \ref synchronize() must not be
+ * called from inside one.
+ *
+ * \note Domains must outlive all threads that use them. Use
+ *       \ref global() or allocate the domain on the heap and never delete
+ *       it.
+ */
+class RcuDomain {
+private:
+	RcuDomain(const RcuDomain &other);
+	RcuDomain& operator=(const RcuDomain &other);
+
+	/// Protects the list of readers.
+	Mutex                     mutex_;
+	volatile unsigned long    period_;
+	std::vector<RcuReader*>   readers_;
+	ThreadLocal<RcuReader>    local_;
+
+	void registerReader(RcuReader *reader);
+
+	friend struct RcuReader;
+	void unregisterReader(RcuReader *reader);
+
+	static RcuDomain* createGlobal();
+	static void       prepareFork();
+	static void       parentAfterFork();
+	static void       childAfterFork();
+
+public:
+	RcuDomain();
+
+	void readLock()
+	{
+		RcuReader &reader = local_.get();
+		if (reader.nesting++ > 0)
+			return;
+		if (reader.domain == NULL)
+			registerReader(&reader);
+		reader.period = period_;
+		// Make the period visible before any shared pointer is read.
+		__sync_synchronize();
+	}
+
+	void readUnlock()
+	{
+		RcuReader &reader = local_.get();
+		if (--reader.nesting > 0)
+			return;
+		__sync_synchronize();
+		reader.period = 0;
+	}
+
+	/**
+	 * \brief Waits until all read sections that started before the call
+	 *        have ended.
+	 */
+	void synchronize();
+
+	/**
+	 * \brief Returns the domain shared by the library.
+	 *
+	 * The domain survives \c fork(): the child forgets the readers of
+	 * the threads that were not forked, so it does not wait for their
+	 * read sections.
+	 */
+	static RcuDomain& global();
+};
+
+
+/**
+ * \brief Guard of an RCU read section.
+ */
+struct RcuReadLock {
+private:
+	RcuReadLock(const RcuReadLock &other);
+
+	RcuDomain *domain_;
+
+public:
+	RcuReadLock(RcuDomain *domain = &RcuDomain::global()) : domain_(domain)
+	{
+		domain_->readLock();
+	}
+
+	~RcuReadLock() { domain_->readUnlock(); }
+};
+
+
+/**
+ * \brief Pointer to RCU protected data.
+ *
+ * Readers call \ref get() inside a read section and must not use the
+ * returned pointer after the section ends. Writers must be serialized
+ * by the caller; \ref update() publishes a new version and deletes the
+ * old one once no reader can see it.
+ */
+template<class T>
+class RcuPtr {
+private:
+	RcuPtr(const RcuPtr<T> &other);
+	RcuPtr<T>& operator=(const RcuPtr<T> &other);
+
+	T * volatile value_;
+	RcuDomain   *domain_;
+
+public:
+	RcuPtr(T *value = NULL, RcuDomain *domain = &RcuDomain::global()) :
+		value_(value), domain_(domain)
+	{}
+
+	/**
+	 * The current version is deleted, so the pointer must not be
+	 * destroyed while there are readers.
+	 */
+	~RcuPtr() { delete value_; }
+
+	T* get() const { return value_; }
+
+	/**
+	 * \brief Publishes \p value and returns the previous version without
+	 *        waiting for readers.
+	 */
+	T* publish(T *value)
+	{
+		T *old = value_;
+		// Initialize the new version before it becomes visible.
+		__sync_synchronize();
+		value_ = value;
+		return old;
+	}
+
+	/**
+	 * \brief Publishes \p value and deletes the previous version.
+	 */
+	void update(T *value)
+	{
+		T *old = publish(value);
+		if (old != NULL) {
+			domain_->synchronize();
+			delete old;
+		}
+	}
+};
+
+
+/** @} */
+
+
+} // namespace cppapp
+
+
+#endif /* end of include guard: RCU_T6MB3XWE */
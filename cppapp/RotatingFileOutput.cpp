@@ -0,0 +1,527 @@
+/**
+ * \file   RotatingFileOutput.cpp
+ * \author Jan Milík <milikjan@fit.cvut.cz>
+ * \date   2026-10-19
+ *
+ * \brief  Implementation file for the RotatingFileOutput class.
+ */
+
+#include "RotatingFileOutput.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <spawn.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <deque>
+#include <iostream>
+
+#include "Mutex.h"
+#include "Thread.h"
+#include "utils.h"
+
+
+extern char **environ;
+
+
+namespace cppapp {
+
+
+////////////////////////////////////////////////////////////////////////////////
+// ROTATED FILES
+////////////////////////////////////////////////////////////////////////////////
+
+
+static void splitPath(const string &path, string *dir, string *base)
+{
+	size_t slash = path.rfind('/');
+	if (slash == string::npos) {
+		*dir  = ".";
+		*base = path;
+	} else {
+		*dir  = (slash == 0) ? "/" : path.substr(0, slash);
+		*base = path.substr(slash + 1);
+	}
+}
+
+
+/**
+ * Rotated files are named <tt>BASE.YYYYmmdd-HHMMSS-NNN</tt>, possibly
+ * followed by a compression suffix, so sorting them by name sorts them
+ * by age.
+ */
+static vector<string> listRotatedFiles(const string &fileName)
+{
+	string dir, base;
+	splitPath(fileName, &dir, &base);
+	string prefix = base + ".";
+
+	vector<string> result;
+
+	DIR *d = opendir(dir.c_str());
+	if (d == NULL)
+		return result;
+
+	struct dirent *entry;
+	while ((entry = readdir(d)) != NULL) {
+		const char *name = entry->d_name;
+		if ((strncmp(name, prefix.c_str(), prefix.size()) != 0) ||
+		    (strlen(name) < prefix.size() + 19))
+			continue;
+		const char *stamp = name + prefix.size();
+		if ((stamp[8] != '-') || (stamp[15] != '-') || (stamp[0] < '0') || (stamp[0] > '9'))
+			continue;
+		result.push_back(name);
+	}
+	closedir(d);
+
+	std::sort(result.begin(), result.end());
+	FOR_EACH(result, name) {
+		*name = (dir == "/" ? "" : dir) + "/" + *name;
+	}
+	return result;
+}
+
+
+static bool fileExists(const string &path)
+{
+	struct stat st;
+	return stat(path.c_str(), &st) == 0;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// COMPRESSOR
+////////////////////////////////////////////////////////////////////////////////
+
+
+/**
+ * \brief Background thread compressing rotated files and removing the
+ *        old ones.
+ */
+class RotatingFileCompressor : public Thread {
+private:
+	Mutex              mutex_;
+	Condition          changed_;
+	std::deque<string> queue_;
+	bool               busy_;
+	bool               stopping_;
+
+	string             fileName_;
+	int                maxFiles_;
+	RotateCompression  compression_;
+
+	void compress(const string &path)
+	{
+		const char *argv[6];
+		int argc = 0;
+
+		switch (compression_) {
+		case ROTATE_COMPRESS_GZIP:
+			argv[argc++] = "gzip";
+			argv[argc++] = "-f";
+			argv[argc++] = "-q";
+			break;
+		case ROTATE_COMPRESS_ZSTD:
+			argv[argc++] = "zstd";
+			argv[argc++] = "-f";
+			argv[argc++] = "-q";
+			argv[argc++] = "--rm";
+			break;
+		default:
+			return;
+		}
+		argv[argc++] = path.c_str();
+		argv[argc++] = NULL;
+
+		// If the command is missing or fails, the file is kept uncompressed.
+		pid_t pid;
+		if (posix_spawnp(&pid, argv[0], NULL, NULL, (char* const*)argv, environ) != 0)
+			return;
+		int status;
+		while ((waitpid(pid, &status, 0) < 0) && (errno == EINTR))
+			;
+	}
+
+	void removeOld()
+	{
+		if (maxFiles_ <= 0)
+			return;
+
+		vector<string> files = listRotatedFiles(fileName_);
+		for (int i = 0; i + maxFiles_ < (int)files.size(); i++)
+			unlink(files[i].c_str());
+	}
+
+public:
+	RotatingFileCompressor(const string &fileName, int maxFiles, RotateCompression compression) :
+		Thread(false),
+		busy_(false),
+		stopping_(false),
+		fileName_(fileName),
+		maxFiles_(maxFiles),
+		compression_(compression)
+	{
+		start();
+	}
+
+	void add(const string &path)
+	{
+		MutexLock lock(&mutex_);
+		queue_.push_back(path);
+		changed_.broadcast();
+	}
+
+	/**
+	 * \brief Waits until all queued files have been processed.
+	 */
+	void waitIdle()
+	{
+		MutexLock lock(&mutex_);
+		while (busy_ || !queue_.empty())
+			changed_.wait(mutex_);
+	}
+
+	void stop()
+	{
+		{
+			MutexLock lock(&mutex_);
+			stopping_ = true;
+			changed_.broadcast();
+		}
+		join();
+	}
+
+	/**
+	 * Old files are removed before compressing, so that files which would
+	 * be removed anyway are not compressed.
+	 */
+	virtual void* run()
+	{
+		std::deque<string> batch;
+
+		while (true) {
+			{
+				MutexLock lock(&mutex_);
+				busy_ = false;
+				changed_.broadcast();
+				while (queue_.empty() && !stopping_)
+					changed_.wait(mutex_);
+				if (queue_.empty())
+					break;
+				batch.swap(queue_);
+				busy_ = true;
+			}
+
+			removeOld();
+			FOR_EACH(batch, path) {
+				if (fileExists(*path))
+					compress(*path);
+			}
+			batch.clear();
+		}
+
+		return NULL;
+	}
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// FILE BUFFER
+////////////////////////////////////////////////////////////////////////////////
+
+
+/**
+ * \brief Stream buffer writing to a file descriptor and rotating the file.
+ */
+class RotatingFileBuffer : public std::streambuf {
+private:
+	string                  fileName_;
+	size_t                  maxSize_;
+	int                     interval_;
+	RotatingFileCompressor *compressor_;
+
+	vector<char>            buffer_;
+	int                     fd_;
+	size_t                  fileSize_;
+	time_t                  opened_;
+
+	string                  lastStamp_;
+	int                     sequence_;
+	bool                    failed_;
+
+	size_t pending() const { return pptr() - pbase(); }
+
+	/**
+	 * Reports the first of consecutive failures to \c stderr; the output
+	 * may be used by the logger itself, so it cannot log them.
+	 */
+	void reportError(const char *action)
+	{
+		int error = errno;
+		if (failed_)
+			return;
+		failed_ = true;
+		std::cerr << "Cannot " << action << " " << fileName_ << ": "
+		          << strerror(error) << std::endl;
+	}
+
+	bool openFile()
+	{
+		fd_ = ::open(fileName_.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+		if (fd_ < 0) {
+			reportError("open");
+			return false;
+		}
+
+		struct stat st;
+		fileSize_ = (fstat(fd_, &st) == 0) ? st.st_size : 0;
+		opened_   = time(NULL);
+		return true;
+	}
+
+	/**
+	 * After a failed write the file is closed, so the next write reopens
+	 * it (and rotates it if it is too large).
+	 */
+	bool writeAll(const char *data, size_t size)
+	{
+		if ((fd_ < 0) && !openFile())
+			return false;
+
+		while (size > 0) {
+			ssize_t written = ::write(fd_, data, size);
+			if (written < 0) {
+				if (errno == EINTR)
+					continue;
+				reportError("write to");
+				::close(fd_);
+				fd_ = -1;
+				return false;
+			}
+			data      += written;
+			size      -= written;
+			fileSize_ += written;
+		}
+		failed_ = false;
+		return true;
+	}
+
+	bool flushBuffer()
+	{
+		size_t size = pending();
+		setp(&buffer_[0], &buffer_[0] + buffer_.size());
+		if (size == 0)
+			return true;
+		return writeAll(&buffer_[0], size);
+	}
+
+	string nextRotatedName()
+	{
+		time_t    now = time(NULL);
+		struct tm local;
+		char      stamp[32];
+		localtime_r(&now, &local);
+		strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &local);
+
+		if (lastStamp_ != stamp) {
+			lastStamp_ = stamp;
+			sequence_  = 0;
+		}
+
+		while (true) {
+			char name[64];
+			snprintf(name, sizeof(name), ".%s-%03d", stamp, sequence_++);
+			string path = fileName_ + name;
+			if (!fileExists(path) && !fileExists(path + ".gz") && !fileExists(path + ".zst"))
+				return path;
+		}
+	}
+
+	/**
+	 * Rotates the file before \p incoming bytes are written if they would
+	 * not fit into it, or if the file is too old. A closed file is
+	 * reopened first, so that its size is known.
+	 */
+	void checkRotation(size_t incoming)
+	{
+		if ((fd_ < 0) && !openFile())
+			return;
+
+		size_t size = fileSize_ + pending();
+		if (size == 0)
+			return;
+
+		if (((maxSize_ > 0) && (size + incoming > maxSize_)) ||
+		    ((interval_ > 0) && (time(NULL) >= opened_ + interval_)))
+			rotate();
+	}
+
+protected:
+	virtual int_type overflow(int_type c)
+	{
+		checkRotation(1);
+		if (!flushBuffer())
+			return traits_type::eof();
+		if (c != traits_type::eof()) {
+			*pptr() = (char)c;
+			pbump(1);
+		}
+		return traits_type::not_eof(c);
+	}
+
+	virtual std::streamsize xsputn(const char *s, std::streamsize n)
+	{
+		checkRotation(n);
+
+		if ((size_t)n > (size_t)(epptr() - pptr())) {
+			if (!flushBuffer())
+				return 0;
+			if ((size_t)n >= buffer_.size())
+				return writeAll(s, n) ? n : 0;
+		}
+
+		memcpy(pptr(), s, n);
+		pbump(n);
+		return n;
+	}
+
+	virtual int sync()
+	{
+		return flushBuffer() ? 0 : -1;
+	}
+
+public:
+	RotatingFileBuffer(const string           &fileName,
+	                   size_t                  maxSize,
+	                   int                     interval,
+	                   size_t                  bufferSize,
+	                   RotatingFileCompressor *compressor) :
+		fileName_(fileName),
+		maxSize_(maxSize),
+		interval_(interval),
+		compressor_(compressor),
+		buffer_(bufferSize > 0 ? bufferSize : 1),
+		fd_(-1),
+		fileSize_(0),
+		opened_(0),
+		sequence_(0),
+		failed_(false)
+	{
+		setp(&buffer_[0], &buffer_[0] + buffer_.size());
+		openFile();
+	}
+
+	~RotatingFileBuffer() { close(); }
+
+	const string& getFileName() const { return fileName_; }
+
+	void rotate()
+	{
+		flushBuffer();
+		if (fd_ < 0)
+			return;
+		if (fileSize_ == 0) {
+			opened_ = time(NULL);
+			return;
+		}
+
+		::close(fd_);
+		fd_ = -1;
+
+		string rotated = nextRotatedName();
+		if (rename(fileName_.c_str(), rotated.c_str()) == 0)
+			compressor_->add(rotated);
+		openFile();
+	}
+
+	void close()
+	{
+		flushBuffer();
+		if (fd_ >= 0) {
+			::close(fd_);
+			fd_ = -1;
+		}
+	}
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// ROTATING FILE OUTPUT
+////////////////////////////////////////////////////////////////////////////////
+
+
+RotatingFileOutput::RotatingFileOutput(const std::string &fileName,
+                                       size_t             maxSize,
+                                       int                maxFiles,
+                                       int                interval,
+                                       RotateCompression  compression,
+                                       size_t             bufferSize) :
+	buffer_(NULL),
+	compressor_(new RotatingFileCompressor(fileName, maxFiles, compression)),
+	stream_(NULL)
+{
+	buffer_ = new RotatingFileBuffer(fileName, maxSize, interval, bufferSize, compressor_);
+	stream_.rdbuf(buffer_);
+}
+
+
+RotatingFileOutput::~RotatingFileOutput()
+{
+	close();
+	compressor_->stop();
+
+	stream_.rdbuf(NULL);
+	delete buffer_;
+	delete compressor_;
+}
+
+
+string RotatingFileOutput::getName()
+{
+	return buffer_->getFileName();
+}
+
+
+/**
+ * A write that failed sets \c badbit, which would make the stream ignore
+ * all later records. The state is cleared, so that the next record tries
+ * to reopen the file.
+ */
+ostream* RotatingFileOutput::getStream()
+{
+	if (!stream_.good())
+		stream_.clear();
+	return &stream_;
+}
+
+
+/**
+ * The file is reopened by the next write.
+ */
+void RotatingFileOutput::close()
+{
+	stream_.flush();
+	buffer_->close();
+	compressor_->waitIdle();
+}
+
+
+void RotatingFileOutput::rotate()
+{
+	buffer_->rotate();
+}
+
+
+std::vector<std::string> RotatingFileOutput::getRotatedFiles()
+{
+	return listRotatedFiles(buffer_->getFileName());
+}
+
+
+} // namespace cppapp
@@ -0,0 +1,129 @@
+/**
+ * \file   RotatingFileOutput.h
+ * \author Jan Milík <milikjan@fit.cvut.cz>
+ * \date   2026-10-19
+ *
+ * \brief  Header file for the RotatingFileOutput class.
+ */
+
+#ifndef ROTATINGFILEOUTPUT_P4ZN8CVD
+#define ROTATINGFILEOUTPUT_P4ZN8CVD
+
+
+#include <ctime>
+#include <string>
+#include <vector>
+#include <ostream>
+
+#include "Output.h"
+
+
+#define CPPAPP_ROTATE_MAX_SIZE    (64 * 1024 * 1024)
+#define CPPAPP_ROTATE_MAX_FILES   8
+#define CPPAPP_ROTATE_BUFFER_SIZE (256 * 1024)
+
+
+namespace cppapp {
+
+
+/** \addtogroup logging
+ * @{
+ */
+
+
+/**
+ * \brief Compression applied to rotated files.
+ */
+enum RotateCompression {
+	ROTATE_COMPRESS_NONE,
+	/// Compressed by the external \c gzip command.
+	ROTATE_COMPRESS_GZIP,
+	/// Compressed by the external \c zstd command.
+	ROTATE_COMPRESS_ZSTD
+};
+
+
+class RotatingFileBuffer;
+class RotatingFileCompressor;
+
+
+/**
+ * \brief File output that is rotated when it grows too large or too old.
+ *
+ * Data are collected in a large buffer and written to the file only when
+ * the buffer is full or the stream is flushed. Rotation renames the file
+ * to <tt>NAME.YYYYmmdd-HHMMSS-NNN</tt> and starts a new one; a single
+ * write (for example one log record) is never split between two files.
+ *
+ * Rotated files are compressed and the old ones removed by a background
+ * thread, so writers only pay for the rename.
+ *
+ * \code
+ * Logger::addOutput(LOG_LVL_INFO,
+ *                   new RotatingFileOutput("app.log", 16 << 20, 10,
+ *                                          24 * 3600, ROTATE_COMPRESS_GZIP));
+ * \endcode
+ *
+ * A failed write is reported to \c stderr once, the data are dropped
+ * and the next write reopens the file.
+ *
+ * \note The output is not synchronized. When it is used by \ref Logger,
+ *       the logger serializes the writes.
+ */
+class RotatingFileOutput : public Output {
+private:
+	RotatingFileOutput(const RotatingFileOutput &other);
+
+	RotatingFileBuffer     *buffer_;
+	RotatingFileCompressor *compressor_;
+	std::ostream            stream_;
+
+public:
+	/**
+	 * \brief Constructor.
+	 *
+	 * \param fileName    path of the file written to; rotated files are
+	 *                    stored next to it
+	 * \param maxSize     file size in bytes that triggers rotation,
+	 *                    0 disables size-based rotation
+	 * \param maxFiles    number of rotated files kept, 0 keeps all
+	 * \param interval    maximum age of the file in seconds, 0 disables
+	 *                    time-based rotation
+	 * \param compression compression of rotated files
+	 * \param bufferSize  size of the write buffer in bytes
+	 */
+	RotatingFileOutput(const std::string &fileName,
+	                   size_t             maxSize     = CPPAPP_ROTATE_MAX_SIZE,
+	                   int                maxFiles    = CPPAPP_ROTATE_MAX_FILES,
+	                   int                interval    = 0,
+	                   RotateCompression  compression = ROTATE_COMPRESS_NONE,
+	                   size_t             bufferSize  = CPPAPP_ROTATE_BUFFER_SIZE);
+	virtual ~RotatingFileOutput();
+
+	virtual string   getName();
+	virtual ostream* getStream();
+	/**
+	 * \brief Flushes the buffer, closes the file and waits for the
+	 *        pending compressions.
+	 */
+	virtual void     close();
+
+	/**
+	 * \brief Rotates the file now (unless it is empty).
+	 */
+	void rotate();
+
+	/**
+	 * \brief Returns the paths of the rotated files, oldest first.
+	 */
+	std::vector<std::string> getRotatedFiles();
+};
+
+
+/** @} */
+
+
+} // namespace cppapp
+
+
+#endif /* end of include guard: ROTATINGFILEOUTPUT_P4ZN8CVD */
@@ -11,9 +11,11 @@
 
 
 #include <cstdlib>
-#include <sys/time.h>
+#include <stdint.h>
 #include <iostream>
 
+#include "Clock.h"
+
 
 namespace cppapp {
 
@@ -21,30 +23,43 @@ namespace cppapp {
 #define MICROSECONDS_PER_SECOND 1000000
 #define MILLISECONDS_PER_SECOND 1000
 #define MICROSECONDS_PER_MILLISECOND 1000
+#define NANOSECONDS_PER_MILLISECOND 1000000
 
 using namespace std;
 
+/**
+ * \brief Measures time between \ref start() and \ref end() using
+ *        a monotonic clock (see \ref Clock).
+ */
 class Stopwatch {
 private:
-	struct timeval startTime;
-	struct timeval endTime;
-	
-	static double timevalToMS(timeval t) {
-		return ((double)t.tv_sec * (double)MILLISECONDS_PER_SECOND) +
-		       ((double)t.tv_usec / (double)MICROSECONDS_PER_MILLISECOND);
-	}
+	ClockBackend backend_;
+	uint64_t     startTime;
+	uint64_t     endTime;
 
 public:
+	Stopwatch(ClockBackend backend = CLOCK_BACKEND_MONOTONIC) :
+		backend_(backend), startTime(0), endTime(0)
+	{}
+	
 	inline void start() {
-		gettimeofday(&startTime, NULL);
+		startTime = Clock::now(backend_);
 	}
 	
 	inline void end() {
-		gettimeofday(&endTime, NULL);
+		endTime = Clock::now(backend_);
+	}
+	
+	uint64_t getNanoseconds() const {
+		return Clock::toNanos(backend_, endTime - startTime);
+	}
+	
+	double getMicroseconds() const {
+		return (double)getNanoseconds() / 1000.0;
 	}
 	
 	double getMilliseconds() const {
-		return timevalToMS(endTime) - timevalToMS(startTime);
+		return (double)getNanoseconds() / (double)NANOSECONDS_PER_MILLISECOND;
 	}
 };
 
@@ -56,4 +71,3 @@ ostream& operator << (ostream& output, const Stopwatch& stopwatch);
 
 
 #endif /* end of include guard: STOPWATCH_PFJWTBKJ */
-
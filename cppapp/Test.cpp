@@ -11,6 +11,17 @@
 #include "Logger.h"
 #include "utils.h"
 
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <list>
+#include <set>
+
 
 namespace cppapp {
 
@@ -186,6 +197,23 @@ void TestCase::reset()
 ////////////////////////////////////////////////////////////////////////////////
 
 
+void TestRunner::recordResult(Ref<TestRef> test, const TestResult &result)
+{
+	if (!result.success) {
+		if (result.expectedFailure)
+			expectedFailureCount_++;
+		else if (result.exception)
+			exceptionCount_++;
+		else
+			failureCount_++;
+	}
+	
+	addTestResult(test, result);
+	
+	testCount_++;
+}
+
+
 void TestRunner::run(const TestSuite &tests)
 {
 	testCount_ = 0;
@@ -195,22 +223,13 @@ void TestRunner::run(const TestSuite &tests)
 	
 	startTests(tests);
 	
-	FOR_EACH(tests, test) {
-		startTest(*test);
-		
-		TestResult result = (*test)->run();
-		if (!result.success) {
-			if (result.expectedFailure)
-				expectedFailureCount_++;
-			else if (result.exception)
-				exceptionCount_++;
-			else
-				failureCount_++;
+	if ((jobs_ != 1) || (timeout_ > 0)) {
+		runForked(tests);
+	} else {
+		FOR_EACH(tests, test) {
+			startTest(*test);
+			recordResult(*test, (*test)->run());
 		}
-		
-		addTestResult(*test, result);
-		
-		testCount_++;
 	}
 	
 	finishTests(tests);
@@ -233,6 +252,374 @@ void TestRunner::debug(const TestSuite &tests)
 }
 
 
+////////////////////////////////////////////////////////////////////////////////
+// FORKED TEST RUNNER
+////////////////////////////////////////////////////////////////////////////////
+
+
+/**
+ * \brief Returns a copy of \p value that lives until the process exits.
+ *
+ * Results received from test processes point to these copies, the
+ * strings of the parent are not valid in the child and vice versa.
+ */
+static const char* internTestString(const std::string &value)
+{
+	static std::set<std::string> *strings = new std::set<std::string>();
+	return strings->insert(value).first->c_str();
+}
+
+
+static long long monotonicMillis()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (long long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+
+static void writeAll(int fd, const std::string &data)
+{
+	size_t written = 0;
+	while (written < data.size()) {
+		ssize_t count = ::write(fd, data.data() + written, data.size() - written);
+		if (count < 0) {
+			if (errno == EINTR)
+				continue;
+			return;
+		}
+		written += count;
+	}
+}
+
+
+static void encodeInt(std::string *out, int value)
+{
+	out->append((const char*)&value, sizeof(value));
+}
+
+
+static void encodeString(std::string *out, const std::string &value)
+{
+	encodeInt(out, value.size());
+	out->append(value);
+}
+
+
+/**
+ * The backtrace is not transferred, only the fields reported by the
+ * runners.
+ */
+static std::string encodeResult(const TestResult &result)
+{
+	std::string out;
+	encodeInt(&out, result.success);
+	encodeInt(&out, result.exception);
+	encodeInt(&out, result.expectedFailure);
+	encodeInt(&out, result.expectedException);
+	encodeInt(&out, result.hasLocation);
+	encodeInt(&out, result.line);
+	encodeString(&out, result.file == NULL ? "" : result.file);
+	encodeString(&out, result.assertion);
+	encodeString(&out, result.message == NULL ? "" : result.message);
+	return out;
+}
+
+
+struct TestResultDecoder {
+	const std::string &data;
+	size_t             position;
+	
+	TestResultDecoder(const std::string &data) : data(data), position(0) {}
+	
+	bool decodeInt(int *value)
+	{
+		if (data.size() - position < sizeof(*value))
+			return false;
+		memcpy(value, data.data() + position, sizeof(*value));
+		position += sizeof(*value);
+		return true;
+	}
+	
+	bool decodeString(std::string *value)
+	{
+		int size;
+		if (!decodeInt(&size) || (size < 0) || (data.size() - position < (size_t)size))
+			return false;
+		value->assign(data, position, size);
+		position += size;
+		return true;
+	}
+	
+	bool decode(TestResult *result)
+	{
+		int success, exception, expectedFailure, expectedException, hasLocation;
+		std::string file, message;
+		
+		if (!decodeInt(&success) || !decodeInt(&exception) ||
+		    !decodeInt(&expectedFailure) || !decodeInt(&expectedException) ||
+		    !decodeInt(&hasLocation) || !decodeInt(&result->line) ||
+		    !decodeString(&file) || !decodeString(&result->assertion) ||
+		    !decodeString(&message))
+			return false;
+		
+		result->success           = success;
+		result->exception         = exception;
+		result->expectedFailure   = expectedFailure;
+		result->expectedException = expectedException;
+		result->hasLocation       = hasLocation;
+		result->file              = internTestString(file);
+		result->message           = internTestString(message);
+		return true;
+	}
+};
+
+
+/**
+ * \brief Test running in a forked process.
+ */
+struct TestJob {
+	size_t      index;
+	pid_t       pid;
+	int         resultFd;
+	int         outputFd;
+	long long   deadline;
+	bool        timedOut;
+	/// Why the test process was killed by the runner, if it was.
+	std::string error;
+	std::string result;
+	std::string output;
+};
+
+
+/**
+ * Runs the test in the child and writes the result into \p resultFd.
+ * Everything the test writes to stdout and stderr goes to \p outputFd.
+ * The logger is usable in the child (it takes its locks across fork()
+ * and logs synchronously there), so its records are flushed as well.
+ */
+static void runTestChild(Ref<TestRef> test, int resultFd, int outputFd)
+{
+	dup2(outputFd, STDOUT_FILENO);
+	dup2(outputFd, STDERR_FILENO);
+	close(outputFd);
+	
+	TestResult result = test->run();
+	
+	Logger::flushAll();
+	std::cout.flush();
+	std::cerr.flush();
+	fflush(NULL);
+	
+	writeAll(resultFd, encodeResult(result));
+	_exit(0);
+}
+
+
+static bool startTestJob(Ref<TestRef> test, TestJob *job, int timeout)
+{
+	int resultPipe[2];
+	int outputPipe[2];
+	
+	if (pipe2(resultPipe, O_CLOEXEC) != 0)
+		return false;
+	if (pipe2(outputPipe, O_CLOEXEC) != 0) {
+		close(resultPipe[0]);
+		close(resultPipe[1]);
+		return false;
+	}
+	
+	// Anything buffered would be written by the child as well.
+	std::cout.flush();
+	std::cerr.flush();
+	fflush(NULL);
+	
+	pid_t pid = fork();
+	if (pid == 0) {
+		close(resultPipe[0]);
+		close(outputPipe[0]);
+		runTestChild(test, resultPipe[1], outputPipe[1]);
+	}
+	
+	close(resultPipe[1]);
+	close(outputPipe[1]);
+	if (pid < 0) {
+		close(resultPipe[0]);
+		close(outputPipe[0]);
+		return false;
+	}
+	
+	job->pid      = pid;
+	job->resultFd = resultPipe[0];
+	job->outputFd = outputPipe[0];
+	job->deadline = (timeout > 0) ? monotonicMillis() + timeout : 0;
+	job->timedOut = false;
+	job->error.clear();
+	return true;
+}
+
+
+/**
+ * \brief Reads what is available from \p fd, closes it at the end of
+ *        the stream.
+ */
+static void readTestPipe(int *fd, std::string *buffer)
+{
+	char data[4096];
+	ssize_t count = ::read(*fd, data, sizeof(data));
+	if (count > 0) {
+		buffer->append(data, count);
+	} else if ((count == 0) || (errno != EINTR)) {
+		close(*fd);
+		*fd = -1;
+	}
+}
+
+
+static TestResult finishTestJob(Ref<TestRef> test, TestJob *job, int timeout)
+{
+	if (job->resultFd >= 0)
+		close(job->resultFd);
+	if (job->outputFd >= 0)
+		close(job->outputFd);
+	
+	int status = 0;
+	while ((waitpid(job->pid, &status, 0) < 0) && (errno == EINTR))
+		;
+	
+	TestResult result;
+	TestResultDecoder decoder(job->result);
+	if (!job->timedOut && job->error.empty() && decoder.decode(&result))
+		return result;
+	
+	std::stringstream message;
+	if (!job->error.empty())
+		message << job->error;
+	else if (job->timedOut)
+		message << "Test timed out after " << timeout << " ms.";
+	else if (WIFSIGNALED(status))
+		message << "Test process was killed by signal " << WTERMSIG(status) <<
+			" (" << strsignal(WTERMSIG(status)) << ").";
+	else
+		message << "Test process exited with status " << WEXITSTATUS(status) << ".";
+	
+	result = TestResult(false, "", 0, "", internTestString(message.str()));
+	result.exception       = true;
+	result.expectedFailure = test->getExpectFailure();
+	return result;
+}
+
+
+/**
+ * Results are collected in the order the tests finish, but reported in
+ * the order of the suite as soon as all preceding tests are reported.
+ * A test that cannot be forked runs in this process.
+ */
+void TestRunner::runForked(const TestSuite &tests)
+{
+	std::vector<Ref<TestRef> > list(tests.begin(), tests.end());
+	std::vector<TestResult>    results(list.size());
+	std::vector<std::string>   outputs(list.size());
+	std::vector<bool>          finished(list.size(), false);
+	
+	int jobs = jobs_;
+	if (jobs <= 0)
+		jobs = sysconf(_SC_NPROCESSORS_ONLN);
+	if (jobs <= 0)
+		jobs = 1;
+	
+	std::list<TestJob> running;
+	size_t next     = 0;
+	size_t reported = 0;
+	
+	while (reported < list.size()) {
+		while (((int)running.size() < jobs) && (next < list.size())) {
+			TestJob job;
+			job.index = next++;
+			if (startTestJob(list[job.index], &job, timeout_)) {
+				running.push_back(job);
+			} else {
+				results[job.index]  = list[job.index]->run();
+				finished[job.index] = true;
+			}
+		}
+		
+		if (!running.empty()) {
+			std::vector<struct pollfd> fds;
+			long long now  = monotonicMillis();
+			int       wait = -1;
+			FOR_EACH(running, job) {
+				struct pollfd fd;
+				fd.events  = POLLIN;
+				fd.revents = 0;
+				if (job->resultFd >= 0) {
+					fd.fd = job->resultFd;
+					fds.push_back(fd);
+				}
+				if (job->outputFd >= 0) {
+					fd.fd = job->outputFd;
+					fds.push_back(fd);
+				}
+				if (job->deadline > 0) {
+					int left = (job->deadline > now) ? (int)(job->deadline - now) : 0;
+					if ((wait < 0) || (left < wait))
+						wait = left;
+				}
+			}
+			
+			if (poll(&fds[0], fds.size(), wait) < 0 && (errno != EINTR)) {
+				// The running tests cannot be watched, they fail.
+				std::string error = std::string("Could not wait for the test process: ") +
+				                    strerror(errno) + ".";
+				FOR_EACH(running, job) {
+					kill(job->pid, SIGKILL);
+					job->error = error;
+					results[job->index]  = finishTestJob(list[job->index], &*job, timeout_);
+					outputs[job->index].swap(job->output);
+					finished[job->index] = true;
+				}
+				running.clear();
+				continue;
+			}
+			
+			now = monotonicMillis();
+			for (std::list<TestJob>::iterator job = running.begin(); job != running.end(); ) {
+				FOR_EACH(fds, fd) {
+					if (fd->revents == 0)
+						continue;
+					if (fd->fd == job->resultFd)
+						readTestPipe(&job->resultFd, &job->result);
+					else if (fd->fd == job->outputFd)
+						readTestPipe(&job->outputFd, &job->output);
+				}
+				
+				if ((job->deadline > 0) && (now >= job->deadline) &&
+				    ((job->resultFd >= 0) || (job->outputFd >= 0))) {
+					kill(job->pid, SIGKILL);
+					job->timedOut = true;
+				} else if ((job->resultFd >= 0) || (job->outputFd >= 0)) {
+					++job;
+					continue;
+				}
+				
+				results[job->index]  = finishTestJob(list[job->index], &*job, timeout_);
+				outputs[job->index].swap(job->output);
+				finished[job->index] = true;
+				job = running.erase(job);
+			}
+		}
+		
+		while ((reported < list.size()) && finished[reported]) {
+			startTest(list[reported]);
+			if (!outputs[reported].empty())
+				addTestOutput(list[reported], outputs[reported]);
+			recordResult(list[reported], results[reported]);
+			reported++;
+		}
+	}
+}
+
+
 ////////////////////////////////////////////////////////////////////////////////
 // TEXT TEST RUNNER
 ////////////////////////////////////////////////////////////////////////////////
@@ -277,6 +664,16 @@ void TextTestRunner::startTest(Ref<TestRef> test)
 }
 
 
+/**
+ * The output is written between the name of the test and its result,
+ * where it would appear if the test ran in this process.
+ */
+void TextTestRunner::addTestOutput(Ref<TestRef> test, const std::string &output)
+{
+	*output_ << output << std::flush;
+}
+
+
 void TextTestRunner::addTestResult(Ref<TestRef> test, TestResult result)
 {
 	if (result.success) {
@@ -349,6 +746,8 @@ TestTestCase::TestTestCase() :
 	TEST_ADD2(TestTestCase, exceptionFailureTest, true);
 	TEST_ADD (TestTestCase, equalsAssertionTest);
 	TEST_ADD2(TestTestCase, equalsAssertionFailureTest, true);
+	TEST_ADD (TestTestCase, forkedRunnerTest);
+	TEST_ADD (TestTestCase, forkedLoggerTest);
 }
 
 
@@ -363,6 +762,34 @@ public:
 };
 
 
+class ForkedTestCase : public TestCase {
+public:
+	void passingTest() { std::cout << "passing" << std::endl; }
+	void failingTest() { TEST_FAIL("This is supposed to fail."); }
+	void crashingTest() { raise(SIGKILL); }
+	void hangingTest() { sleep(10); }
+	
+	ForkedTestCase() : TestCase()
+	{
+		TEST_ADD(ForkedTestCase, passingTest);
+		TEST_ADD(ForkedTestCase, failingTest);
+		TEST_ADD(ForkedTestCase, crashingTest);
+		TEST_ADD(ForkedTestCase, hangingTest);
+	}
+};
+
+
+class ForkedLoggerTestCase : public TestCase {
+public:
+	void loggingTest() { LOG_INFO("logged in the child"); }
+	
+	ForkedLoggerTestCase() : TestCase()
+	{
+		TEST_ADD(ForkedLoggerTestCase, loggingTest);
+	}
+};
+
+
 void TestTestCase::noFailureTest()
 {
 	//LocalTestCase testCase;
@@ -410,6 +837,47 @@ void TestTestCase::equalsAssertionFailureTest()
 }
 
 
+void TestTestCase::forkedRunnerTest()
+{
+	Ref<TestCase> testCase = new ForkedTestCase();
+	std::stringstream output;
+	
+	TextTestRunner runner(&output);
+	runner.setJobs(4);
+	runner.setTimeout(300);
+	runner.run(*testCase);
+	
+	TEST_EQUALS(4, runner.getTestCount(), "4 tests should have been executed.");
+	TEST_EQUALS(1, runner.getFailureCount(), "The failing test should have failed.");
+	TEST_EQUALS(2, runner.getExceptionCount(), "The crash and the timeout should have been reported.");
+	
+	std::string text = output.str();
+	size_t passing = text.find("passingTest... passing\nOK");
+	size_t failing = text.find("failingTest... ");
+	size_t hanging = text.find("hangingTest... ");
+	TEST_ASSERT(passing != std::string::npos, "The output of the test should have been captured.");
+	TEST_ASSERT((passing < failing) && (failing < hanging), "The results should be reported in order.");
+	TEST_ASSERT(text.find("timed out") != std::string::npos, "The timeout should have been reported.");
+}
+
+
+void TestTestCase::forkedLoggerTest()
+{
+	Ref<TestCase> testCase = new ForkedLoggerTestCase();
+	std::stringstream output;
+	
+	Logger::startAsync();
+	TextTestRunner runner(&output);
+	runner.setTimeout(5000);
+	runner.run(*testCase);
+	Logger::stopAsync();
+	
+	TEST_EQUALS(0, runner.getExceptionCount(), "The test should not hang.");
+	TEST_ASSERT(output.str().find("logged in the child") != std::string::npos,
+	            "Records logged in the child should be written.");
+}
+
+
 } /* namespace cppapp */
 
 
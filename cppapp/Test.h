@@ -36,72 +36,11 @@ class TestCase;
 ////////////////////////////////////////////////////////////////////////////////
 
 
-class TestBacktrace {
-private:
-	std::vector<void*> addresses_;
-	std::vector<std::string> lines_;
-	
-	bool getLines()
-	{
-		std::stringstream tmpStream;
-		std::vector<std::string> lines;
-		
-		FOR_EACH(addresses_, addr) {
-			tmpStream.str("");
-			tmpStream << "addr2line -fCp " << *addr << " 2> /dev/null";
-			
-			FILE *pipe = popen(tmpStream.str().c_str(), "r");
-			if (!pipe) {
-				tmpStream.str("");
-				tmpStream << "[" << *addr << "]";
-				lines.push_back(tmpStream.str());
-				continue;
-			}
-			
-			char buffer[128];
-			tmpStream.str("");
-			while (!feof(pipe)) {
-				if (fgets(buffer, 128, pipe) != NULL) {
-					for (char *p = buffer; (p < buffer + 128) && *p != '\n'; p++)
-						tmpStream << *p;
-				}
-			}
-			pclose(pipe);
-			
-			lines.push_back(tmpStream.str());
-		}
-		
-		lines_.swap(lines);
-		return true;
-	}
-	
-public:
-	typedef std::vector<std::string>::const_iterator Iterator;
-	
-	int size() const { return (int)addresses_.size(); }
-	
-	Iterator begin() const { return lines_.begin(); }
-	Iterator end() const { return lines_.end(); }
-	
-	std::string operator[](int index) { return lines_[index]; }
-	
-	void get()
-	{
-		void *buffer[30];
-		size_t size;
-		
-		size = backtrace(buffer, 30);
-		
-		vector<void*> result;
-		for (int i = 0; i < (int)size; i++) {
-			result.push_back(buffer[i]);
-		}
-		
-		addresses_.swap(result);
-		
-		getLines();
-	}
-};
+/**
+ * \brief Stack trace captured for a test, the lines are decoded when
+ *        first accessed.
+ */
+typedef Backtrace TestBacktrace;
 
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -369,6 +308,16 @@ public:
 ////////////////////////////////////////////////////////////////////////////////
 
 
+/**
+ * \brief Runs tests and counts their results.
+ *
+ * By default the tests run one after another in the calling process.
+ * With more than one job, or with a timeout, every test runs in its own
+ * forked process, so a crash or a hang fails only that test. Up to
+ * \ref getJobs() tests run at once; the results are still reported in
+ * the order of the suite, together with the output the test wrote to
+ * stdout and stderr.
+ */
 class TestRunner {
 private:
 	int testCount_;
@@ -376,23 +325,54 @@ private:
 	int exceptionCount_;
 	int expectedFailureCount_;
 	
+	int jobs_;
+	int timeout_;
+	
+	void runForked(const TestSuite &tests);
+	
 protected:
 	virtual void startTests(const TestSuite &tests) {}
 	virtual void finishTests(const TestSuite &tests) {}
 	virtual void startTest(Ref<TestRef> test) {}
+	virtual void addTestOutput(Ref<TestRef> test, const std::string &output) {}
 	virtual void addTestResult(Ref<TestRef> test, TestResult result) {}
 	
+	/**
+	 * \brief Counts the result and passes it to \ref addTestResult().
+	 */
+	void recordResult(Ref<TestRef> test, const TestResult &result);
+	
 	virtual void startDebug(const TestSuite &tests) {}
 	virtual void finishDebug(const TestSuite &tests) {}
 	virtual void startTestDebug(Ref<TestRef> test) {}
 	virtual void finishTestDebug(Ref<TestRef> test, TestResult result) {}
 
 public:
+	TestRunner() :
+		testCount_(0), failureCount_(0),
+		exceptionCount_(0), expectedFailureCount_(0),
+		jobs_(1), timeout_(0)
+	{}
+	virtual ~TestRunner() {}
+	
 	int getTestCount() const { return testCount_; }
 	int getFailureCount() const { return failureCount_; }
 	int getExceptionCount() const { return exceptionCount_; }
 	int getExpectedFailureCount() const { return expectedFailureCount_; }
 	
+	int  getJobs() const { return jobs_; }
+	/**
+	 * \brief Sets the number of tests run at once, 0 for the number of
+	 *        online processors.
+	 */
+	void setJobs(int value) { jobs_ = value; }
+	int  getTimeout() const { return timeout_; }
+	/**
+	 * \brief Sets the time limit of a single test in milliseconds, 0 for
+	 *        no limit.
+	 */
+	void setTimeout(int value) { timeout_ = value; }
+	
 	virtual void run(const TestSuite &tests);
 	virtual void debug(const TestSuite &tests);
 };
@@ -407,6 +387,7 @@ protected:
 	virtual void finishTests(const TestSuite &tests);
 	
 	virtual void startTest(Ref<TestRef> test);
+	virtual void addTestOutput(Ref<TestRef> test, const std::string &output);
 	virtual void addTestResult(Ref<TestRef> test, TestResult result);
 
 	virtual void startDebug(const TestSuite &tests);
@@ -434,6 +415,8 @@ public:
 	void exceptionFailureTest();
 	void equalsAssertionTest();
 	void equalsAssertionFailureTest();
+	void forkedRunnerTest();
+	void forkedLoggerTest();
 };
 
 
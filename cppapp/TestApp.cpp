@@ -19,6 +19,16 @@ void TestApp::setUp()
 	options().add('d',
 			    "debug_tests",
 			    "Debug unit tests.");
+	options().add('j',
+			    "1",
+			    "JOBS",
+			    "test_jobs",
+			    "Run JOBS tests at once, each in its own process (0 for the number of processors).");
+	options().add('t',
+			    "0",
+			    "SECONDS",
+			    "test_timeout",
+			    "Fail tests running longer than SECONDS, each test runs in its own process.");
 }
 
 
@@ -29,7 +39,10 @@ int TestApp::onRun()
 	if ((bool)options().get('d')) {
 		TestSuite::getDefaultSuite().debug();
 	} else {
-		TestSuite::getDefaultSuite().run();
+		TextTestRunner runner;
+		runner.setJobs(options().get('j').toLong());
+		runner.setTimeout(options().get('t').toLong() * 1000);
+		runner.run(TestSuite::getDefaultSuite());
 	}
 	
 	return EXIT_SUCCESS;
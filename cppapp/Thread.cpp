@@ -40,12 +40,21 @@ void Thread::exit(void *result)
 /**
  * Constructor.
  */
-Thread::Thread()
+Thread::Thread() :
+	started_(false)
 {
-#ifdef CPPAPP_DEBUG
-	LOG_DEBUG("Starting thread...");
-#endif
-	HANDLE_SYSERR(pthread_create(&thread_, NULL, threadFunction, this))
+	start();
+}
+
+
+/**
+ * Constructor.
+ */
+Thread::Thread(bool autoStart) :
+	started_(false)
+{
+	if (autoStart)
+		start();
 }
 
 
@@ -54,6 +63,19 @@ Thread::~Thread()
 }
 
 
+void Thread::start()
+{
+	if (started_)
+		return;
+	
+#ifdef CPPAPP_DEBUG
+	LOG_DEBUG("Starting thread...");
+#endif
+	started_ = true;
+	HANDLE_SYSERR(pthread_create(&thread_, NULL, threadFunction, this))
+}
+
+
 void* Thread::join()
 {
 	void *result;
@@ -36,15 +36,27 @@ private:
 	Thread(const Thread& other);
 	
 	pthread_t thread_;
+	bool      started_;
 	
 	static void* threadFunction(void *arg);
 
 protected:
 	void exit(void *result);
 	
+	/**
+	 * \brief Constructor.
+	 *
+	 * \param autoStart if \c false, the thread is not started until
+	 *                  \ref start() is called. Subclasses that initialize
+	 *                  members used by \ref run() should pass \c false
+	 *                  and call \ref start() at the end of their own
+	 *                  constructor.
+	 */
+	Thread(bool autoStart);
+	
 public:
 	/**
-	 * Constructor.
+	 * Constructor. Starts the thread immediately.
 	 */
 	Thread();
 	/**
@@ -52,6 +64,12 @@ public:
 	 */
 	virtual ~Thread();
 	
+	/**
+	 * \brief Starts the thread if it has not been started yet.
+	 */
+	void start();
+	bool isStarted() const { return started_; }
+	
 	void* join();
 	
 	virtual void* run() = 0;
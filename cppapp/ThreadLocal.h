@@ -0,0 +1,89 @@
+/**
+ * \file   ThreadLocal.h
+ * \author Jan Milík <milikjan@fit.cvut.cz>
+ * \date   2026-10-19
+ *
+ * \brief  Header file for the ThreadLocal class.
+ */
+
+#ifndef THREADLOCAL_R3KD8QZT
+#define THREADLOCAL_R3KD8QZT
+
+
+#include <cstddef>
+#include <pthread.h>
+
+#include "Exception.h"
+
+
+namespace cppapp {
+
+
+/** \addtogroup threading
+ * @{
+ */
+
+
+/**
+ * \brief Holds a separate instance of \c T for every thread.
+ *
+ * The instance is default-constructed the first time a thread calls
+ * \ref get() and it is deleted when the thread exits.
+ *
+ * \note Values of threads that are still running when the ThreadLocal
+ *       itself is destroyed are not deleted. Infrastructure that may be
+ *       used during static destruction (such as the logger) should
+ *       allocate its ThreadLocal on the heap and never delete it.
+ */
+template<class T>
+class ThreadLocal {
+private:
+	pthread_key_t key_;
+
+	ThreadLocal(const ThreadLocal<T>& other);
+	ThreadLocal<T>& operator=(const ThreadLocal<T>& other);
+
+	static void destroy(void *value) { delete (T*)value; }
+
+public:
+	ThreadLocal()
+	{
+		HANDLE_SYSERR(pthread_key_create(&key_, destroy));
+	}
+
+	~ThreadLocal()
+	{
+		pthread_key_delete(key_);
+	}
+
+	/**
+	 * \brief Returns the calling thread's instance, creating it if necessary.
+	 */
+	T& get()
+	{
+		T *value = (T*)pthread_getspecific(key_);
+		if (value == NULL) {
+			value = new T();
+			HANDLE_SYSERR(pthread_setspecific(key_, value));
+		}
+		return *value;
+	}
+
+	/**
+	 * \brief Returns the calling thread's instance or \c NULL if it
+	 *        has not been created yet.
+	 */
+	T* peek() const { return (T*)pthread_getspecific(key_); }
+
+	T* operator->() { return &get(); }
+	T& operator*()  { return get(); }
+};
+
+
+/** @} */
+
+
+} // namespace cppapp
+
+
+#endif /* end of include guard: THREADLOCAL_R3KD8QZT */
@@ -0,0 +1,168 @@
+/**
+ * \file   ThreadPool.cpp
+ * \author Jan Milík <milikjan@fit.cvut.cz>
+ * \date   2026-10-19
+ *
+ * \brief  Implementation file for the ThreadPool class.
+ */
+
+#include "ThreadPool.h"
+
+#include <unistd.h>
+
+#include "Thread.h"
+#include "Logger.h"
+#include "utils.h"
+
+
+namespace cppapp {
+
+
+////////////////////////////////////////////////////////////////////////////////
+// WORKER
+////////////////////////////////////////////////////////////////////////////////
+
+
+class ThreadPoolWorker : public Thread {
+private:
+	ThreadPool *pool_;
+
+public:
+	ThreadPoolWorker(ThreadPool *pool) : Thread(false), pool_(pool)
+	{
+		start();
+	}
+
+	virtual void* run()
+	{
+		pool_->workerLoop();
+		return NULL;
+	}
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// THREAD POOL
+////////////////////////////////////////////////////////////////////////////////
+
+
+ThreadPool::ThreadPool(int threads) :
+	stopping_(false)
+{
+	if (threads <= 0)
+		threads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (threads <= 0)
+		threads = 1;
+
+	for (int i = 0; i < threads; i++)
+		workers_.push_back(new ThreadPoolWorker(this));
+}
+
+
+ThreadPool::~ThreadPool()
+{
+	{
+		MutexLock lock(&mutex_);
+		stopping_ = true;
+		changed_.broadcast();
+	}
+
+	FOR_EACH(workers_, worker) {
+		(*worker)->join();
+		delete *worker;
+	}
+}
+
+
+void ThreadPool::runItem(std::deque<Item>::iterator position)
+{
+	Item item = *position;
+	queue_.erase(position);
+
+	mutex_.unlock();
+	try {
+		item.task->run();
+	} catch (std::exception &e) {
+		LOG_ERROR("Uncaught exception in a thread pool task: " << e.what());
+	} catch (...) {
+		LOG_ERROR("Uncaught exception in a thread pool task.");
+	}
+	item.task = NULL;
+	mutex_.lock();
+
+	if (item.group != NULL) {
+		item.group->pending_--;
+		if (item.group->pending_ == 0)
+			changed_.broadcast();
+	}
+}
+
+
+void ThreadPool::workerLoop()
+{
+	MutexLock lock(&mutex_);
+
+	while (true) {
+		while (queue_.empty() && !stopping_)
+			changed_.wait(mutex_);
+		if (queue_.empty())
+			break;
+		runItem(queue_.begin());
+	}
+}
+
+
+void ThreadPool::submit(Ref<Task> task)
+{
+	MutexLock lock(&mutex_);
+
+	Item item;
+	item.task  = task;
+	item.group = NULL;
+	queue_.push_back(item);
+	changed_.signal();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// TASK GROUP
+////////////////////////////////////////////////////////////////////////////////
+
+
+void TaskGroup::add(Ref<Task> task)
+{
+	MutexLock lock(&pool_->mutex_);
+
+	ThreadPool::Item item;
+	item.task  = task;
+	item.group = this;
+	pool_->queue_.push_back(item);
+	pending_++;
+	pool_->changed_.signal();
+}
+
+
+/**
+ * Only tasks of this group are run by the waiting thread. Every queued
+ * task of a waited-for group can be run by its waiter, so tasks waiting
+ * for their own subtasks cannot deadlock the pool, and a waiter never
+ * runs unrelated work that could depend on what the waiter is doing.
+ */
+void TaskGroup::wait()
+{
+	MutexLock lock(&pool_->mutex_);
+
+	while (pending_ > 0) {
+		VAR(it, pool_->queue_.begin());
+		while ((it != pool_->queue_.end()) && (it->group != this))
+			++it;
+
+		if (it != pool_->queue_.end())
+			pool_->runItem(it);
+		else
+			pool_->changed_.wait(pool_->mutex_);
+	}
+}
+
+
+} // namespace cppapp
@@ -0,0 +1,135 @@
+/**
+ * \file   ThreadPool.h
+ * \author Jan Milík <milikjan@fit.cvut.cz>
+ * \date   2026-10-19
+ *
+ * \brief  Header file for the ThreadPool class.
+ */
+
+#ifndef THREADPOOL_W7HC2MUE
+#define THREADPOOL_W7HC2MUE
+
+
+#include <deque>
+#include <vector>
+
+#include "Object.h"
+#include "Mutex.h"
+
+
+namespace cppapp {
+
+
+/** \addtogroup threading
+ * @{
+ */
+
+
+class TaskGroup;
+class ThreadPoolWorker;
+
+
+/**
+ * \brief Unit of work executed by a \ref ThreadPool.
+ */
+class Task : public Object {
+public:
+	virtual ~Task() {}
+
+	virtual void run() = 0;
+};
+
+
+/**
+ * \brief Fixed set of threads executing queued tasks.
+ *
+ * Tasks are usually submitted through a \ref TaskGroup. A thread waiting
+ * for a group runs the queued tasks of the group instead of blocking, so
+ * tasks can submit and wait for their own subtasks without exhausting
+ * the pool.
+ */
+class ThreadPool : public Object {
+friend class TaskGroup;
+friend class ThreadPoolWorker;
+private:
+	struct Item {
+		Ref<Task>  task;
+		TaskGroup *group;
+	};
+
+	ThreadPool(const ThreadPool &other);
+
+	Mutex                           mutex_;
+	Condition                       changed_;
+	std::deque<Item>                queue_;
+	std::vector<ThreadPoolWorker*>  workers_;
+	bool                            stopping_;
+
+	/**
+	 * \brief Removes a task from the queue and runs it. Must be called
+	 *        with \c mutex_ locked, it is unlocked while the task runs.
+	 */
+	void runItem(std::deque<Item>::iterator position);
+	void workerLoop();
+
+public:
+	/**
+	 * \brief Constructor.
+	 *
+	 * \param threads number of worker threads, 0 for the number of
+	 *                online processors
+	 */
+	ThreadPool(int threads = 0);
+	/**
+	 * \brief Destructor. Runs the queued tasks and joins the threads.
+	 */
+	virtual ~ThreadPool();
+
+	/**
+	 * \brief Queues a task that is not a part of any group.
+	 */
+	void submit(Ref<Task> task);
+
+	int  getThreadCount() const { return workers_.size(); }
+};
+
+
+/**
+ * \brief Set of tasks that can be waited for.
+ *
+ * \code
+ * TaskGroup group(pool);
+ * group.add(new SomeTask(...));
+ * group.add(new SomeTask(...));
+ * group.wait();
+ * \endcode
+ *
+ * The destructor waits for the unfinished tasks.
+ */
+class TaskGroup {
+friend class ThreadPool;
+private:
+	TaskGroup(const TaskGroup &other);
+
+	ThreadPool *pool_;
+	int         pending_;
+
+public:
+	TaskGroup(ThreadPool *pool) : pool_(pool), pending_(0) {}
+	~TaskGroup() { wait(); }
+
+	void add(Ref<Task> task);
+	/**
+	 * \brief Runs queued tasks of the group until all of them are finished.
+	 */
+	void wait();
+};
+
+
+/** @} */
+
+
+} // namespace cppapp
+
+
+#endif /* end of include guard: THREADPOOL_W7HC2MUE */
@@ -0,0 +1,278 @@
+/**
+ * \file   Trace.cpp
+ * \author Jan Milík <milikjan@fit.cvut.cz>
+ * \date   2026-10-19
+ *
+ * \brief  Implementation file for the Tracer class.
+ */
+
+#include "Trace.h"
+
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <cstdio>
+#include <iomanip>
+#include <vector>
+
+#include "Mutex.h"
+#include "ThreadLocal.h"
+#include "utils.h"
+
+
+namespace cppapp {
+
+
+////////////////////////////////////////////////////////////////////////////////
+// TRACE BUFFER
+////////////////////////////////////////////////////////////////////////////////
+
+
+/**
+ * \brief Single producer, single consumer ring of spans.
+ *
+ * The owning thread advances \c head, the flushing thread advances
+ * \c tail; each publishes its index with a release store after touching
+ * the slots.
+ */
+class TraceBuffer {
+private:
+	TraceBuffer(const TraceBuffer &other);
+	TraceBuffer& operator=(const TraceBuffer &other);
+
+	TraceEvent        events_[CPPAPP_TRACE_BUFFER_SIZE];
+	volatile uint64_t head_;
+	volatile uint64_t tail_;
+	volatile long     dropped_;
+	long              threadId_;
+	volatile bool     retired_;
+
+public:
+	TraceBuffer() :
+		head_(0), tail_(0), dropped_(0),
+		threadId_(syscall(SYS_gettid)), retired_(false)
+	{}
+
+	long getThreadId() const { return threadId_; }
+	long getDropped() const { return dropped_; }
+	bool isRetired() const { return __atomic_load_n(&retired_, __ATOMIC_ACQUIRE); }
+	void retire() { __atomic_store_n(&retired_, true, __ATOMIC_RELEASE); }
+
+	void push(const TraceEvent &event)
+	{
+		uint64_t head = head_;
+		if (head - __atomic_load_n(&tail_, __ATOMIC_ACQUIRE) >= CPPAPP_TRACE_BUFFER_SIZE) {
+			dropped_++;
+			return;
+		}
+		events_[head & (CPPAPP_TRACE_BUFFER_SIZE - 1)] = event;
+		__atomic_store_n(&head_, head + 1, __ATOMIC_RELEASE);
+	}
+
+	void drain(std::vector<TraceEvent> *events)
+	{
+		uint64_t tail = tail_;
+		uint64_t head = __atomic_load_n(&head_, __ATOMIC_ACQUIRE);
+		for (; tail != head; tail++)
+			events->push_back(events_[tail & (CPPAPP_TRACE_BUFFER_SIZE - 1)]);
+		__atomic_store_n(&tail_, tail, __ATOMIC_RELEASE);
+	}
+};
+
+
+/**
+ * \brief Retires the buffer of a thread when the thread exits.
+ */
+struct TraceThreadState {
+	TraceBuffer *buffer;
+
+	TraceThreadState() : buffer(NULL) {}
+	~TraceThreadState()
+	{
+		if (buffer != NULL)
+			buffer->retire();
+	}
+};
+
+
+static __thread TraceBuffer *threadBuffer = NULL;
+
+
+/**
+ * \brief Buffers of all threads that recorded a span.
+ */
+struct TraceRegistry {
+	Mutex                     mutex;
+	std::vector<TraceBuffer*> buffers;
+	long                      retiredDropped;
+	uint64_t                  baseTicks;
+
+	TraceRegistry() : retiredDropped(0), baseTicks(0) {}
+};
+
+
+/**
+ * The registry and the thread local storage are never deleted, spans may
+ * be recorded during static destruction.
+ */
+static TraceRegistry& getRegistry()
+{
+	static TraceRegistry *registry = new TraceRegistry();
+	return *registry;
+}
+
+
+static TraceBuffer* createThreadBuffer()
+{
+	static ThreadLocal<TraceThreadState> *states = new ThreadLocal<TraceThreadState>();
+
+	TraceRegistry &registry = getRegistry();
+	TraceBuffer   *buffer   = new TraceBuffer();
+	states->get().buffer = buffer;
+	{
+		MutexLock lock(&registry.mutex);
+		registry.buffers.push_back(buffer);
+	}
+	threadBuffer = buffer;
+	return buffer;
+}
+
+
+static void writeJSONString(std::ostream &output, const char *value)
+{
+	output << '"';
+	for (; *value != '\0'; value++) {
+		switch (*value) {
+		case '"':  output << "\\\""; break;
+		case '\\': output << "\\\\"; break;
+		default:
+			if ((unsigned char)*value < 0x20) {
+				char buffer[8];
+				snprintf(buffer, sizeof(buffer), "\\u%04x", *value);
+				output << buffer;
+			} else {
+				output << *value;
+			}
+		}
+	}
+	output << '"';
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// TRACER
+////////////////////////////////////////////////////////////////////////////////
+
+
+volatile bool Tracer::enabled_ = false;
+
+
+/**
+ * Timestamps in the output are relative to the first call.
+ */
+void Tracer::enable()
+{
+	TraceRegistry &registry = getRegistry();
+	{
+		MutexLock lock(&registry.mutex);
+		if (registry.baseTicks == 0)
+			registry.baseTicks = Clock::ticks();
+	}
+	enabled_ = true;
+}
+
+
+void Tracer::disable()
+{
+	enabled_ = false;
+}
+
+
+void Tracer::record(const char *name, uint64_t start, uint64_t end)
+{
+	TraceBuffer *buffer = threadBuffer;
+	if (buffer == NULL)
+		buffer = createThreadBuffer();
+
+	TraceEvent event;
+	event.name  = name;
+	event.start = start;
+	event.end   = end;
+	buffer->push(event);
+}
+
+
+/**
+ * Spans are written as complete (\c "X") events with microsecond times.
+ */
+void Tracer::writeJSON(std::ostream &output)
+{
+	std::ios_base::fmtflags flags     = output.flags();
+	std::streamsize         precision = output.precision();
+	output << std::fixed << std::setprecision(3);
+
+	long pid   = getpid();
+	bool first = true;
+
+	output << "{\"traceEvents\": [";
+
+	TraceRegistry &registry = getRegistry();
+	MutexLock      lock(&registry.mutex);
+
+	std::vector<TraceEvent> events;
+	for (size_t i = 0; i < registry.buffers.size(); ) {
+		TraceBuffer *buffer  = registry.buffers[i];
+		bool         retired = buffer->isRetired();
+
+		events.clear();
+		buffer->drain(&events);
+		FOR_EACH(events, event) {
+			uint64_t start = (event->start > registry.baseTicks) ?
+				event->start - registry.baseTicks : 0;
+			output << (first ? "" : ",") << "\n\t{\"name\": ";
+			writeJSONString(output, event->name);
+			output << ", \"ph\": \"X\""
+			       << ", \"ts\": "  << Clock::ticksToNanos(start) / 1000.0
+			       << ", \"dur\": " << Clock::ticksToNanos(event->end - event->start) / 1000.0
+			       << ", \"pid\": " << pid
+			       << ", \"tid\": " << buffer->getThreadId() << "}";
+			first = false;
+		}
+
+		// The owner has exited, nothing can be pushed anymore.
+		if (retired) {
+			registry.retiredDropped += buffer->getDropped();
+			delete buffer;
+			registry.buffers.erase(registry.buffers.begin() + i);
+		} else {
+			i++;
+		}
+	}
+
+	output << "\n], \"displayTimeUnit\": \"ns\"}\n";
+
+	output.flags(flags);
+	output.precision(precision);
+}
+
+
+void Tracer::flush(Ref<Output> output)
+{
+	std::ostream *stream = output->getStream();
+	writeJSON(*stream);
+	stream->flush();
+}
+
+
+long Tracer::getDroppedCount()
+{
+	TraceRegistry &registry = getRegistry();
+	MutexLock      lock(&registry.mutex);
+
+	long dropped = registry.retiredDropped;
+	FOR_EACH(registry.buffers, buffer)
+		dropped += (*buffer)->getDropped();
+	return dropped;
+}
+
+
+} // namespace cppapp
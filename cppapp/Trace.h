@@ -0,0 +1,144 @@
+/**
+ * \file   Trace.h
+ * \author Jan Milík <milikjan@fit.cvut.cz>
+ * \date   2026-10-19
+ *
+ * \brief  Header file for the Tracer class and the TRACE_SCOPE macro.
+ */
+
+#ifndef TRACE_M3VQ8XKD
+#define TRACE_M3VQ8XKD
+
+
+#include <stdint.h>
+#include <ostream>
+
+#include "Clock.h"
+#include "Object.h"
+#include "Output.h"
+
+
+/**
+ * \brief Number of spans buffered per thread between flushes (a power of
+ *        two). Spans that do not fit are dropped.
+ */
+#ifndef CPPAPP_TRACE_BUFFER_SIZE
+#define CPPAPP_TRACE_BUFFER_SIZE 16384
+#endif
+
+
+#define CPPAPP_TRACE_CONCAT_(a, b) a ## b
+#define CPPAPP_TRACE_CONCAT(a, b) CPPAPP_TRACE_CONCAT_(a, b)
+
+/**
+ * \brief Records a span from this point to the end of the enclosing scope.
+ *
+ * \p name must be a string that outlives the tracer, usually a literal.
+ */
+#define TRACE_SCOPE(name) \
+	::cppapp::TraceScope CPPAPP_TRACE_CONCAT(traceScope_, __LINE__)(name)
+
+
+namespace cppapp {
+
+
+/** \addtogroup threading
+ * @{
+ */
+
+
+/**
+ * \brief Completed span, times in \ref Clock::ticks().
+ */
+struct TraceEvent {
+	const char *name;
+	uint64_t    start;
+	uint64_t    end;
+};
+
+
+/**
+ * \brief Collects trace spans and writes them in the Chrome trace event
+ *        format.
+ *
+ * Every thread records its spans into its own ring buffer, with the
+ * thread as the only producer and \ref flush() as the only consumer, so
+ * recording takes no lock. \ref flush() drains all buffers and writes a
+ * JSON document that can be opened in \c chrome://tracing or Perfetto.
+ * Buffers of exited threads are released by the next flush.
+ *
+ * Tracing is disabled by default. \ref AppBase::run() enables it when the
+ * \c CPPAPP_TRACE environment variable names an output file and flushes
+ * to that file when the application finishes.
+ */
+class Tracer {
+private:
+	Tracer();
+
+	static volatile bool enabled_;
+
+	friend class TraceScope;
+
+public:
+	static bool isEnabled() { return enabled_; }
+	static void enable();
+	static void disable();
+
+	/**
+	 * \brief Records a span of the calling thread.
+	 */
+	static void record(const char *name, uint64_t start, uint64_t end);
+
+	/**
+	 * \brief Drains the recorded spans and writes them as a trace event
+	 *        JSON document.
+	 */
+	static void writeJSON(std::ostream &output);
+	static void flush(Ref<Output> output);
+
+	/**
+	 * \brief Returns the number of spans dropped because a buffer was
+	 *        full.
+	 */
+	static long getDroppedCount();
+};
+
+
+/**
+ * \brief Records a span for its lifetime, see \ref TRACE_SCOPE.
+ *
+ * While tracing is disabled, construction and destruction cost a single
+ * well predicted branch each.
+ */
+class TraceScope {
+private:
+	TraceScope(const TraceScope &other);
+	TraceScope& operator=(const TraceScope &other);
+
+	const char *name_;
+	uint64_t    start_;
+
+public:
+	TraceScope(const char *name) : name_(NULL)
+	{
+		if (__builtin_expect(Tracer::enabled_, 0)) {
+			name_  = name;
+			start_ = Clock::ticks();
+		}
+	}
+
+	~TraceScope()
+	{
+		if (__builtin_expect(name_ != NULL, 0))
+			Tracer::record(name_, start_, Clock::ticks());
+	}
+};
+
+
+/** @} */
+
+
+} // namespace cppapp
+
+
+#endif /* end of include guard: TRACE_M3VQ8XKD */
@@ -0,0 +1,214 @@
+/**
+ * \file   WeakCache.h
+ * \author Jan Milík <milikjan@fit.cvut.cz>
+ * \date   2026-10-19
+ *
+ * \brief  Header file for the WeakCache class.
+ */
+
+#ifndef WEAKCACHE_P5TJ9RZC
+#define WEAKCACHE_P5TJ9RZC
+
+
+#include <cstddef>
+#include <list>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "Object.h"
+#include "Mutex.h"
+
+
+namespace cppapp {
+
+
+/**
+ * \brief Cache of objects that keeps a bounded set of recently used
+ *        values alive and remembers the rest through weak references.
+ *
+ * Every value has a cost (1 by default, or e.g. its size in bytes). The
+ * most recently used values are held by \ref Ref as long as their total
+ * cost does not exceed the capacity; older values are held only by
+ * \ref WeakRef, so a value evicted from the cache is still found while
+ * somebody else uses it, but the cache never keeps more than its
+ * capacity alive. A value found through its weak reference becomes the
+ * most recently used again. Entries of destroyed values are dropped when
+ * they are looked up or by \ref purge(), which also runs when the weak
+ * entries outnumber the strong ones.
+ *
+ * The cache is synchronized. Evicted values are released after the lock
+ * is dropped, so their destructors may use the cache.
+ *
+ * \ingroup obj
+ */
+template<class K, class T>
+class WeakCache {
+private:
+	typedef std::list<std::pair<K, Ref<T> > > List;
+
+	struct Entry {
+		WeakRef<T>              weak;
+		size_t                  cost;
+		bool                    pinned;
+		typename List::iterator position;
+
+		Entry() : cost(0), pinned(false) {}
+	};
+
+	typedef std::map<K, Entry> Map;
+
+	WeakCache(const WeakCache &other);
+	WeakCache& operator=(const WeakCache &other);
+
+	mutable Mutex mutex_;
+	Map           entries_;
+	List          recent_;
+	size_t        capacity_;
+	size_t        cost_;
+
+	void pin(const K &key, Entry &entry, Ref<T> value)
+	{
+		recent_.push_front(std::make_pair(key, value));
+		entry.position = recent_.begin();
+		entry.pinned   = true;
+		cost_         += entry.cost;
+	}
+
+	void unpin(Entry &entry, std::vector<Ref<T> > *released)
+	{
+		released->push_back(entry.position->second);
+		recent_.erase(entry.position);
+		entry.pinned = false;
+		cost_       -= entry.cost;
+	}
+
+	void evict(std::vector<Ref<T> > *released)
+	{
+		while ((cost_ > capacity_) && !recent_.empty())
+			unpin(entries_[recent_.back().first], released);
+
+		if (entries_.size() > 2 * recent_.size() + 16)
+			purgeExpired();
+	}
+
+	void purgeExpired()
+	{
+		for (typename Map::iterator it = entries_.begin(); it != entries_.end(); ) {
+			if (!it->second.pinned && it->second.weak.isExpired())
+				entries_.erase(it++);
+			else
+				++it;
+		}
+	}
+
+public:
+	/**
+	 * \param capacity maximal total cost of the values kept alive
+	 */
+	WeakCache(size_t capacity) : capacity_(capacity), cost_(0) {}
+
+	/**
+	 * \brief Stores \p value under \p key, replacing the previous value.
+	 */
+	void put(const K &key, Ref<T> value, size_t cost = 1)
+	{
+		std::vector<Ref<T> > released;
+		MutexLock            lock(&mutex_);
+
+		Entry &entry = entries_[key];
+		if (entry.pinned)
+			unpin(entry, &released);
+		entry.weak = value;
+		entry.cost = cost;
+		pin(key, entry, value);
+		evict(&released);
+	}
+
+	/**
+	 * \brief Returns the value stored under \p key, or \c NULL if there
+	 *        is none or it has been destroyed.
+	 */
+	Ref<T> get(const K &key)
+	{
+		std::vector<Ref<T> > released;
+		MutexLock            lock(&mutex_);
+
+		typename Map::iterator found = entries_.find(key);
+		if (found == entries_.end())
+			return NULL;
+
+		Entry &entry = found->second;
+		if (entry.pinned) {
+			recent_.splice(recent_.begin(), recent_, entry.position);
+			return entry.position->second;
+		}
+
+		Ref<T> value = entry.weak.lock();
+		if (value.isNull()) {
+			entries_.erase(found);
+			return NULL;
+		}
+		pin(key, entry, value);
+		evict(&released);
+		return value;
+	}
+
+	void remove(const K &key)
+	{
+		std::vector<Ref<T> > released;
+		MutexLock            lock(&mutex_);
+
+		typename Map::iterator found = entries_.find(key);
+		if (found == entries_.end())
+			return;
+		if (found->second.pinned)
+			unpin(found->second, &released);
+		entries_.erase(found);
+	}
+
+	void clear()
+	{
+		List      released;
+		MutexLock lock(&mutex_);
+
+		released.swap(recent_);
+		entries_.clear();
+		cost_ = 0;
+	}
+
+	/**
+	 * \brief Drops the entries of destroyed values.
+	 */
+	void purge()
+	{
+		MutexLock lock(&mutex_);
+		purgeExpired();
+	}
+
+	/**
+	 * \brief Returns the number of entries, including the weak ones.
+	 */
+	size_t getSize() const
+	{
+		MutexLock lock(&mutex_);
+		return entries_.size();
+	}
+
+	/**
+	 * \brief Returns the total cost of the values kept alive.
+	 */
+	size_t getCost() const
+	{
+		MutexLock lock(&mutex_);
+		return cost_;
+	}
+
+	size_t getCapacity() const { return capacity_; }
+};
+
+
+} // namespace cppapp
+
+
+#endif /* end of include guard: WEAKCACHE_P5TJ9RZC */
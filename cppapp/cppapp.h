@@ -11,22 +11,38 @@
 
 #include "Debug.h"
 #include "AppBase.h"
+#include "BenchApp.h"
+#include "Benchmark.h"
+#include "BinaryLog.h"
+#include "Clock.h"
 #include "Config.h"
+#include "ConfigLayers.h"
+#include "ConfigWatcher.h"
+#include "CycleCollector.h"
 #include "DynObject.h"
 #include "Exception.h"
+#include "Histogram.h"
 #include "Injector.h"
 #include "Input.h"
 #include "Lexer.h"
 #include "Logger.h"
+#include "Metrics.h"
 #include "Mutex.h"
 #include "Object.h"
+#include "ObjectRegistry.h"
 #include "Options.h"
 #include "Output.h"
 #include "Path.h"
+#include "Rcu.h"
+#include "RotatingFileOutput.h"
 #include "Stopwatch.h"
 #include "Thread.h"
+#include "ThreadLocal.h"
+#include "ThreadPool.h"
 #include "Test.h"
 #include "TestApp.h"
+#include "Trace.h"
+#include "WeakCache.h"
 #include "string_utils.h"
 #include "json.h"
 #include "utils.h"
@@ -7,6 +7,8 @@
  */
 
 #include "json.h"
+#include "Metrics.h"
+#include "Trace.h"
 
 
 namespace cppapp {
@@ -293,12 +295,25 @@ Ref<DynObject> JSONParser::parse(std::istream *input, std::string fileName)
 
 Ref<DynObject> JSONParser::parse(Ref<Input> input)
 {
+	static MetricCounter *documents = MetricsRegistry::global().counter(
+		"cppapp_json_documents_total", "JSON documents parsed.");
+	static MetricCounter *errors = MetricsRegistry::global().counter(
+		"cppapp_json_errors_total", "JSON documents that failed to parse.");
+	static MetricCounter *bytes = MetricsRegistry::global().counter(
+		"cppapp_json_bytes_total", "Characters read by the JSON parser.");
+	
+	TRACE_SCOPE("JSONParser::parse");
 	lexer.input(input);
 	
 	Ref<DynObject> result;
 	if (!readObject(&result))
 		result = ERROR;
 	
+	documents->add();
+	if (result.isNull() || result->isError())
+		errors->add();
+	bytes->add(lexer.getConsumed());
+	
 	return result;
 }
 
@@ -13,6 +13,7 @@
 
 #include <stdint.h>
 #include <climits>
+#include <limits>
 #include <map>
 #include <ostream>
 #include <iostream>
@@ -255,6 +256,15 @@ struct IntMetrics {
 		count++;
 	}
 	
+	inline void merge(const IntMetrics<T> &other)
+	{
+		if (other.count == 0) return;
+		if ((count == 0) || (other.min < min)) min = other.min;
+		if ((count == 0) || (other.max > max)) max = other.max;
+		sum += other.sum;
+		count += other.count;
+	}
+	
 	inline void dump(ostream& out)
 	{
 		int avg = (int)(sum / (float)count);
@@ -271,6 +281,74 @@ struct IntMetrics {
 };
 
 
+/**
+ * \brief Counterpart of \ref IntMetrics that many threads can add to at
+ *        once without locking.
+ *
+ * \c T must be an integral type that the \c __sync builtins support.
+ */
+template<class T>
+struct ConcurrentIntMetrics {
+	volatile T         min;
+	volatile T         max;
+	
+	volatile int       count;
+	volatile long long sum;
+	
+	ConcurrentIntMetrics() :
+		min(std::numeric_limits<T>::max()),
+		max(std::numeric_limits<T>::min()),
+		count(0), sum(0)
+	{ }
+	
+	inline void updateMin(T value)
+	{
+		T current = min;
+		while ((value < current) && !__sync_bool_compare_and_swap(&min, current, value))
+			current = min;
+	}
+	
+	inline void updateMax(T value)
+	{
+		T current = max;
+		while ((value > current) && !__sync_bool_compare_and_swap(&max, current, value))
+			current = max;
+	}
+	
+	inline void add(T value)
+	{
+		updateMin(value);
+		updateMax(value);
+		__sync_fetch_and_add(&sum, (long long)value);
+		__sync_fetch_and_add(&count, 1);
+	}
+	
+	inline void merge(const IntMetrics<T> &other)
+	{
+		if (other.count == 0) return;
+		updateMin(other.min);
+		updateMax(other.max);
+		__sync_fetch_and_add(&sum, (long long)other.sum);
+		__sync_fetch_and_add(&count, other.count);
+	}
+	
+	/**
+	 * \brief Returns the current values as \ref IntMetrics.
+	 */
+	inline IntMetrics<T> snapshot() const
+	{
+		IntMetrics<T> result;
+		result.count = count;
+		if (result.count > 0) {
+			result.min = min;
+			result.max = max;
+		}
+		result.sum = (float)sum;
+		return result;
+	}
+};
+
+
 #define STATIC_CTOR(className) StaticCtor<className> DUMMY_##className##_staticCtor; void className::staticCtor()
 #define STATIC_CTOR_HEADER(className) \
 	static StaticCtor<className> DUMMY_##className##_staticCtor; \
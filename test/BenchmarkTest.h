@@ -0,0 +1,123 @@
+/**
+ * \file   BenchmarkTest.h
+ * \author Jan Milík <milikjan@fit.cvut.cz>
+ * \date   2026-10-19
+ *
+ * \brief  Header file for the BenchmarkTest class.
+ */
+
+#ifndef BENCHMARKTEST_W2PX6GJT
+#define BENCHMARKTEST_W2PX6GJT
+
+
+#include <unistd.h>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+#include <cppapp/cppapp.h>
+using namespace cppapp;
+
+
+class BenchmarkTestCase : public BenchmarkCase {
+public:
+	long calls;
+	
+	BenchmarkTestCase() : calls(0)
+	{
+		BENCH_ADD(BenchmarkTestCase, benchSum);
+		BENCH_ADD(BenchmarkTestCase, benchFail);
+	}
+	
+	void benchSum(long iterations)
+	{
+		calls++;
+		long sum = 0;
+		for (long i = 0; i < iterations; i++) {
+			sum += i;
+			benchSink(sum);
+		}
+	}
+	
+	void benchFail(long iterations)
+	{
+		TEST_FAIL("This benchmark always fails.");
+	}
+};
+
+
+/**
+ * \brief Tests the benchmark harness.
+ */
+class BenchmarkTest : public TestCase {
+public:
+	BenchmarkTest()
+	{
+		TEST_ADD(BenchmarkTest, testRun);
+		TEST_ADD(BenchmarkTest, testBaseline);
+	}
+	
+	void testRun()
+	{
+		Ref<BenchmarkTestCase> benchmarks = new BenchmarkTestCase();
+		std::stringstream output;
+		
+		BenchmarkRunner runner(&output);
+		runner.setMinTime(1);
+		runner.setRepetitions(5);
+		runner.run(*benchmarks);
+		
+		TEST_EQUALS(2, (int)runner.getResults().size(), "both benchmarks should have been run");
+		TEST_EQUALS(1, runner.getFailureCount(), "the failing benchmark should have been reported");
+		
+		const BenchResult &result = runner.getResults()[0];
+		TEST_ASSERT(result.success, "the benchmark should have succeeded");
+		TEST_EQUALS(5, (int)result.samples.size(), "every repetition should have been recorded");
+		TEST_ASSERT(result.iterations > 1, "the iteration count should have been calibrated");
+		TEST_ASSERT((result.min <= result.median) && (result.median <= result.p99), "the statistics are inconsistent");
+		// Calibration, warm-up and the repetitions.
+		TEST_ASSERT(benchmarks->calls >= 7, "the benchmark should have been called repeatedly");
+	}
+	
+	void testBaseline()
+	{
+		Ref<BenchmarkTestCase> benchmarks = new BenchmarkTestCase();
+		std::stringstream output;
+		
+		BenchmarkRunner runner(&output);
+		runner.setMinTime(1);
+		runner.setRepetitions(3);
+		runner.setFilter("benchSum");
+		runner.run(*benchmarks);
+		TEST_EQUALS(1, (int)runner.getResults().size(), "the filter should have been applied");
+		
+		char fileName[] = "/tmp/cppapp-bench-XXXXXX";
+		int  fd         = mkstemp(fileName);
+		TEST_ASSERT(fd >= 0, "cannot create a temporary file");
+		close(fd);
+		TEST_ASSERT(runner.saveJSON(fileName), "the results should have been saved");
+		
+		// Pretend the baseline was ten times faster.
+		std::stringstream json;
+		json << "{ \"benchmarks\": [ { \"name\": \"BenchmarkTestCase::benchSum\", \"median_ns\": "
+		     << std::fixed << runner.getResults()[0].median / 10 << " } ] }";
+		std::ofstream(fileName) << json.str();
+		
+		BenchmarkRunner compared(&output);
+		compared.setMinTime(1);
+		compared.setRepetitions(3);
+		compared.setFilter("benchSum");
+		TEST_ASSERT(compared.loadBaseline(fileName), "the baseline should have been loaded");
+		compared.run(*benchmarks);
+		unlink(fileName);
+		
+		TEST_EQUALS(1, compared.getRegressionCount(), "the regression should have been detected");
+		TEST_ASSERT(compared.getResults()[0].regressed, "the result should be marked as a regression");
+	}
+};
+
+
+RUN_SUITE(BenchmarkTest);
+
+
+#endif /* end of include guard: BENCHMARKTEST_W2PX6GJT */
@@ -0,0 +1,134 @@
+/**
+ * \file   ClockTest.h
+ * \author Jan Milík <milikjan@fit.cvut.cz>
+ * \date   2026-10-19
+ *
+ * \brief  Header file for the ClockTest class.
+ */
+
+#ifndef CLOCKTEST_Z5GM2KQW
+#define CLOCKTEST_Z5GM2KQW
+
+
+#include <unistd.h>
+
+#include <cppapp/cppapp.h>
+using namespace cppapp;
+
+
+class ClockTestThread : public Thread {
+public:
+	ConcurrentHistogram        *histogram;
+	ConcurrentIntMetrics<int>  *metrics;
+	int                         offset;
+	
+	ClockTestThread(ConcurrentHistogram *histogram, ConcurrentIntMetrics<int> *metrics, int offset) :
+		Thread(false), histogram(histogram), metrics(metrics), offset(offset)
+	{
+		start();
+	}
+	
+	virtual void* run()
+	{
+		for (int i = 1; i <= 1000; i++) {
+			histogram->record(offset + i);
+			metrics->add(offset + i);
+		}
+		return NULL;
+	}
+};
+
+
+/**
+ * \brief Tests the clocks, stopwatch and histograms.
+ */
+class ClockTest : public TestCase {
+public:
+	ClockTest()
+	{
+		TEST_ADD(ClockTest, testStopwatch);
+		TEST_ADD(ClockTest, testHistogram);
+		TEST_ADD(ClockTest, testConcurrent);
+	}
+	
+	void testStopwatch()
+	{
+		Stopwatch monotonic;
+		Stopwatch ticks(CLOCK_BACKEND_TSC);
+		monotonic.start();
+		ticks.start();
+		usleep(20000);
+		ticks.end();
+		monotonic.end();
+		
+		TEST_ASSERT(monotonic.getMilliseconds() >= 20, "the monotonic stopwatch is too fast");
+		TEST_ASSERT(ticks.getMilliseconds() >= 19, "the tick stopwatch is too fast");
+		TEST_ASSERT(ticks.getMilliseconds() <= monotonic.getMilliseconds() + 1,
+		            "the tick stopwatch is too slow");
+	}
+	
+	void testHistogram()
+	{
+		LatencyHistogram histogram;
+		for (uint64_t i = 1; i <= 10000; i++)
+			histogram.record(i * 1000);
+		
+		TEST_EQUALS(10000, (int)histogram.getCount(), "all values should have been counted");
+		TEST_EQUALS(1000, (int)histogram.getMin(), "wrong minimum");
+		TEST_EQUALS(10000000, (int)histogram.getMax(), "wrong maximum");
+		
+		uint64_t p50 = histogram.getPercentile(50);
+		uint64_t p99 = histogram.getPercentile(99);
+		TEST_ASSERT((p50 >= 5000000) && (p50 <= 5000000 * 33 / 32), "the median is out of bounds");
+		TEST_ASSERT((p99 >= 9900000) && (p99 <= 9900000 * 33 / 32), "p99 is out of bounds");
+		TEST_EQUALS(10000000, (int)histogram.getPercentile(100), "p100 should be the maximum");
+		
+		for (int i = 0; i < LatencyHistogram::HISTOGRAM_BUCKETS; i++) {
+			uint64_t low = LatencyHistogram::bucketLow(i);
+			TEST_EQUALS(i, LatencyHistogram::bucketIndex(low), "bucket bounds are inconsistent");
+			TEST_EQUALS(i, LatencyHistogram::bucketIndex(LatencyHistogram::bucketHigh(i)),
+			            "bucket bounds are inconsistent");
+		}
+		
+		LatencyHistogram other;
+		other.record(1);
+		histogram.merge(other);
+		TEST_EQUALS(10001, (int)histogram.getCount(), "the merged value should have been counted");
+		TEST_EQUALS(1, (int)histogram.getMin(), "the minimum should have been merged");
+	}
+	
+	void testConcurrent()
+	{
+		ConcurrentHistogram       histogram;
+		ConcurrentIntMetrics<int> metrics;
+		
+		vector<ClockTestThread*> threads;
+		for (int i = 0; i < 4; i++)
+			threads.push_back(new ClockTestThread(&histogram, &metrics, i * 1000));
+		FOR_EACH(threads, thread) {
+			(*thread)->join();
+			delete *thread;
+		}
+		
+		LatencyHistogram snapshot = histogram.snapshot();
+		TEST_EQUALS(4000, (int)snapshot.getCount(), "all values should have been counted");
+		TEST_EQUALS(1, (int)snapshot.getMin(), "wrong minimum");
+		TEST_EQUALS(4000, (int)snapshot.getMax(), "wrong maximum");
+		
+		IntMetrics<int> merged = metrics.snapshot();
+		TEST_EQUALS(4000, merged.count, "all values should have been added");
+		TEST_EQUALS(1, merged.min, "wrong minimum");
+		TEST_EQUALS(4000, merged.max, "wrong maximum");
+		
+		IntMetrics<int> local;
+		local.add(-5);
+		metrics.merge(local);
+		TEST_EQUALS(-5, metrics.snapshot().min, "the minimum should have been merged");
+	}
+};
+
+
+RUN_SUITE(ClockTest);
+
+
+#endif /* end of include guard: CLOCKTEST_Z5GM2KQW */
@@ -0,0 +1,248 @@
+/**
+ * \file   ConfigTest.h
+ * \author Jan Milík <milikjan@fit.cvut.cz>
+ * \date   2026-10-19
+ *
+ * \brief  Header file for the ConfigTest class.
+ */
+
+#ifndef CONFIGTEST_M5TX8WQD
+#define CONFIGTEST_M5TX8WQD
+
+
+#include <unistd.h>
+#include <fstream>
+
+#include <cppapp/cppapp.h>
+using namespace cppapp;
+
+
+class ConfigTestListener : public ConfigListener {
+public:
+	Mutex          mutex;
+	vector<string> keys;
+	
+	virtual void configChanged(const string &key, Ref<ConfigValue> oldValue, Ref<ConfigValue> newValue)
+	{
+		MutexLock lock(&mutex);
+		keys.push_back(key);
+	}
+	
+	int count()
+	{
+		MutexLock lock(&mutex);
+		return keys.size();
+	}
+};
+
+
+/**
+ * \todo Write documentation for class ConfigTest.
+ */
+class ConfigTest : public TestCase {
+private:
+	string      dir_;
+	Ref<Config> saved_;
+	
+	void writeFile(const string &content)
+	{
+		// Replace the file like an editor does
+		string temp = dir_ + "/app.conf.tmp";
+		std::ofstream out(temp.c_str());
+		out << content;
+		out.close();
+		rename(temp.c_str(), (dir_ + "/app.conf").c_str());
+	}
+	
+public:
+	ConfigTest()
+	{
+		TEST_ADD(ConfigTest, testTypedValues);
+		TEST_ADD(ConfigTest, testHandles);
+		TEST_ADD(ConfigTest, testLayers);
+		TEST_ADD(ConfigTest, testDiff);
+		TEST_ADD(ConfigTest, testReload);
+		TEST_ADD(ConfigTest, testReloadJSON);
+		TEST_ADD(ConfigTest, testWatch);
+	}
+	
+	virtual void setUp()
+	{
+		char dir[] = "/tmp/cppapp-config-XXXXXX";
+		TEST_ASSERT(mkdtemp(dir) != NULL, "could not create a temporary directory");
+		dir_   = dir;
+		saved_ = Config::globalConfig();
+		Config::setGlobalConfig(new Config());
+	}
+	
+	virtual void tearDown()
+	{
+		Config::setGlobalConfig(saved_);
+		std::string command = "rm -rf " + dir_;
+		if (system(command.c_str()) != 0)
+			std::cerr << "could not remove " << dir_ << std::endl;
+	}
+	
+	void testTypedValues()
+	{
+		TEST_ASSERT(!ConfigValue::make("a", string(" False "))->asBool(), "\"False\" should be false");
+		TEST_ASSERT(!ConfigValue::make("a", string(""))->asBool(), "an empty value should be false");
+		TEST_ASSERT(ConfigValue::make("a", string("yes"))->asBool(), "\"yes\" should be true");
+		TEST_EQUALS(42, ConfigValue::make("a", string(" 42 "))->asInteger(), "the integer should be parsed");
+		TEST_EQUALS(1.5f, ConfigValue::make("a", string("1.5"))->asFloat(), "the float should be parsed");
+	}
+	
+	void testHandles()
+	{
+		ConfigHandle early("test.handle.early");
+		
+		Ref<Config> config = new Config();
+		config->setDefault(ConfigValue::make("test.handle.early", 1));
+		config->setDefault(ConfigValue::make("test.handle.late", 2));
+		config->set(ConfigValue::make("test.handle.late", 3));
+		
+		ConfigHandle late("test.handle.late");
+		ConfigHandle missing("test.handle.missing");
+		
+		TEST_EQUALS(1, config->getInteger(early, 0), "a handle made before the key should work");
+		TEST_EQUALS(3, config->getInteger(late, 0), "values should override defaults");
+		TEST_EQUALS(7, config->getInteger(missing, 7), "a missing key should return the default");
+		TEST_ASSERT(config->get(missing) == NULL, "a missing key should have no value");
+		
+		config->set(ConfigValue::make("test.handle.early", 5));
+		TEST_EQUALS(5, config->getInteger(early, 0), "a new value should be visible through the handle");
+		
+		string      input  = "test.handle.early = 8\ntest.handle.parsed = 9\n";
+		Ref<Config> parsed = new Config();
+		ConfigParser parser(parsed);
+		TEST_ASSERT(parser.parse(input.data(), input.size(), "<string>"), "the values should be parsed");
+		TEST_EQUALS(8, parsed->getInteger(early, 0), "a parsed value should be visible through the handle");
+		
+		ConfigHandle parsedLate("test.handle.parsed");
+		TEST_EQUALS(9, parsed->getInteger(parsedLate, 0), "a handle made after parsing should work");
+		parsed->set(ConfigValue::make("test.handle.other", 1));
+		TEST_EQUALS(9, parsed->getInteger(parsedLate, 0), "the handle should work after a change");
+		parsed->set(ConfigValue::make("test.handle.parsed", 10));
+		TEST_EQUALS(10, parsed->getInteger(parsedLate, 0), "a replaced value should be visible through the handle");
+		TEST_EQUALS(10, parsed->get("test.handle.parsed")->asInteger(), "a replaced value should be found by key");
+	}
+	
+	void testLayers()
+	{
+		writeFile("limit = 1\nname = file\nport = 80\n");
+		{
+			std::ofstream out((dir_ + "/app.json").c_str());
+			out << "{ \"cache\": { \"max_size\": 1000000, \"ratio\": 0.5 }, \"port\": 8080 }";
+		}
+		
+		Ref<Config> defaults = new Config();
+		defaults->set(ConfigValue::make("limit", 0));
+		defaults->set(ConfigValue::make("debug", false));
+		
+		char  var0[] = "TESTAPP_NAME=env";
+		char  var1[] = "TESTAPP_CACHE__MAX_SIZE=5";
+		char  var2[] = "OTHER=1";
+		char *env[]  = { var0, var1, var2, NULL };
+		
+		ConfigLayers layers;
+		layers.addEnvironment("TESTAPP_", env);
+		TEST_ASSERT(layers.addFile(dir_ + "/app.conf"), "the file should be read");
+		TEST_ASSERT(layers.addFile(dir_ + "/app.json"), "the JSON file should be read");
+		TEST_ASSERT(!layers.addFile(dir_ + "/missing.conf"), "a missing file should be skipped");
+		layers.addDefaults(defaults);
+		
+		Ref<Config> config = layers.flatten();
+		TEST_EQUALS(false, config->get("debug")->asBool(), "defaults should be used");
+		TEST_EQUALS(1, config->get("limit")->asInteger(), "files should override defaults");
+		TEST_EQUALS(8080, config->get("port")->asInteger(), "later files should override earlier ones");
+		TEST_EQUALS(string("env"), config->get("name")->asString(), "the environment should override files");
+		TEST_EQUALS(5, config->get("cache.max_size")->asInteger(), "nested keys should be joined by dots");
+		TEST_EQUALS(0.5f, config->get("cache.ratio")->asFloat(), "JSON numbers should be kept");
+		TEST_ASSERT(config->get("other").isNull(), "variables without the prefix should be ignored");
+		TEST_EQUALS(string("environment"), layers.getOrigin("name"), "the origin should be recorded");
+	}
+	
+	void testDiff()
+	{
+		Ref<Config> a = new Config();
+		a->setDefault(ConfigValue::make("same", 1));
+		a->set(ConfigValue::make("changed", 1));
+		a->set(ConfigValue::make("removed", 1));
+		
+		Ref<Config> b = new Config();
+		b->setDefault(ConfigValue::make("same", 1));
+		b->set(ConfigValue::make("changed", 2));
+		b->set(ConfigValue::make("added", 1));
+		
+		vector<string> keys = Config::diff(a, b);
+		TEST_EQUALS(3, (int)keys.size(), "three keys should differ");
+		TEST_EQUALS(string("added"),   keys[0], "added keys should differ");
+		TEST_EQUALS(string("changed"), keys[1], "changed keys should differ");
+		TEST_EQUALS(string("removed"), keys[2], "removed keys should differ");
+	}
+	
+	void testReload()
+	{
+		Config::globalConfig()->setDefault(ConfigValue::make("limit", 10));
+		writeFile("limit = 20\nname = a\n");
+		
+		Ref<Config> overrides = new Config();
+		overrides->set(ConfigValue::make("name", string("cli")));
+		
+		Ref<ConfigWatcher>      watcher  = new ConfigWatcher(dir_ + "/app.conf", overrides);
+		Ref<ConfigTestListener> listener = new ConfigTestListener();
+		watcher->addListener("limit", listener);
+		
+		TEST_ASSERT(watcher->reload(), "the file should be reloaded");
+		TEST_EQUALS(20, Config::globalConfig()->get("limit")->asInteger(), "the value should be reloaded");
+		TEST_EQUALS(string("cli"), Config::globalConfig()->get("name")->asString(),
+		            "overrides should be kept");
+		TEST_EQUALS(1, listener->count(), "the listener should be called");
+		
+		writeFile("limit = 20\nname = b\n");
+		TEST_ASSERT(watcher->reload(), "the file should be reloaded");
+		TEST_EQUALS(1, listener->count(), "the listener should not be called for other keys");
+		
+		writeFile("limit\n");
+		TEST_ASSERT(!watcher->reload(), "an invalid file should not be loaded");
+		TEST_EQUALS(20, Config::globalConfig()->get("limit")->asInteger(),
+		            "the current configuration should be kept");
+	}
+	
+	void testReloadJSON()
+	{
+		string fileName = dir_ + "/app.json";
+		std::ofstream out(fileName.c_str());
+		out << "{ \"cache\": { \"size\": 30 } }";
+		out.close();
+		
+		Ref<ConfigWatcher> watcher = new ConfigWatcher(fileName, NULL);
+		TEST_ASSERT(watcher->reload(), "the JSON file should be reloaded");
+		TEST_EQUALS(30, Config::globalConfig()->get("cache.size")->asInteger(),
+		            "nested keys should be joined by dots");
+	}
+	
+	void testWatch()
+	{
+		writeFile("limit = 1\n");
+		
+		Ref<ConfigWatcher>      watcher  = new ConfigWatcher(dir_ + "/app.conf", NULL, 50);
+		Ref<ConfigTestListener> listener = new ConfigTestListener();
+		watcher->addListener("", listener);
+		watcher->reload();
+		watcher->start();
+		
+		writeFile("limit = 2\n");
+		for (int i = 0; (i < 200) && (listener->count() < 2); i++)
+			usleep(10000);
+		watcher->stop();
+		
+		TEST_EQUALS(2, listener->count(), "the change should be noticed");
+		TEST_EQUALS(2, Config::globalConfig()->get("limit")->asInteger(), "the value should be reloaded");
+	}
+};
+
+RUN_SUITE(ConfigTest);
+
+
+#endif /* end of include guard: CONFIGTEST_M5TX8WQD */
@@ -10,6 +10,8 @@
 #define DYNOBJECTTEST_ZZGY7R
 
 
+#include <unistd.h>
+
 #include <cppapp/cppapp.h>
 using namespace cppapp;
 
@@ -190,5 +192,281 @@ public:
 RUN_SUITE(DynListTest);
 
 
+/**
+ * Container that takes a reference to a weakly referenced object (or
+ * notes a change of its children) when the second node is traced, like
+ * a thread reviving garbage during a step.
+ */
+class CycleTestNode : public Object {
+public:
+	static WeakRef<Object> revive;
+	static Ref<Object>     revived;
+	static bool            change;
+	static int             traced;
+	
+	Ref<Object> next;
+	
+	CycleTestNode() { registerContainer(); }
+	
+	virtual void traceChildren(ObjectVisitor *visitor)
+	{
+		if (++traced == 2) {
+			revived = revive.lock();
+			if (change)
+				markChanged();
+		}
+		visitor->visit(next.getPtr());
+	}
+	
+	virtual void clearChildren() { next = NULL; }
+};
+
+WeakRef<Object> CycleTestNode::revive;
+Ref<Object>     CycleTestNode::revived;
+bool            CycleTestNode::change = false;
+int             CycleTestNode::traced = 0;
+
+
+/**
+ * Grows a live list, moves a live dictionary between two containers and
+ * drops garbage cycles while a background collector runs.
+ */
+class CycleTestThread : public Thread {
+public:
+	int damaged;
+	
+	CycleTestThread() :
+		Thread(false), damaged(0)
+	{
+		start();
+	}
+	
+	virtual void* run()
+	{
+		Ref<DynDict> left  = new DynDict(CPPAPP_TEXT_LOC);
+		Ref<DynList> right = new DynList(CPPAPP_TEXT_LOC);
+		left->setStrItem("self", left.as<DynObject>());
+		right->append(right.as<DynObject>());
+		
+		Ref<DynDict> item = new DynDict(CPPAPP_TEXT_LOC);
+		item->setStrItem("self", item.as<DynObject>());
+		item->setStrItem("value", DYN_NEW_STRING("live"));
+		right->append(item.as<DynObject>());
+		item = NULL;
+		
+		for (int i = 0; i < 5000; i++) {
+			right->append(DYN_NEW_STRING("grown"));
+			left->setStrItem("item", right->getIntItem(1));
+			right->setIntItem(1, DYN_NEW_STRING("moved"));
+			right->setIntItem(1, left->getStrItem("item", NULL));
+			left->setStrItem("item", DYN_NEW_STRING("moved"));
+			
+			Ref<DynObject> moved = right->getIntItem(1);
+			if (!moved->hasStrItem("self") || (moved->getStrString("value", "") != "live"))
+				damaged++;
+			moved = right->getIntItem(0);
+			moved = NULL;
+			
+			Ref<DynList> garbage = new DynList(CPPAPP_TEXT_LOC);
+			garbage->append(garbage.as<DynObject>());
+		}
+		
+		left->setStrItem("self", NULL);
+		right->setIntItem(0, NULL);
+		return NULL;
+	}
+};
+
+
+class CycleCollectorTest : public TestCase {
+public:
+	CycleCollectorTest()
+	{
+		TEST_ADD(CycleCollectorTest, testCollect);
+		TEST_ADD(CycleCollectorTest, testBackground);
+		TEST_ADD(CycleCollectorTest, testBudget);
+		TEST_ADD(CycleCollectorTest, testCandidateLimit);
+		TEST_ADD(CycleCollectorTest, testRevived);
+		TEST_ADD(CycleCollectorTest, testChanged);
+		TEST_ADD(CycleCollectorTest, testConcurrent);
+	}
+	
+	void testCollect()
+	{
+		CycleCollector::enable();
+		
+		Ref<DynDict> dict = new DynDict(CPPAPP_TEXT_LOC);
+		Ref<DynList> list = new DynList(CPPAPP_TEXT_LOC);
+		dict->setStrItem("list", list.as<DynObject>());
+		dict->setStrItem("name", new DynString(CPPAPP_TEXT_LOC, "cycle"));
+		list->append(dict.as<DynObject>());
+		
+		Ref<DynDict> live = new DynDict(CPPAPP_TEXT_LOC);
+		live->setStrItem("self", live.as<DynObject>());
+		
+		WeakRef<DynDict> weakDict(dict);
+		WeakRef<DynList> weakList(list);
+		WeakRef<DynDict> weakLive(live);
+		dict = NULL;
+		list = NULL;
+		live->setStrItem("other", new DynDict(CPPAPP_TEXT_LOC));
+		
+		CycleCollector::collect(4);
+		TEST_ASSERT(weakDict.isExpired(), "the dictionary in the cycle should be freed");
+		TEST_ASSERT(weakList.isExpired(), "the list in the cycle should be freed");
+		TEST_ASSERT(!weakLive.isExpired(), "the referenced cycle should stay alive");
+		TEST_EQUALS(0, CycleCollector::getCandidateCount(), "no candidates should be left");
+		
+		live = NULL;
+		CycleCollector::collect();
+		TEST_ASSERT(weakLive.isExpired(), "the released cycle should be freed");
+		
+		CycleCollector::disable();
+	}
+	
+	void testBackground()
+	{
+		CycleCollector::enable();
+		CycleCollector::start(1);
+		
+		WeakRef<DynDict> weak;
+		{
+			Ref<DynDict> dict = new DynDict(CPPAPP_TEXT_LOC);
+			dict->setStrItem("self", dict.as<DynObject>());
+			weak = dict;
+		}
+		
+		for (int i = 0; (i < 1000) && !weak.isExpired(); i++)
+			usleep(1000);
+		TEST_ASSERT(weak.isExpired(), "the background thread should free the cycle");
+		
+		CycleCollector::stop();
+		CycleCollector::disable();
+	}
+	
+	void testBudget()
+	{
+		CycleCollector::enable();
+		
+		WeakRef<DynDict> weak;
+		{
+			Ref<DynDict> first = new DynDict(CPPAPP_TEXT_LOC);
+			Ref<DynDict> last  = first;
+			for (int i = 0; i < 10; i++) {
+				Ref<DynDict> next = new DynDict(CPPAPP_TEXT_LOC);
+				last->setStrItem("next", next.as<DynObject>());
+				last = next;
+			}
+			last->setStrItem("next", first.as<DynObject>());
+			weak = first;
+		}
+		
+		CycleCollector::collect(5);
+		TEST_ASSERT(!weak.isExpired(), "a cycle larger than the budget should not be traced");
+		TEST_ASSERT(CycleCollector::getCandidateCount() > 0, "the cycle should be tried again");
+		
+		CycleCollector::collect();
+		TEST_ASSERT(weak.isExpired(), "a step with a larger budget should free the cycle");
+		
+		CycleCollector::disable();
+	}
+	
+	void testCandidateLimit()
+	{
+		CycleCollector::enable();
+		
+		for (int i = 0; i < 5000; i++) {
+			Ref<DynDict> dict = new DynDict(CPPAPP_TEXT_LOC);
+			Ref<DynDict> copy = dict;
+			copy = NULL;
+		}
+		TEST_ASSERT(CycleCollector::getCandidateCount() <= CPPAPP_GC_COMPACT_SIZE,
+		            "destroyed candidates should be dropped without steps");
+		
+		CycleCollector::collect();
+		CycleCollector::disable();
+	}
+	
+	void testRevived()
+	{
+		CycleCollector::enable();
+		
+		WeakRef<CycleTestNode> weak;
+		{
+			Ref<CycleTestNode> a = new CycleTestNode();
+			Ref<CycleTestNode> b = new CycleTestNode();
+			a->next = b.as<Object>();
+			b->next = a.as<Object>();
+			weak = a;
+			CycleTestNode::revive = b.as<Object>();
+		}
+		
+		CycleTestNode::traced = 0;
+		CycleCollector::step();
+		TEST_ASSERT(CycleTestNode::revived.isNotNull(), "the node should be revived while traced");
+		TEST_ASSERT(!weak.isExpired(), "a cycle revived during the step should not be freed");
+		TEST_ASSERT(CycleTestNode::revived.as<CycleTestNode>()->next.isNotNull(),
+		            "a cycle revived during the step should not be cleared");
+		
+		CycleTestNode::revive.reset();
+		CycleTestNode::revived = NULL;
+		CycleCollector::collect();
+		TEST_ASSERT(weak.isExpired(), "the cycle should be freed once released");
+		
+		CycleCollector::disable();
+	}
+	
+	void testChanged()
+	{
+		CycleCollector::enable();
+		
+		WeakRef<CycleTestNode> weak;
+		{
+			Ref<CycleTestNode> a = new CycleTestNode();
+			Ref<CycleTestNode> b = new CycleTestNode();
+			a->next = b.as<Object>();
+			b->next = a.as<Object>();
+			weak = a;
+		}
+		
+		CycleTestNode::traced = 0;
+		CycleTestNode::change = true;
+		TEST_EQUALS(0, CycleCollector::step(), "a cycle changed during the step should not be freed");
+		TEST_ASSERT(!weak.isExpired(), "a cycle changed during the step should stay alive");
+		
+		CycleTestNode::change = false;
+		CycleCollector::collect();
+		TEST_ASSERT(weak.isExpired(), "the unchanged cycle should be freed");
+		
+		CycleCollector::disable();
+	}
+	
+	void testConcurrent()
+	{
+		CycleCollector::enable();
+		CycleCollector::start(1);
+		
+		std::vector<CycleTestThread*> threads;
+		for (int i = 0; i < 4; i++)
+			threads.push_back(new CycleTestThread());
+		int damaged = 0;
+		FOR_EACH(threads, thread) {
+			(*thread)->join();
+			damaged += (*thread)->damaged;
+			delete *thread;
+		}
+		
+		CycleCollector::stop();
+		CycleCollector::collect();
+		CycleCollector::disable();
+		
+		TEST_EQUALS(0, damaged, "live containers should not be cleared");
+		TEST_EQUALS(0, CycleCollector::getCandidateCount(), "all cycles should be freed");
+	}
+};
+
+RUN_SUITE(CycleCollectorTest);
+
+
 #endif /* end of include guard: DYNOBJECTTEST_ZZGY7R */
 
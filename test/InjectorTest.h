@@ -26,12 +26,144 @@ public:
 };
 
 
+class DITestContainer : public DIAdvancedObject {
+public:
+	Ref<DITestObjectA>    first;
+	Ref<DITestContainer>  inner;
+	Ref<DIObject>         parent;
+	
+	DITestContainer(Ref<DIObject> parent) : parent(parent)
+	{
+		addDIProperty(new DIProperty<Ref<DITestObjectA>, DITestContainer>(
+			"first", this, &DITestContainer::setFirst));
+		addDIProperty(new DIProperty<Ref<DITestContainer>, DITestContainer>(
+			"inner", this, &DITestContainer::setInner));
+	}
+	
+	virtual ~DITestContainer() {}
+	
+	void setFirst(Ref<DITestObjectA> value)   { first = value; }
+	void setInner(Ref<DITestContainer> value) { inner = value; }
+};
+
+
 Ref<DIObject> testCreate(Ref<DynObject> config, Ref<DIObject> parent)
 {
 	return new DITestObjectA();
 }
 
 
+Ref<DIObject> testCreateContainer(Ref<DynObject> config, Ref<DIObject> parent)
+{
+	return new DITestContainer(parent);
+}
+
+
+static std::vector<std::string> diTestReleased;
+static volatile int             diTestCreated = 0;
+
+
+class DITestTracked : public DIAdvancedObject {
+public:
+	std::string        name;
+	Ref<DITestTracked> dependency;
+	
+	DITestTracked(std::string name) : name(name)
+	{
+		addDIProperty(new DIProperty<Ref<DITestTracked>, DITestTracked>(
+			"dependency", this, &DITestTracked::setDependency));
+	}
+	
+	virtual ~DITestTracked() { diTestReleased.push_back(name); }
+	
+	void setDependency(Ref<DITestTracked> value) { dependency = value; }
+};
+
+
+class DITestLazyHolder : public DIAdvancedObject {
+public:
+	DILazy<DITestTracked> lazy;
+	
+	DITestLazyHolder()
+	{
+		addDIProperty(new DIProperty<DILazy<DITestTracked>, DITestLazyHolder>(
+			"lazy", this, &DITestLazyHolder::setLazy));
+	}
+	
+	void setLazy(DILazy<DITestTracked> value) { lazy = value; }
+};
+
+
+Ref<DIObject> testCreateLazyHolder(Ref<DynObject> config, Ref<DIObject> parent)
+{
+	return new DITestLazyHolder();
+}
+
+
+static Ref<DIObject> diTestCycleResult;
+
+
+/**
+ * Instantiates the singleton that is being created, possibly from a
+ * thread of the pool.
+ */
+Ref<DIObject> testCreateCycle(Ref<DynObject> config, Ref<DIObject> parent)
+{
+	diTestCycleResult = Injector::getInstance().instantiate("test.cycle");
+	return new DITestContainer(parent);
+}
+
+
+Ref<DIObject> testCreateTracked(Ref<DynObject> config, Ref<DIObject> parent)
+{
+	__sync_fetch_and_add(&diTestCreated, 1);
+	usleep(1000);
+	return new DITestTracked(config->getStrItem("name")->getString());
+}
+
+
+class DITestThread : public Thread {
+public:
+	Ref<DIObject> result;
+	Ref<DIObject> local;
+	
+	DITestThread() : Thread(false) { start(); }
+	
+	virtual void* run()
+	{
+		result = Injector::getInstance().instantiate("test.singleton");
+		local  = Injector::getInstance().instantiate("test.thread");
+		Injector::getInstance().releaseThreadScope();
+		return NULL;
+	}
+};
+
+
+class DITestLookupThread : public Thread {
+public:
+	volatile bool *stop;
+	int            failures;
+	
+	DITestLookupThread(volatile bool *stop) : Thread(false), stop(stop), failures(0)
+	{
+		start();
+	}
+	
+	virtual void* run()
+	{
+		Injector &injector = Injector::getInstance();
+		while (!*stop) {
+			if (injector.getFactory("test.testFactory").isNull())
+				failures++;
+			if (injector.instantiate("test.testPlan").isNull())
+				failures++;
+			injector.getFactory("test.missing");
+		}
+		return NULL;
+	}
+};
+
+
 /**
  * \todo Write documentation for class InjectorTest.
  */
@@ -45,6 +177,14 @@ public:
 		TEST_ADD(InjectorTest, testRegisterFunction);
 		TEST_ADD(InjectorTest, testComplex01);
 		TEST_ADD(InjectorTest, testComplex02);
+		TEST_ADD(InjectorTest, testCompiledPlan);
+		TEST_ADD(InjectorTest, testLifetimes);
+		TEST_ADD(InjectorTest, testScopeRelease);
+		TEST_ADD(InjectorTest, testParallel);
+		TEST_ADD(InjectorTest, testParallelCycle);
+		TEST_ADD(InjectorTest, testLazy);
+		TEST_ADD(InjectorTest, testConcurrentRegistry);
+		TEST_ADD(InjectorTest, testConcurrentPool);
 	}
 
 	virtual ~InjectorTest() {}
@@ -125,6 +265,369 @@ public:
 			Injector::getInstance().instantiateAs<DITestObjectB>("test.testPlan01");
 		TEST_ASSERT(obj2.isNull(), "the cast to DITestObjectB should fail");
 	}
+	
+	void testCompiledPlan()
+	{
+		Injector::getInstance().clear();
+		
+		CPPAPP_DI_FUNCTION("test.testFactory", testCreate);
+		CPPAPP_DI_FUNCTION("test.containerFactory", testCreateContainer);
+		
+		JSONParser parser;
+		Ref<DynObject> config = parser.parse(
+			"["
+			"	{"
+			"		\"key\":     \"test.outer\","
+			"		\"factory\": \"test.containerFactory\","
+			"		\"children\": ["
+			"			{ \"key\": \"first\", \"factory\": \"test.testFactory\" },"
+			"			{"
+			"				\"key\":      \"inner\","
+			"				\"factory\":  \"test.containerFactory\","
+			"				\"children\": ["
+			"					{ \"key\": \"first\", \"factory\": \"test.testFactory\" },"
+			"				],"
+			"			},"
+			"		],"
+			"	},"
+			"]"
+		);
+		Injector::getInstance().makePlans(config);
+		
+		Ref<DIPlan> plan = Injector::getInstance().getPlan("test.outer");
+		TEST_ASSERT(plan.isNotNull(), "the plan should not be null");
+		TEST_EQUALS(7, (int)plan->getProgram().size(),
+		            "four objects should be created and three injected");
+		
+		for (int i = 0; i < 3; i++) {
+			Ref<DITestContainer> obj =
+				Injector::getInstance().instantiateAs<DITestContainer>("test.outer");
+			TEST_ASSERT(obj.isNotNull(), "the resulting object should not be null");
+			TEST_ASSERT(obj->first.isNotNull(), "the first dependency should be injected");
+			TEST_ASSERT(obj->inner.isNotNull(), "the inner dependency should be injected");
+			TEST_ASSERT(obj->inner->first.isNotNull(), "the nested dependency should be injected");
+			TEST_ASSERT(obj->inner->parent.getPtr() == obj.getPtr(),
+			            "the inner object should be created with its parent");
+		}
+	}
+	
+	void makeLifetimePlans()
+	{
+		Injector::getInstance().clear();
+		
+		CPPAPP_DI_FUNCTION("test.trackedFactory", testCreateTracked);
+		
+		JSONParser parser;
+		Ref<DynObject> config = parser.parse(
+			"["
+			"	{ \"key\": \"test.transient\", \"factory\": \"test.trackedFactory\","
+			"	  \"name\": \"transient\" },"
+			"	{ \"key\": \"test.singleton\", \"factory\": \"test.trackedFactory\","
+			"	  \"name\": \"singleton\", \"lifetime\": \"singleton\" },"
+			"	{ \"key\": \"test.thread\", \"factory\": \"test.trackedFactory\","
+			"	  \"name\": \"thread\", \"lifetime\": \"thread\" },"
+			"	{"
+			"		\"key\":      \"test.request\","
+			"		\"factory\":  \"test.trackedFactory\","
+			"		\"name\":     \"request\","
+			"		\"lifetime\": \"request\","
+			"		\"children\": ["
+			"			{ \"key\": \"dependency\", \"factory\": \"test.trackedFactory\","
+			"			  \"name\": \"shared\", \"lifetime\": \"request\" },"
+			"		],"
+			"	},"
+			"]"
+		);
+		Injector::getInstance().makePlans(config);
+	}
+	
+	void testLifetimes()
+	{
+		makeLifetimePlans();
+		Injector &injector = Injector::getInstance();
+		
+		TEST_ASSERT(injector.instantiate("test.transient").getPtr() !=
+		            injector.instantiate("test.transient").getPtr(),
+		            "transient objects should not be shared");
+		TEST_ASSERT(injector.instantiate("test.thread").getPtr() ==
+		            injector.instantiate("test.thread").getPtr(),
+		            "thread objects should be shared by the thread");
+		TEST_ASSERT(injector.instantiate("test.request").isNull(),
+		            "request objects need a request scope");
+		
+		Ref<DIScope> request = injector.beginRequest();
+		Ref<DITestTracked> obj = injector.instantiateAs<DITestTracked>("test.request", request);
+		TEST_ASSERT(obj.isNotNull(), "the request object should be created");
+		TEST_ASSERT(obj.getPtr() == injector.instantiate("test.request", request).getPtr(),
+		            "request objects should be shared within the request");
+		TEST_ASSERT(obj.getPtr() != injector.instantiate("test.request", injector.beginRequest()).getPtr(),
+		            "request objects should not be shared between requests");
+		
+		diTestCreated = 0;
+		std::vector<DITestThread*> threads;
+		for (int i = 0; i < 8; i++)
+			threads.push_back(new DITestThread());
+		FOR_EACH(threads, thread)
+			(*thread)->join();
+		
+		TEST_EQUALS(9, (int)diTestCreated,
+		            "the singleton should be created once and thread objects once per thread");
+		for (int i = 0; i < 8; i++) {
+			TEST_ASSERT(threads[i]->result.isNotNull(), "the singleton should be created");
+			TEST_ASSERT(threads[i]->result.getPtr() == threads[0]->result.getPtr(),
+			            "the singleton should be shared by all threads");
+			TEST_ASSERT(threads[i]->local.getPtr() != injector.instantiate("test.thread").getPtr(),
+			            "thread objects should not be shared between threads");
+		}
+		FOR_EACH(threads, thread)
+			delete *thread;
+	}
+	
+	void testParallel()
+	{
+		makeLifetimePlans();
+		Injector &injector = Injector::getInstance();
+		
+		CPPAPP_DI_FUNCTION("test.testFactory", testCreate);
+		CPPAPP_DI_FUNCTION("test.containerFactory", testCreateContainer);
+		
+		JSONParser parser;
+		injector.makePlans(parser.parse(
+			"["
+			"	{"
+			"		\"key\":      \"test.parallel\","
+			"		\"factory\":  \"test.containerFactory\","
+			"		\"children\": ["
+			"			{ \"key\": \"first\", \"factory\": \"test.testFactory\" },"
+			"			{"
+			"				\"key\":      \"inner\","
+			"				\"factory\":  \"test.containerFactory\","
+			"				\"children\": ["
+			"					{ \"key\": \"first\", \"factory\": \"test.testFactory\" },"
+			"				],"
+			"			},"
+			"		],"
+			"	},"
+			"]"
+		));
+		
+		injector.setThreadPool(new ThreadPool(4));
+		for (int i = 0; i < 20; i++) {
+			Ref<DITestContainer> obj = injector.instantiateAs<DITestContainer>("test.parallel");
+			TEST_ASSERT(obj.isNotNull(), "the resulting object should not be null");
+			TEST_ASSERT(obj->first.isNotNull(), "the first dependency should be injected");
+			TEST_ASSERT(obj->inner.isNotNull(), "the inner dependency should be injected");
+			TEST_ASSERT(obj->inner->first.isNotNull(), "the nested dependency should be injected");
+			TEST_ASSERT(obj->inner->parent.getPtr() == obj.getPtr(),
+			            "the inner object should be created with its parent");
+			obj->inner->parent = NULL;
+		}
+		
+		diTestCreated = 0;
+		Ref<DIScope> request = injector.beginRequest();
+		TEST_ASSERT(injector.instantiate("test.request", request).isNotNull(),
+		            "the request object should be created");
+		TEST_EQUALS(2, (int)diTestCreated, "scoped objects should be created once");
+		injector.setThreadPool(NULL);
+	}
+	
+	void testParallelCycle()
+	{
+		Injector::getInstance().clear();
+		Injector &injector = Injector::getInstance();
+		
+		CPPAPP_DI_FUNCTION("test.testFactory", testCreate);
+		CPPAPP_DI_FUNCTION("test.containerFactory", testCreateContainer);
+		CPPAPP_DI_FUNCTION("test.cycleFactory", testCreateCycle);
+		
+		JSONParser parser;
+		injector.makePlans(parser.parse(
+			"["
+			"	{"
+			"		\"key\":      \"test.cycle\","
+			"		\"factory\":  \"test.containerFactory\","
+			"		\"lifetime\": \"singleton\","
+			"		\"children\": ["
+			"			{ \"key\": \"first\", \"factory\": \"test.testFactory\" },"
+			"			{ \"key\": \"inner\", \"factory\": \"test.cycleFactory\" },"
+			"		],"
+			"	},"
+			"]"
+		));
+		
+		injector.setThreadPool(new ThreadPool(2));
+		diTestCycleResult = new DITestObjectA();
+		TEST_ASSERT(injector.instantiate("test.cycle").isNotNull(),
+		            "the singleton should be created");
+		TEST_ASSERT(diTestCycleResult.isNull(),
+		            "the singleton should not be available to its own construction");
+		injector.setThreadPool(NULL);
+	}
+	
+	void testLazy()
+	{
+		Injector::getInstance().clear();
+		Injector &injector = Injector::getInstance();
+		
+		CPPAPP_DI_FUNCTION("test.trackedFactory", testCreateTracked);
+		CPPAPP_DI_FUNCTION("test.lazyHolderFactory", testCreateLazyHolder);
+		
+		JSONParser parser;
+		injector.makePlans(parser.parse(
+			"["
+			"	{"
+			"		\"key\":      \"test.holder\","
+			"		\"factory\":  \"test.lazyHolderFactory\","
+			"		\"children\": ["
+			"			{ \"key\": \"lazy\", \"factory\": \"test.trackedFactory\","
+			"			  \"name\": \"lazy\", \"lazy\": true },"
+			"		],"
+			"	},"
+			"	{"
+			"		\"key\":      \"test.requestHolder\","
+			"		\"factory\":  \"test.lazyHolderFactory\","
+			"		\"lifetime\": \"request\","
+			"		\"children\": ["
+			"			{ \"key\": \"lazy\", \"factory\": \"test.trackedFactory\","
+			"			  \"name\": \"lazy\", \"lazy\": true },"
+			"		],"
+			"	},"
+			"	{"
+			"		\"key\":      \"test.eager\","
+			"		\"factory\":  \"test.trackedFactory\","
+			"		\"name\":     \"eager\","
+			"		\"children\": ["
+			"			{ \"key\": \"dependency\", \"factory\": \"test.trackedFactory\","
+			"			  \"name\": \"dependency\", \"lazy\": true },"
+			"		],"
+			"	},"
+			"]"
+		));
+		
+		diTestCreated = 0;
+		Ref<DITestLazyHolder> holder = injector.instantiateAs<DITestLazyHolder>("test.holder");
+		TEST_ASSERT(holder.isNotNull(), "the holder should be created");
+		TEST_ASSERT(holder->lazy.isNotNull(), "the lazy dependency should be injected");
+		TEST_EQUALS(0, (int)diTestCreated, "the lazy dependency should not be created yet");
+		TEST_EQUALS(std::string("lazy"), holder->lazy->name,
+		            "the lazy dependency should be created when used");
+		TEST_ASSERT(holder->lazy.get().getPtr() == holder->lazy.get().getPtr(),
+		            "the lazy dependency should be created once");
+		TEST_EQUALS(1, (int)diTestCreated, "the lazy dependency should be created once");
+		
+		Ref<DITestTracked> eager = injector.instantiateAs<DITestTracked>("test.eager");
+		TEST_ASSERT(eager.isNotNull() && eager->dependency.isNotNull(),
+		            "a Ref property should resolve a lazy dependency");
+		
+		Ref<DIScope> request = injector.beginRequest();
+		TEST_ASSERT(injector.instantiate("test.requestHolder", request).isNotNull(),
+		            "the request holder should be created");
+		WeakRef<DIScope> weakRequest(request);
+		request = NULL;
+		TEST_ASSERT(weakRequest.isExpired(),
+		            "a lazy dependency should not keep its scope alive");
+	}
+	
+	void testConcurrentRegistry()
+	{
+		Injector::getInstance().clear();
+		Injector &injector = Injector::getInstance();
+		
+		CPPAPP_DI_FUNCTION("test.testFactory", testCreate);
+		
+		JSONParser parser;
+		injector.makePlans(parser.parse(
+			"[ { \"key\": \"test.testPlan\", \"factory\": \"test.testFactory\" } ]"
+		));
+		
+		volatile bool stop = false;
+		std::vector<DITestLookupThread*> threads;
+		for (int i = 0; i < 4; i++)
+			threads.push_back(new DITestLookupThread(&stop));
+		
+		for (int i = 0; i < 200; i++) {
+			std::ostringstream name;
+			name << "test.factory" << i;
+			injector.registerFactory(name.str(), new DIFunctionFactory(testCreate));
+		}
+		
+		stop = true;
+		FOR_EACH(threads, thread) {
+			(*thread)->join();
+			TEST_EQUALS(0, (*thread)->failures, "lookups should not fail during registration");
+			delete *thread;
+		}
+		
+		TEST_ASSERT(injector.getFactory("test.factory199").isNotNull(),
+		            "all factories should be registered");
+		TEST_ASSERT(injector.getFactory("test.missing").isNull(),
+		            "a missing factory should not be found");
+	}
+	
+	void testConcurrentPool()
+	{
+		Injector::getInstance().clear();
+		Injector &injector = Injector::getInstance();
+		
+		CPPAPP_DI_FUNCTION("test.testFactory", testCreate);
+		CPPAPP_DI_FUNCTION("test.containerFactory", testCreateContainer);
+		
+		JSONParser parser;
+		injector.makePlans(parser.parse(
+			"["
+			"	{"
+			"		\"key\":      \"test.testPlan\","
+			"		\"factory\":  \"test.containerFactory\","
+			"		\"children\": ["
+			"			{ \"key\": \"first\", \"factory\": \"test.testFactory\" },"
+			"		],"
+			"	},"
+			"]"
+		));
+		
+		volatile bool stop = false;
+		std::vector<DITestLookupThread*> threads;
+		for (int i = 0; i < 4; i++)
+			threads.push_back(new DITestLookupThread(&stop));
+		
+		for (int i = 0; i < 50; i++) {
+			injector.setThreadPool((i % 2 == 0) ? new ThreadPool(2) : NULL);
+			usleep(1000);
+		}
+		
+		stop = true;
+		FOR_EACH(threads, thread) {
+			(*thread)->join();
+			TEST_EQUALS(0, (*thread)->failures, "instantiation should not fail while the pool changes");
+			delete *thread;
+		}
+		
+		Ref<ThreadPool> pool = new ThreadPool(2);
+		injector.setThreadPool(pool);
+		injector.clear();
+		TEST_ASSERT(injector.getThreadPool().getPtr() == pool.getPtr(),
+		            "the pool should be kept by clear()");
+		injector.setThreadPool(NULL);
+	}
+	
+	void testScopeRelease()
+	{
+		makeLifetimePlans();
+		Injector &injector = Injector::getInstance();
+		
+		Ref<DIScope> request = injector.beginRequest();
+		TEST_ASSERT(injector.instantiate("test.request", request).isNotNull(),
+		            "the request object should be created");
+		TEST_EQUALS(2, request->size(), "the scope should contain the object and its dependency");
+		
+		diTestReleased.clear();
+		request->release();
+		TEST_EQUALS(2, (int)diTestReleased.size(), "both objects should be released");
+		TEST_EQUALS(std::string("request"), diTestReleased[0],
+		            "the dependent object should be released first");
+		TEST_EQUALS(std::string("shared"), diTestReleased[1],
+		            "the dependency should be released last");
+	}
 
 };
 
@@ -0,0 +1,552 @@
+/**
+ * \file   LoggerTest.h
+ * \author Jan Milík <milikjan@fit.cvut.cz>
+ * \date   2026-10-19
+ *
+ * \brief  Header file for the LoggerTest class.
+ */
+
+#ifndef LOGGERTEST_Q2VN7MXA
+#define LOGGERTEST_Q2VN7MXA
+
+
+#include <sstream>
+#include <fstream>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <cppapp/cppapp.h>
+using namespace cppapp;
+
+
+/**
+ * \brief Output writing into a string stream, used to inspect log records.
+ */
+class LoggerTestOutput : public Output {
+private:
+	std::ostringstream stream_;
+
+public:
+	virtual string getName() { return "<test>"; }
+	virtual ostream* getStream() { return &stream_; }
+	
+	/**
+	 * Locks the output, records may be written by background threads.
+	 */
+	std::string str()
+	{
+		MutexLock lock(&getWriteMutex());
+		return stream_.str();
+	}
+	
+	int countLines()
+	{
+		std::string s = str();
+		return (int)std::count(s.begin(), s.end(), '\n');
+	}
+};
+
+
+/**
+ * \brief Thread writing numbered records, used to test concurrent logging.
+ */
+class LoggerTestThread : public Thread {
+private:
+	int id_;
+	int count_;
+
+public:
+	LoggerTestThread(int id, int count) : Thread(false), id_(id), count_(count)
+	{
+		start();
+	}
+	
+	virtual void* run()
+	{
+		for (int i = 0; i < count_; i++)
+			LOG_INFO("thread " << id_ << " record " << i << " end");
+		return NULL;
+	}
+};
+
+
+/**
+ * \brief Thread writing the same record, used to test collapsing.
+ */
+class LoggerRepeatThread : public Thread {
+private:
+	int count_;
+
+public:
+	LoggerRepeatThread(int count) : Thread(false), count_(count)
+	{
+		start();
+	}
+	
+	virtual void* run()
+	{
+		for (int i = 0; i < count_; i++)
+			LOG_WARNING("the same message");
+		return NULL;
+	}
+};
+
+
+/**
+ * \todo Write documentation for class LoggerTest.
+ */
+class LoggerTest : public TestCase {
+private:
+	Ref<LoggerTestOutput> output_;
+
+public:
+	/**
+	 * Constructor.
+	 */
+	LoggerTest()
+	{
+		TEST_ADD(LoggerTest, testRecord);
+		TEST_ADD(LoggerTest, testAsync);
+		TEST_ADD(LoggerTest, testAsyncDrop);
+		TEST_ADD(LoggerTest, testThreshold);
+		TEST_ADD(LoggerTest, testSiteEnabled);
+		TEST_ADD(LoggerTest, testConcurrent);
+		TEST_ADD(LoggerTest, testRateLimit);
+		TEST_ADD(LoggerTest, testConcurrentRateLimit);
+		TEST_ADD(LoggerTest, testSampling);
+		TEST_ADD(LoggerTest, testCollapseRepeats);
+		TEST_ADD(LoggerTest, testRepeatInterval);
+		TEST_ADD(LoggerTest, testStopCollapsing);
+	}
+	
+	int sideEffect(int *counter) { return ++(*counter); }
+	
+	virtual void setUp()
+	{
+		output_ = new LoggerTestOutput();
+		Logger::clearConfig();
+		Logger::addOutput(LOG_LVL_DEBUG, output_);
+	}
+	
+	virtual void tearDown()
+	{
+		Logger::stopAsync();
+		Logger::setThreshold(LOG_LVL_DEBUG);
+		Logger::resetSites();
+		Logger::setSampling(LOG_LVL_INFO, 1.0);
+		Logger::setCollapseRepeats(false);
+		Logger::defaultConfig();
+		output_ = NULL;
+	}
+	
+	void testRecord()
+	{
+		LOG_ERROR("first " << 1);
+		LOG_WARNING("second " << 2.5);
+		
+		std::string s = output_->str();
+		TEST_EQUALS(2, output_->countLines(), "two records should have been written");
+		TEST_ASSERT(Strings::contains(s, "ERROR]  first 1\n"), "the first record is malformed");
+		TEST_ASSERT(Strings::contains(s, "WARNING]  second 2.5\n"), "the second record is malformed");
+	}
+	
+	void testAsync()
+	{
+		Logger::startAsync(16, LOG_OVERFLOW_BLOCK);
+		TEST_ASSERT(Logger::isAsync(), "the logger should be asynchronous");
+		
+		for (int i = 0; i < 1000; i++)
+			LOG_INFO("record " << i);
+		
+		Logger::stopAsync();
+		TEST_ASSERT(!Logger::isAsync(), "the logger should be synchronous again");
+		
+		TEST_EQUALS(1000, output_->countLines(), "all records should have been written");
+		TEST_ASSERT(Strings::contains(output_->str(), "INFO]  record 999\n"),
+		            "the last record is missing");
+	}
+	
+	void testAsyncDrop()
+	{
+		long droppedBefore = Logger::getDroppedCount();
+		
+		Logger::startAsync(1, LOG_OVERFLOW_DROP);
+		for (int i = 0; i < 1000; i++)
+			LOG_INFO("record " << i);
+		Logger::stopAsync();
+		
+		long dropped = Logger::getDroppedCount() - droppedBefore;
+		TEST_EQUALS(1000, output_->countLines() + dropped,
+		            "every record should be either written or dropped");
+	}
+	
+	void testThreshold()
+	{
+		int evaluated = 0;
+		
+		Logger::setThreshold(LOG_LVL_WARNING);
+		TEST_ASSERT(Logger::isEnabled(LOG_LVL_WARNING), "warnings should be enabled");
+		TEST_ASSERT(!Logger::isEnabled(LOG_LVL_INFO), "info should be disabled");
+		
+		LOG_INFO("evaluated " << sideEffect(&evaluated));
+		LOG_WARNING("evaluated " << sideEffect(&evaluated));
+		
+		TEST_EQUALS(1, evaluated, "only the enabled message should be evaluated");
+		TEST_EQUALS(1, output_->countLines(), "only the warning should be written");
+		
+		Logger::clearConfig();
+		TEST_ASSERT(!Logger::isEnabled(LOG_LVL_ERROR), "levels without outputs should be disabled");
+	}
+	
+	void testSiteEnabled()
+	{
+		int evaluated = 0;
+		
+		Logger::setSiteEnabled("LoggerTest.h", 0, false);
+		for (int i = 0; i < 3; i++)
+			LOG_ERROR("evaluated " << sideEffect(&evaluated));
+		TEST_EQUALS(0, evaluated, "disabled site should not evaluate its message");
+		
+		Logger::resetSites();
+		LOG_ERROR("evaluated " << sideEffect(&evaluated));
+		TEST_EQUALS(1, evaluated, "re-enabled site should log");
+		TEST_EQUALS(1, output_->countLines(), "one record should be written");
+	}
+	
+	void testConcurrent()
+	{
+		const int threads = 4;
+		const int count   = 500;
+		
+		vector<LoggerTestThread*> writers;
+		for (int i = 0; i < threads; i++)
+			writers.push_back(new LoggerTestThread(i, count));
+		
+		// Reconfigure while the threads are logging.
+		for (int i = 0; i < 20; i++) {
+			Ref<Output> extra = new LoggerTestOutput();
+			Logger::getLogger(LOG_LVL_INFO).addOutput(extra);
+			Logger::getLogger(LOG_LVL_INFO).clearOutputs();
+			Logger::getLogger(LOG_LVL_INFO).addOutput(output_.getPtr());
+		}
+		
+		FOR_EACH(writers, writer) {
+			(*writer)->join();
+			delete *writer;
+		}
+		
+		std::istringstream lines(output_->str());
+		std::string line;
+		int records = 0;
+		while (std::getline(lines, line)) {
+			TEST_ASSERT(Strings::contains(line, "INFO]  thread ") &&
+			            Strings::endsWith(line, " end"),
+			            "records of different threads were interleaved");
+			records++;
+		}
+		TEST_ASSERT(records > 0, "no records were written");
+	}
+	
+	void testRateLimit()
+	{
+		int evaluated = 0;
+		long suppressed = Logger::getSuppressedCount();
+		
+		Logger::setRateLimit("LoggerTest.h", 0, 0.001, 5);
+		for (int i = 0; i < 100; i++)
+			LOG_WARNING("evaluated " << sideEffect(&evaluated));
+		
+		TEST_EQUALS(5, evaluated, "only a burst of records should be evaluated");
+		TEST_EQUALS(5, output_->countLines(), "only a burst of records should be written");
+		TEST_EQUALS(95L, Logger::getSuppressedCount() - suppressed,
+		            "the other records should be counted as suppressed");
+	}
+	
+	void testConcurrentRateLimit()
+	{
+		long suppressed = Logger::getSuppressedCount();
+		
+		Logger::setRateLimit("LoggerTest.h", 0, 0.001, 5);
+		vector<LoggerTestThread*> writers;
+		for (int i = 0; i < 4; i++)
+			writers.push_back(new LoggerTestThread(i, 500));
+		FOR_EACH(writers, writer) {
+			(*writer)->join();
+			delete *writer;
+		}
+		
+		TEST_EQUALS(5, output_->countLines(), "the threads should share one burst");
+		TEST_EQUALS(1995L, Logger::getSuppressedCount() - suppressed,
+		            "the other records should be counted as suppressed");
+	}
+	
+	void testSampling()
+	{
+		Logger::setSampling(LOG_LVL_INFO, 0.0);
+		for (int i = 0; i < 100; i++)
+			LOG_INFO("sampled " << i);
+		TEST_EQUALS(0, output_->countLines(), "no records should be sampled");
+		
+		Logger::setSampling(LOG_LVL_INFO, 0.5);
+		for (int i = 0; i < 1000; i++)
+			LOG_INFO("sampled " << i);
+		int lines = output_->countLines();
+		TEST_ASSERT((lines > 300) && (lines < 700), "about half of the records should be sampled");
+	}
+	
+	void testCollapseRepeats()
+	{
+		Logger::setCollapseRepeats(true);
+		for (int i = 0; i < 10; i++)
+			LOG_WARNING("the same message");
+		LOG_WARNING("another message");
+		
+		TEST_EQUALS(3, output_->countLines(), "repeated records should be collapsed");
+		TEST_ASSERT(Strings::contains(output_->str(), "]  last message repeated 9 times\n"),
+		            "the number of repeats should be reported");
+	}
+	
+	void testRepeatInterval()
+	{
+		Logger::setCollapseRepeats(true, 20);
+		for (int i = 0; i < 5; i++)
+			LOG_WARNING("a burst");
+		
+		for (int i = 0; (i < 100) && (output_->countLines() < 2); i++)
+			usleep(10000);
+		TEST_ASSERT(Strings::contains(output_->str(), "]  last message repeated 4 times\n"),
+		            "the repeats should be reported without another record");
+	}
+	
+	void testStopCollapsing()
+	{
+		Logger::setCollapseRepeats(true);
+		vector<LoggerRepeatThread*> writers;
+		for (int i = 0; i < 4; i++)
+			writers.push_back(new LoggerRepeatThread(2000));
+		usleep(1000);
+		Logger::setCollapseRepeats(false);
+		FOR_EACH(writers, writer) {
+			(*writer)->join();
+			delete *writer;
+		}
+		
+		std::istringstream lines(output_->str());
+		std::string line;
+		int records = 0;
+		while (std::getline(lines, line)) {
+			const std::string repeated = "last message repeated ";
+			size_t found = line.find(repeated);
+			if (found != std::string::npos)
+				records += atoi(line.c_str() + found + repeated.size());
+			else
+				records++;
+		}
+		TEST_EQUALS(8000, records, "every record should be written or reported as a repeat");
+	}
+};
+
+RUN_SUITE(LoggerTest);
+
+
+/**
+ * \brief Tests writing and decoding of the binary log.
+ */
+class BinaryLogTest : public TestCase {
+public:
+	BinaryLogTest()
+	{
+		TEST_ADD(BinaryLogTest, testRoundTrip);
+		TEST_ADD(BinaryLogTest, testFormat);
+		TEST_ADD(BinaryLogTest, testSeveralLogs);
+	}
+
+	virtual void tearDown()
+	{
+		BinaryLog::close();
+		BinaryLog::setThreshold(LOG_LVL_DEBUG);
+	}
+
+	void testRoundTrip()
+	{
+		Ref<LoggerTestOutput> output = new LoggerTestOutput();
+		BinaryLog::open(output);
+
+		std::string name = "world";
+		for (int i = 0; i < 3; i++)
+			BINLOG_INFO("hello %s #%d (%.2f)", name, i, i * 0.5);
+		BINLOG_ERROR("no arguments");
+
+		BinaryLog::setThreshold(LOG_LVL_WARNING);
+		BINLOG_INFO("filtered %d", 1);
+		BinaryLog::close();
+
+		std::istringstream input(output->str());
+		BinaryLogDecoder decoder;
+		TEST_ASSERT(decoder.read(input), "the binary log could not be decoded");
+		TEST_EQUALS(4, (int)decoder.getRecords().size(), "four records should have been written");
+		TEST_EQUALS(std::string("hello world #2 (1.00)"),
+		            decoder.formatMessage(decoder.getRecords()[2]),
+		            "the record was not decoded correctly");
+
+		std::ostringstream text;
+		decoder.print(text);
+		TEST_ASSERT(Strings::contains(text.str(), "ERROR LoggerTest.h"), "the header is malformed");
+		TEST_ASSERT(Strings::contains(text.str(), "]  no arguments\n"), "the last record is missing");
+	}
+
+	void testFormat()
+	{
+		std::vector<BinaryLogDecoder::Arg> args(3);
+		args[0].type       = BINLOG_ARG_INT;
+		args[0].intValue   = -42;
+		args[1].type       = BINLOG_ARG_UINT;
+		args[1].uintValue  = 255;
+		args[2].type       = BINLOG_ARG_STRING;
+		args[2].stringValue = "abc";
+
+		TEST_EQUALS(std::string("-42 0xff 100% [  abc] <missing>"),
+		            BinaryLogDecoder::format("%ld %#lx 100%% [%5s] %d", args),
+		            "the format was not expanded correctly");
+	}
+
+	/**
+	 * A log with a single site and record, as another process would
+	 * write it.
+	 */
+	static std::string makeLog(const std::string &format, char timestamp)
+	{
+		std::string log(CPPAPP_BINLOG_MAGIC, CPPAPP_BINLOG_MAGIC_SIZE);
+		log += BINLOG_ITEM_SITE;
+		log += std::string("\0\3\1", 3) + '\1' + "f" + (char)format.size() + format;
+		log += BINLOG_ITEM_THREAD;
+		log += '\1';
+		log += BINLOG_ITEM_RECORD;
+		log += '\0';
+		log += std::string(1, timestamp) + std::string(7, '\0');
+		log += '\0';
+		return log;
+	}
+
+	void testSeveralLogs()
+	{
+		std::istringstream first(makeLog("first", 1));
+		std::istringstream second(makeLog("second", 2));
+		BinaryLogDecoder decoder;
+		TEST_ASSERT(decoder.read(first), "the first log could not be decoded");
+		TEST_ASSERT(decoder.read(second), "the second log could not be decoded");
+
+		TEST_EQUALS(std::string("first"), decoder.formatMessage(decoder.getRecords()[0]),
+		            "the first log's record should use its own site");
+		TEST_EQUALS(std::string("second"), decoder.formatMessage(decoder.getRecords()[1]),
+		            "the second log's record should use its own site");
+
+		std::ostringstream text;
+		decoder.print(text);
+		TEST_ASSERT(Strings::contains(text.str(), " #0.1]  first\n"), "threads of the first log should be numbered by file");
+		TEST_ASSERT(Strings::contains(text.str(), " #1.1]  second\n"), "threads of the second log should be numbered by file");
+	}
+};
+
+RUN_SUITE(BinaryLogTest);
+
+
+/**
+ * \brief Tests rotation and retention of RotatingFileOutput.
+ */
+class RotatingFileOutputTest : public TestCase {
+private:
+	std::string dir_;
+
+	std::string readFile(const std::string &path)
+	{
+		std::ifstream in(path.c_str());
+		std::ostringstream s;
+		s << in.rdbuf();
+		return s.str();
+	}
+
+public:
+	RotatingFileOutputTest()
+	{
+		TEST_ADD(RotatingFileOutputTest, testRotation);
+		TEST_ADD(RotatingFileOutputTest, testReopen);
+		TEST_ADD(RotatingFileOutputTest, testRecovery);
+	}
+
+	virtual void setUp()
+	{
+		char dir[] = "/tmp/cppapp-rotate-XXXXXX";
+		TEST_ASSERT(mkdtemp(dir) != NULL, "could not create a temporary directory");
+		dir_ = dir;
+	}
+
+	virtual void tearDown()
+	{
+		std::string command = "rm -rf " + dir_;
+		if (system(command.c_str()) != 0)
+			std::cerr << "could not remove " << dir_ << std::endl;
+	}
+
+	void testRotation()
+	{
+		std::string fileName = dir_ + "/test.log";
+		Ref<RotatingFileOutput> output = new RotatingFileOutput(fileName, 1000, 3, 0,
+		                                                        ROTATE_COMPRESS_NONE, 256);
+
+		std::ostream &out = *output->getStream();
+		for (int i = 0; i < 100; i++) {
+			std::string record = "record number " + std::string(30, '0' + i % 10) + "\n";
+			out.write(record.data(), record.size());
+		}
+		output->close();
+
+		std::vector<std::string> files = output->getRotatedFiles();
+		TEST_EQUALS(3, (int)files.size(), "only three rotated files should be kept");
+		files.push_back(fileName);
+		FOR_EACH(files, file) {
+			std::string content = readFile(*file);
+			TEST_ASSERT(content.size() <= 1000, "the file is larger than the limit");
+			TEST_ASSERT(!content.empty() && (content[content.size() - 1] == '\n'),
+			            "a record was split between two files");
+		}
+	}
+
+	void testReopen()
+	{
+		std::string fileName = dir_ + "/test.log";
+		Ref<RotatingFileOutput> output = new RotatingFileOutput(fileName, 1000, 3, 0,
+		                                                        ROTATE_COMPRESS_NONE, 256);
+
+		std::string record(600, 'x');
+		output->getStream()->write(record.data(), record.size());
+		output->close();
+		output->getStream()->write(record.data(), record.size());
+		output->close();
+
+		TEST_EQUALS(1, (int)output->getRotatedFiles().size(), "the reopened file should be rotated");
+		TEST_EQUALS(600, (int)readFile(fileName).size(), "the file is larger than the limit");
+	}
+
+	void testRecovery()
+	{
+		std::string dir      = dir_ + "/missing";
+		std::string fileName = dir + "/test.log";
+		Ref<RotatingFileOutput> output = new RotatingFileOutput(fileName, 1000, 3, 0,
+		                                                        ROTATE_COMPRESS_NONE, 1);
+
+		*output->getStream() << "lost\n" << std::flush;
+		TEST_ASSERT(mkdir(dir.c_str(), 0755) == 0, "could not create the directory");
+		*output->getStream() << "written\n" << std::flush;
+		output->close();
+
+		TEST_EQUALS(std::string("written\n"), readFile(fileName), "the output should recover after a failed write");
+	}
+};
+
+RUN_SUITE(RotatingFileOutputTest);
+
+
+#endif /* end of include guard: LOGGERTEST_Q2VN7MXA */
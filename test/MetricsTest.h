@@ -0,0 +1,110 @@
+/**
+ * \file   MetricsTest.h
+ * \author Jan Milík <milikjan@fit.cvut.cz>
+ * \date   2026-10-19
+ *
+ * \brief  Header file for the MetricsTest class.
+ */
+
+#ifndef METRICSTEST_H7QX2MVD
+#define METRICSTEST_H7QX2MVD
+
+
+#include <sstream>
+#include <stdexcept>
+
+#include <cppapp/cppapp.h>
+using namespace cppapp;
+
+
+class MetricsTestThread : public Thread {
+public:
+	MetricCounter *counter;
+
+	MetricsTestThread(MetricCounter *counter) :
+		Thread(false), counter(counter)
+	{
+		start();
+	}
+
+	virtual void* run()
+	{
+		for (int i = 0; i < 10000; i++)
+			counter->add();
+		return NULL;
+	}
+};
+
+
+/**
+ * \brief Tests the metrics registry and the Prometheus exporter.
+ */
+class MetricsTest : public TestCase {
+public:
+	MetricsTest()
+	{
+		TEST_ADD(MetricsTest, testCounter);
+		TEST_ADD(MetricsTest, testRegistry);
+		TEST_ADD(MetricsTest, testExporter);
+	}
+
+	void testCounter()
+	{
+		MetricsRegistry registry;
+		MetricCounter *counter = registry.counter("test_total");
+
+		std::vector<MetricsTestThread*> threads;
+		for (int i = 0; i < 4; i++)
+			threads.push_back(new MetricsTestThread(counter));
+		FOR_EACH(threads, thread) {
+			(*thread)->join();
+			delete *thread;
+		}
+
+		TEST_EQUALS(40000, (int)counter->get(), "all increments should have been counted");
+		TEST_EQUALS(0, (int)((size_t)counter % CPPAPP_CACHE_LINE),
+		            "the counter should be aligned to a cache line");
+	}
+
+	void testRegistry()
+	{
+		MetricsRegistry registry;
+		MetricCounter *counter = registry.counter("test_total", "Test counter.");
+
+		TEST_ASSERT(registry.counter("test_total") == counter,
+		            "the same name should return the same counter");
+		TEST_ASSERT(registry.get("test_missing") == NULL, "unknown metric should be null");
+
+		bool thrown = false;
+		try {
+			registry.gauge("test_total");
+		} catch (std::invalid_argument &e) {
+			thrown = true;
+		}
+		TEST_ASSERT(thrown, "a name registered with another type should throw");
+	}
+
+	void testExporter()
+	{
+		JSONParser parser;
+		parser.parse(new StreamInput("<test>", "{\"a\": [1, 2]}"));
+
+		Ref<LoggerTestOutput> output = new LoggerTestOutput();
+		Ref<PrometheusExporter> exporter = new PrometheusExporter(output.as<Output>());
+		exporter->write();
+
+		std::string text = output->str();
+		TEST_ASSERT(text.find("# TYPE cppapp_json_documents_total counter\n") != std::string::npos,
+		            "the exporter should write the type of the JSON counter");
+		TEST_ASSERT(text.find("\ncppapp_json_documents_total ") != std::string::npos,
+		            "the exporter should write the JSON counter");
+		TEST_ASSERT(text.find("cppapp_objects_created_total ") != std::string::npos,
+		            "the exporter should write the object counter");
+	}
+};
+
+
+RUN_SUITE(MetricsTest);
+
+
+#endif /* end of include guard: METRICSTEST_H7QX2MVD */
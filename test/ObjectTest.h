@@ -10,10 +10,61 @@
 #define OBJECTTEST_LCLNOC97
 
 
+#include <sstream>
+
 #include <cppapp/cppapp.h>
 using namespace cppapp;
 
 
+class RegistryTestObject : public Object {
+public:
+	char data[100];
+};
+
+
+class WeakTestObject : public Object {
+public:
+	static int destroyed;
+	
+	int value;
+	
+	WeakTestObject(int value = 0) : value(value) {}
+	virtual ~WeakTestObject() { __sync_fetch_and_add(&destroyed, 1); }
+};
+
+int WeakTestObject::destroyed = 0;
+
+
+/**
+ * \brief Upgrades a weak reference while the main thread releases the
+ *        object.
+ */
+class WeakTestThread : public Thread {
+public:
+	WeakRef<WeakTestObject> weak;
+	volatile bool           locked;
+	
+	WeakTestThread(Ref<WeakTestObject> obj) :
+		Thread(false), weak(obj), locked(false)
+	{}
+	
+	virtual void* run()
+	{
+		Ref<WeakTestObject> obj = weak.lock();
+		locked = obj.isNotNull();
+		if (obj.isNotNull())
+			obj->value++;
+		return NULL;
+	}
+};
+
+
+class CastTestDict : public DynDict {
+public:
+	CastTestDict() : DynDict(TextLoc("<test>")) {}
+};
+
+
 /**
  * \todo Write documentation for class ObjectTest.
  */
@@ -26,6 +77,12 @@ public:
 	{
 		TEST_ADD(ObjectTest, testStackAllocation);
 		TEST_ADD(ObjectTest, testHeapAllocation);
+		TEST_ADD(ObjectTest, testRing);
+		TEST_ADD(ObjectTest, testRegistry);
+		TEST_ADD(ObjectTest, testFastCast);
+		TEST_ADD(ObjectTest, testWeakRef);
+		TEST_ADD(ObjectTest, testWeakRace);
+		TEST_ADD(ObjectTest, testWeakCache);
 	}
 	
 	void testStackAllocation()
@@ -41,6 +98,142 @@ public:
 		Ref<Object> obj = new Object();
 		obj->checkHealth();
 	}
+	
+	void testRing()
+	{
+		RingItem<int> head;
+		TEST_ASSERT(head.isAlone(), "a new item should be a ring of its own");
+		
+		{
+			RingItem<int> a, b;
+			head.append(a);
+			head.append(b);
+			TEST_ASSERT(head.next() == &b, "appended item should follow the head");
+			TEST_ASSERT(b.next() == &a, "the older item should follow the newer one");
+			TEST_ASSERT(a.next() == &head, "the ring should be closed");
+			
+			b.remove();
+			TEST_ASSERT(b.isAlone(), "a removed item should be alone");
+			TEST_ASSERT(head.next() == &a, "the removed item should be unlinked");
+		}
+		
+		TEST_ASSERT(head.isAlone(), "destroyed items should leave the ring");
+	}
+	
+	void testRegistry()
+	{
+		ObjectRegistry::enable();
+		long before = ObjectRegistry::getLiveCount();
+		
+		std::vector<Ref<RegistryTestObject> > objects;
+		for (int i = 0; i < 3; i++)
+			objects.push_back(new RegistryTestObject());
+		
+		TEST_EQUALS(before + 3, ObjectRegistry::getLiveCount(), "new objects should be tracked");
+		
+		std::vector<ObjectClassStats> classes = ObjectRegistry::getClassStats();
+		bool found = false;
+		FOR_EACH(classes, stats) {
+			if (stats->className == "RegistryTestObject") {
+				found = true;
+				TEST_EQUALS(3, (int)stats->count, "all instances should be counted");
+				TEST_EQUALS((int)(3 * sizeof(RegistryTestObject)), (int)stats->bytes,
+				            "the allocation sizes should be recorded");
+			}
+		}
+		TEST_ASSERT(found, "the class should be reported");
+		
+		std::vector<ObjectSiteStats> sites = ObjectRegistry::getSiteStats();
+		TEST_ASSERT(!sites.empty() && (sites[0].count >= 3), "the allocation site should be reported");
+		
+		std::ostringstream report;
+		ObjectRegistry::writeReport(report);
+		TEST_ASSERT(report.str().find("RegistryTestObject") != std::string::npos,
+		            "the report should list the class");
+		
+		objects.clear();
+		ObjectRegistry::disable();
+		TEST_EQUALS(before, ObjectRegistry::getLiveCount(), "destroyed objects should be untracked");
+	}
+	
+	void testFastCast()
+	{
+		Ref<CastTestDict> dict = new CastTestDict();
+		Object *obj = dict.getPtr();
+		
+		TEST_ASSERT(DynDict::staticClassInfo()->isA(DynObject::staticClassInfo()),
+		            "a dictionary should be a dynamic object");
+		TEST_ASSERT(!DynObject::staticClassInfo()->isA(DynDict::staticClassInfo()),
+		            "a dynamic object should not be a dictionary");
+		TEST_ASSERT(obj->getClassInfo() == DynDict::staticClassInfo(),
+		            "an undeclared class should have the identity of its declared base");
+		
+		TEST_ASSERT(fast_cast<DynObject>(obj) == dict.getPtr(), "downcast to a base should succeed");
+		TEST_ASSERT(fast_cast<DynDict>(obj) == dict.getPtr(), "downcast to the class should succeed");
+		TEST_ASSERT(fast_cast<CastTestDict>(obj) == dict.getPtr(), "cast to an undeclared class should succeed");
+		TEST_ASSERT(fast_cast<DynList>(obj) == NULL, "downcast to a sibling should fail");
+		TEST_ASSERT(fast_cast<DynDict>((Object*)NULL) == NULL, "null should stay null");
+		
+		Ref<DynObject> value = dict.as<DynObject>();
+		TEST_ASSERT(value.as<DynDict>().isNotNull(), "Ref::as should cast to the class");
+		TEST_ASSERT(value.as<DynString>().isNull(), "Ref::as should fail for other classes");
+	}
+	
+	void testWeakRef()
+	{
+		WeakTestObject::destroyed = 0;
+		
+		Ref<WeakTestObject>     obj = new WeakTestObject(42);
+		WeakRef<WeakTestObject> weak(obj);
+		WeakRef<WeakTestObject> copy = weak;
+		
+		TEST_ASSERT(!weak.isExpired(), "the object should be alive");
+		TEST_EQUALS(42, weak.lock()->value, "lock should return the object");
+		
+		obj = NULL;
+		TEST_EQUALS(1, WeakTestObject::destroyed, "weak references should not keep the object alive");
+		TEST_ASSERT(weak.isExpired(), "the reference should be expired");
+		TEST_ASSERT(weak.lock().isNull(), "lock should fail once the object is gone");
+		TEST_ASSERT(copy.lock().isNull(), "copies should expire as well");
+		TEST_ASSERT(!weak.isNull(), "an expired reference is not a null reference");
+		
+		WeakRef<WeakTestObject> empty;
+		TEST_ASSERT(empty.isNull() && empty.lock().isNull(), "an empty reference should lock to null");
+	}
+	
+	void testWeakRace()
+	{
+		for (int i = 0; i < 200; i++) {
+			WeakTestObject::destroyed = 0;
+			Ref<WeakTestObject> obj = new WeakTestObject();
+			WeakTestThread thread(obj);
+			thread.start();
+			obj = NULL;
+			thread.join();
+			
+			TEST_EQUALS(1, WeakTestObject::destroyed, "the object should be destroyed exactly once");
+			TEST_ASSERT(thread.weak.lock().isNull(), "the reference should be expired");
+		}
+	}
+	
+	void testWeakCache()
+	{
+		WeakCache<int, WeakTestObject> cache(2);
+		
+		Ref<WeakTestObject> held = new WeakTestObject(1);
+		cache.put(1, held);
+		cache.put(2, new WeakTestObject(2));
+		cache.put(3, new WeakTestObject(3));
+		
+		TEST_EQUALS(2, (int)cache.getCost(), "the cache should keep its capacity");
+		TEST_ASSERT(cache.get(1) == held, "an evicted value held elsewhere should be found");
+		TEST_ASSERT(cache.get(2).isNull(), "an evicted value held only by the cache should be gone");
+		TEST_EQUALS(3, cache.get(3)->value, "a recent value should be kept alive");
+		TEST_EQUALS(2, (int)cache.getCost(), "found values should count against the capacity");
+		
+		cache.remove(1);
+		TEST_ASSERT(cache.get(1).isNull(), "a removed value should not be found");
+	}
 };
 
 RUN_SUITE(ObjectTest);
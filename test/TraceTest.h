@@ -0,0 +1,105 @@
+/**
+ * \file   TraceTest.h
+ * \author Jan Milík <milikjan@fit.cvut.cz>
+ * \date   2026-10-19
+ *
+ * \brief  Header file for the TraceTest class.
+ */
+
+#ifndef TRACETEST_Q6RD3WXN
+#define TRACETEST_Q6RD3WXN
+
+
+#include <sstream>
+
+#include <cppapp/cppapp.h>
+using namespace cppapp;
+
+
+class TraceTestThread : public Thread {
+public:
+	TraceTestThread() : Thread(false)
+	{
+		start();
+	}
+
+	virtual void* run()
+	{
+		TRACE_SCOPE("thread");
+		return NULL;
+	}
+};
+
+
+/**
+ * \brief Tests the trace spans and their export.
+ */
+class TraceTest : public TestCase {
+private:
+	Ref<DynObject> flush()
+	{
+		std::ostringstream output;
+		Tracer::writeJSON(output);
+
+		JSONParser parser;
+		return parser.parse(new StreamInput("<trace>", output.str()));
+	}
+
+	int countEvents(Ref<DynObject> trace, const std::string &name)
+	{
+		Ref<DynObject> events = trace->getStrItem("traceEvents");
+		int count = 0;
+		for (int i = 0; i < events->getSize(); i++) {
+			if (events->getIntItem(i)->getStrString("name", "") == name)
+				count++;
+		}
+		return count;
+	}
+
+public:
+	TraceTest()
+	{
+		TEST_ADD(TraceTest, testDisabled);
+		TEST_ADD(TraceTest, testExport);
+	}
+
+	void testDisabled()
+	{
+		flush();
+		{
+			TRACE_SCOPE("disabled");
+		}
+
+		Ref<DynObject> trace = flush();
+		TEST_ASSERT(trace.isNotNull() && !trace->isError(), "the trace should be valid JSON");
+		TEST_EQUALS(0, countEvents(trace, "disabled"), "no span should be recorded while disabled");
+	}
+
+	void testExport()
+	{
+		Tracer::enable();
+		{
+			TRACE_SCOPE("outer");
+			JSONParser parser;
+			parser.parse(new StreamInput("<test>", "[1, 2, 3]"));
+		}
+		TraceTestThread thread;
+		thread.join();
+		Tracer::disable();
+
+		Ref<DynObject> trace = flush();
+		TEST_ASSERT(trace.isNotNull() && !trace->isError(), "the trace should be valid JSON");
+		TEST_EQUALS(1, countEvents(trace, "outer"), "the outer span should be recorded");
+		TEST_EQUALS(1, countEvents(trace, "JSONParser::parse"), "the parser span should be recorded");
+		TEST_EQUALS(1, countEvents(trace, "thread"), "the span of the exited thread should be recorded");
+
+		trace = flush();
+		TEST_EQUALS(0, countEvents(trace, "outer"), "a flush should drain the buffers");
+	}
+};
+
+
+RUN_SUITE(TraceTest);
+
+
+#endif /* end of include guard: TRACETEST_Q6RD3WXN */
@@ -10,6 +10,12 @@ using namespace cppapp;
 #include "StringUtilsTest.h"
 #include "DynObjectTest.h"
 #include "InjectorTest.h"
+#include "LoggerTest.h"
+#include "ConfigTest.h"
+#include "BenchmarkTest.h"
+#include "ClockTest.h"
+#include "MetricsTest.h"
+#include "TraceTest.h"
 
 
 class BacktraceTest : public TestCase {
@@ -17,6 +23,7 @@ public:
 	BacktraceTest()
 	{
 		TEST_ADD(BacktraceTest, testPrint);
+		TEST_ADD(BacktraceTest, testSymbols);
 	}
 	
 	void testPrint()
@@ -27,6 +34,22 @@ public:
 		bt.get();
 		bt.print(out);
 	}
+	
+	void testSymbols()
+	{
+		Backtrace bt;
+		bt.get();
+		TEST_ASSERT(bt.size() > 0, "the backtrace should not be empty");
+		
+		bool found = false;
+		FOR_EACH(bt, line) {
+			if (line->find("BacktraceTest::testSymbols") != string::npos)
+				found = true;
+		}
+		TEST_ASSERT(found, "the calling function should have been symbolized");
+		TEST_EQUALS(bt[0], Symbolizer::symbolize(bt.getAddresses()[0]),
+		            "the cached line should have been returned");
+	}
 };
 
 RUN_SUITE(BacktraceTest);
@@ -0,0 +1,68 @@
+/**
+ * \file   logdecode.cpp
+ * \author Jan Milík <milikjan@fit.cvut.cz>
+ * \date   2026-10-19
+ *
+ * \brief  Prints binary logs written by cppapp::BinaryLog as text.
+ */
+
+
+#include <cstdlib>
+#include <iostream>
+using namespace std;
+
+#include <cppapp/cppapp.h>
+using namespace cppapp;
+
+
+/**
+ * \brief Decodes binary log files given on the command line (or the
+ *        standard input) and prints their records ordered by time.
+ */
+class App : public AppBase {
+protected:
+	virtual void setUp()
+	{
+		AppBase::setUp();
+		options().setUsage("[OPTIONS] [LOG_FILE ...]");
+	}
+	
+	virtual int onRun()
+	{
+		int result = AppBase::onRun();
+		if (result != EXIT_SUCCESS)
+			return result;
+		
+		BinaryLogDecoder decoder;
+		
+		if (args().empty()) {
+			if (!decoder.read(cin)) {
+				cerr << "<stdin>: " << decoder.getError() << endl;
+				return EXIT_FAILURE;
+			}
+		}
+		
+		FOR_EACH(args(), fileName) {
+			Ref<FileInput> input = new FileInput(*fileName);
+			if (!input->exists()) {
+				cerr << *fileName << ": file does not exist" << endl;
+				return EXIT_FAILURE;
+			}
+			if (!decoder.read(*input->getStream())) {
+				cerr << *fileName << ": " << decoder.getError() << endl;
+				return EXIT_FAILURE;
+			}
+			input->close();
+		}
+		
+		decoder.print(*output()->getStream());
+		
+		return EXIT_SUCCESS;
+	}
+
+public:
+	App() : AppBase(false) {}
+};
+
+
+CPPAPP_BOOTSTRAP;